@@ -90,10 +90,22 @@ pushd example/npi_server2
     make $target |& tee $target.npi_server2.log
 popd
 
+pushd example/mac_sim
+    make $target |& tee $target.mac_sim.log
+popd
+
 pushd example/collector
     make $target |& tee $target.collector.log
 popd
 
+pushd example/nv_migrate
+    make $target |& tee $target.nv_migrate.log
+popd
+
+pushd example/bench
+    make $target |& tee $target.bench.log
+popd
+
 pushd example/cc13xx-sbl/app/linux 
     make $target |& tee $target.bootloader.log
 popd
@@ -199,6 +199,12 @@ extern "C"
 #define MAC_WS_ASYNC_IND_cmd0       0x42
 #define MAC_WS_ASYNC_IND_cmd1       0x93
 
+/*
+ * @brief MAC request command values
+ */
+#define MAC_DATA_REQ_cmd0           0x22
+#define MAC_DATA_REQ_cmd1           0x05
+
 /*! Key Length */
 #define APIMAC_KEY_MAX_LEN  16
 
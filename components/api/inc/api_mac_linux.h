@@ -70,8 +70,239 @@ extern int ApiMacLinux_areq_timeout_mSecs;
 #define DEFAULT_ApiMacLinux_areq_timeout_mSecs  (300)
 #endif //HEADLESS
 
+/*!
+  Most pipelined data requests waiting for the co-processor response
+  (SRSP) at the same time, see ApiMac_mcpsDataReqSubmit(). A request
+  the co-processor accepted waits for its confirm without counting
+  here, the co-processor indirect queue bounds those, a full queue
+  gives a transaction overflow confirm as for ApiMac_mcpsDataReq().
+*/
+extern int ApiMacLinux_dataReq_maxInFlight;
+/*! Default value if not overridden via configuration file */
+#define DEFAULT_ApiMacLinux_dataReq_maxInFlight  8
+
+/*! A pipelined data request without a confirm after this is failed */
+extern int ApiMacLinux_dataReq_timeout_mSecs;
+/*! Default value, longer than the indirect transaction persistence time */
+#define DEFAULT_ApiMacLinux_dataReq_timeout_mSecs  (60 * 1000)
+
+/*!
+  Non-zero: ApiMac_mlmeGetReqXXX() answers from a host side copy of
+  PIB values, see ApiMacLinux_pibCacheVolatile()
+*/
+extern int ApiMacLinux_pibCache_enable;
+/*! Default value if not overridden via configuration file */
+#define DEFAULT_ApiMacLinux_pibCache_enable  1
+
+/*!
+ * @struct api_mac_pib_cache_stats
+ * @brief PIB cache counters, see ApiMacLinux_pibCacheStats()
+ */
+struct api_mac_pib_cache_stats {
+    /*! gets answered from the cache */
+    unsigned hits;
+    /*! gets sent to the co-processor */
+    unsigned misses;
+    /*! values stored by a get or set */
+    unsigned fills;
+    /*! single attributes dropped after a failed set */
+    unsigned invalidates;
+    /*! whole cache dropped, reset, start, association etc */
+    unsigned flushes;
+};
+
 extern struct mt_version_info MT_DEVICE_version_info;
 
+/******************************************************************************
+ Function Prototypes
+ *****************************************************************************/
+
+/*!
+ * @brief Completion callback for the async api mac requests
+ * @param status - the status from the MAC (same as the sync version)
+ * @param pCookie - the cookie given with the request
+ *
+ * Called from the rx thread or an async worker thread of the
+ * API_MAC_msg_interface, see MT_MSG_txrx_done_fn, it must not send a
+ * synchronous request.
+ */
+typedef void ApiMac_asyncDoneFn_t(ApiMac_status_t status, void *pCookie);
+
+/*!
+ * @brief Same as ApiMac_mcpsDataReq() but does not wait for the response
+ * @param pData - pointer to parameter structure, not needed after return
+ * @param pDoneFn - called with the status, may be NULL
+ * @param pCookie - passed to pDoneFn
+ * @return ApiMac_status_success if queued, pDoneFn is called later
+ */
+extern ApiMac_status_t ApiMac_mcpsDataReqAsync(ApiMac_mcpsDataReq_t *pData,
+                                               ApiMac_asyncDoneFn_t *pDoneFn,
+                                               void *pCookie);
+
+/*!
+ * @brief Completion callback for ApiMac_mcpsDataReqSubmit()
+ * @param pCnf - the data confirm for the request
+ * @param is_refused - true: the co-processor refused the request, the
+ *                     confirm was made locally and nothing was sent
+ * @param pCookie - the cookie given with the request
+ *
+ * Called from ApiMac_processIncoming()
+ */
+typedef void ApiMac_dataDoneFn_t(ApiMac_mcpsDataCnf_t *pCnf,
+                                 bool is_refused,
+                                 void *pCookie);
+
+/*!
+ * @brief Send a data request without waiting for the response
+ * @param pData - pointer to parameter structure, not needed after return
+ * @param pDoneFn - called with the data confirm, NULL = the pDataCnfCb
+ *                  callback, as for ApiMac_mcpsDataReq()
+ * @param pCookie - passed to pDoneFn
+ * @return ApiMac_status_success if sent, pDoneFn is called later,
+ *         ApiMac_status_transactionOverflow if
+ *         ApiMacLinux_dataReq_maxInFlight requests are still waiting
+ *         for the response after the srsp timeout,
+ *         ApiMac_status_invalidParameter if the msduHandle is waiting,
+ *         pick handles with ApiMacLinux_dataReqHandleBusy().
+ *
+ * Requests are tracked by msduHandle until the data confirm arrives.
+ * If ApiMacLinux_dataReq_maxInFlight requests wait for the response,
+ * the call waits until one is answered.
+ * A request the co-processor refuses completes with a confirm holding
+ * the response status, one without a confirm after
+ * ApiMacLinux_dataReq_timeout_mSecs with ApiMac_status_transactionExpired.
+ * A request whose response timed out may still have been accepted, so
+ * it keeps its handle until a confirm arrives or it expires.
+ */
+extern ApiMac_status_t ApiMac_mcpsDataReqSubmit(ApiMac_mcpsDataReq_t *pData,
+                                                ApiMac_dataDoneFn_t *pDoneFn,
+                                                void *pCookie);
+
+/*!
+ * @brief How many ApiMac_mcpsDataReqSubmit() requests are waiting?
+ * @return number of requests waiting for a data confirm
+ */
+extern int ApiMacLinux_dataReqInFlight(void);
+
+/*!
+ * @brief Is an ApiMac_mcpsDataReqSubmit() request waiting on a handle?
+ * @param msduHandle - the handle
+ * @return true if the handle cannot be used for a new request yet
+ */
+extern bool ApiMacLinux_dataReqHandleBusy(uint8_t msduHandle);
+
+/*!
+ * @brief Mark a PIB attribute as volatile (never cached) or not
+ * @param attr - attribute id, MAC, FH or security
+ * @param is_volatile - true: always read from the co-processor
+ * @return 0 on success, -1 if the attribute id is not valid
+ *
+ * Values are cached when read and written through when set, the
+ * cache is dropped when the co-processor resets or starts, joins or
+ * leaves a network. Counters and sequence numbers the MAC changes on
+ * its own are volatile by default, mark application specific ones
+ * here before reading them.
+ */
+extern int ApiMacLinux_pibCacheVolatile(int attr, bool is_volatile);
+
+/*!
+ * @brief Drop all cached PIB values
+ */
+extern void ApiMacLinux_pibCacheFlush(void);
+
+/*!
+ * @brief Get the PIB cache counters
+ * @param pStats - filled in
+ */
+extern void ApiMacLinux_pibCacheStats(struct api_mac_pib_cache_stats *pStats);
+
+/*!
+ * @brief Send several data requests to the co-processor in one write
+ * @param pReqs - the requests, not needed after return
+ * @param n - number of requests
+ * @param pDoneFn - called with each data confirm, NULL = the pDataCnfCb
+ *                  callback, see ApiMac_mcpsDataReqSubmit()
+ * @param ppCookies - passed to pDoneFn, one per request, may be NULL
+ * @param pStatus - filled in with the status of each request, the same
+ *                  as ApiMac_mcpsDataReq() returns
+ * @return number of requests the co-processor accepted
+ *
+ * The requests are written together (see MT_MSG_txrxBatch()) and the
+ * responses collected after. Accepted requests are tracked by msduHandle
+ * as for ApiMac_mcpsDataReqSubmit(), only those get a confirm. A request
+ * without a response is counted as accepted, it keeps its handle until
+ * a confirm arrives or it expires.
+ */
+extern int ApiMac_mcpsDataReqBatch(ApiMac_mcpsDataReq_t *pReqs,
+                                   int n,
+                                   ApiMac_dataDoneFn_t *pDoneFn,
+                                   void **ppCookies,
+                                   ApiMac_status_t *pStatus);
+
+/*!
+ * @brief Same as ApiMac_mcpsPurgeReq() but does not wait for the response
+ * @param msduHandle - the handle of the data request to purge
+ * @param pDoneFn - called with the status, may be NULL
+ * @param pCookie - passed to pDoneFn
+ * @return ApiMac_status_success if queued, pDoneFn is called later
+ */
+extern ApiMac_status_t ApiMac_mcpsPurgeReqAsync(uint8_t msduHandle,
+                                                ApiMac_asyncDoneFn_t *pDoneFn,
+                                                void *pCookie);
+
+/* forward declaration */
+struct mt_msg;
+
+/*!
+ * @brief Application handler for an AREQ, see ApiMacLinux_registerAreqHandler()
+ * @param pMsg - the message, the payload is read with MT_MSG_rdU8() etc.
+ * @param pCookie - the cookie given when registering
+ *
+ * Called from ApiMac_processIncoming(), the message is released after
+ * the handler returns.
+ */
+typedef void ApiMacLinux_areqHandler_t(struct mt_msg *pMsg, void *pCookie);
+
+/*!
+ * @brief Attach an application handler to an AREQ (cmd0, cmd1)
+ * @param cmd0 - command 0 of the AREQ
+ * @param cmd1 - command 1 of the AREQ
+ * @param pDbgName - name used in logs, may be NULL, must remain valid
+ * @param pFn - the handler, NULL restores the built in handler (if any)
+ * @param pCookie - passed to pFn
+ * @return 0 on success
+ *
+ * An application handler replaces the built in handler for that AREQ.
+ * Call before ApiMac_init(), the handlers are looked up without a lock
+ * once messages arrive; registering later is a bug.
+ */
+extern int ApiMacLinux_registerAreqHandler(int cmd0, int cmd1,
+                                           const char *pDbgName,
+                                           ApiMacLinux_areqHandler_t *pFn,
+                                           void *pCookie);
+
+/*!
+ * @brief Add the built in message schemas to the debug decoder
+ * @return number of messages added, or -1 on error
+ *
+ * Messages already described by a msg-dbg-data file are not changed.
+ * Call after loading those files, before MT_MSG_dbg_buildIndex().
+ */
+extern int ApiMacLinux_dbgAddSchemas(void);
+
+/* forward declaration */
+struct mt_msg_schema;
+
+/*!
+ * @brief Find the built in schema of a message
+ * @param cmd0 - command 0 of the message
+ * @param cmd1 - command 1 of the message
+ * @return the compiled schema, NULL if there is none
+ *
+ * For tools that build or parse messages the way this API does.
+ */
+extern struct mt_msg_schema *ApiMacLinux_findSchema(int cmd0, int cmd1);
+
 #endif // API_MAC_LINUX_H
 
 /*
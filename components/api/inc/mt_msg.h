@@ -91,6 +91,20 @@ struct ini_parser;
 #define MT_MSG_EXT_STATUS_frag_aborted         7
 #define MT_MSG_EXT_STATUS_unsupported_ack      8
 
+/*
+ * @def MT_MSG_FRAG_MAX_BLOCKS
+ * @brief The fragment block number is a single byte on the wire
+ */
+#define MT_MSG_FRAG_MAX_BLOCKS  256
+
+/*
+ * @def MT_MSG_FRAG_MAX_WINDOW
+ * @brief Maximum number of fragment blocks in flight (before an ack)
+ */
+#if !defined(MT_MSG_FRAG_MAX_WINDOW)
+#define MT_MSG_FRAG_MAX_WINDOW  32
+#endif
+
 /*
  * @brief MT SYS interface command values
  */
@@ -125,17 +139,397 @@ struct ini_parser;
 #define LOG_DBG_MT_MSG_fields   _bitN(LOG_DBG_MT_bitnum_first + 3)
 
 #define LOG_DBG_MT_MSG_decode   _bitN(LOG_DBG_MT_bitnum_first + 4)
+/*
+ * @def LOG_DBG_MT_MSG_pool - Log message pool (allocator) statistics
+ */
+#define LOG_DBG_MT_MSG_pool     _bitN(LOG_DBG_MT_bitnum_first + 5)
+/*
+ * @def LOG_DBG_MT_MSG_latency - Log message latency histograms
+ */
+#define LOG_DBG_MT_MSG_latency  _bitN(LOG_DBG_MT_bitnum_first + 6)
+
+/*
+ * Message buffers come from a pool with a few fixed size classes.
+ * A message is allocated from the smallest class that can hold the
+ * worst case frame (sync, 2 len bytes, cmd0, cmd1, payload, chksum)
+ * Messages of unknown length (ie: rx messages) use the largest class.
+ *
+ * Released messages are kept on a per class free list, up to the
+ * limit below, then they are returned to the heap.
+ *
+ * The "share" class has no io buffer, it holds the headers created
+ * by MT_MSG_share(), these refer to the io buffer of another message.
+ */
+#define MT_MSG_POOL_SMALL_SIZE      128
+#define MT_MSG_POOL_MEDIUM_SIZE     512
+#define MT_MSG_POOL_LARGE_SIZE      __4K
+
+#if !defined(MT_MSG_POOL_SMALL_MAX_FREE)
+#define MT_MSG_POOL_SMALL_MAX_FREE  256
+#endif
+#if !defined(MT_MSG_POOL_MEDIUM_MAX_FREE)
+#define MT_MSG_POOL_MEDIUM_MAX_FREE 64
+#endif
+#if !defined(MT_MSG_POOL_LARGE_MAX_FREE)
+#define MT_MSG_POOL_LARGE_MAX_FREE  16
+#endif
+#if !defined(MT_MSG_POOL_SHARE_MAX_FREE)
+#define MT_MSG_POOL_SHARE_MAX_FREE  256
+#endif
+
+/*
+ * @enum mt_msg_pool_class
+ * @brief Size classes for the message pool
+ */
+enum mt_msg_pool_class {
+    MT_MSG_POOL_small,
+    MT_MSG_POOL_medium,
+    MT_MSG_POOL_large,
+    /* header only, see MT_MSG_share() */
+    MT_MSG_POOL_share,
+    /* must be last */
+    MT_MSG_POOL_nClasses
+};
+
+/*
+ * @struct mt_msg_pool_stats
+ * @brief Statistics for one message pool size class
+ */
+struct mt_msg_pool_stats {
+    /*! name of this size class */
+    const char *dbg_name;
+
+    /*! size of the io buffer in this class */
+    int buf_size;
+
+    /*! allocations satisfied from the free list */
+    unsigned hits;
+
+    /*! allocations that required a heap allocation */
+    unsigned misses;
+
+    /*! released messages returned to the heap (free list was full) */
+    unsigned trims;
+
+    /*! messages currently allocated (in use) */
+    unsigned in_use;
+
+    /*! largest value in_use has ever been */
+    unsigned high_water;
+
+    /*! messages currently on the free list */
+    unsigned n_free;
+};
+
+/* forward */
+struct mt_msg;
+
+/*
+ * @enum mt_msg_stamp
+ * @brief Points in the message pipeline, see mt_msg::stamp_nSecs
+ */
+enum mt_msg_stamp {
+    /*! first byte of the frame was read from the stream */
+    MT_MSG_STAMP_rx_first_byte,
+    /*! last byte of the frame was read from the stream */
+    MT_MSG_STAMP_rx_frame,
+    /*! the rx thread put the message in mt_msg_interface::rx_list */
+    MT_MSG_STAMP_rx_enqueue,
+    /*! the application took the message from the rx_list */
+    MT_MSG_STAMP_rx_dequeue,
+    /*! the application is done with the message */
+    MT_MSG_STAMP_rx_handled,
+    /*! MT_MSG_txrx() was called */
+    MT_MSG_STAMP_tx_start,
+    /*! the last byte was written to the stream */
+    MT_MSG_STAMP_tx_done,
+    /* must be last */
+    MT_MSG_STAMP_nStamps
+};
+
+/*
+ * @enum mt_msg_lat_which
+ * @brief The latency histograms kept per interface
+ */
+enum mt_msg_lat_which {
+    /*! rx_first_byte to rx_frame, time on the wire */
+    MT_MSG_LAT_rx_frame,
+    /*! rx_frame to rx_enqueue, parsing and reassembly */
+    MT_MSG_LAT_rx_enqueue,
+    /*! rx_enqueue to rx_dequeue, waiting in the rx_list */
+    MT_MSG_LAT_rx_queue,
+    /*! rx_dequeue to rx_handled, the application handler */
+    MT_MSG_LAT_rx_handler,
+    /*! rx_first_byte to rx_handled, the whole rx path */
+    MT_MSG_LAT_rx_total,
+    /*! tx_start to tx_done, includes waiting for the tx_lock */
+    MT_MSG_LAT_tx,
+    /*! sreq tx_done to srsp rx_frame, the remote response time */
+    MT_MSG_LAT_srsp,
+    /* must be last */
+    MT_MSG_LAT_nHists
+};
+
+/*
+ * Latency histogram buckets are log-linear: each power of 2 is split
+ * into 8 buckets, so a percentile is within 12.5% of the real value.
+ * Values from 0 to about 550 seconds (2^39 nSecs) are kept.
+ */
+#define MT_MSG_LAT_SUB_BITS  3
+#define MT_MSG_LAT_MAX_BITS  39
+#define MT_MSG_LAT_nBUCKETS \
+    (((MT_MSG_LAT_MAX_BITS - MT_MSG_LAT_SUB_BITS + 1) + 1) << MT_MSG_LAT_SUB_BITS)
+
+/*
+ * @struct mt_msg_lat_hist
+ * @brief One latency histogram
+ *
+ * Each histogram is updated by only one thread at a time, a reader
+ * may see a sample that is in progress, which is acceptable here.
+ */
+struct mt_msg_lat_hist {
+    /*! number of samples */
+    unsigned count;
+    /*! sum of all samples, for the mean */
+    uint64_t sum_nSecs;
+    /*! largest sample */
+    uint64_t max_nSecs;
+    /*! the samples */
+    unsigned buckets[ MT_MSG_LAT_nBUCKETS ];
+};
+
+/*
+ * @struct mt_msg_lat_summary
+ * @brief A summary of one latency histogram, see MT_MSG_LAT_get()
+ */
+struct mt_msg_lat_summary {
+    const char *dbg_name;
+    unsigned count;
+    uint64_t mean_nSecs;
+    uint64_t p50_nSecs;
+    uint64_t p99_nSecs;
+    uint64_t max_nSecs;
+};
+
+/*
+ * @typedef MT_MSG_txrx_done_fn
+ * @brief Completion callback for MT_MSG_txrx_async()
+ * @param pMsg - the message that was sent, see mt_msg::pSrsp for the reply
+ * @param result - same as the return value of MT_MSG_txrx()
+ * @param cookie - the cookie given to MT_MSG_txrx_async()
+ *
+ * The callback is called from the rx thread of the interface when the
+ * SRSP arrives, or from an async worker thread otherwise (timeout, error
+ * or no SRSP expected). It must not wait for an SRSP of the interface.
+ * The message (and srsp) is released when the callback returns.
+ */
+typedef void MT_MSG_txrx_done_fn(struct mt_msg *pMsg,
+                                 int result,
+                                 intptr_t cookie);
+
+/*
+ * @def MT_MSG_ASYNC_MAX_WORKERS
+ * @brief Maximum number of async worker threads per interface
+ */
+#if !defined(MT_MSG_ASYNC_MAX_WORKERS)
+#define MT_MSG_ASYNC_MAX_WORKERS 16
+#endif
+
+/*
+ * @def MT_MSG_ASYNC_EXPIRE_mSecs
+ * @brief How often idle async workers look for async SREQs without an SRSP
+ */
+#if !defined(MT_MSG_ASYNC_EXPIRE_mSecs)
+#define MT_MSG_ASYNC_EXPIRE_mSecs 50
+#endif
+
+/*
+ * @def MT_MSG_REACTOR_MAX_READS
+ * @brief Reads per wakeup of a reactor interface, see use_reactor
+ *
+ * Other interfaces are served before a busy interface is read again.
+ */
+#if !defined(MT_MSG_REACTOR_MAX_READS)
+#define MT_MSG_REACTOR_MAX_READS 16
+#endif
+
+/*!
+ * @enum mt_msg_prio
+ * @brief Priority classes of a message list, see MT_MSG_setRxPrio()
+ *
+ * Lower numbers are removed first, a list without a priority table
+ * puts everything in MT_MSG_PRIO_normal, ie: a plain FIFO.
+ */
+enum mt_msg_prio {
+    /*! control plane confirmations the application is waiting for */
+    MT_MSG_PRIO_high = 0,
+    /*! the default */
+    MT_MSG_PRIO_normal = 1,
+    /*! floods that can wait, ie: beacon notify */
+    MT_MSG_PRIO_low = 2,
+    /*! number of classes */
+    MT_MSG_PRIO_nClasses = 3
+};
+
+/*
+ * @def MT_MSG_PRIO_STARVE_LIMIT
+ * @brief Lower classes are not starved forever
+ *
+ * After this many messages are removed ahead of a waiting message in
+ * a lower class, the next one comes from the lower class.
+ */
+#if !defined(MT_MSG_PRIO_STARVE_LIMIT)
+#define MT_MSG_PRIO_STARVE_LIMIT 8
+#endif
+
+/*!
+ * @enum mt_msg_list_policy
+ * @brief What a full list does with one more message, see MT_MSG_LIST_setLimit()
+ *
+ * A message is never dropped to make room for a lower class message,
+ * if only higher classes have messages, the new message is dropped.
+ */
+enum mt_msg_list_policy {
+    /*! the oldest message of the lowest class with messages is dropped */
+    MT_MSG_LIST_POLICY_drop_oldest = 0,
+    /*! the new message is dropped */
+    MT_MSG_LIST_POLICY_drop_newest = 1,
+    /*! the producer waits for room, then drops the new message.
+     * A reactor interface uses drop_newest instead */
+    MT_MSG_LIST_POLICY_block = 2,
+    /*! the new message replaces an older one from the same device,
+     * see MT_MSG_LIST_coalesce_fn, otherwise drop_oldest */
+    MT_MSG_LIST_POLICY_coalesce = 3
+};
+
+/*!
+ * @brief Coalesce test of a list, see MT_MSG_LIST_POLICY_coalesce
+ * @param pOld - a message in the list
+ * @param pNew - the message being inserted
+ * @returns true if pNew makes pOld obsolete
+ */
+typedef bool MT_MSG_LIST_coalesce_fn(struct mt_msg *pOld, struct mt_msg *pNew);
 
 /*
  * @struct mt_msg_list
  * @brief Manage a list of messages
  *
- * Always insert at end, remove from head
+ * Always insert at end of the message's class, remove from the head
+ * of the highest class that has messages.
  */
 struct mt_msg_list {
     const char *dbg_name;
+    /*! posted once per inserted message */
     intptr_t sem;
-    struct mt_msg *pList;
+    /*! protects this list only, not other lists on the interface */
+    intptr_t lock;
+    /*! one FIFO per priority class */
+    struct mt_msg_list_lane {
+        /*! head, messages are removed from here */
+        struct mt_msg *pList;
+        /*! tail, messages are inserted here */
+        struct mt_msg *pTail;
+        /*! number of messages in this class */
+        unsigned depth;
+        /*! largest depth ever seen */
+        unsigned high_water;
+        /*! number of messages ever inserted */
+        unsigned n_inserted;
+        /*! messages removed from other classes while this one waited */
+        unsigned n_bypass;
+    } lanes[ MT_MSG_PRIO_nClasses ];
+    /*! number of messages in the list */
+    unsigned depth;
+    /*! largest depth ever seen */
+    unsigned high_water;
+    /*!
+     * If not null, the priority of a message is
+     * ppPrio[ cmd0 & 0x1f ][ cmd1 ], see MT_MSG_setRxPrio()
+     */
+    uint8_t * const *ppPrio;
+    /*! most messages the list holds, 0 is unbounded */
+    unsigned capacity;
+    /*! what happens when the list is full */
+    enum mt_msg_list_policy policy;
+    /*! block policy: the producer waits at most this long */
+    int block_mSecs;
+    /*! coalesce policy: which messages replace which */
+    MT_MSG_LIST_coalesce_fn *pCoalesceFn;
+    /*! posted when a message is removed while a producer waits */
+    intptr_t room_sem;
+    /*! number of producers waiting for room */
+    unsigned n_waiting;
+    /*! messages dropped because the list was full */
+    unsigned n_dropped;
+    /*! messages replaced by a newer one from the same device */
+    unsigned n_coalesced;
+    /*! times a producer waited for room */
+    unsigned n_blocked;
+};
+
+/*
+ * @def MT_MSG_SREQ_MAX_INFLIGHT
+ * @brief Size of the per interface in-flight SREQ table.
+ *
+ * The number actually used is mt_msg_interface::sreq_max_inflight
+ */
+#if !defined(MT_MSG_SREQ_MAX_INFLIGHT)
+#define MT_MSG_SREQ_MAX_INFLIGHT 8
+#endif
+
+/*!
+ * @def MT_MSG_TX_BATCH_SIZE
+ * @brief Most bytes MT_MSG_txrxBatch() writes at once
+ */
+#if !defined(MT_MSG_TX_BATCH_SIZE)
+#define MT_MSG_TX_BATCH_SIZE 2048
+#endif
+
+/*!
+ * @struct mt_msg_sreq_slot
+ * @brief An entry in the in-flight SREQ table of an interface.
+ *
+ * The SRSP is matched by subsystem (cmd0 bits 4:0) and cmd1. The
+ * wire format has no request id, but the remote answers SREQs in the
+ * order they were sent, so an SRSP belongs to the oldest claim with
+ * the same command. Slots are claimed under the tx_lock, so the claim
+ * order is the order on the wire.
+ *
+ * An SREQ that timed out leaves its slot stale, so a late SRSP is
+ * consumed by it rather than taken as the answer to the next SREQ
+ * with the same command. A stale slot is freed by that SRSP, or after
+ * another srsp timeout.
+ */
+struct mt_msg_sreq_slot {
+    /*! The pending sreq, NULL if the slot is free (or stale) */
+    struct mt_msg *pSreq;
+
+    /*! When claimed, SRSPs are matched to the oldest claim */
+    unsigned order;
+
+    /*! Subsystem (cmd0 bits 4:0) of the claim, kept while stale */
+    int subsys;
+
+    /*! cmd1 of the claim, kept while stale */
+    int cmd1;
+
+    /*! The sender gave up waiting, a late srsp is consumed here */
+    bool is_stale;
+
+    /*! Sent by MT_MSG_txrx_async(), the srsp completes it, not a waiter */
+    bool is_async;
+
+    /*! async: when it was sent, see TIMER_getNow() */
+    unsigned t_sent;
+
+    /*! async: how long to wait for the srsp */
+    int timeout_mSecs;
+
+    /*! When the slot became stale, see TIMER_getNow() */
+    unsigned t_stale;
+
+    /*! The sender waits here for the srsp */
+    intptr_t done_semaphore;
 };
 
 /*!
@@ -171,6 +565,16 @@ struct mt_msg_interface {
     /*! Rx thread reading on this interface */
     intptr_t rx_thread;
 
+    /*!
+     * If true, the shared reactor reads this interface instead of
+     * an rx thread, see reactor.h. Used only if the stream has a file
+     * descriptor, ie: not a uart with a read thread.
+     */
+    bool use_reactor;
+
+    /*! True if the shared reactor is reading this interface */
+    bool in_reactor;
+
     /*! what is the fragment size we should use? */
     int tx_frag_size;
 
@@ -180,6 +584,15 @@ struct mt_msg_interface {
     /*! how long to wait for a fragment response on this interface */
     int frag_timeout_mSecs;
 
+    /*!
+     * How many fragment blocks may be sent before an ack is required,
+     * 1..MT_MSG_FRAG_MAX_WINDOW. 1 is the classic stop-and-wait, larger
+     * values require the remote to accept blocks as they come. If the
+     * remote rejects a block as out of order, this drops back to 1 and
+     * the transfer starts over.
+     */
+    int tx_frag_window;
+
     /*! how long to wait for a message to start.. */
     int intermsg_timeout_mSecs;
 
@@ -201,21 +614,107 @@ struct mt_msg_interface {
     /* in comming messages are put here. */
     struct mt_msg_list rx_list;
 
-    /* current sreq is here, the srsp will be attached here */
-    struct mt_msg *pCurSreq;
-    /* sreq sender waits for srsp here. */
-    intptr_t srsp_semaphore;
+    /*!
+     * Priority class of received messages, by subsystem then cmd1.
+     * Tables are created by MT_MSG_setRxPrio(), a missing table
+     * means MT_MSG_PRIO_normal. Not freed, interface copies share it.
+     */
+    uint8_t *rx_prio[32];
+
+    /*! rx_list capacity, 0 is unbounded, see MT_MSG_LIST_setLimit() */
+    int rx_capacity;
+
+    /*! what a full rx_list does */
+    enum mt_msg_list_policy rx_policy;
+
+    /*! block policy: how long the rx thread waits for room */
+    int rx_block_mSecs;
+
+    /*! coalesce policy: if null, MT_MSG_coalesceDataInd() */
+    MT_MSG_LIST_coalesce_fn *rx_coalesce_fn;
+
+    /*! in-flight sreqs are here, the srsp will be attached to the sreq */
+    struct mt_msg_sreq_slot sreq_table[ MT_MSG_SREQ_MAX_INFLIGHT ];
+
+    /*!
+     * How many sreqs may be in flight at once, 1..MT_MSG_SREQ_MAX_INFLIGHT,
+     * default 4
+     */
+    int sreq_max_inflight;
+
+    /*! Posted when an sreq slot is released, protected by list_lock */
+    intptr_t sreq_free_semaphore;
+
+    /*! Next mt_msg_sreq_slot::order, protected by list_lock */
+    unsigned sreq_order;
+
+    /*! Most SREQs MT_MSG_txrxBatch() writes at once, 1..sreq_max_inflight */
+    int tx_batch_max;
+
+    /*! Messages submitted via MT_MSG_txrx_async() wait here */
+    struct mt_msg_list async_list;
+
+    /*! How many async worker threads, 0..MT_MSG_ASYNC_MAX_WORKERS */
+    int async_workers;
+
+    /*! The async worker threads, started on the first async request */
+    intptr_t async_threads[ MT_MSG_ASYNC_MAX_WORKERS ];
+
+    /*! Latency histograms, see MT_MSG_LAT_log() */
+    struct mt_msg_lat_hist *pLatency;
+
+    /*! If non-zero, the rx thread logs the latency this often */
+    int latency_log_mSecs;
+
+    /*! When the latency was last logged */
+    uint32_t latency_log_last;
 
     /*! Is this interface dead? should the rx thread exit? */
     bool is_dead;
 
-    /*! points to the current message we are trying to receive */
-    struct mt_msg *pCurRxMsg;
+    /*! Capture generation and interface number, see MT_MSG_CAPTURE_start() */
+    int capture_id;
+
+    /*
+     * Received bytes are read into this ring, then every complete
+     * frame is extracted from the ring into a message.
+     */
+    struct mt_msg_rx_ring {
+        /*! the ring buffer, size is a power of 2 */
+        uint8_t *pBuf;
+        /*! size of pBuf */
+        unsigned size;
+        /*! free running read index */
+        unsigned rd;
+        /*! free running write index */
+        unsigned wr;
+        /*! number of read operations on the stream */
+        unsigned n_reads;
+        /*! number of good frames extracted */
+        unsigned n_frames;
+        /*! number of bytes discarded while searching for a frame */
+        unsigned n_discarded;
+        /*! number of frames with a bad checksum */
+        unsigned n_chksum_errors;
+        /*! when the oldest byte in the ring was read, see MT_MSG_stamp() */
+        uint64_t t_first_nSecs;
+        /*! when the newest byte in the ring was read */
+        uint64_t t_last_nSecs;
+    } rx_ring;
 
     /*! When performing a flush operation how long do we stall? */
     int flush_timeout_mSecs;
 
-    /*! Used to lock all lists within this interface */
+    /*!
+     * Used to frame shared messages (see MT_MSG_share()) for this
+     * interface, the payload is copied here under the tx_lock.
+     */
+    uint8_t *pTxFrame;
+
+    /*! MT_MSG_txrxBatch() packs the frames here, under the tx_lock */
+    uint8_t *pTxBatch;
+
+    /*! Protects the sreq table and the fragmentation ack list */
     intptr_t list_lock;
 
     /* Used to lock the interface during a transmission */
@@ -245,6 +744,12 @@ struct mt_msg_interface {
         int total_size;
         /* how large is each packet in this frag sequence? */
         int this_frag_size;
+        /*! one bit per block, acked (tx) or received (rx) */
+        uint8_t block_map[ MT_MSG_FRAG_MAX_BLOCKS / 8 ];
+        /*! how many bits are set in block_map */
+        int block_done;
+        /*! how many blocks were transmitted more than once */
+        int n_resent;
 
         /*! When tx-ing, the ack from the remote is put here */
         struct mt_msg *pTxFragAck;
@@ -331,17 +836,43 @@ struct mt_msg {
     /*! This is how many valid bytes are in the io buffer */
     int iobuf_nvalid;
 
-    /* This (current) implementation, iobuf is fixed Future this might
-     * change to an allocated buf this holds the sizeof() the iobuf.
-     */
+    /*! The size of the io buffer, set by the pool size class */
     int  iobuf_idx_max;
 
-    /*! io buffer for the message */
-    uint8_t iobuf[ __4K ];
+    /*! io buffer for the message, the memory follows this struct */
+    uint8_t *iobuf;
+
+    /*! which pool size class this message came from */
+    enum mt_msg_pool_class pool_class;
+
+    /*!
+     * Number of references to this message and its io buffer.
+     * One for the message itself, plus one per MT_MSG_share().
+     * Protected by the pool lock.
+     */
+    int n_refs;
+
+    /*!
+     * Non-null if this message is a share (see MT_MSG_share()),
+     * the io buffer belongs to this message and is read only.
+     */
+    struct mt_msg *pShared;
 
     /*! Synchronous messages have responses here, otherwise this is null */
     struct mt_msg *pSrsp;
 
+    /*! If non-zero, overrides mt_msg_interface::srsp_timeout_mSecs */
+    int srsp_timeout_mSecs;
+
+    /*! When the message passed each stage, 0 if it did not */
+    uint64_t stamp_nSecs[ MT_MSG_STAMP_nStamps ];
+
+    /*! For MT_MSG_txrx_async(), called when the transfer completes */
+    MT_MSG_txrx_done_fn *pAsyncDone;
+
+    /*! For MT_MSG_txrx_async(), given to the completion callback */
+    intptr_t async_cookie;
+
     /*! Next msg in a specific msg list */
     struct mt_msg *pListNext;
 
@@ -509,10 +1040,159 @@ uint64_t MT_MSG_rdU64_DBG(struct mt_msg *pMsg, const char *name);
 void MT_MSG_rdBuf_DBG(struct mt_msg *pMsg, void *pData, size_t nbytes, const char *name);
 #define MT_MSG_rdBuf(PMSG, PDATA, LEN) MT_MSG_rdBuf_DBG((PMSG), (PDATA), (LEN), NULL)
 
+#if defined(MT_MSG_FAST_FIELDS) && !defined(_MT_MSG_IMPLIMENTOR_)
+#include <string.h>
+
+/*
+ * Release builds (make RELEASE=1) define MT_MSG_FAST_FIELDS, then the
+ * field readers and writers above are inlined little endian loads and
+ * stores with one length check per field (not per byte). The field
+ * names are dropped and fields are not logged (LOG_DBG_MT_MSG_fields).
+ *
+ * Anything unusual, the first write, an overflow, a shared message or
+ * an earlier error, goes to the checked functions so the error
+ * handling is the same.
+ */
+
+/*!
+ * @brief Inlined MT_MSG_wrUX_DBG()
+ * @param pMsg - the message
+ * @param value - value being written
+ * @param nbytes - 1, 2, 4 or 8
+ */
+static inline void MT_MSG_fastWr(struct mt_msg *pMsg, uint64_t value, int nbytes)
+{
+    uint8_t *p;
+    int x;
+
+    if((pMsg->iobuf_idx < 0) ||
+       ((pMsg->iobuf_idx + nbytes) > pMsg->iobuf_idx_max) ||
+       pMsg->is_error || pMsg->pShared)
+    {
+        MT_MSG_wrUX_DBG(pMsg, value, nbytes * 8, NULL);
+        return;
+    }
+
+    p = &(pMsg->iobuf[pMsg->iobuf_idx]);
+    for(x = 0 ; x < nbytes ; x++)
+    {
+        p[x] = (uint8_t)(value >> (x * 8));
+    }
+    pMsg->iobuf_idx += nbytes;
+    pMsg->iobuf_nvalid = pMsg->iobuf_idx;
+}
+
+/*!
+ * @brief Inlined MT_MSG_rdUX_DBG()
+ * @param pMsg - the message
+ * @param nbytes - 1, 2, 4 or 8
+ * @returns the value read
+ */
+static inline uint64_t MT_MSG_fastRd(struct mt_msg *pMsg, int nbytes)
+{
+    const uint8_t *p;
+    uint64_t v;
+    int x;
+
+    if((pMsg->iobuf_idx < 0) ||
+       ((pMsg->iobuf_idx + nbytes) > pMsg->iobuf_nvalid) ||
+       pMsg->is_error)
+    {
+        return (MT_MSG_rdUX_DBG(pMsg, nbytes * 8, NULL));
+    }
+
+    p = &(pMsg->iobuf[pMsg->iobuf_idx]);
+    v = 0;
+    for(x = nbytes - 1 ; x >= 0 ; x--)
+    {
+        v = (v << 8) | p[x];
+    }
+    pMsg->iobuf_idx += nbytes;
+    return (v);
+}
+
+/*! @brief Inlined MT_MSG_rdU8_DBG() */
+static inline uint8_t MT_MSG_fastRdU8(struct mt_msg *pMsg)
+{
+    return ((uint8_t)MT_MSG_fastRd(pMsg, 1));
+}
+
+/*! @brief Inlined MT_MSG_rdU16_DBG() */
+static inline uint16_t MT_MSG_fastRdU16(struct mt_msg *pMsg)
+{
+    return ((uint16_t)MT_MSG_fastRd(pMsg, 2));
+}
+
+/*! @brief Inlined MT_MSG_rdU32_DBG() */
+static inline uint32_t MT_MSG_fastRdU32(struct mt_msg *pMsg)
+{
+    return ((uint32_t)MT_MSG_fastRd(pMsg, 4));
+}
+
+/*!
+ * @brief Inlined MT_MSG_wrBuf_DBG()
+ * @param pMsg - the message
+ * @param pData - bytes to write, NULL for a dummy write
+ * @param nbytes - how many bytes to write
+ */
+static inline void MT_MSG_fastWrBuf(struct mt_msg *pMsg,
+                                    const void *pData, size_t nbytes)
+{
+    if((pMsg->iobuf_idx < 0) ||
+       ((pMsg->iobuf_idx + (int)nbytes) > pMsg->iobuf_idx_max) ||
+       pMsg->is_error || pMsg->pShared || (pData == NULL))
+    {
+        MT_MSG_wrBuf_DBG(pMsg, pData, nbytes, NULL);
+        return;
+    }
+    memcpy((void *)(&(pMsg->iobuf[pMsg->iobuf_idx])), pData, nbytes);
+    pMsg->iobuf_idx += (int)nbytes;
+    pMsg->iobuf_nvalid += (int)nbytes;
+}
+
+/*!
+ * @brief Inlined MT_MSG_rdBuf_DBG()
+ * @param pMsg - the message
+ * @param pData - where to put the data, NULL for a dummy read
+ * @param nbytes - how many
+ */
+static inline void MT_MSG_fastRdBuf(struct mt_msg *pMsg,
+                                    void *pData, size_t nbytes)
+{
+    if((pMsg->iobuf_idx < 0) ||
+       ((pMsg->iobuf_idx + (int)nbytes) > pMsg->iobuf_idx_max) ||
+       pMsg->is_error)
+    {
+        MT_MSG_rdBuf_DBG(pMsg, pData, nbytes, NULL);
+        return;
+    }
+    if(pData)
+    {
+        memcpy(pData, (void *)(&(pMsg->iobuf[pMsg->iobuf_idx])), nbytes);
+    }
+    pMsg->iobuf_idx += (int)nbytes;
+}
+
+#define MT_MSG_wrU8_DBG(PMSG, VALUE, NAME)  MT_MSG_fastWr((PMSG), (VALUE), 1)
+#define MT_MSG_wrU16_DBG(PMSG, VALUE, NAME) MT_MSG_fastWr((PMSG), (VALUE), 2)
+#define MT_MSG_wrU32_DBG(PMSG, VALUE, NAME) MT_MSG_fastWr((PMSG), (VALUE), 4)
+#define MT_MSG_wrU64_DBG(PMSG, VALUE, NAME) MT_MSG_fastWr((PMSG), (VALUE), 8)
+#define MT_MSG_wrBuf_DBG(PMSG, BUF, NBYTES, NAME) \
+    MT_MSG_fastWrBuf((PMSG), (BUF), (NBYTES))
+#define MT_MSG_rdU8_DBG(PMSG, NAME)  MT_MSG_fastRdU8((PMSG))
+#define MT_MSG_rdU16_DBG(PMSG, NAME) MT_MSG_fastRdU16((PMSG))
+#define MT_MSG_rdU32_DBG(PMSG, NAME) MT_MSG_fastRdU32((PMSG))
+#define MT_MSG_rdU64_DBG(PMSG, NAME) MT_MSG_fastRd((PMSG), 8)
+#define MT_MSG_rdBuf_DBG(PMSG, PDATA, LEN, NAME) \
+    MT_MSG_fastRdBuf((PMSG), (PDATA), (LEN))
+#endif
+
 /*
  * @brief Release/Free a message and all related resources.
  * @param pMsg - the message to release/free
  *
+ * If the message was shared (see MT_MSG_share()) this drops one
+ * reference, the io buffer is released with the last reference.
  */
 void MT_MSG_free(struct mt_msg *pMsg);
 
@@ -528,6 +1208,26 @@ void MT_MSG_free(struct mt_msg *pMsg);
  */
 struct mt_msg *MT_MSG_clone(struct mt_msg *pMsg);
 
+/*
+ * @brief Share a message (the payload) without copying it.
+ * @param pMsg - the message to share
+ * @returns new message header, or NULL on error
+ *
+ * This is the cheap form of MT_MSG_clone() used to give one message
+ * to several consumers, ie: an AREQ broadcast to every connection.
+ *
+ * The share is a header only, its io buffer is the io buffer of
+ * the original message which is reference counted; MT_MSG_free()
+ * drops one reference. The payload is read only: writing to a
+ * share is an error, and the original must not be modified (or
+ * transmitted) once shared - transmit another share instead.
+ *
+ * Each share has its own destination interface, the frame header
+ * is built in the transmit buffer of the destination interface, so
+ * MT_MSG_reformat() never moves the shared payload.
+ */
+struct mt_msg *MT_MSG_share(struct mt_msg *pMsg);
+
 /*
  * @brief Allocate or find space for a new message
  * @param len - expected length, or -1 if unknown
@@ -549,15 +1249,74 @@ struct mt_msg *MT_MSG_alloc(int len, int cmd0, int cmd1);
  *  - returns 2 if a message was transmitted and received
  *  - Caller must also check mt_msg::is_error
  *  - For an SREQ, see mt_msg::pSrsp for the SRSP message.
+ *  - The interface tx_lock is only held while transmitting, an SREQ
+ *    waits for its SRSP in a slot of mt_msg_interface::sreq_table
+ *    so other callers can use the interface meanwhile.
  */
 int MT_MSG_txrx(struct mt_msg *pMsg);
 
+/*
+ * @brief Transmit several messages in one write, then wait for the replies
+ * @param ppMsgs - the messages, all to the same interface
+ * @param n - number of messages
+ * @param pResults - filled in with the MT_MSG_txrx() result of each message
+ * @returns number of messages transmitted
+ *
+ * Notes:
+ *  - The frames are packed into one buffer and written with a single
+ *    write under a single tx_lock hold, up to mt_msg_interface::tx_batch_max
+ *    SREQs (or MT_MSG_TX_BATCH_SIZE bytes) at a time.
+ *  - SREQs in a batch may have the same command, the SRSPs are
+ *    matched in order. mt_msg_interface::sreq_max_inflight applies,
+ *    a batch waits for SREQs in flight to be answered.
+ *  - Shared messages and messages that need fragmenting are sent
+ *    one by one with MT_MSG_txrx().
+ *  - The caller still owns the messages, see mt_msg::pSrsp for each reply.
+ */
+int MT_MSG_txrxBatch(struct mt_msg **ppMsgs, int n, int *pResults);
+
+/*
+ * @brief Queue a message for MT_MSG_txrx() and return immediately.
+ * @param pMsg - the message to transmit
+ * @param pDoneFn - called when complete (srsp, timeout, or error)
+ * @param cookie - passed to the callback
+ * @returns 0 if queued, negative on error
+ *
+ * Notes:
+ *  - If queued, the interface owns the message and releases it
+ *    after the callback returns. pDoneFn may be NULL.
+ *  - If not queued, the caller still owns the message.
+ *  - Requests are sent by mt_msg_interface::async_workers threads,
+ *    a worker claims a slot of mt_msg_interface::sreq_table and does
+ *    not wait for the SRSP, the rx thread completes the request. So
+ *    up to mt_msg_interface::sreq_max_inflight requests are in flight,
+ *    also with the same command.
+ */
+int MT_MSG_txrx_async(struct mt_msg *pMsg,
+                      MT_MSG_txrx_done_fn *pDoneFn,
+                      intptr_t cookie);
+
 /*
  * @brief Initialize the MT_MSG module
  * @returns void
  */
 void MT_MSG_init(void);
 
+/*
+ * @brief Get the message pool statistics for one size class
+ * @param which - the size class
+ * @param pStats - where to put the statistics
+ * @returns 0 on success, negative if the class is invalid
+ */
+int MT_MSG_POOL_getStats(enum mt_msg_pool_class which,
+                         struct mt_msg_pool_stats *pStats);
+
+/*
+ * @brief Log the message pool statistics for all size classes
+ * @param why - log reason/why bits, see log.h
+ */
+void MT_MSG_POOL_log(int64_t why);
+
 /*
  * @brief Verify that we have parsed all incoming data.
  * @param pMsg - the message we just finished parsing.
@@ -603,7 +1362,7 @@ void MT_MSG_LIST_insert(struct mt_msg_interface *pMI,
                         struct mt_msg_list *pML, struct mt_msg *pMsg);
 
 /*
- * @brief Insert a message into the list
+ * @brief Remove a message from the list
  * @param pMI - Owning interface
  * @param pML - msg list
  * @param timeout_mSecs - how long to wait
@@ -612,6 +1371,80 @@ void MT_MSG_LIST_insert(struct mt_msg_interface *pMI,
 struct mt_msg *MT_MSG_LIST_remove(struct mt_msg_interface *pMI,
                                   struct mt_msg_list *pML, int timeout_mSecs);
 
+/*
+ * @brief Remove up to N messages from the list
+ * @param pMI - Owning interface
+ * @param pML - msg list
+ * @param ppMsgs - messages are stored here, in list order
+ * @param nmax - at most this many messages are removed
+ * @param timeout_mSecs - how long to wait for the first message
+ * @returns number of messages removed (0..nmax)
+ *
+ * Only waits for the first message, then takes what is available.
+ */
+int MT_MSG_LIST_removeN(struct mt_msg_interface *pMI,
+                        struct mt_msg_list *pML,
+                        struct mt_msg **ppMsgs,
+                        int nmax,
+                        int timeout_mSecs);
+
+/*
+ * @brief Limit the number of messages in a list
+ * @param pML - the message list
+ * @param capacity - most messages, 0 is unbounded
+ * @param policy - what happens when the list is full
+ * @param block_mSecs - block policy: longest wait for room, -1 forever
+ * @param pFn - coalesce policy: the test, null means drop_oldest
+ *
+ * The block policy stalls the producer, on an rx_list that is the rx
+ * thread and so SRSPs are not received while it waits.
+ */
+void MT_MSG_LIST_setLimit(struct mt_msg_list *pML,
+                          unsigned capacity,
+                          enum mt_msg_list_policy policy,
+                          int block_mSecs,
+                          MT_MSG_LIST_coalesce_fn *pFn);
+
+/*
+ * @brief Translate a policy name (ie: "drop-oldest") to the policy
+ * @param name - drop-oldest, drop-newest, block or coalesce
+ * @returns negative if unknown
+ */
+int MT_MSG_LIST_policyFromName(const char *name);
+
+/*! Where the msdu starts in a MAC data indication payload, this is the
+ * fixed part of the data-ind schema, api_mac.c checks it */
+#define MT_MSG_DATA_IND_MSDU_OFS  51
+
+/*
+ * @brief Coalesce test for MAC data indications
+ * @param pOld - a message in the list
+ * @param pNew - the message being inserted
+ * @returns true if both are data indications from the same source
+ *          address, with the same first payload byte (the command)
+ */
+bool MT_MSG_coalesceDataInd(struct mt_msg *pOld, struct mt_msg *pNew);
+
+/*
+ * @brief Log the depth of each priority class of a list
+ * @param pML - the message list
+ * @param why - log flags
+ */
+void MT_MSG_LIST_log(struct mt_msg_list *pML, int64_t why);
+
+/*
+ * @brief Set the priority class of received messages
+ * @param pMI - the interface, before MT_MSG_interfaceCreate()
+ * @param cmd0 - the subsystem is taken from this (bits 4:0)
+ * @param cmd1 - the command, or -1 for the entire subsystem
+ * @param prio - the class
+ * @returns negative on error
+ *
+ * The type bits of cmd0 are ignored, the rx_list holds AREQs.
+ */
+int MT_MSG_setRxPrio(struct mt_msg_interface *pMI,
+                     int cmd0, int cmd1, enum mt_msg_prio prio);
+
 /*
  * @brief Destroy a message list
  * @param pML - the message list to destroy
@@ -661,6 +1494,9 @@ uint8_t MT_MSG_cmd0_poll(int cmd0);
  * in the packet needs to 'shift' over a few bytes.
  *
  * This function does that shift operation.
+ *
+ * A share (see MT_MSG_share()) is never shifted, the frame header
+ * is built for the destination interface when transmitted.
  */
 void MT_MSG_reformat(struct mt_msg *pMsg);
 
@@ -677,6 +1513,78 @@ int MT_MSG_INI_settings(struct ini_parser *pINI,
                         bool *handled,
                         struct mt_msg_interface *pIface);
 
+/*
+ * @brief Record that a message has reached a pipeline stage.
+ * @param pMsg - the message
+ * @param which - the stage
+ *
+ * The rx stages are recorded by the rx thread, the application records
+ * MT_MSG_STAMP_rx_dequeue and MT_MSG_STAMP_rx_handled, the latter adds
+ * the message to the rx histograms of its source interface.
+ */
+void MT_MSG_stamp(struct mt_msg *pMsg, enum mt_msg_stamp which);
+
+/*
+ * @brief Add a sample to a latency histogram of an interface
+ * @param pMI - the interface
+ * @param which - the histogram
+ * @param t_start - start of the interval, 0 if unknown
+ * @param t_end - end of the interval, 0 if unknown
+ *
+ * Nothing is recorded if the interval is not known
+ */
+void MT_MSG_LAT_add(struct mt_msg_interface *pMI,
+                    enum mt_msg_lat_which which,
+                    uint64_t t_start,
+                    uint64_t t_end);
+
+/*
+ * @brief Add a sample to a standalone latency histogram
+ * @param pH - the histogram
+ * @param v - the sample in nSecs
+ */
+void MT_MSG_LAT_histAdd(struct mt_msg_lat_hist *pH, uint64_t v);
+
+/*
+ * @brief Add all samples of one histogram to another
+ * @param pDst - updated
+ * @param pSrc - the samples to add
+ */
+void MT_MSG_LAT_histMerge(struct mt_msg_lat_hist *pDst,
+                          const struct mt_msg_lat_hist *pSrc);
+
+/*
+ * @brief Summarize a standalone latency histogram
+ * @param pH - the histogram
+ * @param pSummary - filled in, the dbg_name is NULL
+ */
+void MT_MSG_LAT_histSummary(const struct mt_msg_lat_hist *pH,
+                            struct mt_msg_lat_summary *pSummary);
+
+/*
+ * @brief Summarize a latency histogram of an interface
+ * @param pMI - the interface
+ * @param which - the histogram
+ * @param pSummary - filled in
+ * @returns 0 on success, -1 if there is no such histogram
+ */
+int MT_MSG_LAT_get(struct mt_msg_interface *pMI,
+                   enum mt_msg_lat_which which,
+                   struct mt_msg_lat_summary *pSummary);
+
+/*
+ * @brief Clear the latency histograms of an interface
+ * @param pMI - the interface
+ */
+void MT_MSG_LAT_reset(struct mt_msg_interface *pMI);
+
+/*
+ * @brief Log the latency histograms (that have samples) of an interface
+ * @param pMI - the interface
+ * @param why - log reason/why bits, see log.h
+ */
+void MT_MSG_LAT_log(struct mt_msg_interface *pMI, int64_t why);
+
 /*
  * @brief Send a loopback message
  * @param pIface - where to send the message
@@ -688,6 +1596,240 @@ int MT_MSG_INI_settings(struct ini_parser *pINI,
 int MT_MSG_loopback(struct mt_msg_interface *pIface, int repeatCount,
                     uint32_t mSec_rate, size_t length, const uint8_t *pPayload);
 
+/*
+ * @def MT_MSG_LOOPBACK_BENCH_MAX_DEPTH
+ * @brief Largest pipeline depth supported by MT_MSG_loopbackBenchmark()
+ */
+#define MT_MSG_LOOPBACK_BENCH_MAX_DEPTH 16
+
+/*
+ * @def MT_MSG_LOOPBACK_BENCH_MAX_SIZE
+ * @brief Largest payload size supported by MT_MSG_loopbackBenchmark()
+ */
+#define MT_MSG_LOOPBACK_BENCH_MAX_SIZE  2048
+
+/*!
+ * @struct mt_msg_loopback_bench_cfg
+ * @brief Parameters for MT_MSG_loopbackBenchmark()
+ *
+ * Every payload size is measured at every pipeline depth, each
+ * (size, depth) point produces one line (csv) or object (json).
+ */
+struct mt_msg_loopback_bench_cfg {
+    /*! Transport label for the output, ie: "uart" */
+    const char *transport;
+
+    /*! Payload sizes in bytes, 0..MT_MSG_LOOPBACK_BENCH_MAX_SIZE */
+    const int *pSizes;
+    /*! Number of entries in pSizes */
+    int n_sizes;
+
+    /*! Depths, 1..MT_MSG_LOOPBACK_BENCH_MAX_DEPTH */
+    const int *pDepths;
+    /*! Number of entries in pDepths */
+    int n_depths;
+
+    /*! Number of loopback requests for each point */
+    int n_msgs;
+
+    /*! Seed for the RAND_DATA payload generator */
+    uint32_t seed;
+
+    /*! Output format, 'c' for csv, 'j' for json */
+    int format;
+
+    /*! Output stream, ie: STREAM_stdout */
+    intptr_t hOut;
+};
+
+/*
+ * @brief Measure loopback throughput and round trip time
+ * @param pIface - where to send the loopback requests
+ * @param pCfg - what to measure, and where to write the results
+ * @returns 0 if every loopback succeeded, negative otherwise
+ *
+ * The depth is the number of threads that issue MT_MSG_loopback()
+ * requests back to back. Because an SRSP is matched by command (see
+ * mt_msg_sreq_slot) only one loopback is on the wire at a time, a
+ * depth above 1 measures how well the next request is queued behind
+ * the current one rather than true pipelining on the link.
+ */
+int MT_MSG_loopbackBenchmark(struct mt_msg_interface *pIface,
+                             const struct mt_msg_loopback_bench_cfg *pCfg);
+
+/*
+ * @brief Run MT_MSG_loopbackBenchmark() against an in-process responder
+ * @param pTemplate - framing and timeout settings for both ends
+ * @param service - local TCP port used between the two ends, ie: "5099"
+ * @param pCfg - what to measure, and where to write the results
+ * @returns 0 if every loopback succeeded, negative otherwise
+ *
+ * A responder thread answers every loopback SREQ with its payload,
+ * this measures the host side cost of the MT layer with no device.
+ */
+int MT_MSG_loopbackBenchmarkInproc(const struct mt_msg_interface *pTemplate,
+                                   const char *service,
+                                   const struct mt_msg_loopback_bench_cfg *pCfg);
+
+/*
+ * @def MT_MSG_CAPTURE_MAGIC
+ * @brief First 8 bytes of a capture file
+ *
+ * A capture file is a 32 byte header followed by records. All values
+ * are little endian.
+ *
+ * File header:
+ *    8 bytes - MT_MSG_CAPTURE_MAGIC
+ *    u32     - header size (32)
+ *    u32     - flags (0)
+ *    u64     - TIMER_getNow_nSecs() when the capture started
+ *    u64     - wall clock time when the capture started (seconds)
+ *
+ * Each record is a 16 byte header, then the data, padded with zeros
+ * to a multiple of 8 bytes so every header is aligned in an mmap:
+ *    u64     - nSecs since the capture started
+ *    u16     - number of data bytes
+ *    u8      - record type, see enum mt_msg_capture_type
+ *    u8      - interface number
+ *    u32     - record sequence number, a gap means records were lost
+ *
+ * The data of an rx or tx record is the frame exactly as it was on the
+ * wire. The data of an interface record is one flag byte (bit0: frame
+ * sync, bit1: checksum, bit2: 2 byte length) and the interface name.
+ */
+#define MT_MSG_CAPTURE_MAGIC      "MTCAPv1\n"
+
+/*! Size of the capture file header */
+#define MT_MSG_CAPTURE_HDR_SIZE   32
+
+/*! Size of a capture record header */
+#define MT_MSG_CAPTURE_REC_SIZE   16
+
+/*!
+ * @enum mt_msg_capture_type
+ * @brief Capture record types
+ */
+enum mt_msg_capture_type {
+    /*! a frame was received */
+    MT_MSG_CAPTURE_rx = 1,
+    /*! a frame was transmitted */
+    MT_MSG_CAPTURE_tx = 2,
+    /*! describes an interface, precedes its first frame */
+    MT_MSG_CAPTURE_iface = 3
+};
+
+/*
+ * @brief Start capturing every frame on every interface
+ * @param filename - the capture file, it is replaced
+ * @returns 0 on success
+ *
+ * Frames are buffered and written by a writer thread at least once a
+ * second, and when the capture is stopped (or the application exits).
+ * If the writer falls a whole buffer behind, frames are dropped, the
+ * record sequence numbers show the gap. An existing capture is
+ * stopped first.
+ */
+int MT_MSG_CAPTURE_start(const char *filename);
+
+/*
+ * @brief Stop capturing, and close the capture file
+ */
+void MT_MSG_CAPTURE_stop(void);
+
+/*
+ * @brief Add a frame to the capture, if a capture is running
+ * @param pMI - the interface
+ * @param type - MT_MSG_CAPTURE_rx or MT_MSG_CAPTURE_tx
+ * @param pFrame - the frame as it is on the wire
+ * @param nbytes - size of the frame
+ * @param t_nSecs - when, see TIMER_getNow_nSecs()
+ *
+ * Called by the rx and tx paths, this returns right away when
+ * no capture is running.
+ */
+void MT_MSG_CAPTURE_frame(struct mt_msg_interface *pMI,
+                          enum mt_msg_capture_type type,
+                          const uint8_t *pFrame,
+                          int nbytes,
+                          uint64_t t_nSecs);
+
+/*!
+ * @struct mt_msg_replay_cfg
+ * @brief Parameters for MT_MSG_replay()
+ */
+struct mt_msg_replay_cfg {
+    /*! the capture file */
+    const char *filename;
+
+    /*! If not NULL, only frames from the interface with this name */
+    const char *iface_name;
+
+    /*! Which frames, MT_MSG_CAPTURE_rx or MT_MSG_CAPTURE_tx */
+    enum mt_msg_capture_type type;
+
+    /*!
+     * 0 as fast as possible, 1 the original speed,
+     * N is N times the original speed
+     */
+    int speed;
+
+    /*!
+     * false: the frames are dispatched as if received on the interface
+     *        (no IO, the application reads them from the rx_list)
+     * true: the frames are transmitted on the interface, so they
+     *       are received by whatever is on the other end
+     */
+    bool transmit;
+
+    /*! Play the capture this many times, 0 means once */
+    int loops;
+
+    /*! If set, stop early, ie: when the other end goes away */
+    volatile bool *pStop;
+};
+
+/*!
+ * @struct mt_msg_replay_result
+ * @brief What MT_MSG_replay() did
+ */
+struct mt_msg_replay_result {
+    /*! frames played */
+    unsigned n_frames;
+    /*! payload bytes in the frames played */
+    uint64_t n_bytes;
+    /*! records that were skipped (other interface, or type) */
+    unsigned n_skipped;
+    /*! records that could not be played (bad frame, tx error) */
+    unsigned n_errors;
+    /*! wall time of the replay */
+    uint64_t elapsed_nSecs;
+};
+
+/*
+ * @brief Play a capture file into an interface
+ * @param pMI - a created interface, see MT_MSG_interfaceCreate()
+ * @param pCfg - what to play and how fast
+ * @param pResult - if not NULL, filled in
+ * @returns 0 on success, negative if the file cannot be played
+ *
+ * The capture is mapped into memory (not read). Each frame is
+ * reframed for pMI, so a uart capture can be played on a socket.
+ * Fragmented (extended) frames are played as they were captured.
+ */
+int MT_MSG_replay(struct mt_msg_interface *pMI,
+                  const struct mt_msg_replay_cfg *pCfg,
+                  struct mt_msg_replay_result *pResult);
+
+/*
+ * @brief Dispatch a message as if it was received on an interface
+ * @param pMI - the interface
+ * @param pMsg - the message, laid out for pMI, it is consumed
+ *
+ * Used by MT_MSG_replay(), the message takes the same path as one
+ * read by the rx thread: fragment handling, srsp matching or the rx_list.
+ */
+void MT_MSG_rxInject(struct mt_msg_interface *pMI, struct mt_msg *pMsg);
+
 /*
  * @brief Get Ext Address
  * @param pIface - destination interface
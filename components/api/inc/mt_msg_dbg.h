@@ -19,6 +19,7 @@
 /* forward declarations */
 struct mt_msg_dbg_field;
 struct mt_msg_dbg;
+struct mt_msg_schema;
 
 /*! contains 'pseudo-globals' when decoding/printing message content */
 struct mt_msg_dbg_info {
@@ -97,12 +98,46 @@ struct mt_msg_dbg {
  */
 struct mt_msg_dbg *MT_MSG_dbg_load(const char *filename);
 
+/*!
+ * @brief Build the debug info for a message described by a schema
+ * @param pSchema - the schema, see mt_msg_schema.h
+ * @return NULL on error, otherwise the debug info (one message).
+ */
+struct mt_msg_dbg *MT_MSG_dbg_fromSchema(const struct mt_msg_schema *pSchema);
+
+/*!
+ * @brief Append debug info for schemas not already in a list
+ * @param ppAll - the list, normally &ALL_MT_MSG_DBG
+ * @param ppSchemas - NULL terminated list of schemas
+ * @return number added, or -1 on error
+ *
+ * Messages described by a loaded file (see MT_MSG_dbg_load()) are
+ * left alone. Call before MT_MSG_dbg_buildIndex().
+ */
+int MT_MSG_dbg_addSchemas(struct mt_msg_dbg **ppAll,
+                          struct mt_msg_schema * const *ppSchemas);
+
 /*!
  * @brief Free memory associated with a list of messages
  * @param pMsgs - list of message debug info to free
  */
 void MT_MSG_dbg_free(struct mt_msg_dbg *pMsgs);
 
+/*!
+ * @brief Build a direct [cmd0][cmd1] lookup for MT_MSG_dbg_decode()
+ * @param pAll - the complete list, normally ALL_MT_MSG_DBG
+ * @return 0 on success, -1 if the list must be searched instead
+ *
+ * Call after all debug files are loaded. Without an index, or for
+ * any other list, MT_MSG_dbg_decode() searches the list.
+ */
+int MT_MSG_dbg_buildIndex(struct mt_msg_dbg *pAll);
+
+/*!
+ * @brief Release the lookup built by MT_MSG_dbg_buildIndex()
+ */
+void MT_MSG_dbg_freeIndex(void);
+
 /*!
  * @brief Decode & print detail about specified message.
  *
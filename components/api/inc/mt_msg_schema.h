@@ -0,0 +1,261 @@
+/******************************************************************************
+ @file mt_msg_schema.h
+
+ @brief TIMAC 2.0 mt msg - table driven payload encode/decode
+
+ Group: WCS LPC
+ $Target Device: DEVICES $
+
+ ******************************************************************************
+ $License: BSD3 2016 $
+ ******************************************************************************
+ $Release Name: PACKAGE NAME $
+ $Release Date: PACKAGE RELEASE DATE $
+ *****************************************************************************/
+
+#if !defined(MT_MSG_SCHEMA_H)
+#define MT_MSG_SCHEMA_H
+
+#include "mt_msg.h"
+#include <stddef.h>
+
+/*
+ * Overview
+ * ========
+ *
+ * A schema lists the fields of an MT payload, in wire order, and
+ * where each field lives in a C structure, for example:
+ *
+ *    static const struct mt_msg_schema_field purge_cnf_fields[] = {
+ *        MT_MSG_SCHEMA_U8(ApiMac_mcpsPurgeCnf_t, status),
+ *        MT_MSG_SCHEMA_U8(ApiMac_mcpsPurgeCnf_t, msduHandle),
+ *        MT_MSG_SCHEMA_END
+ *    };
+ *
+ * MT_MSG_SCHEMA_compile() turns the field list into a list of byte
+ * runs and a list of operations. Fields with the same bytes on the
+ * wire and in the structure (on little endian hosts) are byte runs,
+ * fields next to each other in both places share one run, and the
+ * runs are copied in one loop without looking at the field types.
+ * The other fields, addresses, bools, custom codecs and such, are
+ * operations. The payload length is checked once, not per field.
+ *
+ * The same schema can describe the message to the debug decoder,
+ * see MT_MSG_dbg_fromSchema() in mt_msg_dbg.h
+ */
+
+/*!
+ * @enum mt_msg_schema_type
+ * @brief Field types in a schema
+ */
+enum mt_msg_schema_type {
+    /*! terminates the field list */
+    MT_MSG_SCHEMA_TYPE_end = 0,
+    /*! 1 byte integer, the member may be 1, 2, 4 or 8 bytes */
+    MT_MSG_SCHEMA_TYPE_u8 = 1,
+    /*! 2 byte little endian integer */
+    MT_MSG_SCHEMA_TYPE_u16 = 2,
+    /*! 4 byte little endian integer */
+    MT_MSG_SCHEMA_TYPE_u32 = 3,
+    /*! 8 byte little endian integer */
+    MT_MSG_SCHEMA_TYPE_u64 = 4,
+    /*! 1 byte, the member is a bool */
+    MT_MSG_SCHEMA_TYPE_bool = 5,
+    /*! fixed size byte array, same size on the wire */
+    MT_MSG_SCHEMA_TYPE_bytes = 6,
+    /*! an ApiMac_sAddr_t, 1 byte mode then 8 bytes of address */
+    MT_MSG_SCHEMA_TYPE_addr = 7,
+    /*! bytes on the wire only, ignored when read, zero when written */
+    MT_MSG_SCHEMA_TYPE_skip = 8,
+    /*! the field has its own codec, see mt_msg_schema_fn */
+    MT_MSG_SCHEMA_TYPE_custom = 9,
+    /*! variable length data (uint8_t *), the length is an earlier field */
+    MT_MSG_SCHEMA_TYPE_data = 10
+};
+
+/*!
+ * @brief Codec for a MT_MSG_SCHEMA_TYPE_custom field
+ * @param is_encode - true: member to wire, false: wire to member
+ * @param pWire - the field on the wire, mt_msg_schema_field::wire bytes
+ * @param pMember - the member in the structure
+ */
+typedef void mt_msg_schema_fn(bool is_encode, uint8_t *pWire, void *pMember);
+
+/*!
+ * @struct mt_msg_schema_field
+ * @brief One field in a schema, use the MT_MSG_SCHEMA_xxx() macros below
+ */
+struct mt_msg_schema_field {
+    /*! what type of field is this? */
+    enum mt_msg_schema_type type;
+
+    /*! name for the debug log */
+    const char *name;
+
+    /*! offset of the member in the structure */
+    uint16_t offset;
+
+    /*! size of the member in the structure */
+    uint16_t size;
+
+    /*! bytes on the wire, 0 for variable length data */
+    uint16_t wire;
+
+    /*! MT_MSG_SCHEMA_TYPE_data, offset of the uint16_t length member */
+    uint16_t len_offset;
+
+    /*! MT_MSG_SCHEMA_TYPE_custom, the codec */
+    mt_msg_schema_fn *pFn;
+
+    /*! Set by MT_MSG_SCHEMA_compile() in the operations, where the
+     * field starts in the fixed part of the payload */
+    uint16_t wire_offset;
+};
+
+/*!
+ * @struct mt_msg_schema_copy
+ * @brief Bytes that are the same on the wire and in the structure
+ */
+struct mt_msg_schema_copy {
+    /*! offset in the structure */
+    uint16_t offset;
+    /*! offset in the fixed part of the payload */
+    uint16_t wire_offset;
+    /*! number of bytes, 0 ends the list */
+    uint16_t len;
+};
+
+/*!
+ * @struct mt_msg_schema
+ * @brief Describes one MT message payload
+ */
+struct mt_msg_schema {
+    /*! command bytes of the message */
+    int cmd0;
+    /*! command bytes of the message */
+    int cmd1;
+
+    /*! name for logs and the debug decoder */
+    const char *name;
+
+    /*! fields in wire order, ends with MT_MSG_SCHEMA_END */
+    const struct mt_msg_schema_field *pFields;
+
+    /*! Set by MT_MSG_SCHEMA_compile(), the byte runs */
+    struct mt_msg_schema_copy *pCopies;
+
+    /*! Set by MT_MSG_SCHEMA_compile(), the other fields */
+    struct mt_msg_schema_field *pOps;
+
+    /*! Set by MT_MSG_SCHEMA_compile(), bytes before any variable data */
+    int fixed_len;
+};
+
+/*! size of a member in a structure */
+#define MT_MSG_SCHEMA_memberSize(T, M)  sizeof(((T *)0)->M)
+
+/*! General field, the other macros use this */
+#define MT_MSG_SCHEMA_FIELD(TYPE, T, M, WIRE)                         \
+    { (TYPE), #M, offsetof(T, M), MT_MSG_SCHEMA_memberSize(T, M),     \
+      (WIRE), 0, NULL }
+
+/*! An integer field in structure T, member M */
+#define MT_MSG_SCHEMA_U8(T, M)  \
+    MT_MSG_SCHEMA_FIELD(MT_MSG_SCHEMA_TYPE_u8, T, M, 1)
+/*! An integer field in structure T, member M */
+#define MT_MSG_SCHEMA_U16(T, M) \
+    MT_MSG_SCHEMA_FIELD(MT_MSG_SCHEMA_TYPE_u16, T, M, 2)
+/*! An integer field in structure T, member M */
+#define MT_MSG_SCHEMA_U32(T, M) \
+    MT_MSG_SCHEMA_FIELD(MT_MSG_SCHEMA_TYPE_u32, T, M, 4)
+/*! An integer field in structure T, member M */
+#define MT_MSG_SCHEMA_U64(T, M) \
+    MT_MSG_SCHEMA_FIELD(MT_MSG_SCHEMA_TYPE_u64, T, M, 8)
+/*! A one byte bool in structure T, member M */
+#define MT_MSG_SCHEMA_BOOL(T, M) \
+    MT_MSG_SCHEMA_FIELD(MT_MSG_SCHEMA_TYPE_bool, T, M, 1)
+/*! A byte array in structure T, member M */
+#define MT_MSG_SCHEMA_BYTES(T, M) \
+    MT_MSG_SCHEMA_FIELD(MT_MSG_SCHEMA_TYPE_bytes, T, M, \
+                        MT_MSG_SCHEMA_memberSize(T, M))
+/*! An ApiMac_sAddr_t in structure T, member M */
+#define MT_MSG_SCHEMA_ADDR(T, M) \
+    MT_MSG_SCHEMA_FIELD(MT_MSG_SCHEMA_TYPE_addr, T, M, 9)
+/*! A field with its own codec, WIRE bytes long */
+#define MT_MSG_SCHEMA_CUSTOM(T, M, WIRE, FN)                          \
+    { MT_MSG_SCHEMA_TYPE_custom, #M, offsetof(T, M),                  \
+      MT_MSG_SCHEMA_memberSize(T, M), (WIRE), 0, (FN) }
+/*! N bytes on the wire that are not in the structure */
+#define MT_MSG_SCHEMA_SKIP(NAME, N) \
+    { MT_MSG_SCHEMA_TYPE_skip, (NAME), 0, 0, (N), 0, NULL }
+/*!
+ * Variable length data, PTR is a uint8_t * and LEN a uint16_t member.
+ * These must be at the end of the list, after the length field.
+ * The decoded pointer points into the message io buffer.
+ */
+#define MT_MSG_SCHEMA_DATA(T, PTR, LEN)                               \
+    { MT_MSG_SCHEMA_TYPE_data, #PTR, offsetof(T, PTR),                \
+      MT_MSG_SCHEMA_memberSize(T, PTR), 0, offsetof(T, LEN), NULL }
+/*! Terminates the field list */
+#define MT_MSG_SCHEMA_END \
+    { MT_MSG_SCHEMA_TYPE_end, NULL, 0, 0, 0, 0, NULL }
+
+/*!
+ * @brief Build the operation list for a schema
+ * @param pSchema - the schema
+ * @returns 0 on success, -1 if the schema is not valid
+ *
+ * This is done once, the decode/encode functions call this if needed.
+ * Compile shared schemas before starting threads that use them.
+ */
+int MT_MSG_SCHEMA_compile(struct mt_msg_schema *pSchema);
+
+/*!
+ * @brief Decode a message payload into a structure
+ * @param pMsg - the message, reading starts at the current position
+ * @param pSchema - describes the payload
+ * @param pStruct - the structure to fill in
+ * @returns 0 on success, -1 on error (and pMsg->is_error is set)
+ *
+ * This does not call MT_MSG_parseComplete(), the caller may have
+ * more fields to read.
+ */
+int MT_MSG_SCHEMA_decode(struct mt_msg *pMsg,
+                         struct mt_msg_schema *pSchema,
+                         void *pStruct);
+
+/*!
+ * @brief How many payload bytes will MT_MSG_SCHEMA_encode() write?
+ * @param pSchema - describes the payload
+ * @param pStruct - the structure, for the length of variable data
+ * @returns number of bytes, or -1 if the schema is not valid
+ */
+int MT_MSG_SCHEMA_encodedLen(struct mt_msg_schema *pSchema,
+                             const void *pStruct);
+
+/*!
+ * @brief Encode a structure into a message payload
+ * @param pMsg - the message, writing starts at the current position
+ * @param pSchema - describes the payload
+ * @param pStruct - the structure to encode
+ * @returns 0 on success, -1 on error (and pMsg->is_error is set)
+ */
+int MT_MSG_SCHEMA_encode(struct mt_msg *pMsg,
+                         struct mt_msg_schema *pSchema,
+                         const void *pStruct);
+
+#endif
+
+/*
+ *  ========================================
+ *  Texas Instruments Micro Controller Style
+ *  ========================================
+ *  Local Variables:
+ *  mode: c
+ *  c-file-style: "bsd"
+ *  tab-width: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  End:
+ *  vim:set  filetype=c tabstop=4 shiftwidth=4 expandtab=true
+ */
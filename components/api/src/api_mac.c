@@ -29,6 +29,8 @@
 #include "stream_socket.h"
 
 #include "mt_msg.h"
+#include "mt_msg_dbg.h"
+#include "mt_msg_schema.h"
 #include "api_mac.h"
 #include "api_mac_linux.h"
 
@@ -92,6 +94,22 @@ struct secPibHandler
 */
 int ApiMacLinux_areq_timeout_mSecs = DEFAULT_ApiMacLinux_areq_timeout_mSecs;
 
+/*!
+  Most ApiMac_mcpsDataReqSubmit() requests waiting for a confirm.
+*/
+int ApiMacLinux_dataReq_maxInFlight = DEFAULT_ApiMacLinux_dataReq_maxInFlight;
+
+/*!
+  How long an ApiMac_mcpsDataReqSubmit() request waits for a confirm.
+*/
+int ApiMacLinux_dataReq_timeout_mSecs =
+    DEFAULT_ApiMacLinux_dataReq_timeout_mSecs;
+
+/*!
+  Answer PIB gets from the host side cache? see ApiMacLinux_pibCacheVolatile()
+*/
+int ApiMacLinux_pibCache_enable = DEFAULT_ApiMacLinux_pibCache_enable;
+
 /*!
   Debug log flags for the API MAC module.
   these flags are used by the "main" app when parsing the
@@ -139,6 +157,9 @@ struct mt_version_info MT_DEVICE_version_info;
 /*! Msgs processed while awaiting a reset rsp */
 #define MAX_MSGS_PROCESSED_POST_RESET 20
 
+/*! Largest array PIB attribute, the FH excluded channel bitmaps */
+#define API_MAC_PIB_CACHE_MAX_ARRAY  APIMAC_FH_MAX_BIT_MAP_SIZE
+
 /*! Offset into the payload for the payload IEs */
 #define PAYLOAD_IE_OFFSET                    0
 /*! Offset into the IE for the subIE */
@@ -291,6 +312,102 @@ static ApiMac_callbacks_t *pApiMac_callbacks;
 /*! used as random source for ApiMac_randomByte() */
 static struct rand_data_one rand_data_source;
 
+/*!
+ * @struct api_mac_inflight
+ * @brief A pipelined data request waiting for its confirm,
+ *        see ApiMac_mcpsDataReqSubmit()
+ */
+struct api_mac_inflight {
+    /*! waiting for a confirm */
+    bool in_use;
+    /*! the co-processor refused it, the confirm is made locally */
+    bool is_refused;
+    /*! when it was sent */
+    timertoken_t t_start;
+    /*! called with the confirm, NULL means pDataCnfCb */
+    ApiMac_dataDoneFn_t *pDoneFn;
+    /*! given to pDoneFn */
+    void *pCookie;
+};
+
+/*! Pipelined data requests, indexed by msduHandle */
+static struct api_mac_inflight api_mac_inflight[256];
+
+/*! Number of api_mac_inflight[] entries in use */
+static int api_mac_inflight_count;
+
+/*! Protects api_mac_inflight[] */
+static intptr_t api_mac_inflight_lock;
+
+/*! Room for requests waiting for the SRSP, see ApiMacLinux_dataReq_maxInFlight */
+static intptr_t api_mac_submit_room;
+
+/*! When api_mac_inflight[] was last checked for lost confirms */
+static timertoken_t api_mac_inflight_checked;
+
+/*!
+ * @struct api_mac_pib_entry
+ * @brief A cached PIB attribute value, see API_MAC_Get_Common()
+ */
+struct api_mac_pib_entry {
+    /*! the value is good */
+    bool is_valid;
+    /*! never cache this attribute */
+    bool is_volatile;
+    /*! wire size used to read the value, negative for arrays */
+    int8_t wiresize;
+    /*! numeric value */
+    uint64_t v;
+    /*! array value */
+    uint8_t bytes[API_MAC_PIB_CACHE_MAX_ARRAY];
+};
+
+/*! Cached PIB values, see api_mac_pibIndex() */
+static struct api_mac_pib_entry api_mac_pib_cache[0x200];
+
+/*! Set when api_mac_pib_cache[].is_volatile has the defaults */
+static bool api_mac_pib_cache_init;
+
+/*! Protects api_mac_pib_cache[] and api_mac_pib_stats */
+static intptr_t api_mac_pib_lock;
+
+/*! Changes on every invalidate, a get that raced one is not cached */
+static unsigned api_mac_pib_generation;
+
+/*! Cache statistics, see ApiMacLinux_pibCacheStats() */
+static struct api_mac_pib_cache_stats api_mac_pib_stats;
+
+/*! Attributes the MAC changes on its own, never cached */
+static const uint16_t api_mac_pib_volatile[] = {
+    ApiMac_attribute_beaconTxTime,
+    ApiMac_attribute_bsn,
+    ApiMac_attribute_dsn,
+    ApiMac_attribute_eBeaconSequenceNumber,
+    ApiMac_attribute_diagRxCrcPass,
+    ApiMac_attribute_diagRxCrcFail,
+    ApiMac_attribute_diagRxBroadcast,
+    ApiMac_attribute_diagTxBroadcast,
+    ApiMac_attribute_diagRxUnicast,
+    ApiMac_attribute_diagTxUnicast,
+    ApiMac_attribute_diagTxUnicastRetry,
+    ApiMac_attribute_diagTxUnicastFail,
+    ApiMac_attribute_diagRxSecureFail,
+    ApiMac_attribute_diagTxSecureFail,
+    ApiMac_FHAttribute_numNonSleepDevice,
+    ApiMac_FHAttribute_numSleepDevice,
+    ApiMac_FHAttribute_numTempTableNode,
+    /* terminate */
+    0
+};
+
+/*! Drop all cached PIB values */
+#define API_MAC_PIB_FLUSH_ALL(WHY)  api_mac_pibFlush(0, 0x20ff, (WHY))
+
+/*! Drop the cached security PIB values */
+#define API_MAC_PIB_FLUSH_SECURITY(WHY)                          \
+    api_mac_pibFlush(ApiMac_securityAttribute_keyTable,          \
+                     ApiMac_securityAttribute_securityLevelEntry, (WHY))
+
 /******************************************************************************
  Local Function Prototypes
  *****************************************************************************/
@@ -339,10 +456,19 @@ static void process_areq_poll_ind(const struct mt_msg_dispatch *p,
 static void process_areq_reset_ind(const struct mt_msg_dispatch *p,
                                    struct mt_msg *pMsg);
 static void process_areq(struct mt_msg *pMsg);
+static void api_mac_inflightExpire(bool all);
+static void api_mac_pibFlush(int lo, int hi, const char *why);
+static void api_mac_pibInit(void);
+static void api_mac_dataCnfDeliver(ApiMac_mcpsDataCnf_t *pCnf);
 static void resetCoPDevice(void);
 static void *createInterface(void);
 static uint16_t convertTxOptions(ApiMac_txOptions_t *txOptions);
 static int API_MAC_TxRx_Status(struct mt_msg *pMsg);
+static int API_MAC_Srsp_Status(struct mt_msg *pMsg, int r);
+static ApiMac_status_t API_MAC_TxRx_Status_Async(struct mt_msg *pMsg,
+                                               ApiMac_asyncDoneFn_t *pDoneFn,
+                                               void *pCookie);
+static struct mt_msg *api_mcpsDataReq_msg(ApiMac_mcpsDataReq_t *pData);
 static struct mt_msg *api_new_msg(int len, int cmd0, int cmd1,
                                   const char *dbg_prefix);
 static int API_MAC_Get_Common(int cmd0, int cmd1, int att_id, int wiresize, 
@@ -553,7 +679,8 @@ void *ApiMac_init(bool enableFH)
 {
     int r;
     bool b;
-    void *sem;
+    /* the interface is made once, a re-init returns the same one */
+    static void *sem;
     static bool initialMacInit = true;
 
     if (initialMacInit) 
@@ -621,6 +748,420 @@ void ApiMac_registerCallbacks(ApiMac_callbacks_t *pCallbacks)
     pApiMac_callbacks = pCallbacks;
 }
 
+/*
+ * Payload schemas, see mt_msg_schema.h
+ * These drive the decode (and encode) of the fixed layout messages,
+ * and describe them to the debug decoder, see ApiMacLinux_dbgAddSchemas()
+ */
+
+/*! The security fields, an ApiMac_sec_t in structure T, member M */
+#define API_MAC_SCHEMA_SEC(T, M)                    \
+    MT_MSG_SCHEMA_BYTES(T, M.keySource),            \
+    MT_MSG_SCHEMA_U8(T, M.securityLevel),           \
+    MT_MSG_SCHEMA_U8(T, M.keyIdMode),               \
+    MT_MSG_SCHEMA_U8(T, M.keyIndex)
+
+/*!
+ * @brief Schema codec for the capability information byte
+ * @param is_encode - true: member to wire
+ * @param pWire - the byte on the wire
+ * @param pMember - an ApiMac_capabilityInfo_t
+ */
+static void api_mac_schema_capInfo(bool is_encode, uint8_t *pWire,
+                                   void *pMember)
+{
+    if(is_encode)
+    {
+        pWire[0] = ApiMac_convertCapabilityInfo(
+            (ApiMac_capabilityInfo_t *)(pMember));
+    }
+    else
+    {
+        ApiMac_buildMsgCapInfo(pWire[0], (ApiMac_capabilityInfo_t *)(pMember));
+    }
+}
+
+/*!
+ * @brief Schema codec for the tx options byte
+ * @param is_encode - true: member to wire
+ * @param pWire - the byte on the wire
+ * @param pMember - an ApiMac_txOptions_t
+ */
+static void api_mac_schema_txOptions(bool is_encode, uint8_t *pWire,
+                                     void *pMember)
+{
+    ApiMac_txOptions_t *pTx;
+
+    pTx = (ApiMac_txOptions_t *)(pMember);
+    if(is_encode)
+    {
+        pWire[0] = (uint8_t)convertTxOptions(pTx);
+        return;
+    }
+    pTx->ack                = (pWire[0] & MAC_TXOPTION_ACK) ? true : false;
+    pTx->indirect           = (pWire[0] & MAC_TXOPTION_INDIRECT) ? true : false;
+    pTx->pendingBit         = (pWire[0] & MAC_TXOPTION_PEND_BIT) ? true : false;
+    pTx->noRetransmits      = (pWire[0] & MAC_TXOPTION_NO_RETRANS) ? true : false;
+    pTx->noConfirm          = (pWire[0] & MAC_TXOPTION_NO_CNF) ? true : false;
+    pTx->useAltBE           = (pWire[0] & MAC_TXOPTION_ALT_BE) ? true : false;
+    pTx->usePowerAndChannel = (pWire[0] & MAC_TXOPTION_PWR_CHAN) ? true : false;
+}
+
+static const struct mt_msg_schema_field api_mac_fields_sync_loss_ind[] = {
+    MT_MSG_SCHEMA_U8(ApiMac_mlmeSyncLossInd_t, reason),
+    MT_MSG_SCHEMA_U16(ApiMac_mlmeSyncLossInd_t, panId),
+    MT_MSG_SCHEMA_U8(ApiMac_mlmeSyncLossInd_t, logicalChannel),
+    MT_MSG_SCHEMA_U8(ApiMac_mlmeSyncLossInd_t, channelPage),
+    MT_MSG_SCHEMA_U8(ApiMac_mlmeSyncLossInd_t, phyID),
+    API_MAC_SCHEMA_SEC(ApiMac_mlmeSyncLossInd_t, sec),
+    MT_MSG_SCHEMA_END
+};
+
+static struct mt_msg_schema api_mac_schema_sync_loss_ind = {
+    .cmd0 = MAC_SYNC_LOSS_IND_cmd0,
+    .cmd1 = MAC_SYNC_LOSS_IND_cmd1,
+    .name = "sync-loss-ind",
+    .pFields = api_mac_fields_sync_loss_ind
+};
+
+static const struct mt_msg_schema_field api_mac_fields_associate_ind[] = {
+    MT_MSG_SCHEMA_BYTES(ApiMac_mlmeAssociateInd_t, deviceAddress),
+    MT_MSG_SCHEMA_CUSTOM(ApiMac_mlmeAssociateInd_t, capabilityInformation,
+                         1, api_mac_schema_capInfo),
+    API_MAC_SCHEMA_SEC(ApiMac_mlmeAssociateInd_t, sec),
+    MT_MSG_SCHEMA_END
+};
+
+static struct mt_msg_schema api_mac_schema_associate_ind = {
+    .cmd0 = MAC_ASSOCIATE_IND_cmd0,
+    .cmd1 = MAC_ASSOCIATE_IND_cmd1,
+    .name = "associate-ind",
+    .pFields = api_mac_fields_associate_ind
+};
+
+static const struct mt_msg_schema_field api_mac_fields_associate_cnf[] = {
+    MT_MSG_SCHEMA_U8(ApiMac_mlmeAssociateCnf_t, status),
+    MT_MSG_SCHEMA_U16(ApiMac_mlmeAssociateCnf_t, assocShortAddress),
+    API_MAC_SCHEMA_SEC(ApiMac_mlmeAssociateCnf_t, sec),
+    MT_MSG_SCHEMA_END
+};
+
+static struct mt_msg_schema api_mac_schema_associate_cnf = {
+    .cmd0 = MAC_ASSOCIATE_CNF_cmd0,
+    .cmd1 = MAC_ASSOCIATE_CNF_cmd1,
+    .name = "associate-cnf",
+    .pFields = api_mac_fields_associate_cnf
+};
+
+static const struct mt_msg_schema_field api_mac_fields_data_cnf[] = {
+    MT_MSG_SCHEMA_U8(ApiMac_mcpsDataCnf_t, status),
+    MT_MSG_SCHEMA_U8(ApiMac_mcpsDataCnf_t, msduHandle),
+    MT_MSG_SCHEMA_U32(ApiMac_mcpsDataCnf_t, timestamp),
+    MT_MSG_SCHEMA_U16(ApiMac_mcpsDataCnf_t, timestamp2),
+    MT_MSG_SCHEMA_U8(ApiMac_mcpsDataCnf_t, retries),
+    MT_MSG_SCHEMA_U8(ApiMac_mcpsDataCnf_t, mpduLinkQuality),
+    MT_MSG_SCHEMA_U8(ApiMac_mcpsDataCnf_t, correlation),
+    MT_MSG_SCHEMA_U8(ApiMac_mcpsDataCnf_t, rssi),
+    MT_MSG_SCHEMA_U32(ApiMac_mcpsDataCnf_t, frameCntr),
+    MT_MSG_SCHEMA_END
+};
+
+static struct mt_msg_schema api_mac_schema_data_cnf = {
+    .cmd0 = MAC_DATA_CNF_cmd0,
+    .cmd1 = MAC_DATA_CNF_cmd1,
+    .name = "data-cnf",
+    .pFields = api_mac_fields_data_cnf
+};
+
+/*! The head of a data indication, also used by the WiSun async indication */
+#define API_MAC_SCHEMA_DATA_IND_HEAD(T)             \
+    MT_MSG_SCHEMA_ADDR(T, srcAddr),                 \
+    MT_MSG_SCHEMA_ADDR(T, dstAddr),                 \
+    MT_MSG_SCHEMA_U32(T, timestamp),                \
+    MT_MSG_SCHEMA_U16(T, timestamp2),               \
+    MT_MSG_SCHEMA_U16(T, srcPanId),                 \
+    MT_MSG_SCHEMA_U16(T, dstPanId),                 \
+    MT_MSG_SCHEMA_U8(T, mpduLinkQuality),           \
+    MT_MSG_SCHEMA_U8(T, correlation),               \
+    MT_MSG_SCHEMA_U8(T, rssi),                      \
+    MT_MSG_SCHEMA_U8(T, dsn),                       \
+    API_MAC_SCHEMA_SEC(T, sec),                     \
+    MT_MSG_SCHEMA_U32(T, frameCntr)
+
+static const struct mt_msg_schema_field api_mac_fields_data_ind[] = {
+    API_MAC_SCHEMA_DATA_IND_HEAD(ApiMac_mcpsDataInd_t),
+    MT_MSG_SCHEMA_U16(ApiMac_mcpsDataInd_t, msdu.len),
+    MT_MSG_SCHEMA_U16(ApiMac_mcpsDataInd_t, payloadIeLen),
+    MT_MSG_SCHEMA_DATA(ApiMac_mcpsDataInd_t, msdu.p, msdu.len),
+    MT_MSG_SCHEMA_DATA(ApiMac_mcpsDataInd_t, pPayloadIE, payloadIeLen),
+    MT_MSG_SCHEMA_END
+};
+
+static struct mt_msg_schema api_mac_schema_data_ind = {
+    .cmd0 = MAC_DATA_IND_cmd0,
+    .cmd1 = MAC_DATA_IND_cmd1,
+    .name = "data-ind",
+    .pFields = api_mac_fields_data_ind
+};
+
+static const struct mt_msg_schema_field api_mac_fields_disassociate_ind[] = {
+    MT_MSG_SCHEMA_BYTES(ApiMac_mlmeDisassociateInd_t, deviceAddress),
+    MT_MSG_SCHEMA_U8(ApiMac_mlmeDisassociateInd_t, disassociateReason),
+    API_MAC_SCHEMA_SEC(ApiMac_mlmeDisassociateInd_t, sec),
+    MT_MSG_SCHEMA_END
+};
+
+static struct mt_msg_schema api_mac_schema_disassociate_ind = {
+    .cmd0 = MAC_DISASSOCIATE_IND_cmd0,
+    .cmd1 = MAC_DISASSOCIATE_IND_cmd1,
+    .name = "disassociate-ind",
+    .pFields = api_mac_fields_disassociate_ind
+};
+
+static const struct mt_msg_schema_field api_mac_fields_disassociate_cnf[] = {
+    MT_MSG_SCHEMA_U8(ApiMac_mlmeDisassociateCnf_t, status),
+    MT_MSG_SCHEMA_ADDR(ApiMac_mlmeDisassociateCnf_t, deviceAddress),
+    MT_MSG_SCHEMA_U16(ApiMac_mlmeDisassociateCnf_t, panId),
+    MT_MSG_SCHEMA_END
+};
+
+static struct mt_msg_schema api_mac_schema_disassociate_cnf = {
+    .cmd0 = MAC_DISASSOCIATE_CNF_cmd0,
+    .cmd1 = MAC_DISASSOCIATE_CNF_cmd1,
+    .name = "disassociate-cnf",
+    .pFields = api_mac_fields_disassociate_cnf
+};
+
+static const struct mt_msg_schema_field api_mac_fields_orphan_ind[] = {
+    MT_MSG_SCHEMA_BYTES(ApiMac_mlmeOrphanInd_t, orphanAddress),
+    API_MAC_SCHEMA_SEC(ApiMac_mlmeOrphanInd_t, sec),
+    MT_MSG_SCHEMA_END
+};
+
+static struct mt_msg_schema api_mac_schema_orphan_ind = {
+    .cmd0 = MAC_ORPHAN_IND_cmd0,
+    .cmd1 = MAC_ORPHAN_IND_cmd1,
+    .name = "orphan-ind",
+    .pFields = api_mac_fields_orphan_ind
+};
+
+static const struct mt_msg_schema_field api_mac_fields_poll_cnf[] = {
+    MT_MSG_SCHEMA_U8(ApiMac_mlmePollCnf_t, status),
+    MT_MSG_SCHEMA_U8(ApiMac_mlmePollCnf_t, framePending),
+    MT_MSG_SCHEMA_END
+};
+
+static struct mt_msg_schema api_mac_schema_poll_cnf = {
+    .cmd0 = MAC_POLL_CNF_cmd0,
+    .cmd1 = MAC_POLL_CNF_cmd1,
+    .name = "poll-cnf",
+    .pFields = api_mac_fields_poll_cnf
+};
+
+static const struct mt_msg_schema_field api_mac_fields_comm_status_ind[] = {
+    MT_MSG_SCHEMA_U8(ApiMac_mlmeCommStatusInd_t, status),
+    MT_MSG_SCHEMA_ADDR(ApiMac_mlmeCommStatusInd_t, srcAddr),
+    MT_MSG_SCHEMA_ADDR(ApiMac_mlmeCommStatusInd_t, dstAddr),
+    MT_MSG_SCHEMA_U16(ApiMac_mlmeCommStatusInd_t, panId),
+    MT_MSG_SCHEMA_U8(ApiMac_mlmeCommStatusInd_t, reason),
+    API_MAC_SCHEMA_SEC(ApiMac_mlmeCommStatusInd_t, sec),
+    MT_MSG_SCHEMA_END
+};
+
+static struct mt_msg_schema api_mac_schema_comm_status_ind = {
+    .cmd0 = MAC_COMM_STATUS_IND_cmd0,
+    .cmd1 = MAC_COMM_STATUS_IND_cmd1,
+    .name = "comm-status-ind",
+    .pFields = api_mac_fields_comm_status_ind
+};
+
+static const struct mt_msg_schema_field api_mac_fields_start_cnf[] = {
+    MT_MSG_SCHEMA_U8(ApiMac_mlmeStartCnf_t, status),
+    MT_MSG_SCHEMA_END
+};
+
+static struct mt_msg_schema api_mac_schema_start_cnf = {
+    .cmd0 = MAC_START_CNF_cmd0,
+    .cmd1 = MAC_START_CNF_cmd1,
+    .name = "start-cnf",
+    .pFields = api_mac_fields_start_cnf
+};
+
+static const struct mt_msg_schema_field api_mac_fields_purge_cnf[] = {
+    MT_MSG_SCHEMA_U8(ApiMac_mcpsPurgeCnf_t, status),
+    MT_MSG_SCHEMA_U8(ApiMac_mcpsPurgeCnf_t, msduHandle),
+    MT_MSG_SCHEMA_END
+};
+
+static struct mt_msg_schema api_mac_schema_purge_cnf = {
+    .cmd0 = MAC_PURGE_CNF_cmd0,
+    .cmd1 = MAC_PURGE_CNF_cmd1,
+    .name = "purge-cnf",
+    .pFields = api_mac_fields_purge_cnf
+};
+
+static const struct mt_msg_schema_field api_mac_fields_ws_async_cnf[] = {
+    MT_MSG_SCHEMA_U8(ApiMac_mlmeWsAsyncCnf_t, status),
+    MT_MSG_SCHEMA_END
+};
+
+static struct mt_msg_schema api_mac_schema_ws_async_cnf = {
+    .cmd0 = MAC_WS_ASYNC_CNF_cmd0,
+    .cmd1 = MAC_WS_ASYNC_CNF_cmd1,
+    .name = "ws-async-cnf",
+    .pFields = api_mac_fields_ws_async_cnf
+};
+
+/* the data is copied, so the variable part is done by hand */
+static const struct mt_msg_schema_field api_mac_fields_ws_async_ind[] = {
+    API_MAC_SCHEMA_DATA_IND_HEAD(ApiMac_mlmeWsAsyncInd_t),
+    MT_MSG_SCHEMA_U8(ApiMac_mlmeWsAsyncInd_t, fhFrameType),
+    MT_MSG_SCHEMA_U16(ApiMac_mlmeWsAsyncInd_t, msdu.len),
+    MT_MSG_SCHEMA_U16(ApiMac_mlmeWsAsyncInd_t, payloadIeLen),
+    MT_MSG_SCHEMA_END
+};
+
+static struct mt_msg_schema api_mac_schema_ws_async_ind = {
+    .cmd0 = MAC_WS_ASYNC_IND_cmd0,
+    .cmd1 = MAC_WS_ASYNC_IND_cmd1,
+    .name = "ws-async-ind",
+    .pFields = api_mac_fields_ws_async_ind
+};
+
+static const struct mt_msg_schema_field api_mac_fields_poll_ind[] = {
+    MT_MSG_SCHEMA_ADDR(ApiMac_mlmePollInd_t, srcAddr),
+    MT_MSG_SCHEMA_U16(ApiMac_mlmePollInd_t, srcPanId),
+    MT_MSG_SCHEMA_BOOL(ApiMac_mlmePollInd_t, noRsp),
+    MT_MSG_SCHEMA_END
+};
+
+static struct mt_msg_schema api_mac_schema_poll_ind = {
+    .cmd0 = MAC_POLL_IND_cmd0,
+    .cmd1 = MAC_POLL_IND_cmd1,
+    .name = "poll-ind",
+    .pFields = api_mac_fields_poll_ind
+};
+
+static const struct mt_msg_schema_field api_mac_fields_data_req[] = {
+    MT_MSG_SCHEMA_ADDR(ApiMac_mcpsDataReq_t, dstAddr),
+    MT_MSG_SCHEMA_U16(ApiMac_mcpsDataReq_t, dstPanId),
+    MT_MSG_SCHEMA_U8(ApiMac_mcpsDataReq_t, srcAddrMode),
+    MT_MSG_SCHEMA_U8(ApiMac_mcpsDataReq_t, msduHandle),
+    MT_MSG_SCHEMA_CUSTOM(ApiMac_mcpsDataReq_t, txOptions,
+                         1, api_mac_schema_txOptions),
+    MT_MSG_SCHEMA_U8(ApiMac_mcpsDataReq_t, channel),
+    MT_MSG_SCHEMA_U8(ApiMac_mcpsDataReq_t, power),
+    API_MAC_SCHEMA_SEC(ApiMac_mcpsDataReq_t, sec),
+    MT_MSG_SCHEMA_U32(ApiMac_mcpsDataReq_t, includeFhIEs),
+    MT_MSG_SCHEMA_U16(ApiMac_mcpsDataReq_t, msdu.len),
+    MT_MSG_SCHEMA_U16(ApiMac_mcpsDataReq_t, payloadIELen),
+    MT_MSG_SCHEMA_DATA(ApiMac_mcpsDataReq_t, msdu.p, msdu.len),
+    MT_MSG_SCHEMA_DATA(ApiMac_mcpsDataReq_t, pIEList, payloadIELen),
+    MT_MSG_SCHEMA_END
+};
+
+static struct mt_msg_schema api_mac_schema_data_req = {
+    .cmd0 = MAC_DATA_REQ_cmd0,
+    .cmd1 = MAC_DATA_REQ_cmd1,
+    .name = "mcpsDataReq",
+    .pFields = api_mac_fields_data_req
+};
+
+/*! All of the above, see createInterface() */
+static struct mt_msg_schema * const api_mac_schemas[] = {
+    &api_mac_schema_sync_loss_ind,
+    &api_mac_schema_associate_ind,
+    &api_mac_schema_associate_cnf,
+    &api_mac_schema_data_cnf,
+    &api_mac_schema_data_ind,
+    &api_mac_schema_disassociate_ind,
+    &api_mac_schema_disassociate_cnf,
+    &api_mac_schema_orphan_ind,
+    &api_mac_schema_poll_cnf,
+    &api_mac_schema_comm_status_ind,
+    &api_mac_schema_start_cnf,
+    &api_mac_schema_purge_cnf,
+    &api_mac_schema_ws_async_cnf,
+    &api_mac_schema_ws_async_ind,
+    &api_mac_schema_poll_ind,
+    &api_mac_schema_data_req,
+    /* terminate */
+    NULL
+};
+
+/*!
+ * @brief Compile the schemas before the rx thread runs
+ */
+static void api_mac_schemaInit(void)
+{
+    int x;
+
+    for(x = 0 ; api_mac_schemas[x] ; x++)
+    {
+        if(MT_MSG_SCHEMA_compile(api_mac_schemas[x]) != 0)
+        {
+            BUG_HERE("bad schema: %s\n", api_mac_schemas[x]->name);
+        }
+    }
+
+    /* MT_MSG_coalesceDataInd() looks at the msdu */
+    if(api_mac_schema_data_ind.fixed_len != MT_MSG_DATA_IND_MSDU_OFS)
+    {
+        BUG_HERE("data-ind msdu at %d, not %d\n",
+                 api_mac_schema_data_ind.fixed_len, MT_MSG_DATA_IND_MSDU_OFS);
+    }
+}
+
+/*
+  Describe the schema messages to the debug decoder
+
+  Public function defined in api_mac_linux.h
+*/
+int ApiMacLinux_dbgAddSchemas(void)
+{
+    return (MT_MSG_dbg_addSchemas(&ALL_MT_MSG_DBG, api_mac_schemas));
+}
+
+/*
+  Find the built in schema of a message
+
+  Public function defined in api_mac_linux.h
+*/
+struct mt_msg_schema *ApiMacLinux_findSchema(int cmd0, int cmd1)
+{
+    int x;
+
+    for(x = 0 ; api_mac_schemas[x] ; x++)
+    {
+        if((api_mac_schemas[x]->cmd0 == cmd0) &&
+           (api_mac_schemas[x]->cmd1 == cmd1))
+        {
+            if(MT_MSG_SCHEMA_compile(api_mac_schemas[x]) != 0)
+            {
+                return (NULL);
+            }
+            return (api_mac_schemas[x]);
+        }
+    }
+    return (NULL);
+}
+
+/*!
+ * @brief Decode a complete message with a schema
+ * @param pMsg - the message
+ * @param pSchema - describes the payload
+ * @param pStruct - the structure to fill in
+ * @returns true if the message is ok
+ */
+static bool api_mac_schemaDecode(struct mt_msg *pMsg,
+                                 struct mt_msg_schema *pSchema,
+                                 void *pStruct)
+{
+    MT_MSG_SCHEMA_decode(pMsg, pSchema, pStruct);
+    MT_MSG_parseComplete(pMsg);
+    return (!(pMsg->is_error));
+}
+
 /*!
  * @brief Process an associate indication
  *
@@ -630,25 +1171,14 @@ void ApiMac_registerCallbacks(ApiMac_callbacks_t *pCallbacks)
 static void process_areq_associate_ind(const struct mt_msg_dispatch *p,
                                        struct mt_msg *pMsg)
 {
-    int r;
     ApiMac_mlmeAssociateInd_t indication;
 
     (void)p;
 
     memset((void *)(&indication), 0, sizeof(indication));
 
-    MT_MSG_rdBuf_DBG(pMsg,
-                     (void *)(&indication.deviceAddress[0]),
-                     APIMAC_SADDR_EXT_LEN, "extaddr");
-
-    r = MT_MSG_rdU8_DBG(pMsg, "capInfo");
-    ApiMac_buildMsgCapInfo((uint8_t)(r),
-                           &(indication.capabilityInformation));
-
-    decode_Sec(pMsg, &indication.sec);
-
-    MT_MSG_parseComplete(pMsg);
-    if(pMsg->is_error)
+    if(!api_mac_schemaDecode(pMsg, &api_mac_schema_associate_ind,
+                             &indication))
     {
         return;
     }
@@ -672,17 +1202,12 @@ static void process_areq_sync_loss_ind(const struct mt_msg_dispatch *p,
 
     (void)p;
 
-    memset((void *)(&indication), 0, sizeof(indication));
+    API_MAC_PIB_FLUSH_ALL("sync-loss");
 
-    indication.reason         = MT_MSG_rdU8_DBG(pMsg, "reason");
-    indication.panId          = MT_MSG_rdU16_DBG(pMsg, "panID");
-    indication.logicalChannel = MT_MSG_rdU8_DBG(pMsg, "logicalChannel");
-    indication.channelPage    = MT_MSG_rdU8_DBG(pMsg, "channelPage");
-    indication.phyID          = MT_MSG_rdU8_DBG(pMsg, "phyID");
-    decode_Sec(pMsg, &indication.sec);
+    memset((void *)(&indication), 0, sizeof(indication));
 
-    MT_MSG_parseComplete(pMsg);
-    if(pMsg->is_error)
+    if(!api_mac_schemaDecode(pMsg, &api_mac_schema_sync_loss_ind,
+                             &indication))
     {
         return;
     }
@@ -708,26 +1233,12 @@ static void process_areq_data_cnf(const struct mt_msg_dispatch *p,
 
     memset((void *)(&indication), 0, sizeof(indication));
 
-    indication.status          = MT_MSG_rdU8_DBG(pMsg, "status");
-    indication.msduHandle      = MT_MSG_rdU8_DBG(pMsg, "msdu-handle");
-    indication.timestamp       = MT_MSG_rdU32_DBG(pMsg, "timestamp");
-    indication.timestamp2      = MT_MSG_rdU16_DBG(pMsg, "timestamp2");
-    indication.retries         = MT_MSG_rdU8_DBG(pMsg, "retries" );
-    indication.mpduLinkQuality = MT_MSG_rdU8_DBG(pMsg, "mpduLinkQuality");
-    indication.correlation     = MT_MSG_rdU8_DBG(pMsg, "correlation");
-    indication.rssi            = MT_MSG_rdU8_DBG(pMsg, "rssi" );
-    indication.frameCntr       = MT_MSG_rdU32_DBG(pMsg, "frameCntr");
-
-    MT_MSG_parseComplete(pMsg);
-    if(pMsg->is_error)
+    if(!api_mac_schemaDecode(pMsg, &api_mac_schema_data_cnf, &indication))
     {
         return;
     }
 
-    if(pApiMac_callbacks->pDataCnfCb)
-    {
-        (*(pApiMac_callbacks->pDataCnfCb))(&indication);
-    }
+    api_mac_dataCnfDeliver(&indication);
 }
 
 /*!
@@ -745,35 +1256,12 @@ static void process_areq_data_ind(const struct mt_msg_dispatch *p,
 
     (void)p;
 
-    decode_Addr(pMsg, (&indication.srcAddr));
-    decode_Addr(pMsg, (&indication.dstAddr));
-    indication.timestamp       = MT_MSG_rdU32_DBG(pMsg, "timestamp");
-    indication.timestamp2      = MT_MSG_rdU16_DBG(pMsg, "timestamp2");
-    indication.srcPanId        = MT_MSG_rdU16_DBG(pMsg, "srcPanId");
-    indication.dstPanId        = MT_MSG_rdU16_DBG(pMsg, "dstPanId");
-    indication.mpduLinkQuality = MT_MSG_rdU8_DBG(pMsg, "mdpuLinkQuality");
-    indication.correlation     = MT_MSG_rdU8_DBG(pMsg, "correlation");
-    indication.rssi            = MT_MSG_rdU8_DBG(pMsg, "rssi");
-    indication.dsn             = MT_MSG_rdU8_DBG(pMsg, "dsn");
-    decode_Sec(pMsg, &indication.sec);
-    indication.frameCntr       = MT_MSG_rdU32_DBG(pMsg, "frameCntr");
-
-    indication.msdu.len        = MT_MSG_rdU16_DBG(pMsg, "msdu.len");
-    indication.payloadIeLen    = MT_MSG_rdU16_DBG(pMsg, "payloadIeLen");
-
-    indication.msdu.p          = &(pMsg->iobuf[ pMsg->iobuf_idx ]);
-    MT_MSG_rdBuf_DBG(pMsg, NULL, indication.msdu.len, "msdu.data");
-
-    indication.pPayloadIE      = &(pMsg->iobuf[ pMsg->iobuf_idx ]);
-    MT_MSG_rdBuf_DBG(pMsg, NULL, indication.payloadIeLen, "payloadData");
-
-    MT_MSG_parseComplete(pMsg);
-    if(pMsg->is_error)
+    /* msdu.p and pPayloadIE point into the message */
+    if(!api_mac_schemaDecode(pMsg, &api_mac_schema_data_ind, &indication))
     {
         return;
     }
 
-
     LOG_printf( LOG_DBG_API_MAC_datastats,
                 "data-ind: len=%2d addr: %02x:%02x:%02x:%02x:%02x:%02x:%02x:%02x\n",
                 pMsg->expected_len,
@@ -807,11 +1295,7 @@ static void process_areq_purge_cnf(const struct mt_msg_dispatch *p,
 
     memset((void *)(&indication), 0, sizeof(indication));
 
-    indication.status = MT_MSG_rdU8_DBG(pMsg, "status");
-    indication.msduHandle = MT_MSG_rdU8_DBG(pMsg, "handle");
-
-    MT_MSG_parseComplete(pMsg);
-    if(pMsg->is_error)
+    if(!api_mac_schemaDecode(pMsg, &api_mac_schema_purge_cnf, &indication))
     {
         return;
     }
@@ -837,9 +1321,11 @@ static void process_areq_orphan_ind(const struct mt_msg_dispatch *p,
 
     memset((void *)(&indication), 0, sizeof(indication));
 
-    MT_MSG_rdBuf_DBG(pMsg,
-                 (void *)(&indication.orphanAddress[0]),
-                 APIMAC_SADDR_EXT_LEN, "ext-addr");
+    if(!api_mac_schemaDecode(pMsg, &api_mac_schema_orphan_ind, &indication))
+    {
+        return;
+    }
+
     LOG_printf( LOG_DBG_API_MAC_datastats,
                 "orphan: %02x:%02x:%02x:%02x:%02x:%02x:%02x:%02x\n",
                 indication.orphanAddress[0],
@@ -851,14 +1337,6 @@ static void process_areq_orphan_ind(const struct mt_msg_dispatch *p,
                 indication.orphanAddress[6],
                 indication.orphanAddress[7]);
 
-    decode_Sec(pMsg, &(indication.sec));
-
-    MT_MSG_parseComplete(pMsg);
-    if(pMsg->is_error)
-    {
-        return;
-    }
-
     if(pApiMac_callbacks->pOrphanIndCb)
     {
         (*(pApiMac_callbacks->pOrphanIndCb))(&indication);
@@ -878,14 +1356,12 @@ static void process_areq_associate_cnf(const struct mt_msg_dispatch *p,
 
     (void)(p);
 
-    memset((void *)(&indication), 0, sizeof(indication));
+    API_MAC_PIB_FLUSH_ALL("assoc-cnf");
 
-    indication.status = MT_MSG_rdU8_DBG(pMsg, "status");
-    indication.assocShortAddress = MT_MSG_rdU16_DBG(pMsg, "shorAddress");
-    decode_Sec(pMsg, &indication.sec);
+    memset((void *)(&indication), 0, sizeof(indication));
 
-    MT_MSG_parseComplete(pMsg);
-    if(pMsg->is_error)
+    if(!api_mac_schemaDecode(pMsg, &api_mac_schema_associate_cnf,
+                             &indication))
     {
         return;
     }
@@ -1063,16 +1539,12 @@ static void process_areq_disassociate_ind(const struct mt_msg_dispatch *p,
 
     (void)(p);
 
-    memset((void *)(&indication), 0, sizeof(indication));
+    API_MAC_PIB_FLUSH_ALL("disassoc-ind");
 
-    MT_MSG_rdBuf_DBG(pMsg,
-                 (void *)(&indication.deviceAddress[0]),
-                 APIMAC_SADDR_EXT_LEN, "ext-addr");
-    indication.disassociateReason = MT_MSG_rdU8_DBG(pMsg, "reason");
-    decode_Sec(pMsg, &(indication.sec));
+    memset((void *)(&indication), 0, sizeof(indication));
 
-    MT_MSG_parseComplete(pMsg);
-    if(pMsg->is_error)
+    if(!api_mac_schemaDecode(pMsg, &api_mac_schema_disassociate_ind,
+                             &indication))
     {
         return;
     }
@@ -1096,14 +1568,12 @@ static void process_areq_disassociate_cnf(const struct mt_msg_dispatch *p,
 
     (void)(p);
 
-    memset((void *)(&indication), 0, sizeof(indication));
+    API_MAC_PIB_FLUSH_ALL("disassoc-cnf");
 
-    indication.status = MT_MSG_rdU8_DBG(pMsg, "status");
-    decode_Addr(pMsg, &indication.deviceAddress);
-    indication.panId = MT_MSG_rdU16_DBG(pMsg, "pan-id");
+    memset((void *)(&indication), 0, sizeof(indication));
 
-    MT_MSG_parseComplete(pMsg);
-    if(pMsg->is_error)
+    if(!api_mac_schemaDecode(pMsg, &api_mac_schema_disassociate_cnf,
+                             &indication))
     {
         return;
     }
@@ -1129,11 +1599,7 @@ static void process_areq_poll_cnf(const struct mt_msg_dispatch *p,
 
     memset((void *)(&indication), 0, sizeof(indication));
 
-    indication.status = MT_MSG_rdU8_DBG(pMsg ,"status");
-    indication.framePending = MT_MSG_rdU8_DBG(pMsg, "framePending");
-
-    MT_MSG_parseComplete(pMsg);
-    if(pMsg->is_error)
+    if(!api_mac_schemaDecode(pMsg, &api_mac_schema_poll_cnf, &indication))
     {
         return;
     }
@@ -1160,6 +1626,8 @@ static void process_areq_scan_cnf(const struct mt_msg_dispatch *p,
 
     (void)(p);
 
+    API_MAC_PIB_FLUSH_ALL("scan-cnf");
+
     pU8 = NULL;
     pPD = NULL;
 
@@ -1260,15 +1728,8 @@ static void process_areq_comm_status_ind(const struct mt_msg_dispatch *p,
 
     memset((void *)(&indication), 0, sizeof(indication));
 
-    indication.status = MT_MSG_rdU8_DBG(pMsg, "status");
-    decode_Addr(pMsg, &indication.srcAddr);
-    decode_Addr(pMsg, &indication.dstAddr);
-    indication.panId = MT_MSG_rdU16_DBG(pMsg, "panID");
-    indication.reason = MT_MSG_rdU8_DBG(pMsg, "reason");
-    decode_Sec(pMsg, &indication.sec);
-
-    MT_MSG_parseComplete(pMsg);
-    if(pMsg->is_error)
+    if(!api_mac_schemaDecode(pMsg, &api_mac_schema_comm_status_ind,
+                             &indication))
     {
         return;
     }
@@ -1294,10 +1755,7 @@ static void process_areq_start_cnf(const struct mt_msg_dispatch *p,
 
     memset((void *)(&indication), 0, sizeof(indication));
 
-    indication.status = MT_MSG_rdU8_DBG(pMsg, "status");
-
-    MT_MSG_parseComplete(pMsg);
-    if(pMsg->is_error)
+    if(!api_mac_schemaDecode(pMsg, &api_mac_schema_start_cnf, &indication))
     {
         return;
     }
@@ -1323,10 +1781,8 @@ static void process_areq_ws_async_cnf(const struct mt_msg_dispatch *p,
 
     memset((void *)(&indication), 0, sizeof(indication));
 
-    indication.status = MT_MSG_rdU8_DBG(pMsg, "status");
-
-    MT_MSG_parseComplete(pMsg);
-    if(pMsg->is_error)
+    if(!api_mac_schemaDecode(pMsg, &api_mac_schema_ws_async_cnf,
+                             &indication))
     {
         return;
     }
@@ -1352,22 +1808,7 @@ static void process_areq_ws_async_ind(const struct mt_msg_dispatch *p,
 
     memset((void *)(&indication), 0, sizeof(indication));
 
-    decode_Addr(pMsg, &indication.srcAddr);
-    decode_Addr(pMsg, &indication.dstAddr);
-    indication.timestamp = MT_MSG_rdU32_DBG(pMsg, "timestamp");
-    indication.timestamp2 = MT_MSG_rdU16_DBG(pMsg, "timestamp2");
-    indication.srcPanId = MT_MSG_rdU16_DBG(pMsg, "src-pan-id");
-    indication.dstPanId = MT_MSG_rdU16_DBG(pMsg, "dst-pan-id");
-    indication.mpduLinkQuality = MT_MSG_rdU8_DBG(pMsg, "mdpu-link-quality");
-    indication.correlation = MT_MSG_rdU8_DBG(pMsg, "correlation");
-    indication.rssi = MT_MSG_rdU8_DBG(pMsg, "rssi");
-    indication.dsn = MT_MSG_rdU8_DBG(pMsg, "dsn");
-    decode_Sec(pMsg, &(indication.sec));
-    indication.frameCntr = MT_MSG_rdU32_DBG(pMsg, "framecntr");
-    indication.fhFrameType = MT_MSG_rdU8_DBG(pMsg,"frameType" );
-    // indication.fhProtoDispatch = MT_MSG_rdU8_DBG(pMsg, "fh-protodisptch");
-    indication.msdu.len = MT_MSG_rdU16_DBG(pMsg, "msdu-len");
-    indication.payloadIeLen = MT_MSG_rdU16_DBG(pMsg, "payload-ie-len" );
+    MT_MSG_SCHEMA_decode(pMsg, &api_mac_schema_ws_async_ind, &indication);
 
     if(indication.msdu.len)
     {
@@ -1422,12 +1863,9 @@ static void process_areq_poll_ind(const struct mt_msg_dispatch *p,
 
     (void)(p);
 
-    decode_Addr(pMsg, &indication.srcAddr);
-    indication.srcPanId = MT_MSG_rdU16_DBG(pMsg, "srcPanId");
-    indication.noRsp = MT_MSG_rdU8_DBG(pMsg, "noRsp") ? true : false;
+    memset((void *)(&indication), 0, sizeof(indication));
 
-    MT_MSG_parseComplete(pMsg);
-    if(pMsg->is_error)
+    if(!api_mac_schemaDecode(pMsg, &api_mac_schema_poll_ind, &indication))
     {
         return;
     }
@@ -1454,6 +1892,8 @@ static void process_areq_reset_ind(const struct mt_msg_dispatch *p,
 
     (void)(p);
 
+    API_MAC_PIB_FLUSH_ALL("reset-ind");
+
     memset((void *)(&indication), 0, sizeof(indication));
     
     indication.reason = MT_MSG_rdU8_DBG(pMsg, "reason");
@@ -1492,155 +1932,352 @@ static void process_areq_reset_ind(const struct mt_msg_dispatch *p,
         return;
     }
 
+    /* the co-processor lost its queues, no confirms will come */
+    api_mac_inflightExpire(true);
+
     if(pApiMac_callbacks->pResetIndCb)
     {
         (*(pApiMac_callbacks->pResetIndCb))(&indication);
     }
 }
 
+/*! Lookup table to dispatch messages, see api_mac_areq_index */
+static const struct mt_msg_dispatch api_mac_areq_lut[] = {
+    {
+        .cmd0 = MAC_SYNC_LOSS_IND_cmd0,
+        .cmd1 = MAC_SYNC_LOSS_IND_cmd1,
+        .dbg_prefix = "sync-loss-ind"    ,
+        .pHandler = process_areq_sync_loss_ind
+    },
+    {
+        .cmd0 = MAC_ASSOCIATE_IND_cmd0,
+        .cmd1 = MAC_ASSOCIATE_IND_cmd1,
+        .dbg_prefix = "associate-ind"    ,
+        .pHandler = process_areq_associate_ind
+    },
+    {
+        .cmd0 = MAC_ASSOCIATE_CNF_cmd0,
+        .cmd1 = MAC_ASSOCIATE_CNF_cmd1,
+        .dbg_prefix = "associate-cnf"    ,
+        .pHandler = process_areq_associate_cnf
+    },
+    {
+        .cmd0 = MAC_BEACON_NOTIFY_IND_cmd0,
+        .cmd1 = MAC_BEACON_NOTIFY_IND_cmd1,
+        .dbg_prefix = "beacon-notify"    ,
+        .pHandler = process_areq_beacon_notify },
+    {
+        .cmd0 = MAC_DATA_CNF_cmd0,
+        .cmd1 = MAC_DATA_CNF_cmd1,
+        .dbg_prefix = "data-cnf" ,
+        .pHandler = process_areq_data_cnf },
+    {
+        .cmd0 = MAC_DATA_IND_cmd0,
+        .cmd1 = MAC_DATA_IND_cmd1,
+        .dbg_prefix = "data-ind"         ,
+        .pHandler = process_areq_data_ind
+    },
+    {
+        .cmd0 = MAC_DISASSOCIATE_IND_cmd0,
+        .cmd1 = MAC_DISASSOCIATE_IND_cmd1,
+        .dbg_prefix = "disassociate-ind" ,
+        .pHandler = process_areq_disassociate_ind
+    },
+    {
+        .cmd0 = MAC_DISASSOCIATE_CNF_cmd0,
+        .cmd1 = MAC_DISASSOCIATE_CNF_cmd1,
+        .dbg_prefix = "disassociate-cnf" ,
+        .pHandler = process_areq_disassociate_cnf
+    },
+
+    /* 0x88- not used */
+    /* 0x89- not used */
+
+    {
+        .cmd0 = MAC_ORPHAN_IND_cmd0,
+        .cmd1 = MAC_ORPHAN_IND_cmd1,
+        .dbg_prefix = "orphan-ind"       ,
+        .pHandler = process_areq_orphan_ind
+    },
+    {
+        .cmd0 = MAC_POLL_CNF_cmd0,
+        .cmd1 = MAC_POLL_CNF_cmd1,
+        .dbg_prefix = "poll-cnf"         ,
+        .pHandler = process_areq_poll_cnf
+    },
+    {
+        .cmd0 = MAC_SCAN_CNF_cmd0,
+        .cmd1 = MAC_SCAN_CNF_cmd1,
+        .dbg_prefix = "scan-cnf"         ,
+        .pHandler = process_areq_scan_cnf
+    },
+    {
+        .cmd0 = MAC_COMM_STATUS_IND_cmd0,
+        .cmd1 = MAC_COMM_STATUS_IND_cmd1,
+        .dbg_prefix = "status-ind"       ,
+        .pHandler = process_areq_comm_status_ind
+    },
+    {
+        .cmd0 = MAC_START_CNF_cmd0,
+        .cmd1 = MAC_START_CNF_cmd1,
+        .dbg_prefix = "start-cnf"        ,
+        .pHandler = process_areq_start_cnf
+    },
+    /* 0x8f - not used */
+    {
+        .cmd0 = MAC_PURGE_CNF_cmd0,
+        .cmd1 = MAC_PURGE_CNF_cmd1,
+        .dbg_prefix = "purge-cnf"        ,
+        .pHandler = process_areq_purge_cnf
+    },
+    {
+        .cmd0 = MAC_POLL_IND_cmd0,
+        .cmd1 = MAC_POLL_IND_cmd1,
+        .dbg_prefix = "poll-ind"         ,
+        .pHandler = process_areq_poll_ind
+    },
+    {
+        .cmd0 = MAC_WS_ASYNC_CNF_cmd0,
+        .cmd1 = MAC_WS_ASYNC_CNF_cmd1,
+        .dbg_prefix = "ws-async-cnf"     ,
+        .pHandler = process_areq_ws_async_cnf
+    },
+    {
+        .cmd0 = MAC_WS_ASYNC_IND_cmd0,
+        .cmd1 = MAC_WS_ASYNC_IND_cmd1,
+        .dbg_prefix = "ws-async-ind"     ,
+        .pHandler = process_areq_ws_async_ind
+    },
+    {
+        .cmd0 = SYS_RESET_IND_cmd0,
+        .cmd1 = SYS_RESET_IND_cmd1,
+        .dbg_prefix = "reset-indication"     ,
+        .pHandler = process_areq_reset_ind
+    },
+    /* terminate */
+    { .pHandler = NULL }
+};
+
 /*!
- * @brief Internal function to process/handle messages.
- *
- * @param pMsg - the message to process
+ * @struct api_mac_custom_areq
+ * @brief An AREQ handler registered by the application
  */
-static void process_areq(struct mt_msg *pMsg)
+struct api_mac_custom_areq
 {
-    const struct mt_msg_dispatch *p;
+    /*! the dispatch entry put in api_mac_areq_index */
+    struct mt_msg_dispatch dte;
+    /*! the application handler */
+    ApiMacLinux_areqHandler_t *pFn;
+    /*! passed to pFn */
+    void *pCookie;
+};
 
-    /* Lookup table to dispatch messages */
-    static const struct mt_msg_dispatch lut[] = {
-        {
-            .cmd0 = MAC_SYNC_LOSS_IND_cmd0,
-            .cmd1 = MAC_SYNC_LOSS_IND_cmd1,
-            .dbg_prefix = "sync-loss-ind"    ,
-            .pHandler = process_areq_sync_loss_ind
-        },
-        {
-            .cmd0 = MAC_ASSOCIATE_IND_cmd0,
-            .cmd1 = MAC_ASSOCIATE_IND_cmd1,
-            .dbg_prefix = "associate-ind"    ,
-            .pHandler = process_areq_associate_ind
-        },
+/*
+ * Direct lookup for AREQ handlers, indexed by [subsystem][cmd1].
+ * The cmd1 tables are only allocated for subsystems in use.
+ */
+static const struct mt_msg_dispatch **api_mac_areq_index[32];
+/*! true once api_mac_areq_lut[] has been put in the index */
+static bool api_mac_areq_index_ok;
+/*! true once createInterface() ran, the index is read only after this */
+static bool api_mac_areq_index_frozen;
+
+/*!
+ * @brief Find the index slot for this command
+ * @param cmd0 - command 0 (the extended bit is ignored)
+ * @param cmd1 - command 1
+ * @param create - allocate the subsystem table if needed
+ * @return NULL if there is no slot
+ */
+static const struct mt_msg_dispatch **api_mac_areq_slot(int cmd0,
+                                                        int cmd1,
+                                                        bool create)
+{
+    const struct mt_msg_dispatch ***ppTable;
+
+    /* Lower bits[4:0] = subsystem number */
+    ppTable = &(api_mac_areq_index[ _bitsXYof(cmd0, 4, 0) ]);
+    if(*ppTable == NULL)
+    {
+        if(!create)
         {
-            .cmd0 = MAC_ASSOCIATE_CNF_cmd0,
-            .cmd1 = MAC_ASSOCIATE_CNF_cmd1,
-            .dbg_prefix = "associate-cnf"    ,
-            .pHandler = process_areq_associate_cnf
-        },
+            return (NULL);
+        }
+        *ppTable = (const struct mt_msg_dispatch **)
+            calloc(256, sizeof(struct mt_msg_dispatch *));
+        if(*ppTable == NULL)
         {
-            .cmd0 = MAC_BEACON_NOTIFY_IND_cmd0,
-            .cmd1 = MAC_BEACON_NOTIFY_IND_cmd1,
-            .dbg_prefix = "beacon-notify"    ,
-            .pHandler = process_areq_beacon_notify },
-        {
-            .cmd0 = MAC_DATA_CNF_cmd0,
-            .cmd1 = MAC_DATA_CNF_cmd1,
-            .dbg_prefix = "data-cnf" ,
-            .pHandler = process_areq_data_cnf },
-        {
-            .cmd0 = MAC_DATA_IND_cmd0,
-            .cmd1 = MAC_DATA_IND_cmd1,
-            .dbg_prefix = "data-ind"         ,
-            .pHandler = process_areq_data_ind
-        },
-        {
-            .cmd0 = MAC_DISASSOCIATE_IND_cmd0,
-            .cmd1 = MAC_DISASSOCIATE_IND_cmd1,
-            .dbg_prefix = "disassociate-ind" ,
-            .pHandler = process_areq_disassociate_ind
-        },
-        {
-            .cmd0 = MAC_DISASSOCIATE_CNF_cmd0,
-            .cmd1 = MAC_DISASSOCIATE_CNF_cmd1,
-            .dbg_prefix = "disassociate-cnf" ,
-            .pHandler = process_areq_disassociate_cnf
-        },
+            return (NULL);
+        }
+    }
+    return (&((*ppTable)[ cmd1 & 0x0ff ]));
+}
 
-        /* 0x88- not used */
-        /* 0x89- not used */
+/*!
+ * @brief Put the built in handlers in the direct lookup index
+ *
+ * Called by createInterface() before the rx thread starts, or earlier
+ * by the first ApiMacLinux_registerAreqHandler().
+ */
+static void api_mac_areq_index_init(void)
+{
+    const struct mt_msg_dispatch *p;
+    const struct mt_msg_dispatch **ppSlot;
 
+    if(api_mac_areq_index_ok)
+    {
+        return;
+    }
+    for(p = api_mac_areq_lut ; p->pHandler ; p++)
+    {
+        ppSlot = api_mac_areq_slot(p->cmd0, p->cmd1, true);
+        if(ppSlot == NULL)
         {
-            .cmd0 = MAC_ORPHAN_IND_cmd0,
-            .cmd1 = MAC_ORPHAN_IND_cmd1,
-            .dbg_prefix = "orphan-ind"       ,
-            .pHandler = process_areq_orphan_ind
-        },
-        {
-            .cmd0 = MAC_POLL_CNF_cmd0,
-            .cmd1 = MAC_POLL_CNF_cmd1,
-            .dbg_prefix = "poll-cnf"         ,
-            .pHandler = process_areq_poll_cnf
-        },
-        {
-            .cmd0 = MAC_SCAN_CNF_cmd0,
-            .cmd1 = MAC_SCAN_CNF_cmd1,
-            .dbg_prefix = "scan-cnf"         ,
-            .pHandler = process_areq_scan_cnf
-        },
-        {
-            .cmd0 = MAC_COMM_STATUS_IND_cmd0,
-            .cmd1 = MAC_COMM_STATUS_IND_cmd1,
-            .dbg_prefix = "status-ind"       ,
-            .pHandler = process_areq_comm_status_ind
-        },
-        {
-            .cmd0 = MAC_START_CNF_cmd0,
-            .cmd1 = MAC_START_CNF_cmd1,
-            .dbg_prefix = "start-cnf"        ,
-            .pHandler = process_areq_start_cnf
-        },
-        /* 0x8f - not used */
-        {
-            .cmd0 = MAC_PURGE_CNF_cmd0,
-            .cmd1 = MAC_PURGE_CNF_cmd1,
-            .dbg_prefix = "purge-cnf"        ,
-            .pHandler = process_areq_purge_cnf
-        },
-        {
-            .cmd0 = MAC_POLL_IND_cmd0,
-            .cmd1 = MAC_POLL_IND_cmd1,
-            .dbg_prefix = "poll-ind"         ,
-            .pHandler = process_areq_poll_ind
-        },
-        {
-            .cmd0 = MAC_WS_ASYNC_CNF_cmd0,
-            .cmd1 = MAC_WS_ASYNC_CNF_cmd1,
-            .dbg_prefix = "ws-async-cnf"     ,
-            .pHandler = process_areq_ws_async_cnf
-        },
+            BUG_HERE("no memory\n");
+            return;
+        }
+        /* do not replace an application handler */
+        if(*ppSlot == NULL)
         {
-            .cmd0 = MAC_WS_ASYNC_IND_cmd0,
-            .cmd1 = MAC_WS_ASYNC_IND_cmd1,
-            .dbg_prefix = "ws-async-ind"     ,
-            .pHandler = process_areq_ws_async_ind
-        },
+            *ppSlot = p;
+        }
+    }
+    api_mac_areq_index_ok = true;
+}
+
+/*!
+ * @brief Find the handler for an AREQ
+ * @param pMsg - the message to handle
+ * @return NULL if not found
+ */
+static const struct mt_msg_dispatch *api_mac_areq_lookup(struct mt_msg *pMsg)
+{
+    const struct mt_msg_dispatch **ppSlot;
+
+    /* built before any message arrives, see api_mac_areq_index_init() */
+    ppSlot = api_mac_areq_slot(pMsg->cmd0, pMsg->cmd1, false);
+    if((ppSlot == NULL) || (*ppSlot == NULL))
+    {
+        return (NULL);
+    }
+    /* the index ignores the message type bits */
+    if((*ppSlot)->cmd0 != (pMsg->cmd0 & 0x7F))
+    {
+        return (NULL);
+    }
+    return (*ppSlot);
+}
+
+/*!
+ * @brief Call an application AREQ handler
+ *
+ * @param p - dispatch table entry
+ * @param pMsg - the message to process.
+ */
+static void process_areq_custom(const struct mt_msg_dispatch *p,
+                                struct mt_msg *pMsg)
+{
+    struct api_mac_custom_areq *pC;
+
+    pC = (struct api_mac_custom_areq *)(p->cookie);
+    (*(pC->pFn))(pMsg, pC->pCookie);
+}
+
+/*
+  Register an application handler for an AREQ
+  Public function defined in api_mac_linux.h
+*/
+int ApiMacLinux_registerAreqHandler(int cmd0, int cmd1,
+                                    const char *pDbgName,
+                                    ApiMacLinux_areqHandler_t *pFn,
+                                    void *pCookie)
+{
+    const struct mt_msg_dispatch **ppSlot;
+    const struct mt_msg_dispatch *p;
+    struct api_mac_custom_areq *pC;
+
+    if(!_inrange(cmd0, 0, 0x80) || !_inrange(cmd1, 0, 256))
+    {
+        LOG_printf(LOG_ERROR, "areq-handler: bad cmd 0x%02x 0x%02x\n",
+                   cmd0, cmd1);
+        return (-1);
+    }
+
+    /* the rx path reads the index without a lock */
+    if(api_mac_areq_index_frozen)
+    {
+        BUG_HERE("areq-handler: register before ApiMac_init()\n");
+        return (-1);
+    }
+    api_mac_areq_index_init();
+
+    ppSlot = api_mac_areq_slot(cmd0, cmd1, true);
+    if(ppSlot == NULL)
+    {
+        BUG_HERE("no memory\n");
+        return (-1);
+    }
+
+    pC = NULL;
+    if(pFn)
+    {
+        pC = (struct api_mac_custom_areq *)calloc(1, sizeof(*pC));
+        if(pC == NULL)
         {
-            .cmd0 = SYS_RESET_IND_cmd0,
-            .cmd1 = SYS_RESET_IND_cmd1,
-            .dbg_prefix = "reset-indication"     ,
-            .pHandler = process_areq_reset_ind
-        },
-        /* terminate */
-        { .pHandler = NULL }
-    };
+            BUG_HERE("no memory\n");
+            return (-1);
+        }
+        pC->dte.cmd0 = cmd0;
+        pC->dte.cmd1 = cmd1;
+        pC->dte.cookie = (intptr_t)(pC);
+        pC->dte.dbg_prefix = pDbgName ? pDbgName : "custom-areq";
+        pC->dte.pHandler = process_areq_custom;
+        pC->pFn = pFn;
+        pC->pCookie = pCookie;
+    }
 
-    if(pApiMac_callbacks == NULL)
+    /* release the prior application handler */
+    if(*ppSlot && ((*ppSlot)->pHandler == process_areq_custom))
     {
-        MT_MSG_log(LOG_ERROR, pMsg, "no-callbacks\n");
-        return;
+        free((void *)((*ppSlot)->cookie));
     }
+    *ppSlot = NULL;
 
-    p = lut;
+    if(pC)
+    {
+        *ppSlot = &(pC->dte);
+        return (0);
+    }
 
-    while(p->pHandler)
+    /* handler removed, go back to the built in handler (if any) */
+    for(p = api_mac_areq_lut ; p->pHandler ; p++)
     {
-        if((p->cmd0 == (pMsg->cmd0 & 0x7F)) && (p->cmd1 == pMsg->cmd1))
+        if((p->cmd0 == cmd0) && (p->cmd1 == cmd1))
         {
+            *ppSlot = p;
             break;
         }
-        p++;
     }
-    if(p->pHandler)
+    return (0);
+}
+
+/*!
+ * @brief Internal function to process/handle messages.
+ *
+ * @param pMsg - the message to process
+ */
+static void process_areq(struct mt_msg *pMsg)
+{
+    const struct mt_msg_dispatch *p;
+
+    if(pApiMac_callbacks == NULL)
+    {
+        MT_MSG_log(LOG_ERROR, pMsg, "no-callbacks\n");
+        return;
+    }
+
+    p = api_mac_areq_lookup(pMsg);
+    if(p)
     {
         pMsg->pLogPrefix = p->dbg_prefix;
         LOG_printf(LOG_DBG_MT_MSG_traffic,
@@ -1676,6 +2313,8 @@ void ApiMac_processIncoming(void)
 {
     struct mt_msg *pMsg;
 
+    api_mac_inflightExpire(false);
+
     pMsg = MT_MSG_LIST_remove(API_MAC_msg_interface,
                               &(API_MAC_msg_interface->rx_list),
                               ApiMacLinux_areq_timeout_mSecs);
@@ -1685,6 +2324,7 @@ void ApiMac_processIncoming(void)
         LOG_printf(LOG_DBG_API_MAC_wait, "no-msg\n");
         return;
     }
+    MT_MSG_stamp(pMsg, MT_MSG_STAMP_rx_dequeue);
 
     /* process the message */
     if(pMsg->m_type == MT_MSG_TYPE_areq|| pMsg->m_type == MT_MSG_TYPE_areq_frag_data)
@@ -1709,6 +2349,7 @@ void ApiMac_processIncoming(void)
             }
         }
     }
+    MT_MSG_stamp(pMsg, MT_MSG_STAMP_rx_handled);
     MT_MSG_free(pMsg);
 }
 
@@ -1751,6 +2392,61 @@ static void resetCoPDevice(void)
     } 
 }
 
+/*!
+ * Default priority of MAC callbacks in the rx_list.
+ *
+ * The confirmations and indications the application state machine
+ * waits on are served before floods of beacon notify and comm status.
+ * Used only if the interface has no rx-priority configuration.
+ */
+static const struct api_mac_rx_prio {
+    uint8_t cmd0;
+    uint8_t cmd1;
+    enum mt_msg_prio prio;
+} api_mac_rx_prio_defaults[] = {
+    { SYS_RESET_IND_cmd0,         SYS_RESET_IND_cmd1,         MT_MSG_PRIO_high },
+    { MAC_ASSOCIATE_IND_cmd0,     MAC_ASSOCIATE_IND_cmd1,     MT_MSG_PRIO_high },
+    { MAC_ASSOCIATE_CNF_cmd0,     MAC_ASSOCIATE_CNF_cmd1,     MT_MSG_PRIO_high },
+    { MAC_DATA_CNF_cmd0,          MAC_DATA_CNF_cmd1,          MT_MSG_PRIO_high },
+    { MAC_DISASSOCIATE_CNF_cmd0,  MAC_DISASSOCIATE_CNF_cmd1,  MT_MSG_PRIO_high },
+    { MAC_POLL_CNF_cmd0,          MAC_POLL_CNF_cmd1,          MT_MSG_PRIO_high },
+    { MAC_SCAN_CNF_cmd0,          MAC_SCAN_CNF_cmd1,          MT_MSG_PRIO_high },
+    { MAC_START_CNF_cmd0,         MAC_START_CNF_cmd1,         MT_MSG_PRIO_high },
+    { MAC_PURGE_CNF_cmd0,         MAC_PURGE_CNF_cmd1,         MT_MSG_PRIO_high },
+    { MAC_WS_ASYNC_CNF_cmd0,      MAC_WS_ASYNC_CNF_cmd1,      MT_MSG_PRIO_high },
+    { MAC_BEACON_NOTIFY_IND_cmd0, MAC_BEACON_NOTIFY_IND_cmd1, MT_MSG_PRIO_low  },
+    { MAC_COMM_STATUS_IND_cmd0,   MAC_COMM_STATUS_IND_cmd1,   MT_MSG_PRIO_low  },
+    /* terminate */
+    { 0, 0, MT_MSG_PRIO_normal }
+};
+
+/*!
+ * @brief Give the MAC callbacks their default priority, unless configured
+ */
+static void api_mac_rx_prio_init(void)
+{
+    const struct api_mac_rx_prio *p;
+    int x;
+
+    for(x = 0 ; x < 32 ; x++)
+    {
+        if(API_MAC_msg_interface->rx_prio[x])
+        {
+            /* the ini file said what it wants */
+            return;
+        }
+    }
+
+    for(p = api_mac_rx_prio_defaults ; p->cmd0 ; p++)
+    {
+        if(MT_MSG_setRxPrio(API_MAC_msg_interface,
+                            p->cmd0, p->cmd1, p->prio) != 0)
+        {
+            BUG_HERE("No memory\n");
+        }
+    }
+}
+
 /*!
   Initialize this MT MSG interface.
 */
@@ -1765,6 +2461,34 @@ static void *createInterface(void)
         BUG_HERE("msg interface not specified(NULL)\n");
     }
 
+    api_mac_rx_prio_init();
+    api_mac_schemaInit();
+    api_mac_areq_index_init();
+    api_mac_areq_index_frozen = true;
+
+    api_mac_inflight_lock = MUTEX_create("api-mac-inflight");
+    if(api_mac_inflight_lock == 0)
+    {
+        FATAL_printf("Cannot create in flight lock\n");
+    }
+    if(ApiMacLinux_dataReq_maxInFlight <= 0)
+    {
+        ApiMacLinux_dataReq_maxInFlight = 1;
+    }
+    api_mac_submit_room = SEMAPHORE_create("api-mac-submit",
+                                           ApiMacLinux_dataReq_maxInFlight);
+    if(api_mac_submit_room == 0)
+    {
+        FATAL_printf("Cannot create submit semaphore\n");
+    }
+
+    api_mac_pibInit();
+    api_mac_pib_lock = MUTEX_create("api-mac-pib");
+    if(api_mac_pib_lock == 0)
+    {
+        FATAL_printf("Cannot create pib cache lock\n");
+    }
+
     r = MT_MSG_interfaceCreate(API_MAC_msg_interface);
     if(r != 0)
     {
@@ -1825,19 +2549,14 @@ static uint16_t convertTxOptions(ApiMac_txOptions_t *txOptions)
 }
 
 /*!
- * @brief Internal function to send a synchronous request expecting a status
+ * @brief Internal function to decode the status from a SRSP
  *
- * @param pMsg - the message to send.
+ * @param pMsg - the message that was sent.
+ * @param r - the result of MT_MSG_txrx()
  * @return the status byte code returned from the remote end.
- *
- * Note: This routine also frees both messsages (tx and response)
  */
-static int API_MAC_TxRx_Status(struct mt_msg *pMsg)
+static int API_MAC_Srsp_Status(struct mt_msg *pMsg, int r)
 {
-    int r;
-
-    r = MT_MSG_txrx(pMsg);
-
     /* We should get 2 back.
        1 = we transmitted a message
        1 = we rx'ed a message
@@ -1847,8 +2566,7 @@ static int API_MAC_TxRx_Status(struct mt_msg *pMsg)
     if(r != 2)
     {
         /* Something is wrong... */
-        r = ApiMac_status_badState;
-        goto fail;
+        return (ApiMac_status_badState);
     }
 
     /* Got response */
@@ -1860,84 +2578,620 @@ static int API_MAC_TxRx_Status(struct mt_msg *pMsg)
     /* anything wrong? */
     if(pMsg->is_error || pMsg->pSrsp->is_error)
     {
-        r = ApiMac_status_invalidParameter;
+        r = ApiMac_status_invalidParameter;
+    }
+    LOG_printf(LOG_DBG_MT_MSG_traffic,
+               "SREQ: (%s) SRSP: Result: %d (0x%02x)\n",
+               pMsg->pLogPrefix, r, r);
+    return (r);
+}
+
+/*!
+ * @brief Internal function to send a synchronous request expecting a status
+ *
+ * @param pMsg - the message to send.
+ * @return the status byte code returned from the remote end.
+ *
+ * Note: This routine also frees both messsages (tx and response)
+ */
+static int API_MAC_TxRx_Status(struct mt_msg *pMsg)
+{
+    int r;
+
+    r = MT_MSG_txrx(pMsg);
+    r = API_MAC_Srsp_Status(pMsg, r);
+
+    MT_MSG_free(pMsg);
+    return (r);
+}
+
+/*!
+ * @struct api_mac_async
+ * @brief Completion details for an async api mac request
+ */
+struct api_mac_async {
+    ApiMac_asyncDoneFn_t *pDoneFn;
+    void *pCookie;
+};
+
+/*!
+ * @brief MT_MSG_txrx_async() completion for API_MAC_TxRx_Status_Async()
+ * @param pMsg - the message that was sent
+ * @param r - the result of MT_MSG_txrx()
+ * @param cookie - the struct api_mac_async in disguise
+ */
+static void api_mac_async_done(struct mt_msg *pMsg, int r, intptr_t cookie)
+{
+    struct api_mac_async *pAsync;
+
+    pAsync = (struct api_mac_async *)(cookie);
+
+    r = API_MAC_Srsp_Status(pMsg, r);
+    if(pAsync->pDoneFn)
+    {
+        (*(pAsync->pDoneFn))((ApiMac_status_t)r, pAsync->pCookie);
+    }
+    api_mac_freeMem(pAsync);
+}
+
+/*!
+ * @brief Internal function to send a request expecting a status,
+ *        without waiting for the response.
+ *
+ * @param pMsg - the message to send.
+ * @param pDoneFn - called with the status byte code from the remote end
+ * @param pCookie - passed to pDoneFn
+ * @return ApiMac_status_success if the request was queued
+ *
+ * Note: This routine takes ownership of the message, even on failure.
+ */
+static ApiMac_status_t API_MAC_TxRx_Status_Async(struct mt_msg *pMsg,
+                                               ApiMac_asyncDoneFn_t *pDoneFn,
+                                               void *pCookie)
+{
+    struct api_mac_async *pAsync;
+
+    pAsync = api_mac_callocMem(pMsg, "async", 1, sizeof(*pAsync));
+    if(pAsync == NULL)
+    {
+        MT_MSG_free(pMsg);
+        return (ApiMac_status_noResources);
+    }
+    pAsync->pDoneFn = pDoneFn;
+    pAsync->pCookie = pCookie;
+
+    if(0 != MT_MSG_txrx_async(pMsg, api_mac_async_done, (intptr_t)(pAsync)))
+    {
+        api_mac_freeMem(pAsync);
+        MT_MSG_free(pMsg);
+        return (ApiMac_status_noResources);
+    }
+    return (ApiMac_status_success);
+}
+
+/*!
+ * @brief Put a pipelined data request in the in flight table
+ * @param msduHandle - the request handle
+ * @param pDoneFn - called with the confirm, NULL means pDataCnfCb
+ * @param pCookie - given to pDoneFn
+ * @return false if a request is already waiting on the handle
+ */
+static bool api_mac_inflightReserve(int msduHandle,
+                                    ApiMac_dataDoneFn_t *pDoneFn,
+                                    void *pCookie)
+{
+    struct api_mac_inflight *pE;
+    bool ok;
+
+    pE = &(api_mac_inflight[msduHandle & 0xff]);
+
+    MUTEX_lock(api_mac_inflight_lock, -1);
+    ok = !(pE->in_use);
+    if(ok)
+    {
+        pE->in_use = true;
+        pE->t_start = TIMER_timeoutStart();
+        pE->pDoneFn = pDoneFn;
+        pE->pCookie = pCookie;
+        api_mac_inflight_count++;
+    }
+    MUTEX_unLock(api_mac_inflight_lock);
+    return (ok);
+}
+
+/*!
+ * @brief Drop a pipelined data request that was never sent
+ * @param msduHandle - the request handle
+ */
+static void api_mac_inflightRelease(int msduHandle)
+{
+    struct api_mac_inflight *pE;
+
+    pE = &(api_mac_inflight[msduHandle & 0xff]);
+
+    MUTEX_lock(api_mac_inflight_lock, -1);
+    memset((void *)(pE), 0, sizeof(*pE));
+    api_mac_inflight_count--;
+    MUTEX_unLock(api_mac_inflight_lock);
+}
+
+/*!
+ * @brief Remove a pipelined data request from the in flight table
+ * @param msduHandle - the request handle
+ * @param pEntry - filled in with the entry, if found
+ * @return true if the request was in flight
+ */
+static bool api_mac_inflightTake(int msduHandle,
+                                 struct api_mac_inflight *pEntry)
+{
+    struct api_mac_inflight *pE;
+    bool found;
+
+    if(api_mac_inflight_lock == 0)
+    {
+        /* not initialized, nothing was sent */
+        return (false);
+    }
+    pE = &(api_mac_inflight[msduHandle & 0xff]);
+
+    MUTEX_lock(api_mac_inflight_lock, -1);
+    found = pE->in_use;
+    if(found)
+    {
+        *pEntry = *pE;
+        memset((void *)(pE), 0, sizeof(*pE));
+        api_mac_inflight_count--;
+    }
+    MUTEX_unLock(api_mac_inflight_lock);
+    return (found);
+}
+
+/*!
+ * @brief Give a data confirm to whoever waits for it
+ * @param pCnf - the confirm
+ *
+ * A pipelined request goes to its own callback, anything else
+ * to the pDataCnfCb callback.
+ */
+static void api_mac_dataCnfDeliver(ApiMac_mcpsDataCnf_t *pCnf)
+{
+    struct api_mac_inflight entry;
+
+    if(api_mac_inflightTake(pCnf->msduHandle, &entry) && entry.pDoneFn)
+    {
+        (*(entry.pDoneFn))(pCnf, entry.is_refused, entry.pCookie);
+        return;
+    }
+
+    if(pApiMac_callbacks && pApiMac_callbacks->pDataCnfCb)
+    {
+        (*(pApiMac_callbacks->pDataCnfCb))(pCnf);
+    }
+}
+
+/*!
+ * @brief Fail pipelined requests that will never get a confirm
+ * @param all - true: every request, false: only those that timed out
+ *
+ * Called from the ApiMac_processIncoming() thread.
+ */
+static void api_mac_inflightExpire(bool all)
+{
+    ApiMac_mcpsDataCnf_t cnf;
+    struct api_mac_inflight *pE;
+    bool expired;
+    int x;
+
+    if(!all)
+    {
+        /* a lost confirm is rare, look about once a second */
+        if(!TIMER_timeoutIsExpired(api_mac_inflight_checked, 1000))
+        {
+            return;
+        }
+        api_mac_inflight_checked = TIMER_timeoutStart();
+    }
+
+    for(x = 0 ; (x < 256) && (api_mac_inflight_count > 0) ; x++)
+    {
+        pE = &(api_mac_inflight[x]);
+
+        MUTEX_lock(api_mac_inflight_lock, -1);
+        expired = pE->in_use &&
+            (all || TIMER_timeoutIsExpired(pE->t_start,
+                                           ApiMacLinux_dataReq_timeout_mSecs));
+        MUTEX_unLock(api_mac_inflight_lock);
+        if(!expired)
+        {
+            continue;
+        }
+
+        LOG_printf(LOG_ERROR, "data-req: handle 0x%02x: no confirm\n", x);
+        memset((void *)(&cnf), 0, sizeof(cnf));
+        cnf.status = ApiMac_status_transactionExpired;
+        cnf.msduHandle = (uint8_t)(x);
+        api_mac_dataCnfDeliver(&cnf);
+    }
+}
+
+/*!
+ * @brief Queue a locally made data confirm, as if from the co-processor
+ * @param msduHandle - the request handle
+ * @param status - the confirm status
+ *
+ * The confirm is handled in the ApiMac_processIncoming() thread,
+ * like every other confirm.
+ */
+static void api_mac_dataCnfInject(int msduHandle, int status)
+{
+    struct mt_msg_interface *pMI;
+    struct mt_msg *pMsg;
+    int len;
+    int x;
+
+    pMI = API_MAC_msg_interface;
+    len = api_mac_schema_data_cnf.fixed_len;
+
+    pMsg = MT_MSG_alloc(len, MAC_DATA_CNF_cmd0, MAC_DATA_CNF_cmd1);
+    if(pMsg == NULL)
+    {
+        /* api_mac_inflightExpire() cleans up */
+        return;
+    }
+    pMsg->pLogPrefix = "data-cnf-local";
+
+    /* laid out as received on pMI, see MT_MSG_rxInject() */
+    x = 0;
+    if(pMI->frame_sync)
+    {
+        pMsg->iobuf[x++] = 0xfe;
+    }
+    pMsg->iobuf[x++] = (uint8_t)(len);
+    if(pMI->len_2bytes)
+    {
+        pMsg->iobuf[x++] = 0;
+    }
+    pMsg->iobuf[x++] = MAC_DATA_CNF_cmd0;
+    pMsg->iobuf[x++] = MAC_DATA_CNF_cmd1;
+    memset((void *)(&(pMsg->iobuf[x])), 0, len);
+    pMsg->iobuf[x + 0] = (uint8_t)(status);
+    pMsg->iobuf[x + 1] = (uint8_t)(msduHandle);
+    pMsg->iobuf_nvalid = x + len;
+
+    MT_MSG_rxInject(pMI, pMsg);
+}
+
+/*! api_mac_submitDone() cookie, the request asked for no confirm */
+#define API_MAC_SUBMIT_no_cnf  0x100
+
+/*!
+ * @brief Check the response to a pipelined data request
+ * @param pMsg - the message that was sent
+ * @param r - the result of MT_MSG_txrx()
+ * @param cookie - msduHandle, and maybe API_MAC_SUBMIT_no_cnf
+ * @return ApiMac_status_success if a confirm completes the request,
+ *         otherwise the co-processor refused it
+ *
+ * A request sent with the noConfirm tx option never gets a confirm
+ * from the co-processor, so we make one. A request without a response
+ * may still have been accepted, it keeps its handle until the real
+ * confirm or api_mac_inflightExpire().
+ */
+static int api_mac_submitCheck(struct mt_msg *pMsg, int r, intptr_t cookie)
+{
+    bool is_sent;
+
+    /* 1 = sent, but the response did not arrive in time */
+    is_sent = (r == 1);
+    r = API_MAC_Srsp_Status(pMsg, r);
+    if(r == ApiMac_status_success)
+    {
+        if(cookie & API_MAC_SUBMIT_no_cnf)
+        {
+            api_mac_dataCnfInject((int)(cookie & 0xff), r);
+        }
+        return (ApiMac_status_success);
+    }
+
+    if(is_sent)
+    {
+        LOG_printf(LOG_ERROR, "data-req: handle 0x%02x: no response\n",
+                   (int)(cookie & 0xff));
+        if(cookie & API_MAC_SUBMIT_no_cnf)
+        {
+            /* no confirm can arrive, but it may have been sent */
+            api_mac_dataCnfInject((int)(cookie & 0xff), r);
+        }
+        return (ApiMac_status_success);
+    }
+    return (r);
+}
+
+/*!
+ * @brief MT_MSG_txrx_async() completion for ApiMac_mcpsDataReqSubmit()
+ * @param pMsg - the message that was sent
+ * @param r - the result of MT_MSG_txrx()
+ * @param cookie - msduHandle, and maybe API_MAC_SUBMIT_no_cnf
+ *
+ * A refused request never gets a confirm from the co-processor, so we
+ * make one, see api_mac_submitCheck().
+ */
+static void api_mac_submitDone(struct mt_msg *pMsg, int r, intptr_t cookie)
+{
+    struct api_mac_inflight *pE;
+
+    /* the co-processor has answered, make room for the next */
+    SEMAPHORE_put(api_mac_submit_room);
+
+    r = api_mac_submitCheck(pMsg, r, cookie);
+    if(r == ApiMac_status_success)
+    {
+        return;
+    }
+
+    pE = &(api_mac_inflight[cookie & 0xff]);
+    MUTEX_lock(api_mac_inflight_lock, -1);
+    pE->is_refused = true;
+    MUTEX_unLock(api_mac_inflight_lock);
+    api_mac_dataCnfInject((int)(cookie & 0xff), r);
+}
+
+/*!
+ * @brief Allocate a new message
+ * @param len - expected payload length, or -1 if unknown
+ * @param cmd0 - cmd0 value
+ * @param cmd1 - cmd1 value
+ * @return pointer to an allocated message, or NULL if no memory
+ */
+static struct mt_msg *api_new_msg(int len, int cmd0,
+                                  int cmd1,
+                                  const char *dbg_prefix)
+{
+    struct mt_msg *pMsg;
+
+    pMsg = MT_MSG_alloc(len, cmd0, cmd1);
+    if(pMsg)
+    {
+        pMsg->pLogPrefix = dbg_prefix;
+        MT_MSG_setSrcIface(pMsg, NULL);
+        MT_MSG_setDestIface(pMsg, API_MAC_msg_interface);
+    }
+    return (pMsg);
+}
+
+/*!
+ * @brief Build the message for a data request
+ * @param pData - the data request
+ * @return the message, or NULL if no memory
+ */
+static struct mt_msg *api_mcpsDataReq_msg(ApiMac_mcpsDataReq_t *pData)
+{
+    struct mt_msg *pMsg;
+
+    pMsg = api_new_msg(MT_MSG_SCHEMA_encodedLen(&api_mac_schema_data_req,
+                                                pData),
+                       api_mac_schema_data_req.cmd0,
+                       api_mac_schema_data_req.cmd1,
+                       api_mac_schema_data_req.name);
+    if(!pMsg)
+    {
+        return (NULL);
+    }
+    MT_MSG_SCHEMA_encode(pMsg, &api_mac_schema_data_req, pData);
+    return (pMsg);
+}
+
+/*!
+  This function sends application data to the MAC for
+  transmission in a MAC data frame.
+
+  Public function defined in api_mac.h
+*/
+ApiMac_status_t ApiMac_mcpsDataReq(ApiMac_mcpsDataReq_t *pData)
+{
+    struct mt_msg *pMsg;
+
+    pMsg = api_mcpsDataReq_msg(pData);
+    if(!pMsg)
+    {
+        return (ApiMac_status_noResources);
+    }
+    return (API_MAC_TxRx_Status(pMsg));
+}
+
+/*!
+  Async version of ApiMac_mcpsDataReq()
+
+  Public function defined in api_mac_linux.h
+*/
+ApiMac_status_t ApiMac_mcpsDataReqAsync(ApiMac_mcpsDataReq_t *pData,
+                                        ApiMac_asyncDoneFn_t *pDoneFn,
+                                        void *pCookie)
+{
+    struct mt_msg *pMsg;
+
+    pMsg = api_mcpsDataReq_msg(pData);
+    if(!pMsg)
+    {
+        return (ApiMac_status_noResources);
+    }
+    return (API_MAC_TxRx_Status_Async(pMsg, pDoneFn, pCookie));
+}
+
+/*!
+  Pipelined version of ApiMac_mcpsDataReq()
+
+  Public function defined in api_mac_linux.h
+*/
+ApiMac_status_t ApiMac_mcpsDataReqSubmit(ApiMac_mcpsDataReq_t *pData,
+                                         ApiMac_dataDoneFn_t *pDoneFn,
+                                         void *pCookie)
+{
+    struct mt_msg *pMsg;
+    intptr_t cookie;
+
+    /* wait for room, an SRSP makes room, see api_mac_submitDone() */
+    if(SEMAPHORE_waitWithTimeout(api_mac_submit_room,
+                      API_MAC_msg_interface->srsp_timeout_mSecs) != 1)
+    {
+        LOG_printf(LOG_DBG_API_MAC_datastats,
+                   "data-req: handle 0x%02x: no room\n",
+                   pData->msduHandle);
+        return (ApiMac_status_transactionOverflow);
+    }
+
+    /* the caller picks a free handle, see ApiMacLinux_dataReqHandleBusy() */
+    if(!api_mac_inflightReserve(pData->msduHandle, pDoneFn, pCookie))
+    {
+        SEMAPHORE_put(api_mac_submit_room);
+        LOG_printf(LOG_DBG_API_MAC_datastats,
+                   "data-req: handle 0x%02x: busy\n",
+                   pData->msduHandle);
+        return (ApiMac_status_invalidParameter);
+    }
+
+    cookie = pData->msduHandle;
+    if(pData->txOptions.noConfirm)
+    {
+        cookie |= API_MAC_SUBMIT_no_cnf;
+    }
+
+    pMsg = api_mcpsDataReq_msg(pData);
+    if(pMsg && (0 == MT_MSG_txrx_async(pMsg, api_mac_submitDone, cookie)))
+    {
+        return (ApiMac_status_success);
+    }
+
+    if(pMsg)
+    {
+        MT_MSG_free(pMsg);
     }
-    LOG_printf(LOG_DBG_MT_MSG_traffic,
-               "SREQ: (%s) SRSP: Result: %d (0x%02x)\n",
-               pMsg->pLogPrefix, r, r);
-fail:
-    MT_MSG_free(pMsg);
-    return (r);
+    SEMAPHORE_put(api_mac_submit_room);
+    api_mac_inflightRelease(pData->msduHandle);
+    return (ApiMac_status_noResources);
 }
 
-/*!
- * @brief Allocate a new message
- * @param len - expected payload length, or -1 if unknown
- * @param cmd0 - cmd0 value
- * @param cmd1 - cmd1 value
- * @return pointer to an allocated message, or NULL if no memory
- */
-static struct mt_msg *api_new_msg(int len, int cmd0,
-                                  int cmd1,
-                                  const char *dbg_prefix)
+/*! Requests ApiMac_mcpsDataReqBatch() builds at a time */
+#define API_MAC_BATCH_MAX  MT_MSG_SREQ_MAX_INFLIGHT
+
+/*
+  Send several data requests in one write
+
+  Public function defined in api_mac_linux.h
+*/
+int ApiMac_mcpsDataReqBatch(ApiMac_mcpsDataReq_t *pReqs,
+                            int n,
+                            ApiMac_dataDoneFn_t *pDoneFn,
+                            void **ppCookies,
+                            ApiMac_status_t *pStatus)
 {
-    struct mt_msg *pMsg;
+    struct mt_msg *msgs[ API_MAC_BATCH_MAX ];
+    intptr_t cookies[ API_MAC_BATCH_MAX ];
+    int results[ API_MAC_BATCH_MAX ];
+    int idx[ API_MAC_BATCH_MAX ];
+    int nok;
+    int m;
+    int x;
+    int y;
 
-    pMsg = MT_MSG_alloc(len, cmd0, cmd1);
-    if(pMsg)
+    nok = 0;
+    for(x = 0 ; x < n ; x += API_MAC_BATCH_MAX)
     {
-        pMsg->pLogPrefix = dbg_prefix;
-        MT_MSG_setSrcIface(pMsg, NULL);
-        MT_MSG_setDestIface(pMsg, API_MAC_msg_interface);
+        /* build the next group */
+        m = 0;
+        for(y = x ; (y < n) && (y < (x + API_MAC_BATCH_MAX)) ; y++)
+        {
+            if(!api_mac_inflightReserve(pReqs[y].msduHandle, pDoneFn,
+                                        ppCookies ? ppCookies[y] : NULL))
+            {
+                pStatus[y] = ApiMac_status_invalidParameter;
+                continue;
+            }
+            msgs[m] = api_mcpsDataReq_msg(&(pReqs[y]));
+            if(msgs[m] == NULL)
+            {
+                api_mac_inflightRelease(pReqs[y].msduHandle);
+                pStatus[y] = ApiMac_status_noResources;
+                continue;
+            }
+            cookies[m] = pReqs[y].msduHandle;
+            if(pReqs[y].txOptions.noConfirm)
+            {
+                cookies[m] |= API_MAC_SUBMIT_no_cnf;
+            }
+            idx[m++] = y;
+        }
+
+        MT_MSG_txrxBatch(msgs, m, results);
+
+        for(y = 0 ; y < m ; y++)
+        {
+            pStatus[idx[y]] = api_mac_submitCheck(msgs[y], results[y],
+                                                  cookies[y]);
+            if(pStatus[idx[y]] == ApiMac_status_success)
+            {
+                nok++;
+            }
+            else
+            {
+                /* refused, no confirm will come */
+                api_mac_inflightRelease(pReqs[idx[y]].msduHandle);
+            }
+            MT_MSG_free(msgs[y]);
+        }
     }
-    return (pMsg);
+    return (nok);
+}
+
+/*
+  Number of pipelined data requests
+
+  Public function defined in api_mac_linux.h
+*/
+int ApiMacLinux_dataReqInFlight(void)
+{
+    return (api_mac_inflight_count);
+}
+
+/*
+  Is a pipelined data request waiting on this handle?
+
+  Public function defined in api_mac_linux.h
+*/
+bool ApiMacLinux_dataReqHandleBusy(uint8_t msduHandle)
+{
+    return (api_mac_inflight[msduHandle].in_use);
 }
 
 /*!
-  This function sends application data to the MAC for
-  transmission in a MAC data frame.
+  This function purges and discards a data request from the MAC
+  data queue.
 
   Public function defined in api_mac.h
 */
-ApiMac_status_t ApiMac_mcpsDataReq(ApiMac_mcpsDataReq_t *pData)
+ApiMac_status_t ApiMac_mcpsPurgeReq(uint8_t msduHandle)
 {
     struct mt_msg *pMsg;
-    int n;
-    n = 0x23;
-    n = n + pData->msdu.len;
-    n = n + pData->payloadIELen;
 
-    pMsg = api_new_msg(n, 0x22, 0x05, "mcpsDataReq");
+    pMsg = api_new_msg(1, 0x22, 0x0e, "mcpsPurgeReq");
     if(!pMsg)
     {
         return (ApiMac_status_noResources);
     }
-    encode_Addr(pMsg, &(pData->dstAddr));
-    MT_MSG_wrU16_DBG(pMsg, pData->dstPanId, "dstPanId");
-    MT_MSG_wrU8_DBG(pMsg, pData->srcAddrMode , "srcAddrMode");
-    MT_MSG_wrU8_DBG(pMsg, pData->msduHandle, "msduHandle");
-    MT_MSG_wrU8_DBG(pMsg, convertTxOptions(&(pData->txOptions)), "txOptions");
-    MT_MSG_wrU8_DBG(pMsg, pData->channel, "channel");
-    MT_MSG_wrU8_DBG(pMsg, pData->power, "power");
-    encode_Sec(pMsg, &(pData->sec));
-    MT_MSG_wrU32_DBG(pMsg, pData->includeFhIEs, "includeFhIEs");
 
-    MT_MSG_wrU16_DBG(pMsg, pData->msdu.len, "msdu.len");
-    MT_MSG_wrU16_DBG(pMsg, pData->payloadIELen, "payloadIELen");
-
-    MT_MSG_wrBuf_DBG(pMsg, pData->msdu.p, pData->msdu.len, "msdu-data");
-    MT_MSG_wrBuf_DBG(pMsg, pData->pIEList, pData->payloadIELen, "payload-IE");
+    MT_MSG_wrU8_DBG(pMsg, msduHandle, "handle");
 
     return (API_MAC_TxRx_Status(pMsg));
 }
 
 /*!
-  This function purges and discards a data request from the MAC
-  data queue.
+  Async version of ApiMac_mcpsPurgeReq()
 
-  Public function defined in api_mac.h
+  Public function defined in api_mac_linux.h
 */
-ApiMac_status_t ApiMac_mcpsPurgeReq(uint8_t msduHandle)
+ApiMac_status_t ApiMac_mcpsPurgeReqAsync(uint8_t msduHandle,
+                                         ApiMac_asyncDoneFn_t *pDoneFn,
+                                         void *pCookie)
 {
     struct mt_msg *pMsg;
 
@@ -1949,7 +3203,7 @@ ApiMac_status_t ApiMac_mcpsPurgeReq(uint8_t msduHandle)
 
     MT_MSG_wrU8_DBG(pMsg, msduHandle, "handle");
 
-    return (API_MAC_TxRx_Status(pMsg));
+    return (API_MAC_TxRx_Status_Async(pMsg, pDoneFn, pCookie));
 }
 
 /*!
@@ -1961,6 +3215,7 @@ ApiMac_status_t ApiMac_mcpsPurgeReq(uint8_t msduHandle)
 ApiMac_status_t ApiMac_mlmeAssociateReq(ApiMac_mlmeAssociateReq_t *pData)
 {
     struct mt_msg *pMsg;
+    ApiMac_status_t r;
 
     pMsg = api_new_msg(0x1a, 0x22, 0x06, "mlmeAssociateReq");
     if(pMsg == NULL)
@@ -1979,7 +3234,9 @@ ApiMac_status_t ApiMac_mlmeAssociateReq(ApiMac_mlmeAssociateReq_t *pData)
                     "capabilityInfo");
     encode_Sec(pMsg, &(pData->sec));
 
-    return (API_MAC_TxRx_Status(pMsg));
+    r = API_MAC_TxRx_Status(pMsg);
+    API_MAC_PIB_FLUSH_ALL("assoc-req");
+    return (r);
 }
 
 /*!
@@ -1991,6 +3248,7 @@ ApiMac_status_t ApiMac_mlmeAssociateReq(ApiMac_mlmeAssociateReq_t *pData)
 ApiMac_status_t ApiMac_mlmeDisassociateReq(ApiMac_mlmeDisassociateReq_t *pData)
 {
     struct mt_msg *pMsg;
+    ApiMac_status_t r;
 
     pMsg = api_new_msg(0x18, 0x22, 0x07, "mlmeDisassociateReq");
     if(pMsg == NULL)
@@ -2004,7 +3262,276 @@ ApiMac_status_t ApiMac_mlmeDisassociateReq(ApiMac_mlmeDisassociateReq_t *pData)
     MT_MSG_wrU8_DBG(pMsg, pData->txIndirect , "txIndirect");
     encode_Sec(pMsg, &(pData->sec));
 
-    return (API_MAC_TxRx_Status(pMsg));
+    r = API_MAC_TxRx_Status(pMsg);
+    API_MAC_PIB_FLUSH_ALL("disassoc-req");
+    return (r);
+}
+
+/*!
+ * @brief Index into api_mac_pib_cache[] for an attribute
+ * @param att_id - MAC, security or FH attribute id
+ * @return index, or -1 if the attribute cannot be cached
+ */
+static int api_mac_pibIndex(int att_id)
+{
+    if((att_id >= 0) && (att_id < 0x100))
+    {
+        return (att_id);
+    }
+    if((att_id >= 0x2000) && (att_id < 0x2100))
+    {
+        return (0x100 + (att_id & 0xff));
+    }
+    return (-1);
+}
+
+/*!
+ * @brief Mark the api_mac_pib_volatile[] attributes, the first time
+ */
+static void api_mac_pibInit(void)
+{
+    int x;
+
+    if(api_mac_pib_cache_init)
+    {
+        return;
+    }
+    api_mac_pib_cache_init = true;
+    for(x = 0 ; api_mac_pib_volatile[x] ; x++)
+    {
+        api_mac_pib_cache[api_mac_pibIndex(api_mac_pib_volatile[x])].
+            is_volatile = true;
+    }
+}
+
+/*!
+ * @brief Lock the PIB cache
+ * @return false if there is no cache (no interface yet, or disabled)
+ */
+static bool api_mac_pibLock(void)
+{
+    if((api_mac_pib_lock == 0) || (!ApiMacLinux_pibCache_enable))
+    {
+        return (false);
+    }
+    MUTEX_lock(api_mac_pib_lock, -1);
+    return (true);
+}
+
+/*!
+ * @brief Look for a cached PIB value
+ * @param att_id - the attribute id
+ * @param wiresize - as for API_MAC_Get_Common()
+ * @param pV - numeric values are returned here
+ * @param pBytes - arrays are copied here
+ * @param pGen - the cache generation, for api_mac_pibFill()
+ * @return true if found
+ */
+static bool api_mac_pibLookup(int att_id,
+                              int wiresize,
+                              uint64_t *pV,
+                              void *pBytes,
+                              unsigned *pGen)
+{
+    struct api_mac_pib_entry *pE;
+    bool found;
+    int x;
+
+    /* not cached, api_mac_pibFill() skips it the same way */
+    *pGen = 0;
+
+    x = api_mac_pibIndex(att_id);
+    if((x < 0) || (-wiresize > API_MAC_PIB_CACHE_MAX_ARRAY))
+    {
+        return (false);
+    }
+    if(!api_mac_pibLock())
+    {
+        return (false);
+    }
+
+    pE = &(api_mac_pib_cache[x]);
+    found = pE->is_valid && (pE->wiresize == wiresize);
+    if(found)
+    {
+        if(wiresize < 0)
+        {
+            memcpy(pBytes, (void *)(pE->bytes), -wiresize);
+        }
+        else
+        {
+            *pV = pE->v;
+        }
+        api_mac_pib_stats.hits++;
+    }
+    else if(!pE->is_volatile)
+    {
+        api_mac_pib_stats.misses++;
+    }
+    *pGen = api_mac_pib_generation;
+    MUTEX_unLock(api_mac_pib_lock);
+    return (found);
+}
+
+/*!
+ * @brief Store a PIB value read from, or written to the co-processor
+ * @param att_id - the attribute id
+ * @param wiresize - as for API_MAC_Get_Common()
+ * @param v - numeric value
+ * @param pBytes - array value
+ * @param gen - cache generation from before the transfer
+ *
+ * Nothing is stored if the cache changed during the transfer, the value
+ * may be out of date.
+ */
+static void api_mac_pibFill(int att_id,
+                            int wiresize,
+                            uint64_t v,
+                            const void *pBytes,
+                            unsigned gen)
+{
+    struct api_mac_pib_entry *pE;
+    int x;
+
+    x = api_mac_pibIndex(att_id);
+    if((x < 0) || (-wiresize > API_MAC_PIB_CACHE_MAX_ARRAY))
+    {
+        return;
+    }
+    if(!api_mac_pibLock())
+    {
+        return;
+    }
+    pE = &(api_mac_pib_cache[x]);
+    if((gen == api_mac_pib_generation) && !(pE->is_volatile))
+    {
+        pE->is_valid = true;
+        pE->wiresize = (int8_t)wiresize;
+        if(wiresize < 0)
+        {
+            memcpy((void *)(pE->bytes), pBytes, -wiresize);
+        }
+        else
+        {
+            pE->v = v;
+        }
+        api_mac_pib_stats.fills++;
+    }
+    MUTEX_unLock(api_mac_pib_lock);
+}
+
+/*!
+ * @brief Start a PIB set, gets racing with it are not cached
+ * @param att_id - the attribute id
+ * @return the cache generation, for api_mac_pibFill()
+ *
+ * The old value is dropped, and stays dropped if the set fails.
+ */
+static unsigned api_mac_pibSetBegin(int att_id)
+{
+    unsigned gen;
+    int x;
+
+    if(!api_mac_pibLock())
+    {
+        return (0);
+    }
+    x = api_mac_pibIndex(att_id);
+    if((x >= 0) && api_mac_pib_cache[x].is_valid)
+    {
+        api_mac_pib_cache[x].is_valid = false;
+        api_mac_pib_stats.invalidates++;
+    }
+    gen = ++api_mac_pib_generation;
+    MUTEX_unLock(api_mac_pib_lock);
+    return (gen);
+}
+
+/*!
+ * @brief Drop cached PIB values in a range of attribute ids
+ * @param lo - first attribute id
+ * @param hi - last attribute id
+ * @param why - for the log
+ */
+static void api_mac_pibFlush(int lo, int hi, const char *why)
+{
+    int x;
+
+    if(!api_mac_pibLock())
+    {
+        return;
+    }
+    for(x = lo ; x <= hi ; x++)
+    {
+        if(api_mac_pibIndex(x) >= 0)
+        {
+            api_mac_pib_cache[api_mac_pibIndex(x)].is_valid = false;
+        }
+    }
+    api_mac_pib_generation++;
+    api_mac_pib_stats.flushes++;
+    LOG_printf(LOG_DBG_API_MAC_datastats,
+               "pib-cache: flush(%s) hits: %u misses: %u fills: %u\n",
+               why,
+               api_mac_pib_stats.hits,
+               api_mac_pib_stats.misses,
+               api_mac_pib_stats.fills);
+    MUTEX_unLock(api_mac_pib_lock);
+}
+
+/*!
+  Mark a PIB attribute as volatile
+
+  Public function defined in api_mac_linux.h
+*/
+int ApiMacLinux_pibCacheVolatile(int attr, bool is_volatile)
+{
+    int x;
+
+    x = api_mac_pibIndex(attr);
+    if(x < 0)
+    {
+        return (-1);
+    }
+    if(!api_mac_pibLock())
+    {
+        /* not running yet, or disabled, remember it anyway */
+        api_mac_pibInit();
+        api_mac_pib_cache[x].is_volatile = is_volatile;
+        return (0);
+    }
+    api_mac_pibInit();
+    api_mac_pib_cache[x].is_volatile = is_volatile;
+    api_mac_pib_cache[x].is_valid = false;
+    api_mac_pib_generation++;
+    MUTEX_unLock(api_mac_pib_lock);
+    return (0);
+}
+
+/*!
+  Drop all cached PIB values
+
+  Public function defined in api_mac_linux.h
+*/
+void ApiMacLinux_pibCacheFlush(void)
+{
+    API_MAC_PIB_FLUSH_ALL("app");
+}
+
+/*!
+  Get the PIB cache counters
+
+  Public function defined in api_mac_linux.h
+*/
+void ApiMacLinux_pibCacheStats(struct api_mac_pib_cache_stats *pStats)
+{
+    if(!api_mac_pibLock())
+    {
+        *pStats = api_mac_pib_stats;
+        return;
+    }
+    *pStats = api_mac_pib_stats;
+    MUTEX_unLock(api_mac_pib_lock);
 }
 
 /*!
@@ -2036,9 +3563,16 @@ static int API_MAC_Get_Common(int cmd0,
     uint64_t v;
     struct mt_msg *pMsg;
     struct mt_msg *pSrsp;
+    unsigned gen;
     int l;
 
     v = 0;
+    pMsg = NULL;
+
+    if(api_mac_pibLookup(att_id, wiresize, &v, pValue, &gen))
+    {
+        goto found;
+    }
 
     /* some attributes are 16bit numbers */
     if(att_id > 0x100)
@@ -2148,6 +3682,9 @@ static int API_MAC_Get_Common(int cmd0,
         goto fail;
     }
 
+    api_mac_pibFill(att_id, wiresize, v, pValue, gen);
+
+found:
     if(datasize < 0)
     {
         /* negative case was handled above, both wire & data size
@@ -2207,6 +3744,7 @@ static int API_MAC_Set_Common(int cmd0,
 {
     struct mt_msg *pMsg;
     ApiMac_status_t r;
+    unsigned gen;
     int n_wrote;
     int len;
 
@@ -2276,11 +3814,16 @@ static int API_MAC_Set_Common(int cmd0,
         n_wrote++;
     }
 
+    gen = api_mac_pibSetBegin(att_id);
     r = (API_MAC_TxRx_Status(pMsg));
     if( r != ApiMac_status_success )
     {
         LOG_printf(LOG_ERROR, "**ERROR** Set/Operation failed with status code: 0x%02x\n", r);
     }
+    else
+    {
+        api_mac_pibFill(att_id, wiresize, v, NULL, gen);
+    }
     return (r);
 }
 
@@ -2303,6 +3846,7 @@ static ApiMac_status_t API_MAC_SetGetArray_Common(bool is_set,
     int wiresize;
     int datasize;
     bool is_secure;
+    unsigned gen;
     ApiMac_status_t r;
 
     wiresize = 0;
@@ -2409,11 +3953,16 @@ static ApiMac_status_t API_MAC_SetGetArray_Common(bool is_set,
     }
     MT_MSG_wrBuf_DBG(pMsg, pValue, wiresize, "data-bytes");
 
+    gen = api_mac_pibSetBegin(pib_attribute);
     r = (API_MAC_TxRx_Status(pMsg));
     if( r != ApiMac_status_success )
     {
         LOG_printf(LOG_ERROR, "**ERROR** Set/Operation failed with status code: 0x%02x\n", r);
     }
+    else
+    {
+        api_mac_pibFill(pib_attribute, -wiresize, 0, pValue, gen);
+    }
     return (r);
 }
 
@@ -3142,6 +4691,11 @@ err:
         MT_MSG_free(pdata.pMsg);
         pdata.pMsg = NULL;
     }
+    if(is_set)
+    {
+        /* table entries are not cached, but the MAC may count them */
+        API_MAC_PIB_FLUSH_SECURITY("sec-struct");
+    }
     /* otherwise we return the status */
     if( pdata.result != ApiMac_status_success )
     {
@@ -3222,6 +4776,7 @@ static ApiMac_status_t API_MAC_SetSecurity_Common( int cmd0,
 {
     struct mt_msg *pMsg;
     struct mt_msg *pSrsp;
+    unsigned gen;
     int l;
     int r;
 
@@ -3265,6 +4820,7 @@ static ApiMac_status_t API_MAC_SetSecurity_Common( int cmd0,
         MT_MSG_wrU64_DBG(pMsg, value, "value64");
         break;
     }
+    gen = api_mac_pibSetBegin(att_id);
     /* do the transfer */
     r = MT_MSG_txrx(pMsg);
 
@@ -3286,6 +4842,10 @@ static ApiMac_status_t API_MAC_SetSecurity_Common( int cmd0,
     }
     else
     {
+        if(r == ApiMac_status_success)
+        {
+            api_mac_pibFill(att_id, wiresize, value, NULL, gen);
+        }
         r = ApiMac_status_success;
     }
 fail:
@@ -3464,6 +5024,7 @@ ApiMac_status_t ApiMac_mlmePollReq(ApiMac_mlmePollReq_t *pData)
 ApiMac_status_t ApiMac_mlmeResetReq(bool setDefaultPib)
 {
     struct mt_msg *pMsg;
+    ApiMac_status_t r;
 
     pMsg = api_new_msg(0x01, 0x22, 0x01, "mlmeResetReq");
     if(pMsg == NULL)
@@ -3472,7 +5033,9 @@ ApiMac_status_t ApiMac_mlmeResetReq(bool setDefaultPib)
     }
     MT_MSG_wrU8_DBG(pMsg, setDefaultPib, "resetParam");
 
-    return (API_MAC_TxRx_Status(pMsg));
+    r = API_MAC_TxRx_Status(pMsg);
+    API_MAC_PIB_FLUSH_ALL("reset-req");
+    return (r);
 }
 
 /*!
@@ -3518,6 +5081,7 @@ ApiMac_status_t ApiMac_mlmeScanReq(ApiMac_mlmeScanReq_t *pData)
 ApiMac_status_t ApiMac_mlmeStartReq(ApiMac_mlmeStartReq_t *pData)
 {
     struct mt_msg *pMsg;
+    ApiMac_status_t r;
 
     pMsg = api_new_msg(0x2a + pData->mpmParams.numIEs, 0x22, 0x03, "mlmeStartReq");
     if(pMsg == NULL)
@@ -3544,7 +5108,9 @@ ApiMac_status_t ApiMac_mlmeStartReq(ApiMac_mlmeStartReq_t *pData)
     MT_MSG_wrU8_DBG(pMsg, pData->mpmParams.numIEs, "numIEs");
     MT_MSG_wrBuf_DBG(pMsg, pData->mpmParams.pIEIDs, pData->mpmParams.numIEs, "ieids");
 
-    return (API_MAC_TxRx_Status(pMsg));
+    r = API_MAC_TxRx_Status(pMsg);
+    API_MAC_PIB_FLUSH_ALL("start-req");
+    return (r);
 }
 
 /*!
@@ -3556,6 +5122,7 @@ ApiMac_status_t ApiMac_mlmeStartReq(ApiMac_mlmeStartReq_t *pData)
 ApiMac_status_t ApiMac_mlmeSyncReq(ApiMac_mlmeSyncReq_t *pData)
 {
     struct mt_msg *pMsg;
+    ApiMac_status_t r;
 
     pMsg = api_new_msg(0x04, 0x22, 0x04, "mlmeSyncReq");
     if(pMsg == NULL)
@@ -3568,7 +5135,9 @@ ApiMac_status_t ApiMac_mlmeSyncReq(ApiMac_mlmeSyncReq_t *pData)
     MT_MSG_wrU8_DBG(pMsg, pData->trackBeacon, "trackBeacon");
     MT_MSG_wrU8_DBG(pMsg, pData->phyID, "phyID");
 
-    return (API_MAC_TxRx_Status(pMsg));
+    r = API_MAC_TxRx_Status(pMsg);
+    API_MAC_PIB_FLUSH_ALL("sync-req");
+    return (r);
 }
 
 /*!
@@ -3590,6 +5159,7 @@ uint8_t ApiMac_randomByte(void)
 ApiMac_status_t ApiMac_updatePanId(uint16_t panId)
 {
     struct mt_msg *pMsg;
+    ApiMac_status_t r;
 
     pMsg = api_new_msg(0x02, 0x22, 0x32, "updatePanId");
     if(pMsg == NULL)
@@ -3599,7 +5169,9 @@ ApiMac_status_t ApiMac_updatePanId(uint16_t panId)
 
     MT_MSG_wrU16_DBG(pMsg, panId, "panID");
 
-    return (API_MAC_TxRx_Status(pMsg));
+    r = API_MAC_TxRx_Status(pMsg);
+    API_MAC_PIB_FLUSH_ALL("pan-id");
+    return (r);
 }
 
 /*!
@@ -3652,13 +5224,16 @@ ApiMac_status_t ApiMac_mlmeWSAsyncReq(ApiMac_mlmeWSAsyncReq_t* pData)
 ApiMac_status_t ApiMac_startFH(void)
 {
     struct mt_msg *pMsg;
+    ApiMac_status_t r;
 
     pMsg = api_new_msg(0, 0x22, 0x41, "startFH");
     if(pMsg == NULL)
     {
         return (ApiMac_status_noResources);
     }
-    return (API_MAC_TxRx_Status(pMsg));
+    r = API_MAC_TxRx_Status(pMsg);
+    API_MAC_PIB_FLUSH_ALL("start-fh");
+    return (r);
 }
 
 /*!
@@ -3840,13 +5415,16 @@ void ApiMac_freeIEList(ApiMac_payloadIeRec_t *pList)
 ApiMac_status_t ApiMac_enableFH(void)
 {
     struct mt_msg *pMsg;
+    ApiMac_status_t r;
 
     pMsg = api_new_msg(0, 0x22, 0x40, "enableFH");
     if(pMsg == NULL)
     {
         return (ApiMac_status_noResources);
     }
-    return (API_MAC_TxRx_Status(pMsg));
+    r = API_MAC_TxRx_Status(pMsg);
+    API_MAC_PIB_FLUSH_ALL("enable-fh");
+    return (r);
 }
 
 /*!
@@ -3967,6 +5545,7 @@ void ApiMac_buildMsgCapInfo(uint8_t cInfo, ApiMac_capabilityInfo_t *pPBcapInfo)
 ApiMac_status_t ApiMac_secAddDevice(ApiMac_secAddDevice_t *pAddDev)
 {
     struct mt_msg *pMsg;
+    ApiMac_status_t r;
 
     pMsg = api_new_msg(0x1d, 0x22, 0x33, "secAddDevice");
     if(pMsg == NULL)
@@ -4002,7 +5581,9 @@ ApiMac_status_t ApiMac_secAddDevice(ApiMac_secAddDevice_t *pAddDev)
                      pAddDev->keyIdLookupData, APIMAC_MAX_KEY_LOOKUP_LEN,
                      "lookupData");
 
-    return (API_MAC_TxRx_Status(pMsg));
+    r = API_MAC_TxRx_Status(pMsg);
+    API_MAC_PIB_FLUSH_SECURITY("sec-add-dev");
+    return (r);
 }
 
 /*!
@@ -4013,6 +5594,7 @@ ApiMac_status_t ApiMac_secAddDevice(ApiMac_secAddDevice_t *pAddDev)
 ApiMac_status_t ApiMac_secDeleteDevice(ApiMac_sAddrExt_t *pExtAddr)
 {
     struct mt_msg *pMsg;
+    ApiMac_status_t r;
 
     pMsg = api_new_msg(0x08, 0x22, 0x34, "secDeleteDevice");
     if(pMsg == NULL)
@@ -4022,7 +5604,9 @@ ApiMac_status_t ApiMac_secDeleteDevice(ApiMac_sAddrExt_t *pExtAddr)
 
     MT_MSG_wrBuf_DBG(pMsg, pExtAddr, APIMAC_SADDR_EXT_LEN, "extAddr");
 
-    return (API_MAC_TxRx_Status(pMsg));
+    r = API_MAC_TxRx_Status(pMsg);
+    API_MAC_PIB_FLUSH_SECURITY("sec-del-dev");
+    return (r);
 }
 
 /*!
@@ -4034,6 +5618,7 @@ ApiMac_status_t ApiMac_secDeleteDevice(ApiMac_sAddrExt_t *pExtAddr)
 ApiMac_status_t ApiMac_secDeleteKeyAndAssocDevices(uint8_t keyIndex)
 {
     struct mt_msg *pMsg;
+    ApiMac_status_t r;
 
     pMsg = api_new_msg(0x01, 0x022, 0x36, "secDeleteKeyAndAssocDevices");
     if(pMsg == NULL)
@@ -4043,7 +5628,9 @@ ApiMac_status_t ApiMac_secDeleteKeyAndAssocDevices(uint8_t keyIndex)
 
     MT_MSG_wrU8_DBG(pMsg, keyIndex, "keyIndex");
 
-    return (API_MAC_TxRx_Status(pMsg));
+    r = API_MAC_TxRx_Status(pMsg);
+    API_MAC_PIB_FLUSH_SECURITY("sec-del-key");
+    return (r);
 }
 
 /*!
@@ -4054,6 +5641,7 @@ ApiMac_status_t ApiMac_secDeleteKeyAndAssocDevices(uint8_t keyIndex)
 ApiMac_status_t ApiMac_secDeleteAllDevices(void)
 {
     struct mt_msg *pMsg;
+    ApiMac_status_t r;
 
     pMsg = api_new_msg(0, 0x22, 0x35, "secDeleteAllDevices");
     if(pMsg == NULL)
@@ -4061,7 +5649,9 @@ ApiMac_status_t ApiMac_secDeleteAllDevices(void)
         return (ApiMac_status_noResources);
     }
 
-    return (API_MAC_TxRx_Status(pMsg));
+    r = API_MAC_TxRx_Status(pMsg);
+    API_MAC_PIB_FLUSH_SECURITY("sec-del-all");
+    return (r);
 }
 
 /*!
@@ -4113,6 +5703,7 @@ ApiMac_status_t ApiMac_secAddKeyInitFrameCounter(
     ApiMac_secAddKeyInitFrameCounter_t *pInfo)
 {
     struct mt_msg *pMsg;
+    ApiMac_status_t r;
 
     pMsg = api_new_msg(0x21, 0x22, 0x38, "secAddKeyInitFrameCounter");
     if(pMsg == NULL)
@@ -4141,7 +5732,9 @@ ApiMac_status_t ApiMac_secAddKeyInitFrameCounter(
                       sizeof(pInfo->lookupData) ,
                       "lookupData");
 
-    return (API_MAC_TxRx_Status(pMsg));
+    r = API_MAC_TxRx_Status(pMsg);
+    API_MAC_PIB_FLUSH_SECURITY("sec-add-key");
+    return (r);
 }
 
 /*
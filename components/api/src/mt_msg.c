@@ -17,6 +17,8 @@
  Includes
  *****************************************************************************/
 
+/* the checked field readers/writers are here, not the inlined ones */
+#define _MT_MSG_IMPLIMENTOR_ 1
 #include "compiler.h"
 #include "mt_msg.h"
 #include "mt_msg_dbg.h"
@@ -28,6 +30,7 @@
 #include "stream_uart.h"
 #include "timer.h"
 #include "ti_semaphore.h"
+#include "reactor.h"
 #include "fatal.h"
 
 #include <stdarg.h>
@@ -48,6 +51,8 @@ const struct ini_flag_name mt_msg_log_flags[] = {
     { .name = "mt-msg-areq"    , .value = LOG_DBG_MT_MSG_areq },
     { .name = "mt-msg-fields"  , .value = LOG_DBG_MT_MSG_fields },
     { .name = "mt-msg-decode"  , .value = LOG_DBG_MT_MSG_decode },
+    { .name = "mt-msg-pool"    , .value = LOG_DBG_MT_MSG_pool },
+    { .name = "mt-msg-latency" , .value = LOG_DBG_MT_MSG_latency },
     /* terminate */
     { .name = NULL }
 };
@@ -63,17 +68,271 @@ static const char _incoming_msg[] = "incoming-msg";
 
 struct mt_version_info MT_DEVICE_version_info;
 
+/*!
+ * @struct mt_msg_pool
+ * @brief A free list of messages of one size class
+ */
+struct mt_msg_pool {
+    /*! statistics, also holds the buffer size for this class */
+    struct mt_msg_pool_stats stats;
+
+    /*! at most this many messages are kept on the free list */
+    unsigned max_free;
+
+    /*! released messages, linked via mt_msg::pListNext */
+    struct mt_msg *pFree;
+};
+
+/*! The message pools, one per size class */
+static struct mt_msg_pool mt_msg_pools[ MT_MSG_POOL_nClasses ] = {
+    [MT_MSG_POOL_small] = {
+        .stats.dbg_name = "small",
+        .stats.buf_size = MT_MSG_POOL_SMALL_SIZE,
+        .max_free       = MT_MSG_POOL_SMALL_MAX_FREE
+    },
+    [MT_MSG_POOL_medium] = {
+        .stats.dbg_name = "medium",
+        .stats.buf_size = MT_MSG_POOL_MEDIUM_SIZE,
+        .max_free       = MT_MSG_POOL_MEDIUM_MAX_FREE
+    },
+    [MT_MSG_POOL_large] = {
+        .stats.dbg_name = "large",
+        .stats.buf_size = MT_MSG_POOL_LARGE_SIZE,
+        .max_free       = MT_MSG_POOL_LARGE_MAX_FREE
+    },
+    [MT_MSG_POOL_share] = {
+        .stats.dbg_name = "share",
+        .stats.buf_size = 0,
+        .max_free       = MT_MSG_POOL_SHARE_MAX_FREE
+    }
+};
+
+/*! Protects the message pools */
+static intptr_t mt_msg_pool_mutex;
+
+/*! Reads interfaces with use_reactor set, protected by mt_msg_pool_mutex */
+static intptr_t mt_msg_reactor;
+
+/*! How many interfaces use mt_msg_reactor */
+static int mt_msg_reactor_users;
+
 /******************************************************************************
  Functions
  *****************************************************************************/
 
+/*!
+ * @brief Create the message pool lock if needed
+ *
+ * This is called from MT_MSG_init() and MT_MSG_interfaceCreate()
+ * which are called before any threads are started.
+ */
+static void mt_msg_pool_init(void)
+{
+    if(mt_msg_pool_mutex == 0)
+    {
+        mt_msg_pool_mutex = MUTEX_create("mt-msg-pool");
+        if(mt_msg_pool_mutex == 0)
+        {
+            BUG_HERE("cannot create msg pool mutex\n");
+        }
+    }
+}
+
 /*
    Public funnction in mt_msg.h - see mt_msg.h
  */
 void MT_MSG_init(void)
 {
-    /* nothing todo, everything is done inside the */
-    /* MT_MSG_IFaceInit() call */
+    /* everything else is done inside the */
+    /* MT_MSG_interfaceCreate() call */
+    mt_msg_pool_init();
+}
+
+/*!
+ * @brief Determine the pool size class for a message
+ * @param nbytes - number of bytes required, negative if unknown
+ * @returns the size class
+ */
+static enum mt_msg_pool_class mt_msg_pool_which(int nbytes)
+{
+    int x;
+
+    if(nbytes >= 0)
+    {
+        /* the share class has no buffer, see MT_MSG_share() */
+        for(x = 0 ; x <= MT_MSG_POOL_large ; x++)
+        {
+            if(nbytes <= mt_msg_pools[x].stats.buf_size)
+            {
+                return ((enum mt_msg_pool_class)x);
+            }
+        }
+    }
+    /* unknown or huge, use the largest */
+    return (MT_MSG_POOL_large);
+}
+
+/*!
+ * @brief Get a message from the pool (or the heap)
+ * @param which - the size class
+ * @param pRef - if not null, take a reference to this message
+ * @returns the message, the struct is zeroed the io buffer is not.
+ *
+ * The reference is taken under the pool lock, see MT_MSG_share()
+ */
+static struct mt_msg *mt_msg_pool_get(enum mt_msg_pool_class which,
+                                      struct mt_msg *pRef)
+{
+    struct mt_msg_pool *pPool;
+    struct mt_msg *pMsg;
+
+    pPool = &(mt_msg_pools[which]);
+
+    mt_msg_pool_init();
+    MUTEX_lock(mt_msg_pool_mutex, -1);
+    pMsg = pPool->pFree;
+    if(pMsg)
+    {
+        pPool->pFree = pMsg->pListNext;
+        pPool->stats.n_free--;
+        pPool->stats.hits++;
+    }
+    else
+    {
+        pPool->stats.misses++;
+    }
+    pPool->stats.in_use++;
+    if(pPool->stats.in_use > pPool->stats.high_water)
+    {
+        pPool->stats.high_water = pPool->stats.in_use;
+    }
+    if(pRef)
+    {
+        pRef->n_refs++;
+    }
+    MUTEX_unLock(mt_msg_pool_mutex);
+
+    if(pMsg == NULL)
+    {
+        /* The io buffer follows the struct */
+        /* only the struct is cleared, not the buffer */
+        pMsg = malloc(sizeof(*pMsg) + pPool->stats.buf_size);
+        if(pMsg == NULL)
+        {
+            MUTEX_lock(mt_msg_pool_mutex, -1);
+            pPool->stats.in_use--;
+            if(pRef)
+            {
+                pRef->n_refs--;
+            }
+            MUTEX_unLock(mt_msg_pool_mutex);
+            return (NULL);
+        }
+    }
+
+    memset((void *)(pMsg), 0, sizeof(*pMsg));
+    pMsg->iobuf = (uint8_t *)(pMsg + 1);
+    pMsg->iobuf_idx_max = pPool->stats.buf_size;
+    pMsg->pool_class = which;
+    pMsg->n_refs = 1;
+    return (pMsg);
+}
+
+/*!
+ * @brief Return a message to the pool (or the heap)
+ * @param pMsg - the message
+ * @returns the io buffer owner of a share if this was the last reference
+ */
+static struct mt_msg *mt_msg_pool_put(struct mt_msg *pMsg)
+{
+    struct mt_msg_pool *pPool;
+    struct mt_msg *pShared;
+
+    pPool = &(mt_msg_pools[pMsg->pool_class]);
+    pShared = pMsg->pShared;
+
+    /* make it unusable, the io buffer is not touched */
+    memset((void *)(pMsg), 0, sizeof(*pMsg));
+
+    MUTEX_lock(mt_msg_pool_mutex, -1);
+    /* a share holds a reference to the io buffer owner */
+    if(pShared)
+    {
+        pShared->n_refs--;
+        if(pShared->n_refs > 0)
+        {
+            pShared = NULL;
+        }
+    }
+    pPool->stats.in_use--;
+    if(pPool->stats.n_free < pPool->max_free)
+    {
+        pMsg->pListNext = pPool->pFree;
+        pPool->pFree = pMsg;
+        pPool->stats.n_free++;
+        pMsg = NULL;
+    }
+    else
+    {
+        pPool->stats.trims++;
+    }
+    MUTEX_unLock(mt_msg_pool_mutex);
+
+    if(pMsg)
+    {
+        free((void *)pMsg);
+    }
+    return (pShared);
+}
+
+/*
+  Get pool statistics
+  see mt_msg.h
+*/
+int MT_MSG_POOL_getStats(enum mt_msg_pool_class which,
+                         struct mt_msg_pool_stats *pStats)
+{
+    if(!_inrange(which, 0, MT_MSG_POOL_nClasses))
+    {
+        return (-1);
+    }
+
+    mt_msg_pool_init();
+    MUTEX_lock(mt_msg_pool_mutex, -1);
+    *pStats = mt_msg_pools[which].stats;
+    MUTEX_unLock(mt_msg_pool_mutex);
+    return (0);
+}
+
+/*
+  Log pool statistics
+  see mt_msg.h
+*/
+void MT_MSG_POOL_log(int64_t why)
+{
+    struct mt_msg_pool_stats stats;
+    int x;
+
+    if(!LOG_test(why))
+    {
+        return;
+    }
+
+    for(x = 0 ; x < MT_MSG_POOL_nClasses ; x++)
+    {
+        MT_MSG_POOL_getStats((enum mt_msg_pool_class)x, &stats);
+        LOG_printf(why,
+                   "MT_MSG pool: %-6s size: %4d hits: %u misses: %u "
+                   "trims: %u in-use: %u high-water: %u free: %u\n",
+                   stats.dbg_name,
+                   stats.buf_size,
+                   stats.hits,
+                   stats.misses,
+                   stats.trims,
+                   stats.in_use,
+                   stats.high_water,
+                   stats.n_free);
+    }
 }
 
 /*!
@@ -242,6 +501,88 @@ void MT_MSG_set_type(struct mt_msg *pMsg, struct mt_msg_interface *pMI)
     }
 }
 
+/*!
+ * @brief Size of the frame header (sync, len, cmd0, cmd1) on an interface
+ * @param pMI - the interface
+ * @returns offset of the payload in the io buffer
+ */
+static int mt_msg_hdr_len(struct mt_msg_interface *pMI)
+{
+    return ((pMI->frame_sync ? 1 : 0) +
+            (pMI->len_2bytes ? 2 : 1) +
+            1 + /* cmd0 */
+            1); /* cmd1 */
+}
+
+/*!
+ * @brief Build the frame for a shared message, see MT_MSG_share()
+ * @param pMsg - the shared message
+ * @returns number of bytes in mt_msg_interface::pTxFrame, or -1
+ *
+ * The shared io buffer is read only, the frame (header, payload and
+ * checksum) is built in the destination interface transmit buffer.
+ * The caller must hold the destination interface tx_lock.
+ */
+static int MT_MSG_format_shared(struct mt_msg *pMsg)
+{
+    struct mt_msg_interface *pMI;
+    uint8_t *pFrame;
+    int chksum;
+    int n;
+    int x;
+
+    pMI = pMsg->pDestIface;
+    if((pMsg->expected_len + 6) > MT_MSG_POOL_LARGE_SIZE)
+    {
+        MT_MSG_log(LOG_ERROR, pMsg, "shared msg too big\n");
+        return (-1);
+    }
+
+    if(pMI->pTxFrame == NULL)
+    {
+        pMI->pTxFrame = malloc(MT_MSG_POOL_LARGE_SIZE);
+        if(pMI->pTxFrame == NULL)
+        {
+            MT_MSG_log(LOG_ERROR, pMsg, "%s: no memory for tx frame\n",
+                       pMI->dbg_name);
+            return (-1);
+        }
+    }
+    pFrame = pMI->pTxFrame;
+
+    n = 0;
+    if(pMI->frame_sync)
+    {
+        pFrame[n++] = 0xfe;
+    }
+    pFrame[n++] = (uint8_t)(pMsg->expected_len);
+    if(pMI->len_2bytes)
+    {
+        pFrame[n++] = (uint8_t)(pMsg->expected_len >> 8);
+    }
+    pFrame[n++] = (uint8_t)(pMsg->cmd0);
+    pFrame[n++] = (uint8_t)(pMsg->cmd1);
+
+    /* the payload is where the source interface put it */
+    memcpy((void *)(&pFrame[n]),
+           (void *)(&(pMsg->iobuf[mt_msg_hdr_len(pMsg->pSrcIface)])),
+           pMsg->expected_len);
+    n += pMsg->expected_len;
+
+    if(pMI->include_chksum)
+    {
+        /* the frame sync byte is not included */
+        chksum = 0;
+        for(x = (pMI->frame_sync ? 1 : 0) ; x < n ; x++)
+        {
+            chksum ^= pFrame[x];
+        }
+        pMsg->chksum = chksum;
+        pFrame[n++] = (uint8_t)(chksum);
+    }
+    return (n);
+}
+
 /*!
  * @brief Format a message for transmission.
  * @param pMsg
@@ -383,6 +724,12 @@ void MT_MSG_reformat(struct mt_msg *pMsg)
     int F_start;
     int T_start;
 
+    /* shared payloads do not move, see MT_MSG_format_shared() */
+    if(pMsg->pShared)
+    {
+        return;
+    }
+
     /* on the from side ... where does our payload begin? */
     F_start = (
         (pMsg->pSrcIface->frame_sync ? 1 : 0) +
@@ -456,6 +803,12 @@ void MT_MSG_wrUX_DBG(struct mt_msg *pMsg, uint64_t value,
     {
         return;
     }
+    if(pMsg->pShared)
+    {
+        pMsg->is_error = true;
+        BUG_HERE("wr to shared msg\n");
+        return;
+    }
     if(name)
     {
         LOG_printf(LOG_DBG_MT_MSG_fields, "%s: wr_u%d: %*s: %lld, 0x%llx\n",
@@ -538,6 +891,12 @@ void MT_MSG_wrBuf_DBG(struct mt_msg *pMsg, const void *pData,
     {
         return;
     }
+    if(pMsg->pShared)
+    {
+        pMsg->is_error = true;
+        BUG_HERE("wr to shared msg\n");
+        return;
+    }
 
     /* init the index */
     init_wr_idx(pMsg);
@@ -781,6 +1140,9 @@ void MT_MSG_rdBuf_DBG(struct mt_msg *pMsg,
 */
 void MT_MSG_free(struct mt_msg *pMsg)
 {
+    struct mt_msg *pShared;
+    int n_refs;
+
     if(pMsg == NULL)
     {
         return;
@@ -799,6 +1161,19 @@ void MT_MSG_free(struct mt_msg *pMsg)
         pMsg->pListNext = NULL;
     }
 
+    /* drop our reference, the last one releases the message */
+    /* only a holder can share, so one reference cannot grow */
+    if(pMsg->n_refs > 1)
+    {
+        MUTEX_lock(mt_msg_pool_mutex, -1);
+        n_refs = --(pMsg->n_refs);
+        MUTEX_unLock(mt_msg_pool_mutex);
+        if(n_refs > 0)
+        {
+            return;
+        }
+    }
+
     /* and the srsp for this message */
     if(pMsg->pSrsp)
     {
@@ -806,9 +1181,14 @@ void MT_MSG_free(struct mt_msg *pMsg)
         pMsg->pSrsp = NULL;
     }
 
-    /* make it unusable. */
-    memset((void *)(pMsg), 0, sizeof(*pMsg));
-    free((void *)pMsg);
+    /* back to the pool */
+    pShared = mt_msg_pool_put(pMsg);
+
+    /* was this the last reference to a shared io buffer? */
+    if(pShared)
+    {
+        MT_MSG_free(pShared);
+    }
 }
 
 /*!
@@ -852,9 +1232,9 @@ static void MT_MSG_resetMsg(struct mt_msg *pMsg, int len, int cmd0, int cmd1)
            *len* = provided
             1 = checksum
           ======
-            5 + len
+            6 + len
         */
-        if((len + 5) > sizeof(pMsg->iobuf))
+        if((len + 6) > pMsg->iobuf_idx_max)
         {
             BUG_HERE("msg too big\n");
         }
@@ -870,8 +1250,9 @@ struct mt_msg *MT_MSG_alloc(int len, int cmd0, int cmd1)
 {
     struct mt_msg *pMsg;
 
-    /* get memory */
-    pMsg = calloc(1, sizeof(*pMsg));
+    /* get memory, see MT_MSG_resetMsg() for the +6 */
+    pMsg = mt_msg_pool_get(mt_msg_pool_which((len < 0) ? -1 : (len + 6)),
+                           NULL);
     if(pMsg == NULL)
     {
         BUG_HERE("no memory\n");
@@ -882,8 +1263,6 @@ struct mt_msg *MT_MSG_alloc(int len, int cmd0, int cmd1)
     {
         pMsg->sequence_id = msg_sequence_counter++;
         pMsg->check_ptr = &(msg_check_value);
-        /* current implimentation is a u8 array local to the struct */
-        pMsg->iobuf_idx_max = sizeof(pMsg->iobuf);
 
         MT_MSG_resetMsg(pMsg, len, cmd0, cmd1);
     }
@@ -900,8 +1279,32 @@ struct mt_msg *MT_MSG_clone(struct mt_msg *pOrig)
     struct mt_msg_interface *pMI;;
     struct mt_msg *pClone;
     int save_id;
+    int nbytes;
+    int nused;
+
+    /* how much of the io buffer is used? */
+    nused = pOrig->iobuf_nvalid;
+    if(pOrig->iobuf_idx > nused)
+    {
+        nused = pOrig->iobuf_idx;
+    }
+    if(nused > pOrig->iobuf_idx_max)
+    {
+        nused = pOrig->iobuf_idx_max;
+    }
+
+    /* and how big must the clone be? see MT_MSG_resetMsg() for the +6 */
+    nbytes = -1;
+    if(pOrig->expected_len >= 0)
+    {
+        nbytes = pOrig->expected_len + 6;
+        if(nused > nbytes)
+        {
+            nbytes = nused;
+        }
+    }
 
-    pClone = MT_MSG_alloc(pOrig->expected_len, pOrig->cmd0, pOrig->cmd1);
+    pClone = mt_msg_pool_get(mt_msg_pool_which(nbytes), NULL);
     if(pClone == NULL)
     {
         MT_MSG_log(LOG_ERROR, pOrig, "clone failed no memory\n");
@@ -909,7 +1312,7 @@ struct mt_msg *MT_MSG_clone(struct mt_msg *pOrig)
     }
 
     /* save this */
-    save_id = pClone->sequence_id;
+    save_id = msg_sequence_counter++;
 
     /* make sure it has an interface of some type */
     pMI = pOrig->pSrcIface;
@@ -928,7 +1331,31 @@ struct mt_msg *MT_MSG_clone(struct mt_msg *pOrig)
         pOrig->sequence_id,
         save_id);
 
-    *pClone = *pOrig;
+    {
+        uint8_t *pBuf;
+        int bufsize;
+        enum mt_msg_pool_class which;
+
+        /* the io buffer belongs to the clone */
+        pBuf = pClone->iobuf;
+        bufsize = pClone->iobuf_idx_max;
+        which = pClone->pool_class;
+
+        *pClone = *pOrig;
+
+        pClone->iobuf = pBuf;
+        pClone->iobuf_idx_max = bufsize;
+        pClone->pool_class = which;
+        pClone->n_refs = 1;
+        /* a clone of a share is not shared */
+        pClone->pShared = NULL;
+
+        /* only copy what is used */
+        if(nused > 0)
+        {
+            memcpy((void *)(pClone->iobuf), (void *)(pOrig->iobuf), nused);
+        }
+    }
     pClone->sequence_id = save_id;
 
     if(pClone->pSrsp)
@@ -945,19 +1372,74 @@ struct mt_msg *MT_MSG_clone(struct mt_msg *pOrig)
 }
 
 /*
- * @brief Transmit a message
- * @param pMsg - the message t transmit
- * @returns number of messages transmitteed (1=success)
- */
-static int MT_MSG_tx_raw(struct mt_msg *pMsg)
+  Share a message
+
+  Public function defined in mt_msg
+*/
+struct mt_msg *MT_MSG_share(struct mt_msg *pOrig)
 {
-    int r;
+    struct mt_msg *pOwner;
+    struct mt_msg *pShare;
+
+    /* a share of a share refers to the same io buffer */
+    pOwner = pOrig->pShared ? pOrig->pShared : pOrig;
+
+    pShare = mt_msg_pool_get(MT_MSG_POOL_share, pOwner);
+    if(pShare == NULL)
+    {
+        MT_MSG_log(LOG_ERROR, pOrig, "share failed no memory\n");
+        return (NULL);
+    }
+
+    *pShare = *pOrig;
+    pShare->sequence_id = msg_sequence_counter++;
+    pShare->pool_class = MT_MSG_POOL_share;
+    pShare->n_refs = 1;
+    pShare->pShared = pOwner;
+    pShare->pSrsp = NULL;
+    pShare->pListNext = NULL;
+    pShare->was_formatted = false;
+
+    /* locally built messages have their payload where the */
+    /* destination interface wants it, see init_wr_idx() */
+    if(pShare->pSrcIface == NULL)
+    {
+        pShare->pSrcIface = pShare->pDestIface;
+    }
+    if(pShare->pSrcIface == NULL)
+    {
+        FATAL_printf("this message has no interface\n");
+    }
+
+    if(pShare->expected_len < 0)
+    {
+        pShare->expected_len =
+            pShare->iobuf_idx - mt_msg_hdr_len(pShare->pSrcIface);
+    }
+
+    LOG_printf(LOG_DBG_MT_MSG_traffic,
+        "MT_MSG: share(%s, id: %d) to: id: %d\n",
+        pShare->pSrcIface->dbg_name,
+        pOrig->sequence_id,
+        pShare->sequence_id);
 
-    /* insert frame sync, cmd0/1 and checksum */
-    MT_MSG_format_msg(pMsg);
+    return (pShare);
+}
 
+/*
+ * @brief Log a frame that is about to be transmitted
+ * @param pMsg - the message
+ * @param pFrame - the frame
+ * @param nbytes - size of the frame
+ */
+static void MT_MSG_tx_log(struct mt_msg *pMsg,
+                          const uint8_t *pFrame,
+                          int nbytes)
+{
     LOG_lock();
-    MT_MSG_dbg_decode(pMsg, pMsg->pDestIface, ALL_MT_MSG_DBG);
+    MT_MSG_dbg_decode(pMsg,
+                      pMsg->pShared ? pMsg->pSrcIface : pMsg->pDestIface,
+                      ALL_MT_MSG_DBG);
 
     MT_MSG_log(LOG_DBG_MT_MSG_traffic, pMsg, "%s: TX Msg (start) [%s]\n",
                pMsg->pDestIface->dbg_name,
@@ -967,23 +1449,59 @@ static int MT_MSG_tx_raw(struct mt_msg *pMsg)
     {
         LOG_printf(LOG_DBG_MT_MSG_raw, "%s: TX %d bytes\n",
                    pMsg->pDestIface->dbg_name,
-                   pMsg->iobuf_nvalid);
-        LOG_hexdump(LOG_DBG_MT_MSG_raw, 0, pMsg->iobuf, pMsg->iobuf_nvalid);
+                   nbytes);
+        LOG_hexdump(LOG_DBG_MT_MSG_raw, 0, pFrame, nbytes);
     }
     LOG_unLock();
+}
+
+/*
+ * @brief Transmit a message
+ * @param pMsg - the message t transmit
+ * @returns number of messages transmitteed (1=success)
+ */
+static int MT_MSG_tx_raw(struct mt_msg *pMsg)
+{
+    uint8_t *pFrame;
+    int nbytes;
+    int r;
+
+    if(pMsg->pShared)
+    {
+        /* the frame is built in the interface, the payload is shared */
+        nbytes = MT_MSG_format_shared(pMsg);
+        if(nbytes < 0)
+        {
+            return (0);
+        }
+        pFrame = pMsg->pDestIface->pTxFrame;
+    }
+    else
+    {
+        /* insert frame sync, cmd0/1 and checksum */
+        MT_MSG_format_msg(pMsg);
+        pFrame = pMsg->iobuf;
+        nbytes = pMsg->iobuf_nvalid;
+    }
+
+    MT_MSG_tx_log(pMsg, pFrame, nbytes);
 
     /* send the bytes */
     r = STREAM_wrBytes(pMsg->pDestIface->hndl,
-                        (void *)(pMsg->iobuf),
-                        pMsg->iobuf_nvalid, -1);
+                        (void *)(pFrame),
+                        nbytes, -1);
 
     LOG_printf(LOG_DBG_MT_MSG_traffic,
                 "%s: TX Msg (Complete) r=%d [%s]\n",
                 pMsg->pDestIface->dbg_name, r,
                 pMsg->pLogPrefix);
     /* great success? */
-    if(r == pMsg->iobuf_nvalid)
+    if(r == nbytes)
     {
+        MT_MSG_stamp(pMsg, MT_MSG_STAMP_tx_done);
+        MT_MSG_CAPTURE_frame(pMsg->pDestIface, MT_MSG_CAPTURE_tx,
+                             pFrame, nbytes,
+                             pMsg->stamp_nSecs[MT_MSG_STAMP_tx_done]);
         /* we transmitted 1 message */
         return (1);
     }
@@ -1072,21 +1590,79 @@ static void send_frag_abort_outoforder(struct mt_msg_interface *pMI,
 }
 
 /*!
- * @brief Wait for the fragment ack to occur (or a timeout, or an error)
- * @param pMI - the interface in use
- * @return 0 on succes
+ * @brief Is this block marked in the block map?
+ * @param pFI - the fragment info (tx or rx)
+ * @param block - the block number
+ * @return true if marked
  */
-static int wait_for_frag_ack(struct mt_msg_interface *pMI)
+static bool frag_block_is_done(struct mt_msg_iface_frag_info *pFI, int block)
+{
+    return ((pFI->block_map[ block / 8 ] & (1 << (block % 8))) != 0);
+}
+
+/*!
+ * @brief Mark a block in the block map, and count it.
+ * @param pFI - the fragment info (tx or rx)
+ * @param block - the block number
+ */
+static void frag_block_set_done(struct mt_msg_iface_frag_info *pFI, int block)
+{
+    if(!frag_block_is_done(pFI, block))
+    {
+        pFI->block_map[ block / 8 ] |= (uint8_t)(1 << (block % 8));
+        pFI->block_done++;
+    }
+}
+
+/*!
+ * @brief Clear the block map for a new transfer
+ * @param pFI - the fragment info (tx or rx)
+ */
+static void frag_block_reset(struct mt_msg_iface_frag_info *pFI)
+{
+    memset((void *)(pFI->block_map), 0, sizeof(pFI->block_map));
+    pFI->block_done = 0;
+    pFI->n_resent = 0;
+}
+
+/*!
+ * @brief Throw away any fragment acks left over from a prior transfer
+ * @param pMI - the interface in use
+ */
+static void frag_ack_flush(struct mt_msg_interface *pMI)
 {
-    int r;
     struct mt_msg *pAck;
-    int ack_block;
-    int ack_status;
+
+    MUTEX_lock(pMI->list_lock, -1);
+    pAck = pMI->tx_frag.pTxFragAck;
+    pMI->tx_frag.pTxFragAck = NULL;
+    MUTEX_unLock(pMI->list_lock);
+
+    /* this releases the whole list */
+    MT_MSG_free(pAck);
+
+    while(SEMAPHORE_waitWithTimeout(pMI->tx_frag.tx_ack_semaphore, 0) == 1)
+    {
+        ;
+    }
+}
+
+/*!
+ * @brief Get the next fragment ack from the remote
+ * @param pMI - the interface in use
+ * @param pBlock - the acked block number is put here
+ * @param pStatus - the ack status is put here
+ * @return 1 if an ack was received, 0 on timeout, -1 if the ack is bad
+ */
+static int get_frag_ack(struct mt_msg_interface *pMI,
+                        int *pBlock,
+                        int *pStatus)
+{
+    struct mt_msg *pAck;
+    int r;
 
     /* Fragments are like sreq/srsp... */
     /* so we use the srsp timeout here */
-    LOG_printf(LOG_DBG_MT_MSG_traffic, "Waiting for frag-ack\n");
-try_again:
     SEMAPHORE_waitWithTimeout(pMI->tx_frag.tx_ack_semaphore,
                               pMI->srsp_timeout_mSecs);
 
@@ -1095,26 +1671,60 @@ try_again:
     if(pAck)
     {
         pMI->tx_frag.pTxFragAck = pAck->pListNext;
+        /* MT_MSG_free() would release the rest of the list */
+        pAck->pListNext = NULL;
     }
     MUTEX_unLock(pMI->list_lock);
 
     if(pAck == NULL)
     {
         LOG_printf(LOG_DBG_MT_MSG_traffic, "timeout: frag-ack\n");
-        /* no response */
-        /* we send the current block again. */
-        /* do not advance */
-        r = 0;
-        goto done;
+        return (0);
     }
 
     /* ignore the extended version byte */
     MT_MSG_rdU8(pAck);
     /* read blocknumber */
-    ack_block = MT_MSG_rdU8(pAck);
-    ack_status = MT_MSG_rdU8(pAck);
+    *pBlock = MT_MSG_rdU8(pAck);
+    *pStatus = MT_MSG_rdU8(pAck);
     MT_MSG_parseComplete(pAck);
+    r = 1;
     if(pAck->is_error)
+    {
+        r = -1;
+    }
+    else if(*pStatus != MT_MSG_FRAG_STATUS_success)
+    {
+        MT_MSG_log(LOG_DBG_MT_MSG_traffic, pAck,
+                   "block:%d, ack status: %d\n", *pBlock, *pStatus);
+    }
+    MT_MSG_free(pAck);
+    return (r);
+}
+
+/*!
+ * @brief Wait for the fragment ack to occur (or a timeout, or an error)
+ * @param pMI - the interface in use
+ * @return 0 on succes
+ */
+static int wait_for_frag_ack(struct mt_msg_interface *pMI)
+{
+    int r;
+    int ack_block;
+    int ack_status;
+
+    LOG_printf(LOG_DBG_MT_MSG_traffic, "Waiting for frag-ack\n");
+try_again:
+    r = get_frag_ack(pMI, &ack_block, &ack_status);
+    if(r == 0)
+    {
+        /* no response */
+        /* we send the current block again. */
+        /* do not advance */
+        goto done;
+    }
+
+    if(r < 0)
     {
         /* we are toast.. */
         /* out of sequence abort */
@@ -1161,18 +1771,13 @@ try_again:
     }
 
     pMI->tx_frag.is_error = true;
-    MT_MSG_log(LOG_ERROR, pAck, "block:%d, bad ack status: %d\n",
-               ack_block, ack_status);
+    LOG_printf(LOG_ERROR, "%s: block:%d, bad ack status: %d\n",
+               pMI->dbg_name, ack_block, ack_status);
     /* we don't understand the status.. */
     send_frag_abort_outoforder(pMI, &(pMI->tx_frag));
     /* do not advance */
     r = 0;
 done:
-    if(pAck)
-    {
-        MT_MSG_free(pAck);
-        pAck = NULL;
-    }
     return (r);
 }
 
@@ -1269,6 +1874,174 @@ static int frag_txrx_one_block(struct mt_msg_interface *pMI)
     return (r);
 }
 
+/*!
+ * @brief Resend a fragment block that has not been acked
+ * @param pMI - interface to handle the fragment block
+ * @param block - the block to resend
+ */
+static void frag_tx_resend_block(struct mt_msg_interface *pMI, int block)
+{
+    LOG_printf(LOG_DBG_MT_MSG_traffic, "TX: %s:(frag) resend block: %d\n",
+        pMI->dbg_name, block + 1);
+    pMI->tx_frag.block_cur = block;
+    pMI->tx_frag.n_resent++;
+    frag_tx_one_block(pMI);
+}
+
+/*!
+ * @brief Transmit all blocks, with several blocks in flight
+ * @param pMI - interface to handle the fragment blocks
+ *
+ * Up to tx_frag_window blocks are sent ahead of the oldest unacked
+ * block. Each ack marks its own block as done. An ack for a later
+ * block means an earlier block was lost, so only the missing blocks
+ * are sent again. On a timeout, every unacked block is sent again.
+ *
+ * Sets "is_error" if we should abandon
+ *
+ * @return true if the remote rejected a block as out of order, it only
+ *         does stop-and-wait, so the transfer must start over
+ */
+static bool frag_tx_windowed(struct mt_msg_interface *pMI)
+{
+    struct mt_msg_iface_frag_info *pFI;
+    int base;
+    int next;
+    int fast_mark;
+    int trynum;
+    int ack_block;
+    int ack_status;
+    int x;
+    int r;
+
+    pFI = &(pMI->tx_frag);
+
+    /* oldest block not acked yet */
+    base = 0;
+    /* next block never sent */
+    next = 0;
+    /* acks for blocks before this say nothing about our last resend */
+    fast_mark = 0;
+    trynum = 0;
+
+    while(base < pFI->block_count)
+    {
+        /* fill the window */
+        while((next < pFI->block_count) &&
+              (next < (base + pMI->tx_frag_window)))
+        {
+            pFI->block_cur = next;
+            frag_tx_one_block(pMI);
+            next++;
+        }
+
+        r = get_frag_ack(pMI, &ack_block, &ack_status);
+        if(r == 0)
+        {
+            trynum++;
+            if(trynum >= pMI->retry_max)
+            {
+                LOG_printf(LOG_ERROR, "%s: frag: no ack for block %d\n",
+                           pMI->dbg_name, base + 1);
+                pFI->is_error = true;
+                break;
+            }
+            /* resend everything in flight that is not acked */
+            for(x = base ; x < next ; x++)
+            {
+                if(!frag_block_is_done(pFI, x))
+                {
+                    frag_tx_resend_block(pMI, x);
+                }
+            }
+            fast_mark = next;
+            continue;
+        }
+
+        if(r < 0)
+        {
+            /* out of sequence abort */
+            pFI->is_error = true;
+            break;
+        }
+
+        if((ack_block < base) || (ack_block >= next))
+        {
+            /* late duplicate, or not something we sent */
+            LOG_printf(LOG_DBG_MT_MSG_traffic,
+                       "Received ack for block %d, window: %d..%d\n",
+                       ack_block, base, next - 1);
+            continue;
+        }
+
+        if(ack_status == MT_MSG_FRAG_STATUS_resend_last)
+        {
+            trynum++;
+            if(trynum >= pMI->retry_max)
+            {
+                pFI->is_error = true;
+                break;
+            }
+            frag_tx_resend_block(pMI, ack_block);
+            continue;
+        }
+
+        if((ack_status == MT_MSG_FRAG_STATUS_success) ||
+           ((ack_status == MT_MSG_FRAG_STATUS_frag_complete) &&
+            ((ack_block + 1) == pFI->block_count)))
+        {
+            trynum = 0;
+            frag_block_set_done(pFI, ack_block);
+
+            /* selective resend of the blocks the remote skipped */
+            /* a block is only taken as lost once 2 later blocks are acked */
+            if(ack_block >= fast_mark)
+            {
+                for(x = base ; (x + 2) <= ack_block ; x++)
+                {
+                    if(!frag_block_is_done(pFI, x))
+                    {
+                        frag_tx_resend_block(pMI, x);
+                        fast_mark = next;
+                    }
+                }
+            }
+
+            /* slide the window */
+            while((base < pFI->block_count) && frag_block_is_done(pFI, base))
+            {
+                base++;
+            }
+            continue;
+        }
+
+        if(ack_status == MT_MSG_FRAG_STATUS_block_out_of_order)
+        {
+            /* the remote only does stop-and-wait, it dropped the transfer */
+            LOG_printf(LOG_ERROR,
+                       "%s: remote rejected frag window %d, using 1\n",
+                       pMI->dbg_name, pMI->tx_frag_window);
+            pMI->tx_frag_window = 1;
+            return (true);
+        }
+
+        LOG_printf(LOG_ERROR, "%s: block:%d, bad ack status: %d\n",
+                   pMI->dbg_name, ack_block, ack_status);
+        /* we don't understand the status.. */
+        send_frag_abort_outoforder(pMI, pFI);
+        pFI->is_error = true;
+        break;
+    }
+
+    /* for the extended status */
+    pFI->block_cur = pFI->block_count;
+    LOG_printf(LOG_DBG_MT_MSG_traffic,
+               "%s: frag: %d blocks, %d resent, window: %d\n",
+               pMI->dbg_name, pFI->block_count, pFI->n_resent,
+               pMI->tx_frag_window);
+    return (false);
+}
+
 /*!
  * @brief Chop up, loop over, and transmit a message via fragmentation
  * @param pMsg - msg to transmit
@@ -1291,6 +2064,10 @@ static int MT_MSG_tx_fragment(struct mt_msg *pMsg)
         (pMsg->expected_len + pMI->tx_frag.this_frag_size - 1) /
         pMI->tx_frag.this_frag_size;
 
+    frag_block_reset(&(pMI->tx_frag));
+    /* acks from an older transfer must not be taken as ours */
+    frag_ack_flush(pMI);
+
     pMI->tx_frag.pTxFragData = MT_MSG_alloc(-1,
                                              pMsg->cmd0 | _bit7,
                                              pMsg->cmd1);
@@ -1299,25 +2076,42 @@ static int MT_MSG_tx_fragment(struct mt_msg *pMsg)
         MT_MSG_log(LOG_ERROR, pMsg, "no memory to fragment\n");
         pMI->tx_frag.is_error = true;
     }
+    else if(pMI->tx_frag.block_count > MT_MSG_FRAG_MAX_BLOCKS)
+    {
+        /* the block number is a byte */
+        MT_MSG_log(LOG_ERROR, pMsg, "too many fragments: %d\n",
+                   pMI->tx_frag.block_count);
+        pMI->tx_frag.is_error = true;
+    }
     else
     {
-        /* for each block.. */
-        r = 0;
-        for(pMI->tx_frag.block_cur = 0;
-            pMI->tx_frag.block_cur < pMI->tx_frag.block_count;
-                pMI->tx_frag.block_cur += r)
+        if((pMI->tx_frag_window > 1) && frag_tx_windowed(pMI))
         {
+            /* start over, one block at a time */
+            frag_block_reset(&(pMI->tx_frag));
+            frag_ack_flush(pMI);
+        }
 
-            if(pMI->tx_frag.is_error)
+        if(pMI->tx_frag_window == 1)
+        {
+            /* for each block.. */
+            r = 0;
+            for(pMI->tx_frag.block_cur = 0;
+                pMI->tx_frag.block_cur < pMI->tx_frag.block_count;
+                    pMI->tx_frag.block_cur += r)
             {
-                break;
-            }
 
-            /* transfer the block */
-            r = frag_txrx_one_block(pMI);
-            /* this returns: */
-            /* 0 - resend current block */
-            /* or +1 to send the next block */
+                if(pMI->tx_frag.is_error)
+                {
+                    break;
+                }
+
+                /* transfer the block */
+                r = frag_txrx_one_block(pMI);
+                /* this returns: */
+                /* 0 - resend current block */
+                /* or +1 to send the next block */
+            }
         }
     }
 
@@ -1346,7 +2140,7 @@ static int MT_MSG_tx_fragment(struct mt_msg *pMsg)
 
     /* cleanup */
     pMI->tx_frag.pMsg = NULL;
-    pMI->tx_frag.pTxFragAck = NULL;
+    frag_ack_flush(pMI);
 
     if(pMI->tx_frag.pTxFragData)
     {
@@ -1364,6 +2158,8 @@ static int MT_MSG_tx_fragment(struct mt_msg *pMsg)
  */
 static int MT_MSG_tx(struct mt_msg *pMsg)
 {
+    struct mt_msg *pCopy;
+    int nbytes;
     int r;
     /* Set the message type */
     MT_MSG_set_type(pMsg, pMsg->pDestIface);
@@ -1383,9 +2179,29 @@ static int MT_MSG_tx(struct mt_msg *pMsg)
     }
     else
     {
-        if((pMsg->iobuf_nvalid > 256) ||
-            (pMsg->iobuf_nvalid >= pMsg->pDestIface->tx_frag_size))
+        nbytes = pMsg->iobuf_nvalid;
+        if(pMsg->pShared)
+        {
+            /* the size as framed for the destination */
+            nbytes = mt_msg_hdr_len(pMsg->pDestIface) + pMsg->expected_len;
+        }
+        if((nbytes > 256) ||
+            (nbytes >= pMsg->pDestIface->tx_frag_size))
         {
+            if(pMsg->pShared)
+            {
+                /* fragments are sent from a private copy */
+                pCopy = MT_MSG_clone(pMsg);
+                if(pCopy == NULL)
+                {
+                    r = 0;
+                    goto done;
+                }
+                MT_MSG_reformat(pCopy);
+                r = MT_MSG_tx_fragment(pCopy);
+                MT_MSG_free(pCopy);
+                goto done;
+            }
             /* yes, we fragment */
             r = MT_MSG_tx_fragment(pMsg);
             goto done;
@@ -1397,347 +2213,1030 @@ done:
     return (r);
 }
 
-/*
-  release resources for this message interface
-  see mt_msg.h
-*/
-void MT_MSG_interfaceDestroy(struct mt_msg_interface *pMI)
+/*!
+ * @brief Complete an async request, and release the message.
+ * @param pMsg - the message
+ * @param result - the result from MT_MSG_txrx()
+ */
+static void mt_msg_async_complete(struct mt_msg *pMsg, int result)
 {
-    if(pMI == NULL)
+    if(result != 2)
     {
-        return;
+        MT_MSG_log(LOG_DBG_MT_MSG_traffic, pMsg,
+                   "async complete, result: %d\n", result);
+    }
+    if(pMsg->pAsyncDone)
+    {
+        (*(pMsg->pAsyncDone))(pMsg, result, pMsg->async_cookie);
     }
+    MT_MSG_free(pMsg);
+}
 
-    LOG_printf(LOG_DBG_MT_MSG_traffic,
-               "%s: Destroy interface\n", pMI->dbg_name);
-    pMI->is_dead = true;
+/*!
+ * @brief Is this slot claimed for the same subsystem and cmd1 as the message?
+ * @param pSlot - the slot
+ * @param pMsg - the message
+ * @returns true if they match
+ */
+static bool mt_msg_sreq_same_cmd(struct mt_msg_sreq_slot *pSlot,
+                                 struct mt_msg *pMsg)
+{
+    /* Upper bits[7:5] = message type */
+    /* Lower bits[4:0] = subsystem number */
+    /* We only care about the subsystem number */
+    return ((pSlot->subsys == _bitsXYof(pMsg->cmd0, 4, 0)) &&
+            (pSlot->cmd1 == pMsg->cmd1));
+}
 
-    /* kill off any messages we have in process */
-    if(pMI->pCurRxMsg)
+/*!
+ * @brief Is this slot in use? A stale slot expires here.
+ * @param pMI - the interface
+ * @param pSlot - the slot
+ * @returns true if in use
+ *
+ * The list lock must be held.
+ */
+static bool mt_msg_sreq_busy(struct mt_msg_interface *pMI,
+                             struct mt_msg_sreq_slot *pSlot)
+{
+    if(pSlot->pSreq)
+    {
+        return (true);
+    }
+    if(pSlot->is_stale &&
+       ((int)(TIMER_getNow() - pSlot->t_stale) >= pMI->srsp_timeout_mSecs))
     {
-        MT_MSG_free(pMI->pCurRxMsg);
-        pMI->pCurRxMsg = NULL;
+        /* the remote never answered */
+        pSlot->is_stale = false;
+        SEMAPHORE_put(pMI->sreq_free_semaphore);
     }
+    return (pSlot->is_stale);
+}
 
-    /* close our connection */
-    if(pMI->hndl)
+/*!
+ * @brief Claim a free slot for this sreq
+ * @param pMI - the interface
+ * @param pSlot - the slot
+ * @param pMsg - the sreq
+ *
+ * The list lock must be held.
+ */
+static void mt_msg_sreq_take(struct mt_msg_interface *pMI,
+                             struct mt_msg_sreq_slot *pSlot,
+                             struct mt_msg *pMsg)
+{
+    pSlot->pSreq = pMsg;
+    pSlot->subsys = _bitsXYof(pMsg->cmd0, 4, 0);
+    pSlot->cmd1 = pMsg->cmd1;
+    pSlot->is_stale = false;
+    pSlot->is_async = false;
+    pSlot->order = pMI->sreq_order++;
+    /* discard any stale completion */
+    while(SEMAPHORE_waitWithTimeout(pSlot->done_semaphore, 0) == 1)
     {
-        STREAM_close(pMI->hndl);
-        /* is this a socket connection? */
-        if(pMI->s_cfg)
+        ;
+    }
+}
+
+/*!
+ * @brief Find the in-flight sreq for this srsp, and attach the srsp.
+ * @param pMI - the interface
+ * @param pRxMsg - the srsp we received
+ * @returns NULL if not found, otherwise the slot of the sreq
+ *
+ * The remote answers in order, so the srsp belongs to the oldest
+ * claim with the same command. If that claim is stale, its sender
+ * gave up, the srsp is released here.
+ *
+ * The done semaphore is posted while holding the list lock so that
+ * a late post cannot be seen by the next owner of the slot.
+ */
+static struct mt_msg_sreq_slot *mt_msg_sreq_match(
+    struct mt_msg_interface *pMI,
+    struct mt_msg *pRxMsg)
+{
+    struct mt_msg_sreq_slot *pSlot;
+    struct mt_msg_sreq_slot *pS;
+    struct mt_msg *pAsync;
+    uint64_t t_sent;
+    bool is_late;
+    int x;
+
+    pSlot = NULL;
+    pAsync = NULL;
+    t_sent = 0;
+    is_late = false;
+
+    MUTEX_lock(pMI->list_lock, -1);
+    for(x = 0 ; x < MT_MSG_SREQ_MAX_INFLIGHT ; x++)
+    {
+        pS = &(pMI->sreq_table[x]);
+        if(pS->pSreq)
         {
-            if(pMI->s_cfg->ascp == 'c')
-            {
-                SOCKET_CLIENT_destroy(pMI->hndl);
-            }
-            else
+            /* already answered? */
+            if(pS->pSreq->pSrsp)
             {
-                SOCKET_SERVER_destroy(pMI->hndl);
+                continue;
             }
         }
-        pMI->hndl = 0;
+        else if(!(pS->is_stale))
+        {
+            continue;
+        }
+        if(!mt_msg_sreq_same_cmd(pS, pRxMsg))
+        {
+            continue;
+        }
+        /* the oldest is answered first */
+        if((pSlot == NULL) || ((int)(pS->order - pSlot->order) < 0))
+        {
+            pSlot = pS;
+        }
     }
 
-    /* and our rx thread */
-    if(pMI->rx_thread)
+    if(pSlot && (pSlot->pSreq == NULL))
     {
-        THREAD_destroy(pMI->rx_thread);
-        pMI->rx_thread = 0;
+        /* the answer to an sreq that timed out */
+        pSlot->is_stale = false;
+        is_late = true;
+        SEMAPHORE_put(pMI->sreq_free_semaphore);
     }
-
-    /* any pending message are tossed */
-    MT_MSG_LIST_destroy(&(pMI->rx_list));
-
-    /* our lock */
-    if(pMI->list_lock)
+    else if(pSlot)
     {
-        MUTEX_destroy(pMI->list_lock);
-        pMI->list_lock = 0;
+        /* attach it to the request */
+        t_sent = pSlot->pSreq->stamp_nSecs[MT_MSG_STAMP_tx_done];
+        pSlot->pSreq->pSrsp = pRxMsg;
+        if(pSlot->is_async)
+        {
+            /* nobody waits, it is completed here */
+            pAsync = pSlot->pSreq;
+            pSlot->pSreq = NULL;
+            pSlot->is_async = false;
+            SEMAPHORE_put(pMI->sreq_free_semaphore);
+        }
+        else
+        {
+            SEMAPHORE_put(pSlot->done_semaphore);
+        }
     }
+    MUTEX_unLock(pMI->list_lock);
 
-    /* our SREQ/SRSP semaphore */
-    if(pMI->srsp_semaphore)
+    if(is_late)
     {
-        SEMAPHORE_destroy(pMI->srsp_semaphore);
-        pMI->srsp_semaphore = 0;
+        MT_MSG_log(LOG_ERROR, pRxMsg, "late srsp, discarded\n");
+        MT_MSG_free(pRxMsg);
+        return (pSlot);
     }
 
-    /* our fragmentation semaphore */
-    if(pMI->tx_frag.tx_ack_semaphore)
+    /* the sreq is not ours, it might be gone already */
+    MT_MSG_LAT_add(pMI, MT_MSG_LAT_srsp,
+                   t_sent, pRxMsg->stamp_nSecs[MT_MSG_STAMP_rx_frame]);
+
+    if(pSlot == NULL)
     {
-        SEMAPHORE_destroy(pMI->tx_frag.tx_ack_semaphore);
-        pMI->tx_frag.tx_ack_semaphore = 0;
+        MT_MSG_log(LOG_DBG_MT_MSG_traffic, pRxMsg, "no matching sreq?\n");
     }
-
-    if(pMI->tx_lock)
+    if(pAsync)
     {
-        MUTEX_destroy(pMI->tx_lock);
-        pMI->tx_lock = 0;
+        mt_msg_async_complete(pAsync, 2);
     }
+    return (pSlot);
+}
 
-    /* Any pending sreq is dead */
-    MT_MSG_free(pMI->pCurSreq);
-    pMI->pCurSreq = NULL;
+/*!
+ * @brief Claim a slot in the in-flight sreq table for this message
+ * @param pMI - the interface
+ * @param pMsg - the sreq to send
+ * @param timeout_mSecs - how long to wait for a slot
+ * @returns NULL on timeout, otherwise the slot
+ *
+ * A slot is available if fewer than sreq_max_inflight are in use.
+ * On success the tx_lock is held, the caller transmits and unlocks,
+ * so the claim order is the order on the wire.
+ */
+static struct mt_msg_sreq_slot *mt_msg_sreq_claim(
+    struct mt_msg_interface *pMI,
+    struct mt_msg *pMsg,
+    int timeout_mSecs)
+{
+    struct mt_msg_sreq_slot *pSlot;
+    unsigned tStart;
+    int nbusy;
+    int x;
+    int r;
 
-    /* we do *NOT* zap (zero) the interface. */
-    /* The caller may need to release destroy the handle. */
+    tStart = TIMER_getNow();
+    for(;;)
+    {
+        r = timeout_mSecs - (int)(TIMER_getNow() - tStart);
+        if(r <= 0)
+        {
+            return (NULL);
+        }
+        if(MUTEX_lock(pMI->tx_lock, r) != 0)
+        {
+            return (NULL);
+        }
+
+        pSlot = NULL;
+        nbusy = 0;
+
+        MUTEX_lock(pMI->list_lock, -1);
+        for(x = 0 ; x < MT_MSG_SREQ_MAX_INFLIGHT ; x++)
+        {
+            if(mt_msg_sreq_busy(pMI, &(pMI->sreq_table[x])))
+            {
+                nbusy++;
+            }
+            else if(pSlot == NULL)
+            {
+                pSlot = &(pMI->sreq_table[x]);
+            }
+        }
+        if(nbusy >= pMI->sreq_max_inflight)
+        {
+            pSlot = NULL;
+        }
+        if(pSlot)
+        {
+            mt_msg_sreq_take(pMI, pSlot, pMsg);
+        }
+        MUTEX_unLock(pMI->list_lock);
+
+        if(pSlot)
+        {
+            return (pSlot);
+        }
+        MUTEX_unLock(pMI->tx_lock);
+
+        /* wait for a slot to be released */
+        r = timeout_mSecs - (int)(TIMER_getNow() - tStart);
+        if(r <= 0)
+        {
+            return (NULL);
+        }
+        /* a release might wake some other waiter, so poll as well */
+        if(r > 10)
+        {
+            r = 10;
+        }
+        SEMAPHORE_waitWithTimeout(pMI->sreq_free_semaphore, r);
+    }
+}
+
+/*!
+ * @brief Release a slot in the in-flight sreq table.
+ * @param pMI - the interface
+ * @param pSlot - the slot to release
+ * @param was_sent - true if the sreq went out on the wire
+ *
+ * An sreq that was sent but not answered leaves the slot stale,
+ * see mt_msg_sreq_match()
+ */
+static void mt_msg_sreq_release(struct mt_msg_interface *pMI,
+                                struct mt_msg_sreq_slot *pSlot,
+                                bool was_sent)
+{
+    MUTEX_lock(pMI->list_lock, -1);
+    if(was_sent && (pSlot->pSreq->pSrsp == NULL))
+    {
+        pSlot->is_stale = true;
+        pSlot->t_stale = TIMER_getNow();
+    }
+    pSlot->pSreq = NULL;
+    MUTEX_unLock(pMI->list_lock);
+    SEMAPHORE_put(pMI->sreq_free_semaphore);
 }
 
 /*!
- * @brief Read N bytes from the interface and insert into the message
- * @param pMsg - the message to insert into
- * @param n - how many bytes we need
- * @param timeout_mSecs - how long to wait
- * @returns nbytes valid in the rx buffer (total)
+ * @brief Complete async sreqs whose srsp did not arrive in time
+ * @param pMI - the interface
+ * @param all - true: every async sreq, the interface is dying
+ *
+ * The slot is left stale, as for MT_MSG_txrx(), see mt_msg_sreq_release()
  */
-static int mt_msg_rx_bytes(struct mt_msg_interface *pMI,
-                            int n, int timeout_mSecs)
+static void mt_msg_async_expire(struct mt_msg_interface *pMI, bool all)
 {
+    struct mt_msg_sreq_slot *pSlot;
     struct mt_msg *pMsg;
+    int x;
+
+    for(x = 0 ; x < MT_MSG_SREQ_MAX_INFLIGHT ; x++)
+    {
+        pSlot = &(pMI->sreq_table[x]);
+        pMsg = NULL;
+
+        MUTEX_lock(pMI->list_lock, -1);
+        if(pSlot->is_async && pSlot->pSreq &&
+           (all || ((int)(TIMER_getNow() - pSlot->t_sent) >=
+                    pSlot->timeout_mSecs)))
+        {
+            pMsg = pSlot->pSreq;
+            pSlot->pSreq = NULL;
+            pSlot->is_async = false;
+            pSlot->is_stale = true;
+            pSlot->t_stale = TIMER_getNow();
+        }
+        MUTEX_unLock(pMI->list_lock);
+
+        if(pMsg)
+        {
+            SEMAPHORE_put(pMI->sreq_free_semaphore);
+            /* transmitted, nothing received */
+            mt_msg_async_complete(pMsg, 1);
+        }
+    }
+}
+
+/*!
+ * @brief Send an async request, an sreq is completed by its srsp
+ * @param pMsg - the message
+ *
+ * The srsp completes the request on the rx thread, see
+ * mt_msg_sreq_match(), or mt_msg_async_expire() does if it does not come.
+ */
+static void mt_msg_async_send(struct mt_msg *pMsg)
+{
+    struct mt_msg_interface *pMI;
+    struct mt_msg_sreq_slot *pSlot;
+    unsigned tStart;
     int r;
-    int nneed;
 
-    pMsg = pMI->pCurRxMsg;
+    pMI = pMsg->pDestIface;
+    pMsg->pSrsp = NULL;
+    MT_MSG_set_type(pMsg, pMI);
+    if(pMsg->m_type != MT_MSG_TYPE_sreq)
+    {
+        r = MT_MSG_txrx(pMsg);
+        mt_msg_async_complete(pMsg, r);
+        return;
+    }
+
+    /* this also takes the tx_lock, see mt_msg_sreq_claim() */
+    tStart = TIMER_getNow();
+    for(;;)
+    {
+        pSlot = mt_msg_sreq_claim(pMI, pMsg, MT_MSG_ASYNC_EXPIRE_mSecs);
+        if(pSlot)
+        {
+            break;
+        }
+        /* the slots may be held by async sreqs that will not be answered */
+        mt_msg_async_expire(pMI, false);
+        if((int)(TIMER_getNow() - tStart) >= pMI->tx_lock_timeout)
+        {
+            LOG_printf(LOG_ERROR, "%s: sreq slot timeout\n", pMI->dbg_name);
+            MT_MSG_log(LOG_ERROR, pMsg, "sreq slot timeout\n");
+            mt_msg_async_complete(pMsg, 0);
+            return;
+        }
+    }
 
-    /* do we already have enough? */
-    if(pMsg->iobuf_nvalid >= n)
+    /* before sending, the srsp might be very quick */
+    MUTEX_lock(pMI->list_lock, -1);
+    pSlot->is_async = true;
+    pSlot->t_sent = TIMER_getNow();
+    pSlot->timeout_mSecs = pMsg->srsp_timeout_mSecs;
+    if(pSlot->timeout_mSecs <= 0)
     {
-        return (n);
+        pSlot->timeout_mSecs = pMI->srsp_timeout_mSecs;
     }
-    /* how many *MORE* do we need? */
-    nneed = n - pMsg->iobuf_nvalid;
+    MUTEX_unLock(pMI->list_lock);
 
-    /* go read */
-    r = STREAM_rdBytes(pMI->hndl,
-                       pMsg->iobuf + pMsg->iobuf_nvalid,
-                       nneed,
-                       timeout_mSecs);
-    if(r > 0)
+    r = MT_MSG_tx(pMsg);
+    MUTEX_unLock(pMI->tx_lock);
+    if(r == 1)
     {
-        /* great success? */
-        pMsg->iobuf_nvalid += r;
+        /* the message now belongs to the slot */
+        return;
     }
-    if(r <= 0)
+
+    MT_MSG_log(LOG_ERROR,
+               pMsg,
+               "Cannot transmit, result: %d (expected: 1)\n", r);
+    pMsg->is_error = true;
+    MUTEX_lock(pMI->list_lock, -1);
+    pSlot->is_async = false;
+    MUTEX_unLock(pMI->list_lock);
+    mt_msg_sreq_release(pMI, pSlot, false);
+    mt_msg_async_complete(pMsg, 0);
+}
+
+/*!
+ * @brief Async worker thread, sends queued messages
+ * @param cookie - the message interface in disguise
+ * @return nothing important.
+ *
+ * The workers also expire async sreqs, so they wake up now and then.
+ */
+static intptr_t mt_msg_async_thread(intptr_t cookie)
+{
+    struct mt_msg_interface *pMI;
+    struct mt_msg *pMsg;
+
+    pMI = (struct mt_msg_interface *)(cookie);
+    for(;;)
     {
-        if(STREAM_isSocket(pMI->hndl))
+        pMsg = MT_MSG_LIST_remove(pMI, &(pMI->async_list),
+                                  MT_MSG_ASYNC_EXPIRE_mSecs);
+        if(pMI->is_dead)
         {
-            /* did we get a tcpip disconnect? */
-            if(!STREAM_SOCKET_isConnected(pMI->hndl))
+            if(pMsg)
             {
-                LOG_printf(LOG_DBG_MT_MSG_traffic,
-                           "%s: Socket is dead\n",
-                           pMI->dbg_name);
-                pMI->is_dead = true;
+                pMsg->is_error = true;
+                mt_msg_async_complete(pMsg, 0);
             }
+            break;
         }
-        else
+
+        mt_msg_async_expire(pMI, false);
+        if(pMsg == NULL)
         {
-            if(r < 0)
+            continue;
+        }
+
+        mt_msg_async_send(pMsg);
+    }
+    return (0);
+}
+
+/*!
+ * @brief Stop the async workers of a dying interface.
+ * @param pMI - the interface, mt_msg_interface::is_dead must be set.
+ *
+ * Requests that have not been sent are completed with a result of 0.
+ */
+static void mt_msg_async_stop(struct mt_msg_interface *pMI)
+{
+    struct mt_msg *pMsg;
+    unsigned tStart;
+    int x;
+
+    if(pMI->async_list.sem == 0)
+    {
+        return;
+    }
+
+    /* wake them up, they will see is_dead */
+    SEMAPHORE_putN(pMI->async_list.sem, MT_MSG_ASYNC_MAX_WORKERS);
+
+    /* a worker might be waiting for an srsp */
+    tStart = TIMER_getNow();
+    for(x = 0 ; x < MT_MSG_ASYNC_MAX_WORKERS ; x++)
+    {
+        if(pMI->async_threads[x] == 0)
+        {
+            continue;
+        }
+        while(THREAD_isAlive(pMI->async_threads[x]))
+        {
+            if((TIMER_getNow() - tStart) >
+               ((unsigned)(pMI->srsp_timeout_mSecs) + 100))
             {
-                /* USB uarts die if they are disconnected */
-                pMI->is_dead = true;
+                break;
             }
+            TIMER_sleep(10);
         }
+        THREAD_destroy(pMI->async_threads[x]);
+        pMI->async_threads[x] = 0;
     }
-    /* log ... */
-    if(pMsg->iobuf_nvalid)
+
+    /* fail anything left over */
+    for(;;)
     {
-        if(LOG_test(LOG_DBG_MT_MSG_raw))
+        pMsg = MT_MSG_LIST_remove(pMI, &(pMI->async_list), 0);
+        if(pMsg == NULL)
         {
-            LOG_printf(LOG_DBG_MT_MSG_raw,
-                       "%s: nbytes-avail: %d\n",
-                       pMI->dbg_name,
-                       pMsg->iobuf_nvalid);
-            LOG_hexdump(LOG_DBG_MT_MSG_raw,
-                        0,
-                        pMI->pCurRxMsg->iobuf,
-                        pMI->pCurRxMsg->iobuf_nvalid);
+            break;
         }
+        pMsg->is_error = true;
+        mt_msg_async_complete(pMsg, 0);
     }
 
-    return (pMsg->iobuf_nvalid);
+    /* the rx thread is gone, no srsp will complete these */
+    mt_msg_async_expire(pMI, true);
 }
 
 /*!
- * @brief - read a message from the interface.
- * @param pMI - msg interface
- * @returns NULL if no message received, otherwise a valid msg
+ * @brief Stop reading an interface
+ * @param pMI - the message interface, the stream is still open
+ *
+ * The last interface to leave the reactor destroys it.
  */
-static struct mt_msg *mt_msg_rx(struct mt_msg_interface *pMI)
+static void mt_msg_rx_stop(struct mt_msg_interface *pMI)
 {
-    int r;
-    int nneed;
-    struct mt_msg *pMsg;
+    if(!(pMI->in_reactor))
+    {
+        return;
+    }
+    /* when this returns our handler is not running */
+    REACTOR_remove(mt_msg_reactor, pMI->hndl);
+    pMI->in_reactor = false;
+
+    MUTEX_lock(mt_msg_pool_mutex, -1);
+    mt_msg_reactor_users--;
+    if(mt_msg_reactor_users == 0)
+    {
+        REACTOR_destroy(mt_msg_reactor);
+        mt_msg_reactor = 0;
+    }
+    MUTEX_unLock(mt_msg_pool_mutex);
+}
 
-    /* do we allocate a new message? */
-    if(pMI->pCurRxMsg == NULL)
+/*
+  release resources for this message interface
+  see mt_msg.h
+*/
+void MT_MSG_interfaceDestroy(struct mt_msg_interface *pMI)
+{
+    int x;
+
+    if(pMI == NULL)
     {
-        pMI->pCurRxMsg = MT_MSG_alloc(-1, -1, -1);
-        /* allocation error :-(*/
-        if(pMI->pCurRxMsg == NULL)
+        return;
+    }
+
+    LOG_printf(LOG_DBG_MT_MSG_traffic,
+               "%s: Destroy interface\n", pMI->dbg_name);
+    pMI->is_dead = true;
+
+    MT_MSG_POOL_log(LOG_DBG_MT_MSG_pool);
+
+
+    /* stop reading before the stream goes away */
+    mt_msg_rx_stop(pMI);
+
+    /* close our connection */
+    if(pMI->hndl)
+    {
+        STREAM_close(pMI->hndl);
+        /* is this a socket connection? */
+        if(pMI->s_cfg)
         {
-            return (NULL);
+            if(pMI->s_cfg->ascp == 'c')
+            {
+                SOCKET_CLIENT_destroy(pMI->hndl);
+            }
+            else
+            {
+                SOCKET_SERVER_destroy(pMI->hndl);
+            }
         }
-        pMI->pCurRxMsg->pLogPrefix = _incoming_msg;
-        MT_MSG_setSrcIface(pMI->pCurRxMsg, pMI);
+        pMI->hndl = 0;
     }
-    else
+
+    /* and our rx thread */
+    if(pMI->rx_thread)
     {
-        MT_MSG_resetMsg(pMI->pCurRxMsg, -1, -1, -1);
+        THREAD_destroy(pMI->rx_thread);
+        pMI->rx_thread = 0;
     }
 
-    pMsg = pMI->pCurRxMsg;
+    /* stop the async workers, and fail what they did not send */
+    mt_msg_async_stop(pMI);
 
-    LOG_printf(LOG_DBG_MT_MSG_traffic,
-               "%s: rx-msg looking for start\n",
-               pMI->dbg_name);
+    /* any pending message are tossed */
+    MT_MSG_LIST_destroy(&(pMI->rx_list));
+    MT_MSG_LIST_destroy(&(pMI->async_list));
 
-try_again:
-    /* zap what we have */
-    pMsg->iobuf_nvalid = 0;
-    /* zap the existing buffer for debug reasons */
-    memset((void *)(&(pMsg->iobuf[0])), 0, pMsg->iobuf_idx_max);
+    /* our lock */
+    if(pMI->list_lock)
+    {
+        MUTEX_destroy(pMI->list_lock);
+        pMI->list_lock = 0;
+    }
 
-    /* how many bytes should we get? */
-    nneed = (
-        (pMI->frame_sync ? 1 : 0) + /* sync */
-        (pMI->len_2bytes ? 2 : 1) + /* len */
-        1 + /* cmd0 */
-        1 + /* cmd1 */
-        0 + /* unknown length yet */
-        (pMI->include_chksum ? 1 : 0)); /* checksum */
+    /* our SREQ/SRSP semaphores */
+    /* Any pending sreq is dead, the sender still owns the message */
+    for(x = 0 ; x < MT_MSG_SREQ_MAX_INFLIGHT ; x++)
+    {
+        pMI->sreq_table[x].pSreq = NULL;
+        pMI->sreq_table[x].is_stale = false;
+        pMI->sreq_table[x].is_async = false;
+        if(pMI->sreq_table[x].done_semaphore)
+        {
+            SEMAPHORE_destroy(pMI->sreq_table[x].done_semaphore);
+            pMI->sreq_table[x].done_semaphore = 0;
+        }
+    }
+    if(pMI->sreq_free_semaphore)
+    {
+        SEMAPHORE_destroy(pMI->sreq_free_semaphore);
+        pMI->sreq_free_semaphore = 0;
+    }
 
-read_more:
-    r = mt_msg_rx_bytes(pMI, nneed, pMI->intermsg_timeout_mSecs);
-    if(r == 0)
+    /* our fragmentation semaphore */
+    if(pMI->tx_frag.tx_ack_semaphore)
     {
-        LOG_printf(LOG_DBG_MT_MSG_traffic, "%s: rx-silent\n", pMI->dbg_name);
-        return (NULL);
+        SEMAPHORE_destroy(pMI->tx_frag.tx_ack_semaphore);
+        pMI->tx_frag.tx_ack_semaphore = 0;
     }
 
-    if(r < 0)
+    if(pMI->tx_lock)
     {
-        /* something is wrong */
-        LOG_printf(LOG_DBG_MT_MSG_traffic, "%s: Io error?\n", pMI->dbg_name);
-        return (NULL);
+        MUTEX_destroy(pMI->tx_lock);
+        pMI->tx_lock = 0;
     }
 
-    /* we start reading at byte 0 in the message */
-    pMsg->iobuf_idx = 0;
+    if(pMI->pTxFrame)
+    {
+        free((void *)(pMI->pTxFrame));
+        pMI->pTxFrame = NULL;
+    }
+
+    if(pMI->pTxBatch)
+    {
+        free((void *)(pMI->pTxBatch));
+        pMI->pTxBatch = NULL;
+    }
+
+    /* the rx thread is gone, so is the rx data */
+    if(pMI->rx_ring.pBuf)
+    {
+        LOG_printf(LOG_DBG_MT_MSG_traffic,
+                   "%s: rx reads: %u frames: %u discarded: %u chksum-err: %u\n",
+                   pMI->dbg_name,
+                   pMI->rx_ring.n_reads,
+                   pMI->rx_ring.n_frames,
+                   pMI->rx_ring.n_discarded,
+                   pMI->rx_ring.n_chksum_errors);
+        free((void *)(pMI->rx_ring.pBuf));
+    }
+    memset((void *)(&(pMI->rx_ring)), 0, sizeof(pMI->rx_ring));
+
+    if(pMI->pLatency)
+    {
+        MT_MSG_LAT_log(pMI, LOG_DBG_MT_MSG_latency);
+        free((void *)(pMI->pLatency));
+        pMI->pLatency = NULL;
+    }
+
+    /* we do *NOT* zap (zero) the interface. */
+    /* The caller may need to release destroy the handle. */
+}
+
+/*!
+ * @brief Number of valid bytes in the rx ring
+ * @param pR - the ring
+ * @returns byte count
+ */
+static unsigned mt_msg_ring_avail(struct mt_msg_rx_ring *pR)
+{
+    return (pR->wr - pR->rd);
+}
+
+/*!
+ * @brief Get a byte from the rx ring, without removing it
+ * @param pR - the ring
+ * @param ofs - offset from the read index
+ * @returns the byte value
+ */
+static int mt_msg_ring_peek(struct mt_msg_rx_ring *pR, unsigned ofs)
+{
+    return (pR->pBuf[ (pR->rd + ofs) & (pR->size - 1) ]);
+}
+
+/*!
+ * @brief Copy bytes from the rx ring, without removing them
+ * @param pR - the ring
+ * @param pDest - where to put the data
+ * @param n - number of bytes
+ */
+static void mt_msg_ring_copy(struct mt_msg_rx_ring *pR,
+                             uint8_t *pDest,
+                             unsigned n)
+{
+    unsigned ofs;
+    unsigned n1;
+
+    ofs = pR->rd & (pR->size - 1);
+    n1 = pR->size - ofs;
+    if(n1 > n)
+    {
+        n1 = n;
+    }
+    memcpy((void *)(pDest), (void *)(&(pR->pBuf[ofs])), n1);
+    if(n1 < n)
+    {
+        /* wrapped */
+        memcpy((void *)(pDest + n1), (void *)(&(pR->pBuf[0])), n - n1);
+    }
+}
+
+/*!
+ * @brief Read what is available from the interface into the rx ring
+ * @param pMI - the interface
+ * @param timeout_mSecs - how long to wait for the first byte
+ * @returns negative on error, otherwise number of bytes read
+ *
+ * At most one read is done, it is not split at the ring wrap point
+ * so the next call reads the rest. Only the wait for the first byte
+ * uses the timeout, the read itself takes whatever is there so one
+ * read can bring in many frames.
+ */
+static int mt_msg_ring_fill(struct mt_msg_interface *pMI, int timeout_mSecs)
+{
+    struct mt_msg_rx_ring *pR;
+    unsigned avail;
+    unsigned ofs;
+    unsigned nfree;
+    int r;
+
+    pR = &(pMI->rx_ring);
+
+    avail = mt_msg_ring_avail(pR);
+    nfree = pR->size - avail;
+    ofs = pR->wr & (pR->size - 1);
+    if(nfree > (pR->size - ofs))
+    {
+        nfree = pR->size - ofs;
+    }
+    if(nfree == 0)
+    {
+        /* should not happen, frames are smaller than the ring */
+        return (0);
+    }
+
+    /* wait for something to arrive */
+    r = STREAM_rxAvail(pMI->hndl, timeout_mSecs);
+    if(r > 0)
+    {
+        /* take what is there, do not wait to fill the buffer */
+        r = STREAM_rdBytes(pMI->hndl, &(pR->pBuf[ofs]), nfree, 0);
+        pR->n_reads++;
+    }
+    if(r > 0)
+    {
+        if(LOG_test(LOG_DBG_MT_MSG_raw))
+        {
+            LOG_printf(LOG_DBG_MT_MSG_raw,
+                       "%s: nbytes-read: %d\n",
+                       pMI->dbg_name,
+                       r);
+            LOG_hexdump(LOG_DBG_MT_MSG_raw, 0, &(pR->pBuf[ofs]), r);
+        }
+        pR->wr += (unsigned)r;
+
+        /* the bytes arrived (at the latest) now */
+        pR->t_last_nSecs = TIMER_getNow_nSecs();
+        if(avail == 0)
+        {
+            pR->t_first_nSecs = pR->t_last_nSecs;
+        }
+        return (r);
+    }
+
+    if(STREAM_isSocket(pMI->hndl))
+    {
+        /* did we get a tcpip disconnect? */
+        if(!STREAM_SOCKET_isConnected(pMI->hndl))
+        {
+            LOG_printf(LOG_DBG_MT_MSG_traffic,
+                       "%s: Socket is dead\n",
+                       pMI->dbg_name);
+            pMI->is_dead = true;
+            r = -1;
+        }
+    }
+    else
+    {
+        if(r < 0)
+        {
+            /* USB uarts die if they are disconnected */
+            pMI->is_dead = true;
+        }
+    }
+    return (r);
+}
+
+/*!
+ * @brief Discard bytes from the front of the rx ring
+ * @param pMI - the interface
+ * @param n - number of bytes to discard
+ */
+static void mt_msg_ring_discard(struct mt_msg_interface *pMI, unsigned n)
+{
+    pMI->rx_ring.rd += n;
+    pMI->rx_ring.n_discarded += n;
+}
+
+/*!
+ * @brief Try to extract one frame from the rx ring
+ * @param pMI - msg interface
+ * @param ppMsg - set to the message, if one was extracted
+ * @returns 0 if a message was extracted, 1 if more bytes are needed,
+ *          or -1 if the ring held garbage which was discarded (try again)
+ */
+static int mt_msg_ring_parse(struct mt_msg_interface *pMI,
+                             struct mt_msg **ppMsg)
+{
+    struct mt_msg_rx_ring *pR;
+    struct mt_msg *pMsg;
+    unsigned avail;
+    unsigned x;
+    int hdr_len;
+    int len;
+    int total;
+
+    pR = &(pMI->rx_ring);
+    *ppMsg = NULL;
+
+    hdr_len = (
+        (pMI->frame_sync ? 1 : 0) + /* sync */
+        (pMI->len_2bytes ? 2 : 1) + /* len */
+        1 + /* cmd0 */
+        1); /* cmd1 */
+
+    avail = mt_msg_ring_avail(pR);
 
     /* should we find a frame sync? */
     if(pMI->frame_sync)
     {
         /* hunt for the sync byte */
-        /* and move the sync byte to byte 0 in the buffer */
-        uint8_t *p8;
-
-        p8 = (uint8_t *)memchr((void *)(&pMsg->iobuf[0]),
-                               0xfe,
-                               pMsg->iobuf_nvalid);
-        if(p8 == NULL)
-        {
-            /* not found */
-            MT_MSG_log(LOG_DBG_MT_MSG_traffic | LOG_DBG_MT_MSG_raw,
-                       pMsg, "Garbage data...\n");
-            goto try_again;
-        }
-
-        /* frame sync must start at zero. */
-        if(p8 != pMsg->iobuf)
-        {
-            /* need to shift data over some */
-
-            /* how many bytes to shift? */
-            int n;
-            n = (int)(&(pMsg->iobuf[pMsg->iobuf_nvalid]) - p8);
-            /* shift */
-            memmove((void *)(&pMsg->iobuf[0]), (void *)p8, n);
-            /* zero what we deleted */
-            memset((void *)(&(pMsg->iobuf[n])), 0, pMsg->iobuf_nvalid - n);
-            pMsg->iobuf_nvalid = n;
-            /* Do we have enough bytes? */
-            if(nneed > pMsg->iobuf_nvalid)
+        for(x = 0 ; x < avail ; x++)
+        {
+            if(mt_msg_ring_peek(pR, x) == 0xfe)
             {
-                /* No - we need more, go get more */
-                goto read_more;
+                break;
             }
         }
-        /* DUMMY read of the sync byte */
-        MT_MSG_rdU8(pMsg);
+        if(x)
+        {
+            LOG_printf(LOG_DBG_MT_MSG_traffic | LOG_DBG_MT_MSG_raw,
+                       "%s: Garbage data... (%u bytes)\n",
+                       pMI->dbg_name, x);
+            mt_msg_ring_discard(pMI, x);
+            avail -= x;
+        }
+    }
+
+    /* enough for a header? */
+    total = hdr_len + (pMI->include_chksum ? 1 : 0);
+    if(avail < (unsigned)(total))
+    {
+        return (1);
+    }
+
+    x = (pMI->frame_sync ? 1 : 0);
+    len = mt_msg_ring_peek(pR, x);
+    if(pMI->len_2bytes)
+    {
+        /* Data is transmitted LSB first */
+        len = len | (mt_msg_ring_peek(pR, x + 1) << 8);
+    }
+
+    total = hdr_len + len + (pMI->include_chksum ? 1 : 0);
+    /* see MT_MSG_resetMsg() for the +6 */
+    if((len + 6) > MT_MSG_POOL_LARGE_SIZE)
+    {
+        LOG_printf(LOG_ERROR, "%s: frame too big (%d), resync\n",
+                   pMI->dbg_name, len);
+        goto resync;
+    }
+
+    /* is the whole frame here? */
+    if(avail < (unsigned)(total))
+    {
+        return (1);
+    }
+
+    pMsg = MT_MSG_alloc(len,
+                        mt_msg_ring_peek(pR, hdr_len - 2),
+                        mt_msg_ring_peek(pR, hdr_len - 1));
+    if(pMsg == NULL)
+    {
+        /* leave the frame in the ring */
+        return (1);
+    }
+    pMsg->pLogPrefix = _incoming_msg;
+    MT_MSG_setSrcIface(pMsg, pMI);
+    mt_msg_ring_copy(pR, pMsg->iobuf, total);
+    pMsg->iobuf_nvalid = total;
+
+    /* do the checksum */
+    if(pMI->include_chksum)
+    {
+        if(MT_MSG_calc_chksum(pMsg, 'f', pMsg->iobuf_nvalid) != 0)
+        {
+            pR->n_chksum_errors++;
+            MT_MSG_log(LOG_ERROR, pMsg, "%s: chksum error\n",
+                pMI->dbg_name);
+            LOG_hexdump(!LOG_ERROR, 0, pMsg->iobuf, pMsg->iobuf_nvalid);
+            MT_MSG_free(pMsg);
+            goto resync;
+        }
     }
 
-    /* Found start */
-    /* how big is our length? */
-    if(pMI->len_2bytes)
+    /* We have a message, remove it from the ring */
+    pR->rd += (unsigned)(total);
+    pR->n_frames++;
+
+    /* what follows came with (or before) the last read */
+    pMsg->stamp_nSecs[MT_MSG_STAMP_rx_first_byte] = pR->t_first_nSecs;
+    pMsg->stamp_nSecs[MT_MSG_STAMP_rx_frame] = pR->t_last_nSecs;
+    pR->t_first_nSecs = pR->t_last_nSecs;
+
+    MT_MSG_CAPTURE_frame(pMI, MT_MSG_CAPTURE_rx,
+                         pMsg->iobuf, total, pR->t_last_nSecs);
+
+    MT_MSG_set_type(pMsg, pMsg->pSrcIface);
+
+    /* since we will be parsing the message... */
+    /* Set the iobuf_idx to the start of the payload */
+    pMsg->iobuf_idx = hdr_len;
+
+    *ppMsg = pMsg;
+    return (0);
+
+resync:
+    /* this was not a frame start, look for the next one */
+    /* other (good) frames that follow are kept */
+    if(pMI->frame_sync)
     {
-        pMsg->expected_len = MT_MSG_rdU16(pMsg);
+        mt_msg_ring_discard(pMI, 1);
     }
     else
     {
-        pMsg->expected_len = MT_MSG_rdU8(pMsg);
+        /* without sync bytes, we cannot tell where frames start */
+        LOG_printf(LOG_DBG_MT_MSG_traffic, "Flushing RX stream\n");
+        mt_msg_ring_discard(pMI, avail);
     }
+    return (-1);
+}
 
-    pMsg->cmd0 = MT_MSG_rdU8(pMsg);
-    pMsg->cmd1 = MT_MSG_rdU8(pMsg);
+/*!
+ * @brief - read a message from the interface.
+ * @param pMI - msg interface
+ * @returns NULL if no message received, otherwise a valid msg
+ */
+static struct mt_msg *mt_msg_rx(struct mt_msg_interface *pMI)
+{
+    struct mt_msg *pMsg;
+    int timeout_mSecs;
+    int r;
 
-    nneed += pMsg->expected_len;
+    LOG_printf(LOG_DBG_MT_MSG_traffic,
+               "%s: rx-msg looking for start\n",
+               pMI->dbg_name);
 
-    /* read the data component */
-    r = mt_msg_rx_bytes(pMI, nneed, pMI->intersymbol_timeout_mSecs);
-    if(r != nneed)
+    for(;;)
     {
-        /* something is wrong? */
-        if(r > 0)
+        /* do we already have one? */
+        r = mt_msg_ring_parse(pMI, &pMsg);
+        if(r == 0)
         {
-            /* we got some ... but not enough .. */
-            LOG_printf(LOG_DBG_MT_MSG_raw,
-                "Short read ... got: %d, want: %d, try again...\n",
-                nneed, r);
-            goto read_more;
+            return (pMsg);
+        }
+        if(r < 0)
+        {
+            /* we tossed some garbage, look again */
+            continue;
         }
-        MT_MSG_log(LOG_ERROR, pMsg, "%s: expected: %d, got: %d\n",
-            pMI->dbg_name, nneed, r);
-    dump_recover:
-        LOG_printf(LOG_DBG_MT_MSG_traffic, "Flushing RX stream\n");
-        /* Dump all incoming data until we find a sync byte */
-        STREAM_rdDump(pMI->hndl, pMI->flush_timeout_mSecs);
-        goto try_again;
-    }
 
-    /* Dummy read to the end of the data. */
-    /* this puts us at the checksum byte (if present) */
-    MT_MSG_rdBuf(pMsg, NULL, pMsg->expected_len);
+        /* we need more data */
+        /* inside a message, the gap between bytes is smaller */
+        if(mt_msg_ring_avail(&(pMI->rx_ring)))
+        {
+            timeout_mSecs = pMI->intersymbol_timeout_mSecs;
+        }
+        else
+        {
+            timeout_mSecs = pMI->intermsg_timeout_mSecs;
+        }
 
-    /* do the checksum */
-    if(pMI->include_chksum)
-    {
-        r = MT_MSG_calc_chksum(pMsg, 'f', pMsg->iobuf_nvalid);
-        if(r != 0)
+        r = mt_msg_ring_fill(pMI, timeout_mSecs);
+        if(r < 0)
         {
-            MT_MSG_log(LOG_ERROR, pMI->pCurRxMsg, "%s: chksum error\n",
-                pMI->dbg_name);
-            LOG_hexdump(!LOG_ERROR, 0, pMsg->iobuf, pMsg->iobuf_nvalid);
-            goto dump_recover;
+            /* something is wrong */
+            LOG_printf(LOG_DBG_MT_MSG_traffic, "%s: Io error?\n", pMI->dbg_name);
+            return (NULL);
+        }
+        if(r > 0)
+        {
+            continue;
         }
-    }
-    /* We have a message */
-    MT_MSG_set_type(pMsg, pMsg->pSrcIface);
-    /* Set the iobuf_idx to the start of the payload */
 
-    /* since we will be parsing the message... */
-    /* Set the iobuf_idx to the start of the payload */
-    pMsg->iobuf_idx = (
-        (pMI->frame_sync ? 1 : 0) +
-        (pMI->len_2bytes ? 2 : 1) +
-        1 + /* cmd0 */
-        1 /* cmd1 */
-       );
-    /* next time we need to allocate a new message */
-    pMI->pCurRxMsg = NULL;
+        if(mt_msg_ring_avail(&(pMI->rx_ring)) == 0)
+        {
+            LOG_printf(LOG_DBG_MT_MSG_traffic, "%s: rx-silent\n", pMI->dbg_name);
+            return (NULL);
+        }
 
-    /* return our message */
-    return (pMsg);
+        /* partial frame, and the rest never came */
+        LOG_printf(LOG_ERROR, "%s: incomplete frame (%u bytes), resync\n",
+                   pMI->dbg_name,
+                   mt_msg_ring_avail(&(pMI->rx_ring)));
+        if(pMI->frame_sync)
+        {
+            /* skip this sync byte and look for the next */
+            mt_msg_ring_discard(pMI, 1);
+        }
+        else
+        {
+            mt_msg_ring_discard(pMI, mt_msg_ring_avail(&(pMI->rx_ring)));
+        }
+        return (NULL);
+    }
 }
 
 /*!
@@ -1747,6 +3246,7 @@ read_more:
  */
 static struct mt_msg *handle_ext_status(struct mt_msg *pMsg)
 {
+    struct mt_msg_interface *pMI;
     int block_num;
     int status;
     const char *cp;
@@ -1776,6 +3276,14 @@ static struct mt_msg *handle_ext_status(struct mt_msg *pMsg)
     }
     MT_MSG_log(LOG_DBG_MT_MSG_traffic, pMsg, "extended status: block: %d, %s\n",
         block_num, cp);
+
+    /* the sender gave up, do not mix its blocks with the next transfer */
+    pMI = pMsg->pSrcIface;
+    if((status == MT_MSG_EXT_STATUS_frag_aborted) && (pMI->rx_frag.pMsg))
+    {
+        MT_MSG_free(pMI->rx_frag.pMsg);
+        pMI->rx_frag.pMsg = NULL;
+    }
     MT_MSG_free(pMsg);
     pMsg = NULL;
     return (NULL);
@@ -1817,102 +3325,94 @@ static void send_frag_ack(struct mt_msg_interface *pMI,
 
 /*!
  * @brief handle first packet of a fragmented message
- * @param pRxmsg - the fragment we just received.
- * @return 0 success
+ * @param pRxMsg - the fragment we just received.
+ * @param total_size - total size from the extended header
+ * @return 1 on success, the whole message is allocated
  */
-static int rx_first_frag_block(struct mt_msg *pRxMsg)
+static int rx_first_frag_block(struct mt_msg *pRxMsg, int total_size)
 {
     struct mt_msg_interface *pMI;
-    int rd_loc;
-    int wr_loc;
+    struct mt_msg_iface_frag_info *pFI;
 
     pMI = pRxMsg->pSrcIface;
+    pFI = &(pMI->rx_frag);
 
     /* we don't use these */
-    pMI->rx_frag.pTxFragAck = NULL;
-    pMI->rx_frag.pTxFragData = NULL;
+    pFI->pTxFragAck = NULL;
+    pFI->pTxFragData = NULL;
 
     /* we have no error (YET!) */
-    pMI->rx_frag.is_error = false;
-
-    /* we'll keep this here. */
-    pMI->rx_frag.pMsg = pRxMsg;
-
-    /* skip the version byte */
-    MT_MSG_rdU8(pMI->rx_frag.pMsg);
+    pFI->is_error = false;
 
-    /* read the block number */
-    /* must start with block 0 */
-    pMI->rx_frag.block_cur = MT_MSG_rdU8(pMI->rx_frag.pMsg);
-
-    pMI->rx_frag.total_size = MT_MSG_rdU16(pMI->rx_frag.pMsg);
+    /* until the whole message exists, status is sent via this block */
+    pFI->pMsg = pRxMsg;
+    pFI->block_cur = 0;
+    pFI->total_size = total_size;
 
     /* "-4" is because the size of *this* extended header is 4 bytes. */
-    pMI->rx_frag.this_frag_size = pMI->rx_frag.pMsg->expected_len - 4;
+    pFI->this_frag_size = pRxMsg->expected_len - 4;
+    if(pFI->this_frag_size <= 0)
+    {
+        MT_MSG_log(LOG_ERROR, pRxMsg, "RX Frag: no data in block\n");
+        send_frag_ack_packet(pMI, pFI, MT_MSG_FRAG_STATUS_block_len_changed);
+        pFI->pMsg = NULL;
+        return (0);
+    }
 
     /* determine how many blocks we should receive */
-    pMI->rx_frag.block_count =
-        (pMI->rx_frag.total_size + pMI->rx_frag.this_frag_size - 1) /
-        pMI->rx_frag.this_frag_size;
+    pFI->block_count =
+        (pFI->total_size + pFI->this_frag_size - 1) /
+        pFI->this_frag_size;
 
     MT_MSG_log(LOG_DBG_MT_MSG_traffic,
-        pMI->rx_frag.pMsg, "RX Frag: Block %d of %d, frag size: %d\n",
-        pMI->rx_frag.block_cur + 1,
-        pMI->rx_frag.block_count,
-        pMI->rx_frag.this_frag_size);
-
-    /* sanity check, did we get block 0? */
-    if(pMI->rx_frag.block_cur != 0)
-    {
-        MT_MSG_log(LOG_ERROR, pMI->rx_frag.pMsg, "RX-non-first-block\n");
-
-        /* abort */
-        send_frag_abort_outoforder(pMI, &(pMI->rx_frag));
-
-        /* toss the message we just received */
-        MT_MSG_free(pMI->rx_frag.pMsg);
-        pMI->rx_frag.pMsg = NULL;
-        /* we handled ZERO messages */
+        pRxMsg, "RX Frag: Block %d of %d, frag size: %d\n",
+        1,
+        pFI->block_count,
+        pFI->this_frag_size);
+
+    /* see MT_MSG_resetMsg() for the +6 */
+    if((pFI->block_count > MT_MSG_FRAG_MAX_BLOCKS) ||
+       ((pFI->total_size + 6) > MT_MSG_POOL_LARGE_SIZE))
+    {
+        MT_MSG_log(LOG_ERROR, pRxMsg, "RX Frag: too large: %d\n",
+                   pFI->total_size);
+        send_frag_ack_packet(pMI, pFI, MT_MSG_FRAG_STATUS_mem_alloc_error);
+        pFI->pMsg = NULL;
         return (0);
     }
 
-    /* Now, move the data in the message to the front */
+    /* The block is smaller than the whole, so allocate the whole */
     /* we are going to throw away the extended header */
+    pFI->pMsg = MT_MSG_alloc(pFI->total_size,
+                             pRxMsg->cmd0 & 0x7f,
+                             pRxMsg->cmd1);
+    if(pFI->pMsg == NULL)
+    {
+        return (0);
+    }
+    pFI->pMsg->pLogPrefix = pRxMsg->pLogPrefix;
+    MT_MSG_setSrcIface(pFI->pMsg, pMI);
+    pFI->pMsg->stamp_nSecs[MT_MSG_STAMP_rx_first_byte] =
+        pRxMsg->stamp_nSecs[MT_MSG_STAMP_rx_first_byte];
 
-    /* this is where the payload should be when done */
-    wr_loc =
-        (pMI->frame_sync ? 1 : 0) +
-        (pMI->len_2bytes ? 2 : 1) +
-        1 + /* cmd0 */
-        1; /* cmd1 */
-
-    /* the payload currently is after the header */
-    rd_loc = wr_loc + 4;
-
-    /* now move the data */
-    memmove((void *)(&(pMI->rx_frag.pMsg->iobuf[wr_loc])),
-        (void *)(&(pMI->rx_frag.pMsg->iobuf[rd_loc])),
-        pMI->rx_frag.this_frag_size);
-
-    /* update the expected size */
-    pMI->rx_frag.pMsg->expected_len = pMI->rx_frag.total_size;
-    /* clear the extended bit */
-    pMI->rx_frag.pMsg->cmd0 &= 0x7f;
-
-    /* send our ack. */
-    send_frag_ack(pMI, &(pMI->rx_frag));
+    frag_block_reset(pFI);
     /* we successfully handled 1 message */
     return (1);
 }
 
 /*!
  * @brief We have received an extended packet of type fragment data.
- * @param pMI - where it came from
  * @param pRxFrag - what we received.
+ *
+ * Blocks may arrive in any order, for example when the sender resends
+ * a lost block while later blocks are in flight. Each block is acked
+ * as it arrives, a duplicate block is acked again.
  */
 static struct mt_msg *handle_data_fragment(struct mt_msg *pRxFrag)
 {
     struct mt_msg_interface *pMI;
+    struct mt_msg_iface_frag_info *pFI;
+    struct mt_msg *pWhole;
     int this_block;
     int this_len;
     int rd_loc;
@@ -1922,33 +3422,44 @@ static struct mt_msg *handle_data_fragment(struct mt_msg *pRxFrag)
 
     /* recover the interface */
     pMI = pRxFrag->pSrcIface;
-
-    /* first packet is special. */
-    if(pMI->rx_frag.pMsg == NULL)
-    {
-        rx_first_frag_block(pRxFrag);
-        return (NULL);
-    }
-
-    /* all others are handled here. */
+    pFI = &(pMI->rx_frag);
 
     /* throw away the 1st byte */
     MT_MSG_rdU8(pRxFrag);
     this_block = MT_MSG_rdU8(pRxFrag);
     this_len   = MT_MSG_rdU16(pRxFrag);
 
+    /* first packet is special. */
+    if(pFI->pMsg == NULL)
+    {
+        /* it tells us the block size, must be block 0 */
+        if(this_block != 0)
+        {
+            /* block 0 was lost, the sender will resend everything */
+            MT_MSG_log(LOG_ERROR, pRxFrag,
+                       "RX-non-first-block: %d\n", this_block);
+            MT_MSG_free(pRxFrag);
+            return (NULL);
+        }
+        if(!rx_first_frag_block(pRxFrag, this_len))
+        {
+            MT_MSG_free(pRxFrag);
+            return (NULL);
+        }
+    }
+
     /* detect errors and cleanup */
-    if(pMI->rx_frag.block_cur == this_block)
+    if(pFI->total_size != this_len)
     {
-        MT_MSG_log(LOG_DBG_MT_MSG_traffic,
-                   pRxFrag,
-                   "RX Frag: Duplicate block %d\n",
-                   this_block);
+        MT_MSG_log(LOG_ERROR, pRxFrag,
+                   "RX Frag: total size change (was: %d, now: %d)\n",
+                   pFI->total_size, this_len);
+        send_frag_abort_outoforder(pMI, pFI);
     abort_clean_up:
-        if(pMI->rx_frag.pMsg)
+        if(pFI->pMsg)
         {
-            MT_MSG_free(pMI->rx_frag.pMsg);
-            pMI->rx_frag.pMsg = NULL;
+            MT_MSG_free(pFI->pMsg);
+            pFI->pMsg = NULL;
         }
         if(pRxFrag)
         {
@@ -1958,32 +3469,23 @@ static struct mt_msg *handle_data_fragment(struct mt_msg *pRxFrag)
         return (NULL);
     }
 
-    if(pMI->rx_frag.total_size != this_len)
+    /* block number beyond the end? */
+    if(this_block >= pFI->block_count)
     {
         MT_MSG_log(LOG_ERROR, pRxFrag,
-                   "RX Frag: total size change (was: %d, now: %d)\n",
-                   pMI->rx_frag.total_size, this_len);
-        send_frag_abort_outoforder(pMI, &(pMI->rx_frag));
+                   "RX Frag: out of range, count %d, got %d\n",
+                   pFI->block_count, this_block);
+        send_frag_abort_outoforder(pMI, pFI);
         goto abort_clean_up;
     }
 
     /* is this the last block? */
     last_block = false;
-    if((this_block + 1) == pMI->rx_frag.block_count)
+    if((this_block + 1) == pFI->block_count)
     {
         last_block = true;
     }
 
-    /* block order wrong? */
-    if((pMI->rx_frag.block_cur + 1) != this_block)
-    {
-        MT_MSG_log(LOG_ERROR, pRxFrag,
-                   "RX Frag: out of order, expect %d, got %d\n",
-                   (pMI->rx_frag.block_cur + 1), this_block);
-        send_frag_abort_outoforder(pMI, &(pMI->rx_frag));
-        goto abort_clean_up;
-    }
-
     /* how big is this specific fragment? */
     this_len = pRxFrag->expected_len - 4;
 
@@ -1992,12 +3494,12 @@ static struct mt_msg *handle_data_fragment(struct mt_msg *pRxFrag)
     if(last_block)
     {
         /* last block can be smaller, but not larger */
-        bad = (this_len > pMI->rx_frag.this_frag_size);
+        bad = (this_len > pFI->this_frag_size);
     }
     else
     {
         /* internal blocks must be same size */
-        bad = (this_len != pMI->rx_frag.this_frag_size);
+        bad = (this_len != pFI->this_frag_size);
     }
 
     if(bad)
@@ -2006,21 +3508,33 @@ static struct mt_msg *handle_data_fragment(struct mt_msg *pRxFrag)
         MT_MSG_log(LOG_ERROR,
                    pRxFrag,
                    "RX Frag: block len change new: %d, old: %d\n",
-                   this_len, pMI->rx_frag.this_frag_size);
+                   this_len, pFI->this_frag_size);
         send_frag_ack_packet(pMI,
-                             &(pMI->rx_frag),
+                             pFI,
                              MT_MSG_FRAG_STATUS_block_len_changed);
         goto abort_clean_up;
     }
 
-    /* update the block number. */
-    pMI->rx_frag.block_cur = this_block;
+    /* the ack is for this block */
+    pFI->block_cur = this_block;
+
+    if(frag_block_is_done(pFI, this_block))
+    {
+        /* our ack was lost, the sender tried again */
+        MT_MSG_log(LOG_DBG_MT_MSG_traffic,
+                   pRxFrag,
+                   "RX Frag: Duplicate block %d\n",
+                   this_block);
+        send_frag_ack(pMI, pFI);
+        MT_MSG_free(pRxFrag);
+        return (NULL);
+    }
 
     MT_MSG_log(LOG_DBG_MT_MSG_traffic,
         pRxFrag,
         "RX-Frag: Block %d of %d\n",
         this_block + 1,
-        pMI->rx_frag.block_count);
+        pFI->block_count);
 
     /* otherwise we are good, copy the data */
     rd_loc =
@@ -2031,7 +3545,7 @@ static struct mt_msg *handle_data_fragment(struct mt_msg *pRxFrag)
         1; /* cmd1; */
 
     /* where do we put it? */
-    wr_loc = pMI->rx_frag.block_cur * pMI->rx_frag.this_frag_size;
+    wr_loc = this_block * pFI->this_frag_size;
     /* go past the header in the 'whole' packet. */
     wr_loc +=
         (pMI->frame_sync ? 1 : 0) +
@@ -2040,28 +3554,33 @@ static struct mt_msg *handle_data_fragment(struct mt_msg *pRxFrag)
         1; /* cmd1 */
 
     /* copy the data. */
-    memcpy((void *)(&(pMI->rx_frag.pMsg->iobuf[wr_loc])),
+    memcpy((void *)(&(pFI->pMsg->iobuf[wr_loc])),
         (void *)(&(pRxFrag->iobuf[rd_loc])),
         this_len);
+    frag_block_set_done(pFI, this_block);
 
     /* send our ack */
-    send_frag_ack(pMI, &(pMI->rx_frag));
+    send_frag_ack(pMI, pFI);
+
+    /* the whole message arrived with its last block */
+    pFI->pMsg->stamp_nSecs[MT_MSG_STAMP_rx_frame] =
+        pRxFrag->stamp_nSecs[MT_MSG_STAMP_rx_frame];
 
     /* we no longer need the fragment */
     MT_MSG_free(pRxFrag);
     pRxFrag = NULL;
 
-    struct mt_msg *pWhole;
     pWhole = NULL;
-    if(last_block)
+    if(pFI->block_done == pFI->block_count)
     {
-        /* send COMPLETE */
+        /* send COMPLETE, with the last block number */
+        pFI->block_cur = pFI->block_count - 1;
         send_extended_status(pMI,
-                             &(pMI->rx_frag),
+                             pFI,
                              MT_MSG_EXT_STATUS_frag_complete);
 
-        pWhole = pMI->rx_frag.pMsg;
-        pMI->rx_frag.pMsg = NULL;
+        pWhole = pFI->pMsg;
+        pFI->pMsg = NULL;
 
         /* set the parse point. */
         pWhole->iobuf_idx =
@@ -2069,7 +3588,8 @@ static struct mt_msg *handle_data_fragment(struct mt_msg *pRxFrag)
             (pMI->len_2bytes ? 2 : 1) +
             1 + /* cmd0 */
             1; /* cmd1 */
-
+        pWhole->iobuf_nvalid = pWhole->iobuf_idx + pWhole->expected_len;
+        MT_MSG_set_type(pWhole, pMI);
     }
     return (pWhole);
 }
@@ -2081,6 +3601,7 @@ static struct mt_msg *handle_data_fragment(struct mt_msg *pRxFrag)
 static struct mt_msg *handle_extend_packet(struct mt_msg *pMsg)
 {
     struct mt_msg_interface *pMI;
+    struct mt_msg **ppAck;
     const char *cp;
     /* recover where it came from */
 
@@ -2105,9 +3626,15 @@ static struct mt_msg *handle_extend_packet(struct mt_msg *pMsg)
         pMsg->pLogPrefix = cp;
         MT_MSG_log(LOG_DBG_MT_MSG_traffic, pMsg, "RX frag-ack\n");
 
+        /* keep the acks in order, there may be several in flight */
         MUTEX_lock(pMI->list_lock, -1);
-        pMsg->pListNext = pMI->tx_frag.pTxFragAck;
-        pMI->tx_frag.pTxFragAck = pMsg;
+        pMsg->pListNext = NULL;
+        ppAck = &(pMI->tx_frag.pTxFragAck);
+        while(*ppAck)
+        {
+            ppAck = &((*ppAck)->pListNext);
+        }
+        *ppAck = pMsg;
         pMsg = NULL;
         MUTEX_unLock(pMI->list_lock);
         SEMAPHORE_put(pMI->tx_frag.tx_ack_semaphore);
@@ -2138,6 +3665,96 @@ static struct mt_msg *handle_extend_packet(struct mt_msg *pMsg)
     return (pMsg);
 }
 
+/*!
+ * @brief Log the latency histograms, if it is time to do so
+ * @param pMI - the message interface
+ */
+static void mt_msg_rx_latency_log(struct mt_msg_interface *pMI)
+{
+    if(pMI->latency_log_mSecs &&
+       TIMER_timeoutIsExpired(pMI->latency_log_last,
+                              pMI->latency_log_mSecs))
+    {
+        pMI->latency_log_last = TIMER_timeoutStart();
+        MT_MSG_LAT_log(pMI, LOG_DBG_MT_MSG_latency);
+        /* waiting in the rx_list is part of the latency */
+        MT_MSG_LIST_log(&(pMI->rx_list), LOG_DBG_MT_MSG_latency);
+    }
+}
+
+/*!
+ * @brief Hand a received message to whoever is waiting for it
+ * @param pMI - the message interface
+ * @param pRxMsg - the message
+ */
+static void mt_msg_rx_dispatch(struct mt_msg_interface *pMI,
+                               struct mt_msg *pRxMsg)
+{
+    struct mt_msg_sreq_slot *pSlot;
+
+    /* Debug dump if requested */
+    MT_MSG_dbg_decode(pRxMsg, pRxMsg->pSrcIface, ALL_MT_MSG_DBG);
+
+    /* if this message has the extension bit.. */
+    if(pRxMsg->cmd0 & _bit7)
+    {
+        pRxMsg = handle_extend_packet(pRxMsg);
+    }
+
+    /* did we complete the decoding of a the extended packet? */
+    /* or if we got a normall packet... */
+    if(pRxMsg == NULL)
+    {
+        /* nothing left to do... */
+        return;
+    }
+
+    if(pRxMsg->m_type == MT_MSG_TYPE_areq)
+    {
+    areq_msg:
+        MT_MSG_log(LOG_DBG_MT_MSG_traffic, pRxMsg, "rx areq\n");
+        /* async request */
+        MT_MSG_stamp(pRxMsg, MT_MSG_STAMP_rx_enqueue);
+        MT_MSG_LIST_insert(pMI, &(pMI->rx_list), pRxMsg);
+        return;
+    }
+
+    if(pRxMsg->m_type == MT_MSG_TYPE_poll)
+    {
+        /* polls are handled as an areq */
+        goto areq_msg;
+    }
+
+    if(pRxMsg->m_type == MT_MSG_TYPE_sreq)
+    {
+        /* polls are handled as an areq */
+        goto areq_msg;
+    }
+
+    /* it should match one of our in-flight Sreqs */
+    /* and it might not match any of them */
+    pSlot = mt_msg_sreq_match(pMI, pRxMsg);
+    if(pSlot == NULL)
+    {
+        /* treat as an areq */
+        goto areq_msg;
+    }
+    /* the waiter was woken by the match, under the list lock */
+}
+
+/*
+  Dispatch a message as if it was received
+  see mt_msg.h
+*/
+void MT_MSG_rxInject(struct mt_msg_interface *pMI, struct mt_msg *pMsg)
+{
+    MT_MSG_setSrcIface(pMsg, pMI);
+    MT_MSG_set_type(pMsg, pMI);
+    /* the payload follows the header, see mt_msg_ring_parse() */
+    pMsg->iobuf_idx = mt_msg_hdr_len(pMI);
+    mt_msg_rx_dispatch(pMI, pMsg);
+}
+
 /*!
  * @brief rx thread that handles all incoming messages.
  * @param cookie - the message interface in disguise
@@ -2145,8 +3762,6 @@ static struct mt_msg *handle_extend_packet(struct mt_msg *pMsg)
  */
 static intptr_t mt_msg_rx_thread(intptr_t cookie)
 {
-    int a;
-    int b;
     struct mt_msg_interface *pMI;
     struct mt_msg *pRxMsg;
 
@@ -2160,6 +3775,8 @@ static intptr_t mt_msg_rx_thread(intptr_t cookie)
             break;
         }
 
+        mt_msg_rx_latency_log(pMI);
+
         if(STREAM_isError(pMI->hndl))
         {
             LOG_printf(LOG_ERROR, "%s: Dead\n", pMI->dbg_name);
@@ -2172,88 +3789,135 @@ static intptr_t mt_msg_rx_thread(intptr_t cookie)
         {
             continue;
         }
-        /* Debug dump if requested */
-        MT_MSG_dbg_decode(pRxMsg, pRxMsg->pSrcIface, ALL_MT_MSG_DBG);
+        mt_msg_rx_dispatch(pMI, pRxMsg);
+    }
+    LOG_printf(LOG_ERROR, "%s: rx-thread dead\n", pMI->dbg_name);
+    /* we die */
+    return (0);
+}
 
-        /* if this message has the extension bit.. */
-        if(pRxMsg->cmd0 & _bit7)
-        {
-            pRxMsg = handle_extend_packet(pRxMsg);
-        }
+/*!
+ * @brief Reactor handler, called when the interface is readable
+ * @param cookie - the message interface in disguise
+ *
+ * This runs on the reactor thread, it must not block. It reads what
+ * is available, and dispatches every complete frame. A partial frame
+ * stays in the rx ring until the rest arrives.
+ */
+static void mt_msg_rx_ready(intptr_t cookie)
+{
+    struct mt_msg_interface *pMI;
+    struct mt_msg *pRxMsg;
+    int n;
+    int r;
 
-        /* did we complete the decoding of a the extended packet? */
-        /* or if we got a normall packet... */
-        if(pRxMsg == NULL)
-        {
-            /* nothing left to do... */
-            continue;
-        }
+    pMI = (struct mt_msg_interface *)(cookie);
 
-        if(pRxMsg->m_type == MT_MSG_TYPE_areq)
-        {
-        areq_msg:
-            MT_MSG_log(LOG_DBG_MT_MSG_traffic, pRxMsg, "rx areq\n");
-            /* async request */
-            MT_MSG_LIST_insert(pMI, &(pMI->rx_list), pRxMsg);
-            pRxMsg = NULL;
-            continue;
-        }
+    mt_msg_rx_latency_log(pMI);
 
-        if(pRxMsg->m_type == MT_MSG_TYPE_poll)
+    /* a busy interface must not starve the others */
+    for(n = 0 ; n < MT_MSG_REACTOR_MAX_READS ; n++)
+    {
+        if(pMI->is_dead || STREAM_isError(pMI->hndl))
         {
-            /* polls are handled as an areq */
-            goto areq_msg;
+            break;
         }
 
-        if(pRxMsg->m_type == MT_MSG_TYPE_sreq)
+        r = mt_msg_ring_fill(pMI, 0);
+        if(r <= 0)
         {
-            /* polls are handled as an areq */
-            goto areq_msg;
+            /* nothing more is there (or it died) */
+            break;
         }
 
-        /* it should match our current Sreq */
-        /* and it might not match our Sreq */
-        if(pMI->pCurSreq == NULL)
+        /* extract everything that is complete */
+        for(;;)
         {
-            /* But there is no current sreq? */
-            MT_MSG_log(LOG_DBG_MT_MSG_traffic, pRxMsg, "no pending sreq?\n");
-            /* treat as an areq */
-            goto areq_msg;
+            r = mt_msg_ring_parse(pMI, &pRxMsg);
+            if(r > 0)
+            {
+                break;
+            }
+            if(r == 0)
+            {
+                mt_msg_rx_dispatch(pMI, pRxMsg);
+            }
         }
+    }
 
-        /* Does this match? */
+    if(pMI->is_dead || STREAM_isError(pMI->hndl))
+    {
+        LOG_printf(LOG_ERROR, "%s: Dead\n", pMI->dbg_name);
+        pMI->is_dead = true;
+        /* MT_MSG_interfaceDestroy() does the rest */
+        REACTOR_remove(mt_msg_reactor, pMI->hndl);
+    }
+}
 
-        /* Upper bits[7:5] = message type */
-        /* Lower bits[4:0] = subsystem number */
-        /* We only care about the subsystem number */
-        a = _bitsXYof(pMI->pCurSreq->cmd0, 4, 0);
-        b = _bitsXYof(pRxMsg->cmd0, 4, 0);
-        if((a == b) && (pMI->pCurSreq->cmd1 == pRxMsg->cmd1))
+/*!
+ * @brief Start reading an interface, with the reactor or an rx thread
+ * @param pMI - the message interface
+ * @returns 0 on success
+ */
+static int mt_msg_rx_start(struct mt_msg_interface *pMI)
+{
+    if(pMI->use_reactor)
+    {
+        if(STREAM_getFd(pMI->hndl) < 0)
         {
-            /* All is well */
+            LOG_printf(LOG_ERROR,
+                       "%s: stream cannot use the reactor, using a thread\n",
+                       pMI->dbg_name);
         }
         else
         {
-            /* does not match.. */
-            MT_MSG_log(LOG_DBG_MT_MSG_traffic,
-                pRxMsg,
-                "sreq(cmd0=0x%02x, cmd1=0x%02x) does not match\n",
-                pMI->pCurSreq->cmd0,
-                pMI->pCurSreq->cmd1);
-            /* treat as areq */
-            goto areq_msg;
-        }
+            /* shared by all interfaces */
+            MUTEX_lock(mt_msg_pool_mutex, -1);
+            if(mt_msg_reactor == 0)
+            {
+                mt_msg_reactor = REACTOR_create("mt-msg-reactor");
+            }
+            if(mt_msg_reactor)
+            {
+                mt_msg_reactor_users++;
+            }
+            MUTEX_unLock(mt_msg_pool_mutex);
 
-        /* attach it to the request */
-        pMI->pCurSreq->pSrsp = pRxMsg;
-        pMI->pCurSreq = NULL;
-        pRxMsg = NULL;
-        /* wake up the waiter */
-        SEMAPHORE_put(pMI->srsp_semaphore);
+            if(mt_msg_reactor == 0)
+            {
+                return (-1);
+            }
+
+            /* the reactor thread is shared, it must not wait for room */
+            MUTEX_lock(pMI->rx_list.lock, -1);
+            if(pMI->rx_list.policy == MT_MSG_LIST_POLICY_block)
+            {
+                LOG_printf(LOG_ERROR,
+                           "%s: reactor cannot block, rx-policy: drop-newest\n",
+                           pMI->dbg_name);
+                pMI->rx_list.policy = MT_MSG_LIST_POLICY_drop_newest;
+            }
+            MUTEX_unLock(pMI->rx_list.lock);
+
+            /* must be set first, the handler might run right away */
+            pMI->in_reactor = true;
+            if(REACTOR_add(mt_msg_reactor,
+                           pMI->hndl,
+                           mt_msg_rx_ready,
+                           (intptr_t)(pMI)) == 0)
+            {
+                return (0);
+            }
+            mt_msg_rx_stop(pMI);
+            return (-1);
+        }
     }
-    LOG_printf(LOG_ERROR, "%s: rx-thread dead\n", pMI->dbg_name);
-    /* we die */
-    return (0);
+
+    pMI->rx_thread = THREAD_create(pMI->dbg_name,
+                                   mt_msg_rx_thread,
+                                   (intptr_t)(pMI),
+                                   THREAD_FLAGS_DEFAULT);
+    return ((pMI->rx_thread == 0) ? -1 : 0);
 }
 
 /*
@@ -2265,6 +3929,10 @@ int MT_MSG_interfaceCreate(struct mt_msg_interface *pMI)
     int r;
 
     pMI->is_dead = false;
+    pMI->capture_id = 0;
+
+    /* the pool lock must exist before our rx thread starts */
+    mt_msg_pool_init();
 
     /*
      The handle may come in pre-populated.
@@ -2327,19 +3995,62 @@ int MT_MSG_interfaceCreate(struct mt_msg_interface *pMI)
         goto bad;
     }
 
+    /* twice the largest frame */
+    memset((void *)(&(pMI->rx_ring)), 0, sizeof(pMI->rx_ring));
+    pMI->rx_ring.size = 2 * MT_MSG_POOL_LARGE_SIZE;
+    pMI->rx_ring.pBuf = malloc(pMI->rx_ring.size);
+    if(pMI->rx_ring.pBuf == NULL)
+    {
+        goto bad;
+    }
+
+    pMI->pLatency = calloc(MT_MSG_LAT_nHists, sizeof(*(pMI->pLatency)));
+    if(pMI->pLatency == NULL)
+    {
+        goto bad;
+    }
+    pMI->latency_log_last = TIMER_timeoutStart();
+
     r= MT_MSG_LIST_create(&(pMI->rx_list), pMI->dbg_name, "rx-msgs");
     if(r != 0)
     {
         goto bad;
     }
+    pMI->rx_list.ppPrio = pMI->rx_prio;
+    if(pMI->rx_capacity > 0)
+    {
+        MT_MSG_LIST_setLimit(&(pMI->rx_list),
+                             (unsigned)(pMI->rx_capacity),
+                             pMI->rx_policy,
+                             pMI->rx_block_mSecs,
+                             pMI->rx_coalesce_fn ?
+                             pMI->rx_coalesce_fn : MT_MSG_coalesceDataInd);
+    }
+
+    r= MT_MSG_LIST_create(&(pMI->async_list), pMI->dbg_name, "async-msgs");
+    if(r != 0)
+    {
+        goto bad;
+    }
 
     pMI->tx_lock = MUTEX_create("mi-tx-lock");
-    pMI->srsp_semaphore = SEMAPHORE_create("srsp-semaphore", 0);
+    pMI->sreq_free_semaphore = SEMAPHORE_create("sreq-free-semaphore", 0);
+    for(r = 0 ; r < MT_MSG_SREQ_MAX_INFLIGHT ; r++)
+    {
+        pMI->sreq_table[r].pSreq = NULL;
+        pMI->sreq_table[r].is_stale = false;
+        pMI->sreq_table[r].done_semaphore =
+            SEMAPHORE_create("srsp-semaphore", 0);
+        if(pMI->sreq_table[r].done_semaphore == 0)
+        {
+            goto bad;
+        }
+    }
     pMI->tx_frag.tx_ack_semaphore = SEMAPHORE_create("frag-semaphore", 0);
     pMI->list_lock = MUTEX_create("mi-lock");
 
     if((pMI->tx_lock == 0) ||
-        (pMI->srsp_semaphore == 0) ||
+        (pMI->sreq_free_semaphore == 0) ||
         (pMI->tx_frag.tx_ack_semaphore == 0) ||
         (pMI->list_lock == 0))
     {
@@ -2401,13 +4112,47 @@ int MT_MSG_interfaceCreate(struct mt_msg_interface *pMI)
         pMI->tx_lock_timeout = 3000;
     }
 
-    /* create the thread last... because it is going to run */
-    pMI->rx_thread = THREAD_create(pMI->dbg_name,
-                                    mt_msg_rx_thread,
-                                    (intptr_t)(pMI),
-                                    THREAD_FLAGS_DEFAULT);
+    /* a few sreqs at a time, they fit in the embedded receive buffer */
+    if(pMI->sreq_max_inflight <= 0)
+    {
+        pMI->sreq_max_inflight = 4;
+    }
+    if(pMI->sreq_max_inflight > MT_MSG_SREQ_MAX_INFLIGHT)
+    {
+        pMI->sreq_max_inflight = MT_MSG_SREQ_MAX_INFLIGHT;
+    }
+
+    /* a batch must fit in the receive buffer of the embedded side */
+    if((pMI->tx_batch_max <= 0) ||
+       (pMI->tx_batch_max > pMI->sreq_max_inflight))
+    {
+        pMI->tx_batch_max = pMI->sreq_max_inflight;
+    }
+
+    /* by default, stop-and-wait fragmentation (same as the embedded side) */
+    if(pMI->tx_frag_window <= 0)
+    {
+        pMI->tx_frag_window = 1;
+    }
+    if(pMI->tx_frag_window > MT_MSG_FRAG_MAX_WINDOW)
+    {
+        pMI->tx_frag_window = MT_MSG_FRAG_MAX_WINDOW;
+    }
+
+    /* async workers are only started if MT_MSG_txrx_async() is used */
+    if(pMI->async_workers <= 0)
+    {
+        pMI->async_workers = 4;
+    }
+    if(pMI->async_workers > MT_MSG_ASYNC_MAX_WORKERS)
+    {
+        pMI->async_workers = MT_MSG_ASYNC_MAX_WORKERS;
+    }
 
-    if((pMI->hndl == 0) || (pMI->rx_thread == 0))
+    /* start reading last... because it is going to run */
+    r = mt_msg_rx_start(pMI);
+
+    if((pMI->hndl == 0) || (r != 0))
     {
     bad:
         /* problem? */
@@ -2460,10 +4205,13 @@ int MT_MSG_LIST_create(struct mt_msg_list *pML,
         pML->dbg_name = cp;
     }
     pML->sem = SEMAPHORE_create(dbg_name, 0);
-    pML->pList = NULL;
+    pML->room_sem = SEMAPHORE_create(dbg_name, 0);
+    pML->lock = MUTEX_create(dbg_name);
 
     if((pML->dbg_name == NULL) ||
-        (pML->sem == 0))
+        (pML->sem == 0) ||
+        (pML->room_sem == 0) ||
+        (pML->lock == 0))
     {
         MT_MSG_LIST_destroy(pML);
         return (-1);
@@ -2474,6 +4222,236 @@ int MT_MSG_LIST_create(struct mt_msg_list *pML,
     }
 }
 
+/*
+  Set the priority class of received messages
+  see mt_msg.h
+*/
+int MT_MSG_setRxPrio(struct mt_msg_interface *pMI,
+                     int cmd0, int cmd1, enum mt_msg_prio prio)
+{
+    uint8_t *pTable;
+
+    if(!_inrange(prio, 0, MT_MSG_PRIO_nClasses) ||
+       !_inrange(cmd1, -1, 256))
+    {
+        return (-1);
+    }
+
+    /* Lower bits[4:0] = subsystem number */
+    pTable = pMI->rx_prio[cmd0 & 0x1f];
+    if(pTable == NULL)
+    {
+        pTable = malloc(256);
+        if(pTable == NULL)
+        {
+            return (-1);
+        }
+        memset((void *)(pTable), MT_MSG_PRIO_normal, 256);
+        pMI->rx_prio[cmd0 & 0x1f] = pTable;
+    }
+
+    if(cmd1 < 0)
+    {
+        memset((void *)(pTable), (int)(prio), 256);
+    }
+    else
+    {
+        pTable[cmd1] = (uint8_t)(prio);
+    }
+    return (0);
+}
+
+/*
+  Limit the number of messages in a list
+  see mt_msg.h
+*/
+void MT_MSG_LIST_setLimit(struct mt_msg_list *pML,
+                          unsigned capacity,
+                          enum mt_msg_list_policy policy,
+                          int block_mSecs,
+                          MT_MSG_LIST_coalesce_fn *pFn)
+{
+    MUTEX_lock(pML->lock, -1);
+    pML->capacity = capacity;
+    pML->policy = policy;
+    pML->block_mSecs = block_mSecs;
+    pML->pCoalesceFn = pFn;
+    MUTEX_unLock(pML->lock);
+}
+
+/*
+  Translate a policy name
+  see mt_msg.h
+*/
+int MT_MSG_LIST_policyFromName(const char *name)
+{
+    static const char * const names[] = {
+        "drop-oldest", "drop-newest", "block", "coalesce", NULL
+    };
+    int x;
+
+    for(x = 0 ; names[x] ; x++)
+    {
+        if(0 == strcmp(name, names[x]))
+        {
+            return (x);
+        }
+    }
+    return (-1);
+}
+
+/* MAC data indication, see process_areq_data_ind() in api_mac.c */
+#define MT_MSG_DATA_IND_cmd0      0x42
+#define MT_MSG_DATA_IND_cmd1      0x85
+/* source address mode, and 8 address bytes */
+#define MT_MSG_DATA_IND_SRC_LEN   9
+
+/*
+  Coalesce test for MAC data indications
+  see mt_msg.h
+*/
+bool MT_MSG_coalesceDataInd(struct mt_msg *pOld, struct mt_msg *pNew)
+{
+    const uint8_t *pO;
+    const uint8_t *pN;
+
+    if((pOld->cmd0 != MT_MSG_DATA_IND_cmd0) ||
+       (pOld->cmd1 != MT_MSG_DATA_IND_cmd1) ||
+       (pNew->cmd0 != pOld->cmd0) ||
+       (pNew->cmd1 != pOld->cmd1) ||
+       (pOld->pSrcIface == NULL) ||
+       (pNew->pSrcIface == NULL) ||
+       (pOld->expected_len <= MT_MSG_DATA_IND_MSDU_OFS) ||
+       (pNew->expected_len <= MT_MSG_DATA_IND_MSDU_OFS))
+    {
+        return (false);
+    }
+
+    pO = &(pOld->iobuf[ mt_msg_hdr_len(pOld->pSrcIface) ]);
+    pN = &(pNew->iobuf[ mt_msg_hdr_len(pNew->pSrcIface) ]);
+    if(memcmp(pO, pN, MT_MSG_DATA_IND_SRC_LEN) != 0)
+    {
+        return (false);
+    }
+    /* a report does not replace, ie: a config response */
+    return (pO[MT_MSG_DATA_IND_MSDU_OFS] == pN[MT_MSG_DATA_IND_MSDU_OFS]);
+}
+
+/*!
+ * @brief Replace an obsolete message with a new one, the lock is held
+ * @param pML - the list
+ * @param pLane - the class of pMsg
+ * @param pMsg - the new message
+ * @returns true if pMsg took the place of an older message
+ */
+static bool mt_msg_list_coalesce(struct mt_msg_list *pML,
+                                 struct mt_msg_list_lane *pLane,
+                                 struct mt_msg *pMsg)
+{
+    struct mt_msg **ppOld;
+    struct mt_msg *pOld;
+
+    if(pML->pCoalesceFn == NULL)
+    {
+        return (false);
+    }
+
+    for(ppOld = &(pLane->pList) ; *ppOld ; ppOld = &((*ppOld)->pListNext))
+    {
+        pOld = *ppOld;
+        if(!(*(pML->pCoalesceFn))(pOld, pMsg))
+        {
+            continue;
+        }
+        /* the new one waits where the old one waited */
+        pMsg->pListNext = pOld->pListNext;
+        *ppOld = pMsg;
+        if(pLane->pTail == pOld)
+        {
+            pLane->pTail = pMsg;
+        }
+        pLane->n_inserted++;
+        pML->n_coalesced++;
+        /* free would release the rest of the list */
+        pOld->pListNext = NULL;
+        MT_MSG_free(pOld);
+        return (true);
+    }
+    return (false);
+}
+
+/*!
+ * @brief Drop the oldest message that is not more important, the lock is held
+ * @param pML - the list
+ * @param prio - the class of the new message
+ * @returns true if a message was dropped
+ */
+static bool mt_msg_list_drop_oldest(struct mt_msg_list *pML, int prio)
+{
+    struct mt_msg_list_lane *pLane;
+    struct mt_msg *pMsg;
+    int x;
+
+    for(x = MT_MSG_PRIO_nClasses - 1 ; x >= prio ; x--)
+    {
+        pLane = &(pML->lanes[x]);
+        pMsg = pLane->pList;
+        if(pMsg == NULL)
+        {
+            continue;
+        }
+        pLane->pList = pMsg->pListNext;
+        if(pLane->pList == NULL)
+        {
+            pLane->pTail = NULL;
+        }
+        pMsg->pListNext = NULL;
+        pLane->depth--;
+        pML->depth--;
+        MT_MSG_free(pMsg);
+        /* its semaphore count goes with it */
+        SEMAPHORE_waitWithTimeout(pML->sem, 0);
+        return (true);
+    }
+    return (false);
+}
+
+/*!
+ * @brief Wait for room in a full list, the lock is held
+ * @param pML - the list
+ * @returns true if there is room
+ */
+static bool mt_msg_list_wait_room(struct mt_msg_list *pML)
+{
+    unsigned tstart;
+    int wait_mSecs;
+
+    pML->n_blocked++;
+    tstart = TIMER_timeoutStart();
+    while(pML->depth >= pML->capacity)
+    {
+        wait_mSecs = pML->block_mSecs;
+        if(wait_mSecs >= 0)
+        {
+            if(TIMER_timeoutIsExpired(tstart, pML->block_mSecs))
+            {
+                return (false);
+            }
+            /* check the time now and then, a post may be stale */
+            if(wait_mSecs > 100)
+            {
+                wait_mSecs = 100;
+            }
+        }
+        pML->n_waiting++;
+        MUTEX_unLock(pML->lock);
+        SEMAPHORE_waitWithTimeout(pML->room_sem, wait_mSecs);
+        MUTEX_lock(pML->lock, -1);
+        pML->n_waiting--;
+    }
+    return (true);
+}
+
 /*
   Insert a message into this message list.
   see mt_msg.h
@@ -2482,53 +4460,285 @@ void MT_MSG_LIST_insert(struct mt_msg_interface *pMI,
                          struct mt_msg_list *pML,
                          struct mt_msg *pMsg)
 {
-    struct mt_msg **ppMsg;
+    struct mt_msg_list_lane *pLane;
+    const uint8_t *pTable;
+    bool dropped;
+    bool room;
+    int prio;
 
-    MUTEX_lock(pMI->list_lock,-1);
-    ppMsg = &(pML->pList);
+    /* each list has its own lock */
+    (void)(pMI);
 
     /* nothing follows this guy */
     pMsg->pListNext = NULL;
 
-    /* goto end of the list */
-    while(*ppMsg)
+    prio = MT_MSG_PRIO_normal;
+    if(pML->ppPrio)
+    {
+        pTable = pML->ppPrio[pMsg->cmd0 & 0x1f];
+        if(pTable)
+        {
+            prio = pTable[pMsg->cmd1 & 0xff];
+        }
+    }
+    pLane = &(pML->lanes[prio]);
+
+    MUTEX_lock(pML->lock, -1);
+
+    if(pML->capacity && (pML->depth >= pML->capacity))
+    {
+        switch(pML->policy)
+        {
+        case MT_MSG_LIST_POLICY_coalesce:
+            if(mt_msg_list_coalesce(pML, pLane, pMsg))
+            {
+                /* the depth did not change, no one to wake */
+                MUTEX_unLock(pML->lock);
+                return;
+            }
+            /* fall through */
+        default:
+        case MT_MSG_LIST_POLICY_drop_oldest:
+            room = mt_msg_list_drop_oldest(pML, prio);
+            dropped = true;
+            break;
+        case MT_MSG_LIST_POLICY_drop_newest:
+            room = false;
+            dropped = true;
+            break;
+        case MT_MSG_LIST_POLICY_block:
+            room = mt_msg_list_wait_room(pML);
+            dropped = !room;
+            break;
+        }
+
+        if(dropped)
+        {
+            pML->n_dropped++;
+        }
+        /* 1, 2, 4, 8 ... do not flood the log */
+        if(dropped && ((pML->n_dropped & (pML->n_dropped - 1)) == 0))
+        {
+            LOG_printf(LOG_WARN, "%s: full (%u), dropped: %u\n",
+                       pML->dbg_name, pML->capacity, pML->n_dropped);
+        }
+        if(!room)
+        {
+            MUTEX_unLock(pML->lock);
+            MT_MSG_log(LOG_DBG_MT_MSG_traffic, pMsg, "list full, dropped\n");
+            MT_MSG_free(pMsg);
+            return;
+        }
+    }
+
+    /* add to end */
+    if(pLane->pTail)
+    {
+        pLane->pTail->pListNext = pMsg;
+    }
+    else
+    {
+        pLane->pList = pMsg;
+    }
+    pLane->pTail = pMsg;
+
+    pLane->n_inserted++;
+    pLane->depth++;
+    if(pLane->depth > pLane->high_water)
+    {
+        pLane->high_water = pLane->depth;
+    }
+    pML->depth++;
+    if(pML->depth > pML->high_water)
+    {
+        pML->high_water = pML->depth;
+    }
+
+    MUTEX_unLock(pML->lock);
+
+    SEMAPHORE_put(pML->sem);
+}
+
+/*!
+ * @brief Remove the next message of a list, the list lock must be held.
+ * @param pML - the list
+ * @returns NULL if empty, or the message
+ *
+ * The highest class with messages is served, unless a lower class
+ * has waited for MT_MSG_PRIO_STARVE_LIMIT messages.
+ */
+static struct mt_msg *mt_msg_list_pop(struct mt_msg_list *pML)
+{
+    struct mt_msg_list_lane *pLane;
+    struct mt_msg *pMsg;
+    int first;
+    int x;
+
+    for(first = 0 ; first < MT_MSG_PRIO_nClasses ; first++)
+    {
+        if(pML->lanes[first].pList)
+        {
+            break;
+        }
+    }
+    if(first == MT_MSG_PRIO_nClasses)
+    {
+        return (NULL);
+    }
+
+    /* has a lower class waited long enough? */
+    for(x = MT_MSG_PRIO_nClasses - 1 ; x > first ; x--)
+    {
+        if(pML->lanes[x].pList &&
+           (pML->lanes[x].n_bypass >= MT_MSG_PRIO_STARVE_LIMIT))
+        {
+            first = x;
+            break;
+        }
+    }
+
+    /* everyone else that is waiting, waits a bit longer */
+    for(x = 0 ; x < MT_MSG_PRIO_nClasses ; x++)
+    {
+        if((x == first) || (pML->lanes[x].pList == NULL))
+        {
+            pML->lanes[x].n_bypass = 0;
+        }
+        else
+        {
+            pML->lanes[x].n_bypass++;
+        }
+    }
+
+    pLane = &(pML->lanes[first]);
+    pMsg = pLane->pList;
+    pLane->pList = pMsg->pListNext;
+    if(pLane->pList == NULL)
+    {
+        pLane->pTail = NULL;
+    }
+    pMsg->pListNext = NULL;
+    pLane->depth--;
+    pML->depth--;
+
+    if(pML->n_waiting)
+    {
+        SEMAPHORE_put(pML->room_sem);
+    }
+    return (pMsg);
+}
+
+/*
+  Remove a message from this message list.
+  see mt_msg.h
+*/
+struct mt_msg *MT_MSG_LIST_remove(struct mt_msg_interface *pMI,
+                            struct mt_msg_list *pML, int timeout_mSecs)
+{
+    struct mt_msg *pMsg;
+
+    (void)(pMI);
+
+    /* did data arrive? */
+    SEMAPHORE_waitWithTimeout(pML->sem, timeout_mSecs);
+
+    /* remove */
+    MUTEX_lock(pML->lock, -1);
+    pMsg = mt_msg_list_pop(pML);
+    MUTEX_unLock(pML->lock);
+
+    return (pMsg);
+}
+
+/*
+  Remove several messages from this message list.
+  see mt_msg.h
+*/
+int MT_MSG_LIST_removeN(struct mt_msg_interface *pMI,
+                        struct mt_msg_list *pML,
+                        struct mt_msg **ppMsgs,
+                        int nmax,
+                        int timeout_mSecs)
+{
+    int n;
+    int x;
+
+    (void)(pMI);
+
+    if(nmax <= 0)
+    {
+        return (0);
+    }
+
+    /* wait for the first one */
+    SEMAPHORE_waitWithTimeout(pML->sem, timeout_mSecs);
+
+    MUTEX_lock(pML->lock, -1);
+    for(n = 0 ; n < nmax ; n++)
+    {
+        ppMsgs[n] = mt_msg_list_pop(pML);
+        if(ppMsgs[n] == NULL)
+        {
+            break;
+        }
+    }
+    MUTEX_unLock(pML->lock);
+
+    /* consume the semaphore counts for the extra messages */
+    for(x = 1 ; x < n ; x++)
     {
-        ppMsg = &((*ppMsg)->pListNext);
+        SEMAPHORE_waitWithTimeout(pML->sem, 0);
     }
-
-    /* add to end */
-    *ppMsg = pMsg;
-
-    MUTEX_unLock(pMI->list_lock);
-
-    SEMAPHORE_put(pML->sem);
+    return (n);
 }
 
 /*
-  Remove a message from this message list.
+  Log the depth of each priority class
   see mt_msg.h
 */
-struct mt_msg *MT_MSG_LIST_remove(struct mt_msg_interface *pMI,
-                            struct mt_msg_list *pML, int timeout_mSecs)
+void MT_MSG_LIST_log(struct mt_msg_list *pML, int64_t why)
 {
-    struct mt_msg *pMsg;
-
-    /* did data arrive? */
-    SEMAPHORE_waitWithTimeout(pML->sem, timeout_mSecs);
-
-    /* remove */
-    MUTEX_lock(pMI->list_lock, -1);
+    static const char * const names[ MT_MSG_PRIO_nClasses ] = {
+        "high", "normal", "low"
+    };
+    struct mt_msg_list_lane lanes[ MT_MSG_PRIO_nClasses ];
+    unsigned depth;
+    unsigned high_water;
+    unsigned n_dropped;
+    unsigned n_coalesced;
+    unsigned n_blocked;
+    int x;
 
-    pMsg = pML->pList;
-    if(pMsg)
+    if((pML->dbg_name == NULL) || !LOG_test(why))
     {
-        pML->pList = pMsg->pListNext;
-        pMsg->pListNext = NULL;
+        return;
     }
 
-    MUTEX_unLock(pMI->list_lock);
+    MUTEX_lock(pML->lock, -1);
+    memcpy((void *)(lanes), (void *)(pML->lanes), sizeof(lanes));
+    depth = pML->depth;
+    high_water = pML->high_water;
+    n_dropped = pML->n_dropped;
+    n_coalesced = pML->n_coalesced;
+    n_blocked = pML->n_blocked;
+    MUTEX_unLock(pML->lock);
 
-    return (pMsg);
+    LOG_printf(why, "%s: depth: %u, high-water: %u, "
+               "dropped: %u, coalesced: %u, blocked: %u\n",
+               pML->dbg_name, depth, high_water,
+               n_dropped, n_coalesced, n_blocked);
+    for(x = 0 ; x < MT_MSG_PRIO_nClasses ; x++)
+    {
+        if(lanes[x].n_inserted == 0)
+        {
+            continue;
+        }
+        LOG_printf(why, "%s:   %-6s depth: %u, high-water: %u, total: %u\n",
+                   pML->dbg_name, names[x],
+                   lanes[x].depth,
+                   lanes[x].high_water,
+                   lanes[x].n_inserted);
+    }
 }
 
 /*
@@ -2538,18 +4748,34 @@ struct mt_msg *MT_MSG_LIST_remove(struct mt_msg_interface *pMI,
 void MT_MSG_LIST_destroy(struct mt_msg_list *pML)
 {
     struct mt_msg *pMsg;
+    int x;
 
     /* the list might be in a strange state */
     /* not fully initialized */
     /* do this carefully */
 
-    while(pML->pList)
+    if(pML->lock)
     {
-        pMsg = pML->pList;
-        pML->pList = pMsg->pListNext;
-        pMsg->pListNext = NULL;
+        MT_MSG_LIST_log(pML, LOG_DBG_MT_MSG_traffic);
+    }
 
-        MT_MSG_free(pMsg);
+    for(x = 0 ; x < MT_MSG_PRIO_nClasses ; x++)
+    {
+        while(pML->lanes[x].pList)
+        {
+            pMsg = pML->lanes[x].pList;
+            pML->lanes[x].pList = pMsg->pListNext;
+            pMsg->pListNext = NULL;
+
+            MT_MSG_free(pMsg);
+        }
+        pML->lanes[x].pTail = NULL;
+    }
+
+    if(pML->lock)
+    {
+        MUTEX_destroy(pML->lock);
+        pML->lock = 0;
     }
 
     if(pML->sem)
@@ -2558,6 +4784,12 @@ void MT_MSG_LIST_destroy(struct mt_msg_list *pML)
         pML->sem = 0;
     }
 
+    if(pML->room_sem)
+    {
+        SEMAPHORE_destroy(pML->room_sem);
+        pML->room_sem = 0;
+    }
+
     if(pML->dbg_name)
     {
         free_const((const void *)(pML->dbg_name));
@@ -2575,24 +4807,23 @@ void MT_MSG_LIST_destroy(struct mt_msg_list *pML)
 int MT_MSG_txrx(struct mt_msg *pMsg)
 {
     int r;
+    int timeout_mSecs;
     struct mt_msg_interface *pMI;
+    struct mt_msg_sreq_slot *pSlot;
 
     /* get our destination interface */
     pMI = pMsg->pDestIface;
-
-    /* do not transmit 2 messages at the same time */
-    r = MUTEX_lock(pMI->tx_lock, pMI->tx_lock_timeout);
-    if(r != 0)
-    {
-        LOG_printf(LOG_ERROR, "%s: Interface lock timeout\n", pMI->dbg_name);
-        MT_MSG_log(LOG_ERROR, pMsg, "Interface lock timeout\n");
-        /* we transmitted zero messages */
-        return (0);
-    }
+    pSlot = NULL;
 
     /* We have no response yet */
     pMsg->pSrsp = NULL;
 
+    /* async requests are stamped when queued */
+    if(pMsg->stamp_nSecs[MT_MSG_STAMP_tx_start] == 0)
+    {
+        MT_MSG_stamp(pMsg, MT_MSG_STAMP_tx_start);
+    }
+
     MT_MSG_set_type(pMsg, pMI);
 
     if(pMsg->m_type == MT_MSG_TYPE_unknown)
@@ -2601,19 +4832,39 @@ int MT_MSG_txrx(struct mt_msg *pMsg)
     }
 
     /* we are about to send an SREQ */
-    if(pMI->pCurSreq)
+    if(pMsg->m_type == MT_MSG_TYPE_sreq)
+    {
+        /* this is our pending SREQ... */
+        /* claim it before sending, the srsp might be very quick */
+        /* this also takes the tx_lock, see mt_msg_sreq_claim() */
+        pSlot = mt_msg_sreq_claim(pMI, pMsg, pMI->tx_lock_timeout);
+        if(pSlot == NULL)
+        {
+            LOG_printf(LOG_ERROR, "%s: sreq slot timeout\n", pMI->dbg_name);
+            MT_MSG_log(LOG_ERROR, pMsg, "sreq slot timeout\n");
+            /* we transmitted zero messages */
+            return (0);
+        }
+    }
+    else
     {
-        /* There should *not* be any pending
-         * or left over SREQ from before...
-         * if there is one, it is a bug. */
-        BUG_HERE("interface: %s, has a pending SREQ!\n", pMI->dbg_name);
+        /* do not transmit 2 messages at the same time */
+        r = MUTEX_lock(pMI->tx_lock, pMI->tx_lock_timeout);
+        if(r != 0)
+        {
+            LOG_printf(LOG_ERROR, "%s: Interface lock timeout\n", pMI->dbg_name);
+            MT_MSG_log(LOG_ERROR, pMsg, "Interface lock timeout\n");
+            /* we transmitted zero messages */
+            return (0);
+        }
     }
 
-    /* this is our pending SREQ... */
-    pMI->pCurSreq = pMsg;
     /* send our message */
     r = MT_MSG_tx(pMsg);
 
+    /* the response is not sent under the lock */
+    MUTEX_unLock(pMI->tx_lock);
+
     /* could we send it? */
     if(r != 1)
     {
@@ -2622,8 +4873,6 @@ int MT_MSG_txrx(struct mt_msg *pMsg)
                    "Cannot transmit, result: %d (expected: 1)\n", r);
 
         /* No, ... cleanup */
-        /* we have nothing pending any more. */
-        pMI->pCurSreq = NULL;
         pMsg->is_error = true;
         /* did not transmit and did not receive */
         r = 0;
@@ -2633,18 +4882,17 @@ int MT_MSG_txrx(struct mt_msg *pMsg)
     /* we transmitted, so our result so far is 1. */
     r = 1;
     /* is this a command expecting a response? */
-    if(pMsg->m_type != MT_MSG_TYPE_sreq)
-    {
-        /* we have nothing pending any more. */
-        pMI->pCurSreq = NULL;
-    }
-    else
+    if(pSlot)
     {
+        timeout_mSecs = pMsg->srsp_timeout_mSecs;
+        if(timeout_mSecs <= 0)
+        {
+            timeout_mSecs = pMI->srsp_timeout_mSecs;
+        }
         /* wait for the response... */
-        SEMAPHORE_waitWithTimeout(pMI->srsp_semaphore, pMI->srsp_timeout_mSecs);
-        /* clear the SREQ  */
-        pMI->pCurSreq = NULL;
+        SEMAPHORE_waitWithTimeout(pSlot->done_semaphore, timeout_mSecs);
         /* Did we get our answer?  */
+        MUTEX_lock(pMI->list_lock, -1);
         if(pMsg->pSrsp)
         {
             /* Yea!! Success! */
@@ -2652,12 +4900,391 @@ int MT_MSG_txrx(struct mt_msg *pMsg)
             r = r + 1;
             /* --- Total =2 */
         }
+        MUTEX_unLock(pMI->list_lock);
     }
 done:
-    MUTEX_unLock(pMI->tx_lock);
+    /* we have nothing pending any more. */
+    if(pSlot)
+    {
+        mt_msg_sreq_release(pMI, pSlot, (r > 0));
+    }
     return (r);
 }
 
+/*!
+ * @brief Size of a message once framed, or 0 if it cannot be batched
+ * @param pMsg - the message, the destination is set
+ * @returns upper bound of the frame size in bytes
+ *
+ * See MT_MSG_tx(), shared messages and fragments are not batched.
+ */
+static int mt_msg_batch_size(struct mt_msg *pMsg)
+{
+    struct mt_msg_interface *pMI;
+    int nbytes;
+
+    pMI = pMsg->pDestIface;
+    MT_MSG_set_type(pMsg, pMI);
+    if(pMsg->is_error || pMsg->pShared ||
+       (pMsg->m_type == MT_MSG_TYPE_unknown))
+    {
+        return (0);
+    }
+
+    nbytes = mt_msg_hdr_len(pMI);
+    if(pMsg->expected_len > 0)
+    {
+        nbytes += pMsg->expected_len;
+    }
+    if(nbytes < pMsg->iobuf_nvalid)
+    {
+        nbytes = pMsg->iobuf_nvalid;
+    }
+    if(!(pMI->len_2bytes) &&
+       ((nbytes > 256) || (nbytes >= pMI->tx_frag_size)))
+    {
+        return (0);
+    }
+    /* the checksum */
+    nbytes++;
+    if(nbytes > MT_MSG_TX_BATCH_SIZE)
+    {
+        return (0);
+    }
+    return (nbytes);
+}
+
+/*!
+ * @brief Claim in-flight sreq slots for the SREQs of a batch
+ * @param pMI - the interface
+ * @param ppMsgs - the messages
+ * @param n - number of messages
+ * @param ppSlots - filled in, NULL for messages that are not SREQs
+ * @param timeout_mSecs - how long to wait for slots
+ * @returns number of messages (from the start) that may be sent, 0 on timeout
+ *
+ * As with mt_msg_sreq_claim(), on success the tx_lock is held, and
+ * at most sreq_max_inflight SREQs are in flight.
+ */
+static int mt_msg_sreq_claimBatch(struct mt_msg_interface *pMI,
+                                  struct mt_msg **ppMsgs,
+                                  int n,
+                                  struct mt_msg_sreq_slot **ppSlots,
+                                  int timeout_mSecs)
+{
+    unsigned tStart;
+    int nbusy;
+    int nfree;
+    int nsreq;
+    int m;
+    int x;
+    int y;
+    int r;
+
+    tStart = TIMER_getNow();
+    for(;;)
+    {
+        r = timeout_mSecs - (int)(TIMER_getNow() - tStart);
+        if(r <= 0)
+        {
+            return (0);
+        }
+        if(MUTEX_lock(pMI->tx_lock, r) != 0)
+        {
+            return (0);
+        }
+
+        MUTEX_lock(pMI->list_lock, -1);
+        nbusy = 0;
+        for(x = 0 ; x < MT_MSG_SREQ_MAX_INFLIGHT ; x++)
+        {
+            if(mt_msg_sreq_busy(pMI, &(pMI->sreq_table[x])))
+            {
+                nbusy++;
+            }
+        }
+        nfree = pMI->sreq_max_inflight - nbusy;
+
+        /* how many can go now? */
+        nsreq = 0;
+        for(m = 0 ; m < n ; m++)
+        {
+            if(ppMsgs[m]->m_type != MT_MSG_TYPE_sreq)
+            {
+                continue;
+            }
+            if(nsreq >= nfree)
+            {
+                break;
+            }
+            nsreq++;
+        }
+
+        /* claim in order, the srsps are matched in this order */
+        y = 0;
+        for(x = 0 ; x < m ; x++)
+        {
+            ppSlots[x] = NULL;
+            if(ppMsgs[x]->m_type != MT_MSG_TYPE_sreq)
+            {
+                continue;
+            }
+            while(mt_msg_sreq_busy(pMI, &(pMI->sreq_table[y])))
+            {
+                y++;
+            }
+            ppSlots[x] = &(pMI->sreq_table[y]);
+            mt_msg_sreq_take(pMI, ppSlots[x], ppMsgs[x]);
+        }
+        MUTEX_unLock(pMI->list_lock);
+
+        if(m > 0)
+        {
+            return (m);
+        }
+        MUTEX_unLock(pMI->tx_lock);
+
+        /* wait for a slot to be released */
+        r = timeout_mSecs - (int)(TIMER_getNow() - tStart);
+        if(r <= 0)
+        {
+            return (0);
+        }
+        if(r > 10)
+        {
+            r = 10;
+        }
+        SEMAPHORE_waitWithTimeout(pMI->sreq_free_semaphore, r);
+    }
+}
+
+/*!
+ * @brief Write a batch of messages with one write
+ * @param pMI - the interface
+ * @param ppMsgs - the messages, see mt_msg_batch_size()
+ * @param n - number of messages
+ * @returns true if all were written
+ *
+ * The tx_lock is held by the caller, see mt_msg_sreq_claimBatch()
+ */
+static bool mt_msg_tx_batch(struct mt_msg_interface *pMI,
+                            struct mt_msg **ppMsgs,
+                            int n)
+{
+    struct mt_msg *pMsg;
+    int nbytes;
+    int r;
+    int x;
+
+    if(pMI->pTxBatch == NULL)
+    {
+        pMI->pTxBatch = malloc(MT_MSG_TX_BATCH_SIZE);
+        if(pMI->pTxBatch == NULL)
+        {
+            MUTEX_unLock(pMI->tx_lock);
+            LOG_printf(LOG_ERROR, "%s: no memory for batch\n", pMI->dbg_name);
+            return (false);
+        }
+    }
+
+    /* insert frame sync, cmd0/1 and checksum, then pack */
+    nbytes = 0;
+    for(x = 0 ; x < n ; x++)
+    {
+        pMsg = ppMsgs[x];
+        if(pMsg->stamp_nSecs[MT_MSG_STAMP_tx_start] == 0)
+        {
+            MT_MSG_stamp(pMsg, MT_MSG_STAMP_tx_start);
+        }
+        MT_MSG_format_msg(pMsg);
+        MT_MSG_tx_log(pMsg, pMsg->iobuf, pMsg->iobuf_nvalid);
+        memcpy((void *)(&(pMI->pTxBatch[nbytes])),
+               (void *)(pMsg->iobuf),
+               pMsg->iobuf_nvalid);
+        nbytes += pMsg->iobuf_nvalid;
+    }
+
+    r = STREAM_wrBytes(pMI->hndl, (void *)(pMI->pTxBatch), nbytes, -1);
+
+    LOG_printf(LOG_DBG_MT_MSG_traffic,
+               "%s: TX batch (Complete) %d msgs, %d bytes r=%d\n",
+               pMI->dbg_name, n, nbytes, r);
+    if(r == nbytes)
+    {
+        for(x = 0 ; x < n ; x++)
+        {
+            pMsg = ppMsgs[x];
+            MT_MSG_stamp(pMsg, MT_MSG_STAMP_tx_done);
+            MT_MSG_CAPTURE_frame(pMI, MT_MSG_CAPTURE_tx,
+                                 pMsg->iobuf, pMsg->iobuf_nvalid,
+                                 pMsg->stamp_nSecs[MT_MSG_STAMP_tx_done]);
+        }
+    }
+    MUTEX_unLock(pMI->tx_lock);
+
+    if(r != nbytes)
+    {
+        LOG_printf(LOG_ERROR, "%s: cannot transmit batch r=%d\n",
+                   pMI->dbg_name, r);
+        return (false);
+    }
+    return (true);
+}
+
+/*
+  Transmit several messages in one write
+  see mt_msg.h
+*/
+int MT_MSG_txrxBatch(struct mt_msg **ppMsgs, int n, int *pResults)
+{
+    struct mt_msg_sreq_slot *pSlots[ MT_MSG_SREQ_MAX_INFLIGHT ];
+    struct mt_msg_interface *pMI;
+    struct mt_msg *pMsg;
+    int timeout_mSecs;
+    int nbytes;
+    int nsent;
+    bool ok;
+    int m;
+    int x;
+    int y;
+
+    nsent = 0;
+    x = 0;
+    while(x < n)
+    {
+        pMsg = ppMsgs[x];
+        pMI = pMsg->pDestIface;
+        pMsg->pSrsp = NULL;
+
+        /* the run of messages that can go in one write */
+        nbytes = 0;
+        for(m = 0 ; (m < pMI->tx_batch_max) && ((x + m) < n) ; m++)
+        {
+            pMsg = ppMsgs[x + m];
+            pMsg->pSrsp = NULL;
+            y = (pMsg->pDestIface == pMI) ? mt_msg_batch_size(pMsg) : 0;
+            if((y == 0) || ((nbytes + y) > MT_MSG_TX_BATCH_SIZE))
+            {
+                break;
+            }
+            nbytes += y;
+        }
+        if(m == 0)
+        {
+            /* the hard way */
+            pResults[x] = MT_MSG_txrx(ppMsgs[x]);
+            nsent += (pResults[x] > 0) ? 1 : 0;
+            x++;
+            continue;
+        }
+
+        m = mt_msg_sreq_claimBatch(pMI, &(ppMsgs[x]), m, pSlots,
+                                   pMI->tx_lock_timeout);
+        if(m == 0)
+        {
+            LOG_printf(LOG_ERROR, "%s: sreq slot timeout\n", pMI->dbg_name);
+            MT_MSG_log(LOG_ERROR, ppMsgs[x], "sreq slot timeout\n");
+            pResults[x] = 0;
+            x++;
+            continue;
+        }
+
+        ok = mt_msg_tx_batch(pMI, &(ppMsgs[x]), m);
+
+        for(y = 0 ; y < m ; y++)
+        {
+            pMsg = ppMsgs[x + y];
+            pResults[x + y] = ok ? 1 : 0;
+            if(!ok)
+            {
+                pMsg->is_error = true;
+            }
+            else
+            {
+                nsent++;
+            }
+            if(pSlots[y] == NULL)
+            {
+                continue;
+            }
+            if(ok)
+            {
+                timeout_mSecs = pMsg->srsp_timeout_mSecs;
+                if(timeout_mSecs <= 0)
+                {
+                    timeout_mSecs = pMI->srsp_timeout_mSecs;
+                }
+                SEMAPHORE_waitWithTimeout(pSlots[y]->done_semaphore,
+                                          timeout_mSecs);
+                MUTEX_lock(pMI->list_lock, -1);
+                if(pMsg->pSrsp)
+                {
+                    pResults[x + y] = 2;
+                }
+                MUTEX_unLock(pMI->list_lock);
+            }
+            mt_msg_sreq_release(pMI, pSlots[y], ok);
+        }
+        x += m;
+    }
+    return (nsent);
+}
+
+/*
+  Queue a message for MT_MSG_txrx() by an async worker
+  see mt_msg.h
+*/
+int MT_MSG_txrx_async(struct mt_msg *pMsg,
+                      MT_MSG_txrx_done_fn *pDoneFn,
+                      intptr_t cookie)
+{
+    struct mt_msg_interface *pMI;
+    char buf[40];
+    int r;
+    int x;
+
+    pMI = pMsg->pDestIface;
+    if((pMI == NULL) || (pMI->is_dead) || (pMI->async_list.sem == 0))
+    {
+        MT_MSG_log(LOG_ERROR, pMsg, "async: interface is not usable\n");
+        return (-1);
+    }
+
+    /* start the workers the first time */
+    r = 0;
+    MUTEX_lock(pMI->list_lock, -1);
+    for(x = 0 ; x < pMI->async_workers ; x++)
+    {
+        if(pMI->async_threads[x])
+        {
+            continue;
+        }
+        (void)snprintf(buf, sizeof(buf), "%s-async-%d", pMI->dbg_name, x);
+        pMI->async_threads[x] = THREAD_create(buf,
+                                              mt_msg_async_thread,
+                                              (intptr_t)(pMI),
+                                              THREAD_FLAGS_DEFAULT);
+        if(pMI->async_threads[x] == 0)
+        {
+            r = -1;
+            break;
+        }
+    }
+    MUTEX_unLock(pMI->list_lock);
+
+    if(r != 0)
+    {
+        MT_MSG_log(LOG_ERROR, pMsg, "async: cannot create worker\n");
+        return (r);
+    }
+
+    pMsg->pAsyncDone = pDoneFn;
+    pMsg->async_cookie = cookie;
+    MT_MSG_stamp(pMsg, MT_MSG_STAMP_tx_start);
+    MT_MSG_LIST_insert(pMI, &(pMI->async_list), pMsg);
+    return (0);
+}
+
 /*
   mark this cmd0 byte as a poll.
   Public function mt_msg.h
@@ -0,0 +1,599 @@
+/******************************************************************************
+ @file mt_msg_bench.c
+
+ @brief TIMAC 2.0 API loopback throughput and latency benchmark
+
+ Group: WCS LPC
+ $Target Device: DEVICES $
+
+ ******************************************************************************
+ $License: BSD3 2016 $
+ ******************************************************************************
+ $Release Name: PACKAGE NAME $
+ $Release Date: PACKAGE RELEASE DATE $
+ *****************************************************************************/
+
+/******************************************************************************
+ Includes
+*****************************************************************************/
+
+#include "compiler.h"
+#include "mt_msg.h"
+#include "log.h"
+#include "timer.h"
+#include "threads.h"
+#include "ti_semaphore.h"
+#include "rand_data.h"
+#include "stream.h"
+#include "stream_socket.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/******************************************************************************
+ Typedefs
+*****************************************************************************/
+
+/*!
+ * @struct bench_worker
+ * @brief One thread issuing loopback requests for a (size, depth) point
+ */
+struct bench_worker {
+    /*! where the requests go */
+    struct mt_msg_interface *pIface;
+    /*! posted by the main thread to start all workers at once */
+    intptr_t start_sem;
+    /*! posted by the worker when it is finished */
+    intptr_t done_sem;
+    /*! the worker thread */
+    intptr_t thread;
+    /*! payload size */
+    int size;
+    /*! how many requests this worker issues */
+    int n_msgs;
+    /*! payload generator seed, unique to each worker */
+    uint32_t seed;
+    /*! results */
+    unsigned n_ok;
+    unsigned n_fail;
+    /*! round trip times */
+    struct mt_msg_lat_hist rtt;
+};
+
+/*!
+ * @struct bench_responder
+ * @brief The in-process end that answers loopback requests
+ */
+struct bench_responder {
+    /*! the accepted socket */
+    struct mt_msg_interface iface;
+    /*! the responder thread */
+    intptr_t thread;
+    /*! set to stop the responder thread */
+    volatile bool stop;
+    /*! number of requests answered */
+    unsigned n_answered;
+};
+
+/******************************************************************************
+ Functions
+*****************************************************************************/
+
+/*!
+ * @brief Worker thread, performs back to back loopback requests
+ * @param cookie - the struct bench_worker in disguise
+ * @return nothing important.
+ */
+static intptr_t bench_worker_thread(intptr_t cookie)
+{
+    struct bench_worker *pW;
+    struct rand_data_one rd;
+    uint8_t *pBuf;
+    uint64_t tStart;
+    int r;
+    int x;
+
+    pW = (struct bench_worker *)(cookie);
+    RAND_DATA_initOne(&rd, pW->seed);
+
+    /* never allocate zero bytes */
+    pBuf = malloc(pW->size + 1);
+
+    (void)SEMAPHORE_waitWithTimeout(pW->start_sem, -1);
+
+    for(x = 0 ; (pBuf != NULL) && (x < pW->n_msgs) ; x++)
+    {
+        RAND_DATA_generateBuf(&rd, pBuf, pW->size);
+        tStart = TIMER_getNow_nSecs();
+        r = MT_MSG_loopback(pW->pIface, 0, 0, pW->size, pBuf);
+        if(r != 2)
+        {
+            /* the link is not healthy, do not wait out more timeouts */
+            pW->n_fail++;
+            break;
+        }
+        MT_MSG_LAT_histAdd(&(pW->rtt), TIMER_getNow_nSecs() - tStart);
+        pW->n_ok++;
+    }
+    if(pBuf == NULL)
+    {
+        pW->n_fail++;
+    }
+    else
+    {
+        free((void *)(pBuf));
+    }
+
+    (void)SEMAPHORE_put(pW->done_sem);
+    return (0);
+}
+
+/*!
+ * @brief Write the start of the results
+ * @param pCfg - the benchmark configuration
+ */
+static void bench_out_header(const struct mt_msg_loopback_bench_cfg *pCfg)
+{
+    if(pCfg->format == 'j')
+    {
+        STREAM_printf(pCfg->hOut,
+                      "{\n  \"transport\": \"%s\",\n  \"points\": [",
+                      pCfg->transport);
+        return;
+    }
+    STREAM_printf(pCfg->hOut,
+                  "transport,size,depth,n_ok,n_fail,seconds,msgs_per_sec,"
+                  "bytes_per_sec,rtt_mean_us,rtt_p50_us,rtt_p99_us,"
+                  "rtt_max_us\n");
+}
+
+/*!
+ * @brief Write the results of one (size, depth) point
+ * @param pCfg - the benchmark configuration
+ * @param size - payload size
+ * @param depth - pipeline depth
+ * @param n_ok - number of successful loopbacks
+ * @param n_fail - number of failed loopbacks
+ * @param nSecs - how long the point took
+ * @param pRtt - the round trip times
+ * @param is_first - true for the first point
+ *
+ * The bytes per second is the payload bytes in one direction.
+ */
+static void bench_out_point(const struct mt_msg_loopback_bench_cfg *pCfg,
+                            int size,
+                            int depth,
+                            unsigned n_ok,
+                            unsigned n_fail,
+                            uint64_t nSecs,
+                            const struct mt_msg_lat_hist *pRtt,
+                            bool is_first)
+{
+    struct mt_msg_lat_summary s;
+    double secs;
+    double msgs_per_sec;
+
+    MT_MSG_LAT_histSummary(pRtt, &s);
+    secs = ((double)(nSecs)) / 1.0e9;
+    msgs_per_sec = (nSecs > 0) ? (((double)(n_ok)) / secs) : 0.0;
+
+    if(pCfg->format == 'j')
+    {
+        STREAM_printf(pCfg->hOut,
+                      "%s\n    { \"size\": %d, \"depth\": %d, "
+                      "\"n_ok\": %u, \"n_fail\": %u, \"seconds\": %.6f, "
+                      "\"msgs_per_sec\": %.1f, \"bytes_per_sec\": %.1f, "
+                      "\"rtt_us\": { \"mean\": %.1f, \"p50\": %.1f, "
+                      "\"p99\": %.1f, \"max\": %.1f } }",
+                      is_first ? "" : ",",
+                      size, depth, n_ok, n_fail, secs,
+                      msgs_per_sec, msgs_per_sec * size,
+                      ((double)(s.mean_nSecs)) / 1000.0,
+                      ((double)(s.p50_nSecs)) / 1000.0,
+                      ((double)(s.p99_nSecs)) / 1000.0,
+                      ((double)(s.max_nSecs)) / 1000.0);
+        return;
+    }
+    STREAM_printf(pCfg->hOut,
+                  "%s,%d,%d,%u,%u,%.6f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f\n",
+                  pCfg->transport, size, depth, n_ok, n_fail, secs,
+                  msgs_per_sec, msgs_per_sec * size,
+                  ((double)(s.mean_nSecs)) / 1000.0,
+                  ((double)(s.p50_nSecs)) / 1000.0,
+                  ((double)(s.p99_nSecs)) / 1000.0,
+                  ((double)(s.max_nSecs)) / 1000.0);
+}
+
+/*!
+ * @brief Write the end of the results
+ * @param pCfg - the benchmark configuration
+ */
+static void bench_out_footer(const struct mt_msg_loopback_bench_cfg *pCfg)
+{
+    if(pCfg->format == 'j')
+    {
+        STREAM_printf(pCfg->hOut, "\n  ]\n}\n");
+    }
+}
+
+/*!
+ * @brief Measure one (size, depth) point
+ * @param pIface - where to send the requests
+ * @param pCfg - the benchmark configuration
+ * @param size - payload size
+ * @param depth - number of worker threads
+ * @param is_first - true for the first point
+ * @returns number of failed loopbacks, negative on error
+ */
+static int bench_point(struct mt_msg_interface *pIface,
+                       const struct mt_msg_loopback_bench_cfg *pCfg,
+                       int size,
+                       int depth,
+                       bool is_first)
+{
+    struct bench_worker *pWorkers;
+    struct mt_msg_lat_hist *pRtt;
+    uint64_t tStart;
+    uint64_t nSecs;
+    unsigned n_ok;
+    unsigned n_fail;
+    intptr_t start_sem;
+    intptr_t done_sem;
+    char buf[40];
+    int r;
+    int x;
+
+    r = -1;
+    pWorkers = NULL;
+    pRtt = NULL;
+    start_sem = SEMAPHORE_create("bench-start", 0);
+    done_sem = SEMAPHORE_create("bench-done", 0);
+    if((start_sem == 0) || (done_sem == 0))
+    {
+        goto fail;
+    }
+    pWorkers = calloc(depth, sizeof(*pWorkers));
+    pRtt = calloc(1, sizeof(*pRtt));
+    if((pWorkers == NULL) || (pRtt == NULL))
+    {
+        goto fail;
+    }
+
+    for(x = 0 ; x < depth ; x++)
+    {
+        pWorkers[x].pIface = pIface;
+        pWorkers[x].start_sem = start_sem;
+        pWorkers[x].done_sem = done_sem;
+        pWorkers[x].size = size;
+        /* the first workers take the remainder */
+        pWorkers[x].n_msgs = (pCfg->n_msgs / depth) +
+            (x < (pCfg->n_msgs % depth));
+        pWorkers[x].seed = pCfg->seed + (uint32_t)(x);
+        (void)snprintf(buf, sizeof(buf), "bench-%d", x);
+        pWorkers[x].thread = THREAD_create(buf,
+                                           bench_worker_thread,
+                                           (intptr_t)(&(pWorkers[x])),
+                                           THREAD_FLAGS_DEFAULT);
+        if(pWorkers[x].thread == 0)
+        {
+            /* release the ones we have, they have nothing to do */
+            for(depth = x, x = 0 ; x < depth ; x++)
+            {
+                pWorkers[x].n_msgs = 0;
+            }
+            (void)SEMAPHORE_putN(start_sem, depth);
+            (void)SEMAPHORE_waitNWithTimeout(done_sem, depth, -1);
+            goto join;
+        }
+    }
+
+    /* go! */
+    tStart = TIMER_getNow_nSecs();
+    (void)SEMAPHORE_putN(start_sem, depth);
+    (void)SEMAPHORE_waitNWithTimeout(done_sem, depth, -1);
+    nSecs = TIMER_getNow_nSecs() - tStart;
+
+    n_ok = 0;
+    n_fail = 0;
+    for(x = 0 ; x < depth ; x++)
+    {
+        n_ok += pWorkers[x].n_ok;
+        n_fail += pWorkers[x].n_fail;
+        MT_MSG_LAT_histMerge(pRtt, &(pWorkers[x].rtt));
+    }
+    bench_out_point(pCfg, size, depth, n_ok, n_fail, nSecs, pRtt, is_first);
+    r = (int)(n_fail);
+
+join:
+    for(x = 0 ; x < depth ; x++)
+    {
+        while(THREAD_isAlive(pWorkers[x].thread))
+        {
+            TIMER_sleep(1);
+        }
+        THREAD_destroy(pWorkers[x].thread);
+    }
+fail:
+    if(r < 0)
+    {
+        LOG_printf(LOG_ERROR, "loopback-benchmark: cannot run "
+                   "size: %d depth: %d\n", size, depth);
+    }
+    if(pWorkers)
+    {
+        free((void *)(pWorkers));
+    }
+    if(pRtt)
+    {
+        free((void *)(pRtt));
+    }
+    if(start_sem)
+    {
+        SEMAPHORE_destroy(start_sem);
+    }
+    if(done_sem)
+    {
+        SEMAPHORE_destroy(done_sem);
+    }
+    return (r);
+}
+
+/*
+  Measure loopback throughput and round trip time
+  Public function defined in mt_msg.h
+*/
+int MT_MSG_loopbackBenchmark(struct mt_msg_interface *pIface,
+                             const struct mt_msg_loopback_bench_cfg *pCfg)
+{
+    bool is_first;
+    int result;
+    int depth;
+    int size;
+    int r;
+    int s;
+    int d;
+
+    for(s = 0 ; s < pCfg->n_sizes ; s++)
+    {
+        if(!_inrange(pCfg->pSizes[s], 0, MT_MSG_LOOPBACK_BENCH_MAX_SIZE + 1))
+        {
+            LOG_printf(LOG_ERROR, "loopback-benchmark: bad size: %d\n",
+                       pCfg->pSizes[s]);
+            return (-1);
+        }
+    }
+    for(d = 0 ; d < pCfg->n_depths ; d++)
+    {
+        if(!_inrange(pCfg->pDepths[d], 1, MT_MSG_LOOPBACK_BENCH_MAX_DEPTH + 1))
+        {
+            LOG_printf(LOG_ERROR, "loopback-benchmark: bad depth: %d\n",
+                       pCfg->pDepths[d]);
+            return (-1);
+        }
+    }
+
+    result = 0;
+    is_first = true;
+    bench_out_header(pCfg);
+    for(s = 0 ; s < pCfg->n_sizes ; s++)
+    {
+        size = pCfg->pSizes[s];
+        for(d = 0 ; d < pCfg->n_depths ; d++)
+        {
+            depth = pCfg->pDepths[d];
+            r = bench_point(pIface, pCfg, size, depth, is_first);
+            if(r < 0)
+            {
+                result = -1;
+                goto done;
+            }
+            is_first = false;
+            if(r > 0)
+            {
+                LOG_printf(LOG_ERROR, "loopback-benchmark: %s: %d failures, "
+                           "size: %d depth: %d\n",
+                           pIface->dbg_name, r, size, depth);
+                result = -1;
+            }
+        }
+    }
+done:
+    bench_out_footer(pCfg);
+    return (result);
+}
+
+/*!
+ * @brief Responder thread, answers loopback requests with their payload
+ * @param cookie - the struct bench_responder in disguise
+ * @return nothing important.
+ */
+static intptr_t bench_responder_thread(intptr_t cookie)
+{
+    struct bench_responder *pR;
+    struct mt_msg *pMsg;
+    struct mt_msg *pRsp;
+    int len;
+
+    pR = (struct bench_responder *)(cookie);
+    while(!(pR->stop))
+    {
+        pMsg = MT_MSG_LIST_remove(&(pR->iface), &(pR->iface.rx_list), 100);
+        if(pMsg == NULL)
+        {
+            continue;
+        }
+        if((pMsg->m_type != MT_MSG_TYPE_sreq) ||
+           (pMsg->cmd1 != MT_UTIL_LOOPBACK_cmd1) ||
+           (_bitsXYof(pMsg->cmd0, 4, 0) !=
+            _bitsXYof(MT_UTIL_LOOPBACK_cmd0, 4, 0)))
+        {
+            MT_MSG_log(LOG_ERROR, pMsg, "loopback-benchmark: unexpected\n");
+            MT_MSG_free(pMsg);
+            continue;
+        }
+
+        /* the reply is the request, repeat count and rate included */
+        len = pMsg->expected_len;
+        pRsp = MT_MSG_alloc(len, MT_MSG_cmd0_srsp(pMsg->cmd0), pMsg->cmd1);
+        if(pRsp)
+        {
+            MT_MSG_setDestIface(pRsp, &(pR->iface));
+            MT_MSG_wrBuf(pRsp, &(pMsg->iobuf[pMsg->iobuf_idx]), len);
+            if(MT_MSG_txrx(pRsp) == 1)
+            {
+                pR->n_answered++;
+            }
+            MT_MSG_free(pRsp);
+        }
+        MT_MSG_free(pMsg);
+    }
+    return (0);
+}
+
+/*!
+ * @brief Prepare an interface from a template
+ * @param pMI - the interface to prepare
+ * @param pTemplate - framing and timeout settings
+ * @param name - debug name
+ */
+static void bench_iface_init(struct mt_msg_interface *pMI,
+                             const struct mt_msg_interface *pTemplate,
+                             const char *name)
+{
+    *pMI = *pTemplate;
+    pMI->dbg_name = name;
+    pMI->is_NPI = false;
+    pMI->hndl = 0;
+    pMI->s_cfg = NULL;
+    pMI->u_cfg = NULL;
+    pMI->rx_thread = 0;
+    pMI->startup_flush = false;
+}
+
+/*
+  Run the loopback benchmark against an in-process responder
+  Public function defined in mt_msg.h
+*/
+int MT_MSG_loopbackBenchmarkInproc(const struct mt_msg_interface *pTemplate,
+                                   const char *service,
+                                   const struct mt_msg_loopback_bench_cfg *pCfg)
+{
+    struct mt_msg_interface client;
+    struct bench_responder *pR;
+    struct socket_cfg server_cfg;
+    struct socket_cfg client_cfg;
+    intptr_t hListener;
+    intptr_t hAccepted;
+    bool client_up;
+    bool server_up;
+    int r;
+
+    client_up = false;
+    server_up = false;
+    hListener = 0;
+    pR = calloc(1, sizeof(*pR));
+    if(pR == NULL)
+    {
+        BUG_HERE("No memory\n");
+    }
+
+    memset((void *)(&server_cfg), 0, sizeof(server_cfg));
+    server_cfg.inet_4or6 = 4;
+    server_cfg.ascp = 's';
+    server_cfg.host = "127.0.0.1";
+    server_cfg.service = service;
+    server_cfg.server_backlog = 1;
+
+    client_cfg = server_cfg;
+    client_cfg.ascp = 'c';
+    client_cfg.connect_timeout_mSecs = 2000;
+
+    r = -1;
+    hListener = SOCKET_SERVER_create(&server_cfg);
+    if(hListener == 0)
+    {
+        LOG_printf(LOG_ERROR, "loopback-benchmark: cannot create server\n");
+        goto done;
+    }
+    if(SOCKET_SERVER_listen(hListener) != 0)
+    {
+        LOG_printf(LOG_ERROR, "loopback-benchmark: cannot listen\n");
+        goto done;
+    }
+
+    /* the connection completes in the listen backlog */
+    bench_iface_init(&client, pTemplate, "bench-client");
+    client.s_cfg = &client_cfg;
+    if(MT_MSG_interfaceCreate(&client) != 0)
+    {
+        LOG_printf(LOG_ERROR, "loopback-benchmark: cannot connect\n");
+        goto done;
+    }
+    client_up = true;
+
+    bench_iface_init(&(pR->iface), pTemplate, "bench-responder");
+    if(SOCKET_SERVER_accept(&(pR->iface.hndl), hListener, 2000) != 1)
+    {
+        LOG_printf(LOG_ERROR, "loopback-benchmark: cannot accept\n");
+        goto done;
+    }
+    if(MT_MSG_interfaceCreate(&(pR->iface)) != 0)
+    {
+        SOCKET_ACCEPT_destroy(pR->iface.hndl);
+        goto done;
+    }
+    server_up = true;
+
+    pR->thread = THREAD_create("bench-responder",
+                               bench_responder_thread,
+                               (intptr_t)(pR),
+                               THREAD_FLAGS_DEFAULT);
+    if(pR->thread == 0)
+    {
+        goto done;
+    }
+
+    r = MT_MSG_loopbackBenchmark(&client, pCfg);
+
+    pR->stop = true;
+    while(THREAD_isAlive(pR->thread))
+    {
+        TIMER_sleep(1);
+    }
+    THREAD_destroy(pR->thread);
+    LOG_printf(LOG_DBG_MT_MSG_traffic, "loopback-benchmark: answered: %u\n",
+               pR->n_answered);
+
+done:
+    if(client_up)
+    {
+        MT_MSG_interfaceDestroy(&client);
+    }
+    if(server_up)
+    {
+        /* the interface only closes the accepted socket */
+        hAccepted = pR->iface.hndl;
+        MT_MSG_interfaceDestroy(&(pR->iface));
+        SOCKET_ACCEPT_destroy(hAccepted);
+    }
+    if(hListener)
+    {
+        SOCKET_SERVER_destroy(hListener);
+    }
+    free((void *)(pR));
+    return (r);
+}
+
+/*
+ *  ========================================
+ *  Texas Instruments Micro Controller Style
+ *  ========================================
+ *  Local Variables:
+ *  mode: c
+ *  c-file-style: "bsd"
+ *  tab-width: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  End:
+ *  vim:set  filetype=c tabstop=4 shiftwidth=4 expandtab=true
+ */
@@ -0,0 +1,855 @@
+/******************************************************************************
+ @file mt_msg_capture.c
+
+ @brief TIMAC 2.0 API capture and replay of MT frames
+
+ Group: WCS LPC
+ $Target Device: DEVICES $
+
+ ******************************************************************************
+ $License: BSD3 2016 $
+ ******************************************************************************
+ $Release Name: PACKAGE NAME $
+ $Release Date: PACKAGE RELEASE DATE $
+ *****************************************************************************/
+
+/******************************************************************************
+ Includes
+*****************************************************************************/
+
+#include "compiler.h"
+#include "mt_msg.h"
+#include "log.h"
+#include "timer.h"
+#include "mutex.h"
+#include "threads.h"
+#include "ti_semaphore.h"
+#include "stream.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/******************************************************************************
+ Constants and definitions
+*****************************************************************************/
+
+/*! Frames are collected in one of two buffers, the other is written */
+#define CAPTURE_BUF_SIZE       (64 * 1024)
+
+/*! A partly filled buffer is written after this long */
+#define CAPTURE_FLUSH_mSecs    1000
+
+/*! Interface numbers are one byte, 0 means not assigned */
+#define CAPTURE_MAX_IFACES     255
+
+/*! Records are padded to this */
+#define CAPTURE_ALIGN          8
+
+/*! Interface record flags */
+#define CAPTURE_IFACE_frame_sync  _bit0
+#define CAPTURE_IFACE_chksum      _bit1
+#define CAPTURE_IFACE_len_2bytes  _bit2
+
+/*!
+ * @struct mt_msg_capture
+ * @brief A running capture
+ *
+ * The rx and tx paths add records to pBuf. A full (or stale) buffer is
+ * handed to the writer thread as pFull, and the spare buffer takes its
+ * place, so the file is never written on an rx or tx thread.
+ */
+struct mt_msg_capture {
+    /*! the capture file, only the writer thread writes it */
+    intptr_t hFile;
+
+    /*! the writer thread, and what wakes it */
+    intptr_t thread;
+    intptr_t wr_sem;
+
+    /*! protects everything below */
+    intptr_t lock;
+
+    /*! records are added here */
+    uint8_t *pBuf;
+    unsigned n_buf;
+
+    /*! the buffer being written, NULL if the writer is idle */
+    uint8_t *pFull;
+    unsigned n_full;
+
+    /*! the other buffer while the writer is idle, else NULL */
+    uint8_t *pSpare;
+
+    /*! TIMER_getNow_nSecs() when the capture started */
+    uint64_t t0_nSecs;
+
+    /*! when a buffer was last handed to the writer */
+    unsigned last_flush;
+
+    /*! next record sequence number */
+    uint32_t seq;
+
+    /*! interface numbers that have been assigned */
+    int n_ifaces;
+
+    /*! writes that failed, their records are lost */
+    unsigned n_lost;
+
+    /*! records dropped because both buffers were full */
+    unsigned n_dropped;
+
+    /*! set by MT_MSG_CAPTURE_stop(), no more records are added */
+    bool is_stopping;
+
+    /*! interface numbers from an older capture are not valid */
+    int generation;
+
+    /*!
+     * Frames being captured, plus one while this is the running
+     * capture, protected by mt_msg_capture_lock. Freed at zero.
+     */
+    int refs;
+};
+
+/*!
+ * @struct capture_map
+ * @brief A capture file mapped into memory
+ */
+struct capture_map {
+    const uint8_t *pBase;
+    size_t size;
+    /*! interface flags and names, by interface number */
+    uint8_t iface_flags[CAPTURE_MAX_IFACES + 1];
+    bool iface_match[CAPTURE_MAX_IFACES + 1];
+};
+
+/******************************************************************************
+ Local Variables
+*****************************************************************************/
+
+/*! The running capture, NULL if none */
+static struct mt_msg_capture *volatile mt_msg_capture;
+
+/*! Serializes start and stop, protects mt_msg_capture and the refs */
+static intptr_t mt_msg_capture_lock;
+
+/*! Incremented for each capture, see mt_msg_interface::capture_id */
+static int mt_msg_capture_generation;
+
+/******************************************************************************
+ Functions
+*****************************************************************************/
+
+/*!
+ * @brief Write a little endian value
+ * @param p - where
+ * @param v - the value
+ * @param n - number of bytes
+ */
+static void cap_put(uint8_t *p, uint64_t v, int n)
+{
+    int x;
+
+    for(x = 0 ; x < n ; x++)
+    {
+        p[x] = (uint8_t)(v >> (8 * x));
+    }
+}
+
+/*!
+ * @brief Read a little endian value
+ * @param p - where
+ * @param n - number of bytes
+ * @returns the value
+ */
+static uint64_t cap_get(const uint8_t *p, int n)
+{
+    uint64_t v;
+
+    v = 0;
+    while(n > 0)
+    {
+        n--;
+        v = (v << 8) | p[n];
+    }
+    return (v);
+}
+
+/*!
+ * @brief Size of a record on disk
+ * @param nbytes - data bytes
+ */
+static unsigned cap_recSize(int nbytes)
+{
+    return ((MT_MSG_CAPTURE_REC_SIZE + nbytes + (CAPTURE_ALIGN - 1)) &
+            ~(unsigned)(CAPTURE_ALIGN - 1));
+}
+
+/*!
+ * @brief Hand the buffered records to the writer thread
+ * @param pC - the capture, the lock is held
+ * @returns false if the writer is still busy with the other buffer
+ */
+static bool cap_swap(struct mt_msg_capture *pC)
+{
+    if(pC->pFull)
+    {
+        return (false);
+    }
+    pC->last_flush = TIMER_timeoutStart();
+    if(pC->n_buf == 0)
+    {
+        return (true);
+    }
+    pC->pFull = pC->pBuf;
+    pC->n_full = pC->n_buf;
+    pC->pBuf = pC->pSpare;
+    pC->pSpare = NULL;
+    pC->n_buf = 0;
+    SEMAPHORE_put(pC->wr_sem);
+    return (true);
+}
+
+/*!
+ * @brief Write buffers handed over by cap_swap(), and stale buffers
+ * @param cookie - the capture
+ * @returns 0
+ *
+ * Exits once the capture is stopping and both buffers are written.
+ */
+static intptr_t cap_writer(intptr_t cookie)
+{
+    struct mt_msg_capture *pC;
+    uint8_t *pFull;
+    unsigned n_full;
+    bool is_stopping;
+    int r;
+
+    pC = (struct mt_msg_capture *)(cookie);
+    for(;;)
+    {
+        SEMAPHORE_waitWithTimeout(pC->wr_sem, CAPTURE_FLUSH_mSecs);
+
+        MUTEX_lock(pC->lock, -1);
+        is_stopping = pC->is_stopping;
+        if(is_stopping ||
+           TIMER_timeoutIsExpired(pC->last_flush, CAPTURE_FLUSH_mSecs))
+        {
+            cap_swap(pC);
+        }
+        pFull = pC->pFull;
+        n_full = pC->n_full;
+        MUTEX_unLock(pC->lock);
+
+        if(pFull == NULL)
+        {
+            if(is_stopping)
+            {
+                break;
+            }
+            continue;
+        }
+
+        r = STREAM_wrBytes(pC->hFile, pFull, n_full, 0);
+        /* file streams are stdio, push it out so a kill loses little */
+        if((r != (int)(n_full)) || (STREAM_flush(pC->hFile) != 0))
+        {
+            r = -1;
+        }
+
+        MUTEX_lock(pC->lock, -1);
+        if(r < 0)
+        {
+            pC->n_lost++;
+        }
+        pC->pSpare = pFull;
+        pC->pFull = NULL;
+        MUTEX_unLock(pC->lock);
+    }
+    return (0);
+}
+
+/*!
+ * @brief Free a capture, no one can reach it
+ * @param pC - the capture
+ */
+static void cap_free(struct mt_msg_capture *pC)
+{
+    if(pC->wr_sem)
+    {
+        SEMAPHORE_destroy(pC->wr_sem);
+    }
+    if(pC->lock)
+    {
+        MUTEX_destroy(pC->lock);
+    }
+    if(pC->pBuf)
+    {
+        free((void *)(pC->pBuf));
+    }
+    if(pC->pSpare)
+    {
+        free((void *)(pC->pSpare));
+    }
+    free((void *)(pC));
+}
+
+/*!
+ * @brief Drop a reference to a capture, the last one frees it
+ * @param pC - the capture
+ */
+static void cap_release(struct mt_msg_capture *pC)
+{
+    bool is_last;
+
+    MUTEX_lock(mt_msg_capture_lock, -1);
+    pC->refs--;
+    is_last = (pC->refs == 0);
+    MUTEX_unLock(mt_msg_capture_lock);
+
+    if(is_last)
+    {
+        cap_free(pC);
+    }
+}
+
+/*!
+ * @brief Add one record to the buffer
+ * @param pC - the capture, the lock is held
+ * @param type - the record type
+ * @param id - interface number
+ * @param t_nSecs - when
+ * @param pHdr - optional bytes that start the data (or NULL)
+ * @param n_hdr - number of bytes in pHdr
+ * @param pData - the data
+ * @param nbytes - number of bytes in pData
+ */
+static void cap_record(struct mt_msg_capture *pC,
+                       int type,
+                       int id,
+                       uint64_t t_nSecs,
+                       const uint8_t *pHdr,
+                       int n_hdr,
+                       const uint8_t *pData,
+                       int nbytes)
+{
+    uint8_t *p;
+    unsigned size;
+
+    size = cap_recSize(n_hdr + nbytes);
+    if(((pC->n_buf + size) > CAPTURE_BUF_SIZE) && !cap_swap(pC))
+    {
+        /* the writer is behind, the sequence gap shows the loss */
+        pC->n_dropped++;
+        pC->seq++;
+        return;
+    }
+
+    p = &(pC->pBuf[pC->n_buf]);
+    memset((void *)(p), 0, size);
+    cap_put(p + 0, (t_nSecs > pC->t0_nSecs) ? (t_nSecs - pC->t0_nSecs) : 0, 8);
+    cap_put(p + 8, (uint64_t)(n_hdr + nbytes), 2);
+    p[10] = (uint8_t)(type);
+    p[11] = (uint8_t)(id);
+    cap_put(p + 12, pC->seq++, 4);
+    if(n_hdr)
+    {
+        memcpy((void *)(p + MT_MSG_CAPTURE_REC_SIZE), pHdr, n_hdr);
+    }
+    memcpy((void *)(p + MT_MSG_CAPTURE_REC_SIZE + n_hdr), pData, nbytes);
+    pC->n_buf += size;
+}
+
+/*
+  Start a capture
+  see mt_msg.h
+*/
+int MT_MSG_CAPTURE_start(const char *filename)
+{
+    struct mt_msg_capture *pC;
+    uint8_t hdr[MT_MSG_CAPTURE_HDR_SIZE];
+
+    if(mt_msg_capture_lock == 0)
+    {
+        mt_msg_capture_lock = MUTEX_create("mt-capture");
+        if(mt_msg_capture_lock == 0)
+        {
+            return (-1);
+        }
+        /* write what is buffered when the application exits */
+        atexit(MT_MSG_CAPTURE_stop);
+    }
+
+    MT_MSG_CAPTURE_stop();
+
+    pC = calloc(1, sizeof(*pC));
+    if(pC == NULL)
+    {
+        return (-1);
+    }
+    pC->pBuf = malloc(CAPTURE_BUF_SIZE);
+    pC->pSpare = malloc(CAPTURE_BUF_SIZE);
+    pC->lock = MUTEX_create("mt-capture-buf");
+    pC->wr_sem = SEMAPHORE_create("mt-capture-wr", 0);
+    pC->hFile = STREAM_createWrFile(filename);
+    if((pC->pBuf == NULL) || (pC->pSpare == NULL) ||
+       (pC->lock == 0) || (pC->wr_sem == 0) || (pC->hFile == 0))
+    {
+        LOG_printf(LOG_ERROR, "mt-capture: cannot create: %s\n", filename);
+        goto fail;
+    }
+
+    pC->t0_nSecs = TIMER_getNow_nSecs();
+    pC->last_flush = TIMER_timeoutStart();
+
+    memset((void *)(hdr), 0, sizeof(hdr));
+    memcpy((void *)(hdr), MT_MSG_CAPTURE_MAGIC, 8);
+    cap_put(hdr + 8, MT_MSG_CAPTURE_HDR_SIZE, 4);
+    cap_put(hdr + 12, 0, 4);
+    cap_put(hdr + 16, pC->t0_nSecs, 8);
+    cap_put(hdr + 24, (uint64_t)(time(NULL)), 8);
+    if(STREAM_wrBytes(pC->hFile, hdr, sizeof(hdr), 0) != (int)sizeof(hdr))
+    {
+        goto fail;
+    }
+
+    pC->thread = THREAD_create("mt-capture",
+                               cap_writer,
+                               (intptr_t)(pC),
+                               THREAD_FLAGS_DEFAULT);
+    if(pC->thread == 0)
+    {
+        goto fail;
+    }
+
+    MUTEX_lock(mt_msg_capture_lock, -1);
+    mt_msg_capture_generation++;
+    pC->generation = mt_msg_capture_generation;
+    pC->refs = 1;
+    mt_msg_capture = pC;
+    MUTEX_unLock(mt_msg_capture_lock);
+
+    LOG_printf(LOG_ALWAYS, "mt-capture: started: %s\n", filename);
+    return (0);
+
+fail:
+    if(pC->hFile)
+    {
+        STREAM_close(pC->hFile);
+    }
+    cap_free(pC);
+    return (-1);
+}
+
+/*
+  Stop the capture
+  see mt_msg.h
+*/
+void MT_MSG_CAPTURE_stop(void)
+{
+    struct mt_msg_capture *pC;
+
+    if(mt_msg_capture_lock == 0)
+    {
+        return;
+    }
+
+    MUTEX_lock(mt_msg_capture_lock, -1);
+    pC = mt_msg_capture;
+    mt_msg_capture = NULL;
+    MUTEX_unLock(mt_msg_capture_lock);
+    if(pC == NULL)
+    {
+        return;
+    }
+
+    /* a late frame may still hold the capture, it sees is_stopping */
+    MUTEX_lock(pC->lock, -1);
+    pC->is_stopping = true;
+    MUTEX_unLock(pC->lock);
+
+    /* the writer writes what is left, then exits */
+    SEMAPHORE_put(pC->wr_sem);
+    while(THREAD_isAlive(pC->thread))
+    {
+        TIMER_sleep(10);
+    }
+    THREAD_destroy(pC->thread);
+    STREAM_close(pC->hFile);
+
+    LOG_printf(LOG_ALWAYS,
+               "mt-capture: stopped, %u records, %u dropped, "
+               "%u failed writes\n",
+               pC->seq, pC->n_dropped, pC->n_lost);
+
+    /* freed here, or by the last frame that holds it */
+    cap_release(pC);
+}
+
+/*
+  Capture a frame
+  see mt_msg.h
+*/
+void MT_MSG_CAPTURE_frame(struct mt_msg_interface *pMI,
+                          enum mt_msg_capture_type type,
+                          const uint8_t *pFrame,
+                          int nbytes,
+                          uint64_t t_nSecs)
+{
+    struct mt_msg_capture *pC;
+    uint8_t flags;
+    const char *name;
+
+    if(mt_msg_capture == NULL)
+    {
+        return;
+    }
+
+    /* hold the capture, it may be stopped meanwhile */
+    MUTEX_lock(mt_msg_capture_lock, -1);
+    pC = mt_msg_capture;
+    if(pC)
+    {
+        pC->refs++;
+    }
+    MUTEX_unLock(mt_msg_capture_lock);
+    if(pC == NULL)
+    {
+        return;
+    }
+
+    MUTEX_lock(pC->lock, -1);
+    if(pC->is_stopping)
+    {
+        MUTEX_unLock(pC->lock);
+        cap_release(pC);
+        return;
+    }
+
+    /* the first frame on an interface describes the interface */
+    if(((pMI->capture_id >> 8) != pC->generation) &&
+       (pC->n_ifaces < CAPTURE_MAX_IFACES))
+    {
+        pC->n_ifaces++;
+        pMI->capture_id = (pC->generation << 8) | pC->n_ifaces;
+
+        flags = 0;
+        if(pMI->frame_sync)
+        {
+            flags |= CAPTURE_IFACE_frame_sync;
+        }
+        if(pMI->include_chksum)
+        {
+            flags |= CAPTURE_IFACE_chksum;
+        }
+        if(pMI->len_2bytes)
+        {
+            flags |= CAPTURE_IFACE_len_2bytes;
+        }
+        name = pMI->dbg_name ? pMI->dbg_name : "";
+        cap_record(pC, MT_MSG_CAPTURE_iface, pMI->capture_id & 0xff,
+                   t_nSecs, &flags, 1,
+                   (const uint8_t *)(name), (int)strlen(name));
+    }
+
+    cap_record(pC, type, pMI->capture_id & 0xff, t_nSecs,
+               NULL, 0, pFrame, nbytes);
+    MUTEX_unLock(pC->lock);
+
+    cap_release(pC);
+}
+
+/*!
+ * @brief Map a capture file into memory, and check the header
+ * @param pMap - filled in
+ * @param filename - the capture file
+ * @returns 0 on success
+ */
+static int cap_map(struct capture_map *pMap, const char *filename)
+{
+    struct stat st;
+    void *p;
+    int fd;
+
+    memset((void *)(pMap), 0, sizeof(*pMap));
+    fd = open(filename, O_RDONLY);
+    if(fd < 0)
+    {
+        LOG_printf(LOG_ERROR, "mt-replay: cannot open: %s\n", filename);
+        return (-1);
+    }
+    if((fstat(fd, &st) != 0) || (st.st_size < MT_MSG_CAPTURE_HDR_SIZE))
+    {
+        LOG_printf(LOG_ERROR, "mt-replay: not a capture: %s\n", filename);
+        close(fd);
+        return (-1);
+    }
+    p = mmap(NULL, (size_t)(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED)
+    {
+        LOG_printf(LOG_ERROR, "mt-replay: cannot map: %s\n", filename);
+        return (-1);
+    }
+    pMap->pBase = (const uint8_t *)(p);
+    pMap->size = (size_t)(st.st_size);
+
+    /* we read it front to back */
+    (void)madvise(p, pMap->size, MADV_SEQUENTIAL);
+
+    if((memcmp(pMap->pBase, MT_MSG_CAPTURE_MAGIC, 8) != 0) ||
+       (cap_get(pMap->pBase + 8, 4) < MT_MSG_CAPTURE_HDR_SIZE) ||
+       (cap_get(pMap->pBase + 8, 4) > pMap->size))
+    {
+        LOG_printf(LOG_ERROR, "mt-replay: not a capture: %s\n", filename);
+        munmap(p, pMap->size);
+        return (-1);
+    }
+    return (0);
+}
+
+/*!
+ * @brief Turn a captured frame into a message for an interface
+ * @param pMI - the interface the message is for
+ * @param flags - how the frame was captured
+ * @param pFrame - the frame
+ * @param nbytes - size of the frame
+ * @returns NULL if the frame is not valid
+ *
+ * The frame header is rebuilt for pMI, as mt_msg_ring_parse() would
+ * have laid it out.
+ */
+static struct mt_msg *cap_toMsg(struct mt_msg_interface *pMI,
+                                int flags,
+                                const uint8_t *pFrame,
+                                int nbytes)
+{
+    struct mt_msg *pMsg;
+    int hdr_len;
+    int len;
+    int x;
+
+    x = (flags & CAPTURE_IFACE_frame_sync) ? 1 : 0;
+    hdr_len = x + ((flags & CAPTURE_IFACE_len_2bytes) ? 2 : 1) + 2;
+    if(nbytes < hdr_len)
+    {
+        return (NULL);
+    }
+    len = pFrame[x];
+    if(flags & CAPTURE_IFACE_len_2bytes)
+    {
+        len |= (pFrame[x + 1] << 8);
+    }
+    if(((hdr_len + len) > nbytes) || ((len + 6) > MT_MSG_POOL_LARGE_SIZE))
+    {
+        return (NULL);
+    }
+
+    pMsg = MT_MSG_alloc(len, pFrame[hdr_len - 2], pFrame[hdr_len - 1]);
+    if(pMsg == NULL)
+    {
+        return (NULL);
+    }
+    pMsg->pLogPrefix = "replay";
+
+    /* same layout as a received frame on pMI */
+    x = 0;
+    if(pMI->frame_sync)
+    {
+        pMsg->iobuf[x++] = 0xfe;
+    }
+    pMsg->iobuf[x++] = (uint8_t)(len);
+    if(pMI->len_2bytes)
+    {
+        pMsg->iobuf[x++] = (uint8_t)(len >> 8);
+    }
+    pMsg->iobuf[x++] = pFrame[hdr_len - 2];
+    pMsg->iobuf[x++] = pFrame[hdr_len - 1];
+    memcpy((void *)(&(pMsg->iobuf[x])), &(pFrame[hdr_len]), len);
+    pMsg->iobuf_nvalid = x + len;
+    return (pMsg);
+}
+
+/*!
+ * @brief Play one frame
+ * @param pMI - the interface
+ * @param pCfg - how to play it
+ * @param pMsg - the message, from cap_toMsg()
+ * @returns 0 on success
+ */
+static int cap_play(struct mt_msg_interface *pMI,
+                    const struct mt_msg_replay_cfg *pCfg,
+                    struct mt_msg *pMsg)
+{
+    int r;
+
+    if(!(pCfg->transmit))
+    {
+        pMsg->stamp_nSecs[MT_MSG_STAMP_rx_first_byte] = TIMER_getNow_nSecs();
+        pMsg->stamp_nSecs[MT_MSG_STAMP_rx_frame] =
+            pMsg->stamp_nSecs[MT_MSG_STAMP_rx_first_byte];
+        MT_MSG_rxInject(pMI, pMsg);
+        return (0);
+    }
+
+    /* as if the application wrote the payload */
+    pMsg->iobuf_idx = pMsg->iobuf_nvalid;
+    pMsg->iobuf_nvalid = 0;
+    MT_MSG_setDestIface(pMsg, pMI);
+    /* the reply to an sreq is not ours to wait for, it is in the capture */
+    pMsg->srsp_timeout_mSecs = 1;
+    r = MT_MSG_txrx(pMsg);
+    MT_MSG_free(pMsg);
+    return ((r == 1) ? 0 : -1);
+}
+
+/*
+  Play a capture
+  see mt_msg.h
+*/
+int MT_MSG_replay(struct mt_msg_interface *pMI,
+                  const struct mt_msg_replay_cfg *pCfg,
+                  struct mt_msg_replay_result *pResult)
+{
+    struct mt_msg_replay_result result;
+    struct capture_map map;
+    struct mt_msg *pMsg;
+    const uint8_t *p;
+    uint64_t t_start;
+    uint64_t t_loop;
+    uint64_t t_first;
+    uint64_t t_rec;
+    uint64_t t_due;
+    uint64_t now;
+    bool has_first;
+    size_t ofs;
+    int nbytes;
+    int type;
+    int loop;
+    int id;
+
+    memset((void *)(&result), 0, sizeof(result));
+    if(cap_map(&map, pCfg->filename) != 0)
+    {
+        return (-1);
+    }
+
+    t_start = TIMER_getNow_nSecs();
+    for(loop = 0 ; (loop == 0) || (loop < pCfg->loops) ; loop++)
+    {
+        /* each loop starts over on the original time line */
+        has_first = false;
+        t_first = 0;
+        t_loop = TIMER_getNow_nSecs();
+        ofs = (size_t)cap_get(map.pBase + 8, 4);
+
+        while((ofs + MT_MSG_CAPTURE_REC_SIZE) <= map.size)
+        {
+            if(pCfg->pStop && *(pCfg->pStop))
+            {
+                goto done;
+            }
+
+            p = map.pBase + ofs;
+            t_rec = cap_get(p + 0, 8);
+            nbytes = (int)cap_get(p + 8, 2);
+            type = p[10];
+            id = p[11];
+            if((ofs + cap_recSize(nbytes)) > map.size)
+            {
+                /* the capture was cut short */
+                break;
+            }
+            ofs += cap_recSize(nbytes);
+            p += MT_MSG_CAPTURE_REC_SIZE;
+
+            if(type == MT_MSG_CAPTURE_iface)
+            {
+                if(nbytes >= 1)
+                {
+                    map.iface_flags[id] = p[0];
+                    map.iface_match[id] = (pCfg->iface_name == NULL) ||
+                        (((int)strlen(pCfg->iface_name) == (nbytes - 1)) &&
+                         (memcmp(pCfg->iface_name, p + 1, nbytes - 1) == 0));
+                }
+                continue;
+            }
+            if((type != (int)(pCfg->type)) || !(map.iface_match[id]))
+            {
+                result.n_skipped++;
+                continue;
+            }
+
+            /* keep the original spacing, scaled by the speed */
+            if(pCfg->speed > 0)
+            {
+                if(!has_first)
+                {
+                    has_first = true;
+                    t_first = t_rec;
+                }
+                t_due = t_loop;
+                if(t_rec > t_first)
+                {
+                    t_due += (t_rec - t_first) / (uint64_t)(pCfg->speed);
+                }
+                for(;;)
+                {
+                    now = TIMER_getNow_nSecs();
+                    if(now >= t_due)
+                    {
+                        break;
+                    }
+                    /* close enough, the sleep is in mSecs */
+                    if((t_due - now) < 1000000)
+                    {
+                        break;
+                    }
+                    TIMER_sleep((uint32_t)((t_due - now) / 1000000));
+                }
+            }
+
+            pMsg = cap_toMsg(pMI, map.iface_flags[id], p, nbytes);
+            if((pMsg == NULL) || (cap_play(pMI, pCfg, pMsg) != 0))
+            {
+                result.n_errors++;
+                continue;
+            }
+            result.n_frames++;
+            result.n_bytes += (uint64_t)(nbytes);
+        }
+    }
+
+done:
+    result.elapsed_nSecs = TIMER_getNow_nSecs() - t_start;
+    munmap((void *)(map.pBase), map.size);
+
+    LOG_printf(LOG_DBG_MT_MSG_traffic,
+               "mt-replay: %s: %u frames, %u skipped, %u errors\n",
+               pCfg->filename, result.n_frames, result.n_skipped,
+               result.n_errors);
+    if(pResult)
+    {
+        *pResult = result;
+    }
+    return (0);
+}
+
+/*
+ *  ========================================
+ *  Texas Instruments Micro Controller Style
+ *  ========================================
+ *  Local Variables:
+ *  mode: c
+ *  c-file-style: "bsd"
+ *  tab-width: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  End:
+ *  vim:set  filetype=c tabstop=4 shiftwidth=4 expandtab=true
+ */
@@ -32,6 +32,76 @@
 
 struct mt_msg_dbg *ALL_MT_MSG_DBG;
 
+/*
+ * Direct lookup for MT_MSG_dbg_decode(), indexed by [cmd0][cmd1].
+ * The cmd1 tables are only allocated for cmd0 values in use.
+ */
+static struct mt_msg_dbg **dbg_index[256];
+/*! the list dbg_index was built from, NULL if there is no index */
+static struct mt_msg_dbg *dbg_index_head;
+
+/*
+  Release the lookup index
+
+  Public function in mt_msg_dbg.h
+*/
+void MT_MSG_dbg_freeIndex(void)
+{
+    int x;
+
+    dbg_index_head = NULL;
+    for(x = 0 ; x < 256 ; x++)
+    {
+        if(dbg_index[x])
+        {
+            free((void *)(dbg_index[x]));
+            dbg_index[x] = NULL;
+        }
+    }
+}
+
+/*
+  Build the lookup index for a list of debug info
+
+  Public function in mt_msg_dbg.h
+*/
+int MT_MSG_dbg_buildIndex(struct mt_msg_dbg *pAll)
+{
+    struct mt_msg_dbg *p;
+
+    MT_MSG_dbg_freeIndex();
+
+    /* wildcards are rare, those lists are searched the slow way */
+    for(p = pAll ; p ; p = p->m_pNext)
+    {
+        if((p->m_cmd0 == -1) || (p->m_cmd1 == -1))
+        {
+            return (-1);
+        }
+    }
+
+    for(p = pAll ; p ; p = p->m_pNext)
+    {
+        if(dbg_index[p->m_cmd0] == NULL)
+        {
+            dbg_index[p->m_cmd0] =
+                (struct mt_msg_dbg **)calloc(256, sizeof(struct mt_msg_dbg *));
+            if(dbg_index[p->m_cmd0] == NULL)
+            {
+                MT_MSG_dbg_freeIndex();
+                return (-1);
+            }
+        }
+        /* the first one in the list wins, same as the list search */
+        if(dbg_index[p->m_cmd0][p->m_cmd1] == NULL)
+        {
+            dbg_index[p->m_cmd0][p->m_cmd1] = p;
+        }
+    }
+    dbg_index_head = pAll;
+    return (0);
+}
+
 static void print_field(struct mt_msg_dbg_info *pV)
 {
     uint32_t v, a, b, c, d;
@@ -66,6 +136,7 @@ static void print_field(struct mt_msg_dbg_info *pV)
                 (unsigned)(pV->m_pMsg->iobuf[pV->m_idx_cursor + a]));
         }
         LOG_printf(LOG_ALWAYS, "\n");
+        pV->m_idx_cursor += n;
         return;
     }
 
@@ -155,7 +226,20 @@ void MT_MSG_dbg_decode(struct mt_msg *pMsg,
     /* setup cur */
     v.m_idx_cursor = v.m_idx_start;
 
-    v.m_pDbg= pDbg;
+    if((pDbg == dbg_index_head) && _inrange(v.m_pMsg->cmd0, 0, 256) &&
+       _inrange(v.m_pMsg->cmd1, 0, 256))
+    {
+        /* direct lookup */
+        v.m_pDbg = NULL;
+        if(dbg_index[v.m_pMsg->cmd0])
+        {
+            v.m_pDbg = dbg_index[v.m_pMsg->cmd0][v.m_pMsg->cmd1];
+        }
+    }
+    else
+    {
+        v.m_pDbg = pDbg;
+    }
     while(v.m_pDbg)
     {
         m = 1;
@@ -16,6 +16,7 @@
 #include "compiler.h"
 #include "mt_msg.h"
 #include "mt_msg_dbg.h"
+#include "mt_msg_schema.h"
 #include "log.h"
 #include "mutex.h"
 #include "threads.h"
@@ -26,6 +27,7 @@
 #include "ti_semaphore.h"
 #include "fatal.h"
 
+#include <stdio.h>
 #include <stdarg.h>
 #include <ctype.h>
 #include <string.h>
@@ -403,10 +405,134 @@ static void do_free(struct mt_msg_dbg *pDbg)
     free(pDbg);
 }
 
+/* add a field to the end of a message built from a schema */
+static int schema_field(struct mt_msg_dbg_field ***pppTail,
+                        int fieldtype, const char *name, const char *suffix)
+{
+    struct mt_msg_dbg_field *pF;
+    char buf[64];
+
+    pF = (struct mt_msg_dbg_field *)calloc(1, sizeof(*pF));
+    if(pF == NULL)
+    {
+        return -1;
+    }
+    snprintf(buf, sizeof(buf), "%s%s", name, suffix);
+    pF->m_name = strdup(buf);
+    pF->m_fieldtype = fieldtype;
+    **pppTail = pF;
+    *pppTail = &(pF->m_pNext);
+    return (pF->m_name == NULL) ? -1 : 0;
+}
+
+/* public function, debug info built from a schema */
+struct mt_msg_dbg *MT_MSG_dbg_fromSchema(const struct mt_msg_schema *pSchema)
+{
+    const struct mt_msg_schema_field *pSF;
+    struct mt_msg_dbg_field **ppTail;
+    struct mt_msg_dbg *p;
+    int r;
+
+    p = (struct mt_msg_dbg *)calloc(1, sizeof(*p));
+    if(p == NULL)
+    {
+        return NULL;
+    }
+    p->m_cmd0 = pSchema->cmd0;
+    p->m_cmd1 = pSchema->cmd1;
+    p->m_pktName = strdup(pSchema->name);
+    r = (p->m_pktName == NULL) ? -1 : 0;
+
+    ppTail = &(p->m_pFields);
+    for(pSF = pSchema->pFields ;
+        (r == 0) && (pSF->type != MT_MSG_SCHEMA_TYPE_end) ;
+        pSF++)
+    {
+        switch(pSF->type)
+        {
+        case MT_MSG_SCHEMA_TYPE_addr:
+            r = schema_field(&ppTail, FIELDTYPE_U8, pSF->name, ".mode");
+            if(r == 0)
+            {
+                r = schema_field(&ppTail, FIELDTYPE_BYTES_N(8), pSF->name, "");
+            }
+            break;
+        case MT_MSG_SCHEMA_TYPE_data:
+            /* the rest of the payload */
+            r = schema_field(&ppTail, FIELDTYPE_MAXBYTES(9999), pSF->name, "");
+            break;
+        default:
+            switch(pSF->wire)
+            {
+            case 1:
+                r = schema_field(&ppTail, FIELDTYPE_U8, pSF->name, "");
+                break;
+            case 2:
+                r = schema_field(&ppTail, FIELDTYPE_U16, pSF->name, "");
+                break;
+            case 4:
+                r = schema_field(&ppTail, FIELDTYPE_U32, pSF->name, "");
+                break;
+            default:
+                r = schema_field(&ppTail, FIELDTYPE_BYTES_N(pSF->wire),
+                                 pSF->name, "");
+                break;
+            }
+            break;
+        }
+    }
+    if(r != 0)
+    {
+        do_free(p);
+        return NULL;
+    }
+    return p;
+}
+
+/* public function, add schemas the list does not describe */
+int MT_MSG_dbg_addSchemas(struct mt_msg_dbg **ppAll,
+                          struct mt_msg_schema * const *ppSchemas)
+{
+    struct mt_msg_dbg **ppDbg;
+    struct mt_msg_dbg *p;
+    int n;
+
+    n = 0;
+    for( ; *ppSchemas ; ppSchemas++)
+    {
+        /* loaded files win, the schema is appended */
+        for(ppDbg = ppAll ; *ppDbg ; ppDbg = &((*ppDbg)->m_pNext))
+        {
+            if(((*ppDbg)->m_cmd0 == (*ppSchemas)->cmd0) &&
+               ((*ppDbg)->m_cmd1 == (*ppSchemas)->cmd1))
+            {
+                break;
+            }
+        }
+        if(*ppDbg)
+        {
+            continue;
+        }
+        p = MT_MSG_dbg_fromSchema(*ppSchemas);
+        if(p == NULL)
+        {
+            LOG_printf(LOG_ERROR, "%s: no memory for debug info\n",
+                       (*ppSchemas)->name);
+            return -1;
+        }
+        *ppDbg = p;
+        n++;
+    }
+    return n;
+}
+
 void MT_MSG_dbg_free(struct mt_msg_dbg *pMsgs)
 {
     struct mt_msg_dbg *pNext;
 
+    /* the index would point into freed memory */
+    MT_MSG_dbg_freeIndex();
+
     /* walk list, freeing messages */
     while (pMsgs)
     {
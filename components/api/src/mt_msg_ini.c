@@ -24,6 +24,7 @@
 #include "log.h"
 
 #include <stdarg.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -31,6 +32,57 @@
  Functions
 *****************************************************************************/
 
+/*!
+ * @brief Parse: "rx-priority = CLASS CMD0 [CMD1]"
+ * @param pINI - the ini file parser information
+ * @param pMI - the message interface
+ * @returns negative on error
+ *
+ * CLASS is high, normal or low, without CMD1 the class applies to
+ * the entire subsystem of CMD0. Example: "rx-priority = high 0x42 0x84"
+ */
+static int mt_msg_ini_rx_prio(struct ini_parser *pINI,
+                              struct mt_msg_interface *pMI)
+{
+    static const char * const names[ MT_MSG_PRIO_nClasses ] = {
+        "high", "normal", "low"
+    };
+    char name[10];
+    int cmd0;
+    int cmd1;
+    int prio;
+    int n;
+
+    cmd1 = -1;
+    n = sscanf(pINI->item_value, "%9s %i %i", name, &cmd0, &cmd1);
+    if(n < 2)
+    {
+        INI_syntaxError(pINI, "expected: CLASS CMD0 [CMD1]\n");
+        return (-1);
+    }
+
+    for(prio = 0 ; prio < MT_MSG_PRIO_nClasses ; prio++)
+    {
+        if(0 == strcmp(name, names[prio]))
+        {
+            break;
+        }
+    }
+    if(prio == MT_MSG_PRIO_nClasses)
+    {
+        INI_syntaxError(pINI, "class must be: high, normal or low\n");
+        return (-1);
+    }
+
+    if(!_inrange(cmd0, 0, 256) ||
+       (MT_MSG_setRxPrio(pMI, cmd0, cmd1, (enum mt_msg_prio)(prio)) != 0))
+    {
+        INI_syntaxError(pINI, "invalid CMD0 or CMD1\n");
+        return (-1);
+    }
+    return (0);
+}
+
 /*
   Parse elements from an INI file for a message interface.
 
@@ -92,6 +144,12 @@ int MT_MSG_INI_settings(struct ini_parser *pINI,
         goto igood;
     }
 
+    if(INI_itemMatches(pINI, NULL, "fragmentation-window"))
+    {
+        iptr = &(pMI->tx_frag_window);
+        goto igood;
+    }
+
     if(INI_itemMatches(pINI, NULL, "intersymbol-timeout-msecs"))
     {
         iptr = &(pMI->intersymbol_timeout_mSecs);
@@ -122,11 +180,76 @@ int MT_MSG_INI_settings(struct ini_parser *pINI,
         goto bgood;
     }
 
+    if(INI_itemMatches(pINI, NULL, "reactor"))
+    {
+        bptr = &(pMI->use_reactor);
+        goto bgood;
+    }
+
     if(INI_itemMatches(pINI, NULL, "tx-lock-timeout"))
     {
         iptr = &(pMI->tx_lock_timeout);
         goto igood;
     }
+
+    if(INI_itemMatches(pINI, NULL, "sreq-max-inflight"))
+    {
+        iptr = &(pMI->sreq_max_inflight);
+        goto igood;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "tx-batch-max"))
+    {
+        iptr = &(pMI->tx_batch_max);
+        goto igood;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "async-workers"))
+    {
+        iptr = &(pMI->async_workers);
+        goto igood;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "latency-log-msecs"))
+    {
+        iptr = &(pMI->latency_log_mSecs);
+        goto igood;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "rx-capacity"))
+    {
+        iptr = &(pMI->rx_capacity);
+        goto igood;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "rx-block-msecs"))
+    {
+        iptr = &(pMI->rx_block_mSecs);
+        goto igood;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "rx-policy"))
+    {
+        int policy;
+
+        INI_dequote(pINI);
+        policy = MT_MSG_LIST_policyFromName(pINI->item_value);
+        if(policy < 0)
+        {
+            INI_syntaxError(pINI,
+                "rx-policy must be: drop-oldest, drop-newest, block or coalesce\n");
+            return (-1);
+        }
+        pMI->rx_policy = (enum mt_msg_list_policy)(policy);
+        *handled = true;
+        return (0);
+    }
+
+    if(INI_itemMatches(pINI, NULL, "rx-priority"))
+    {
+        *handled = true;
+        return (mt_msg_ini_rx_prio(pINI, pMI));
+    }
     return (0);
 }
 
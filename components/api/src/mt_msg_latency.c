@@ -0,0 +1,344 @@
+/******************************************************************************
+ @file mt_msg_latency.c
+
+ @brief TIMAC 2.0 API message pipeline timestamps and latency histograms
+
+ Group: WCS LPC
+ $Target Device: DEVICES $
+
+ ******************************************************************************
+ $License: BSD3 2016 $
+ ******************************************************************************
+ $Release Name: PACKAGE NAME $
+ $Release Date: PACKAGE RELEASE DATE $
+ *****************************************************************************/
+
+/******************************************************************************
+ Includes
+*****************************************************************************/
+
+#include "compiler.h"
+#include "mt_msg.h"
+#include "timer.h"
+#include "log.h"
+
+#include <string.h>
+
+/******************************************************************************
+ Local Variables
+*****************************************************************************/
+
+/*! names used when logging the histograms */
+static const char * const lat_names[ MT_MSG_LAT_nHists ] = {
+    [MT_MSG_LAT_rx_frame]   = "rx-frame",
+    [MT_MSG_LAT_rx_enqueue] = "rx-enqueue",
+    [MT_MSG_LAT_rx_queue]   = "rx-queue",
+    [MT_MSG_LAT_rx_handler] = "rx-handler",
+    [MT_MSG_LAT_rx_total]   = "rx-total",
+    [MT_MSG_LAT_tx]         = "tx",
+    [MT_MSG_LAT_srsp]       = "srsp"
+};
+
+/******************************************************************************
+ Functions
+*****************************************************************************/
+
+/*!
+ * @brief Determine the histogram bucket for a value
+ * @param v - the value in nSecs
+ * @returns bucket index
+ */
+static int lat_bucket(uint64_t v)
+{
+    int b;
+
+    /* small values have their own bucket */
+    if(v < (1 << MT_MSG_LAT_SUB_BITS))
+    {
+        return ((int)(v));
+    }
+
+    /* find the most significant bit */
+    for(b = MT_MSG_LAT_SUB_BITS ; (v >> (b + 1)) != 0 ; b++)
+    {
+        ;
+    }
+    if(b > MT_MSG_LAT_MAX_BITS)
+    {
+        return (MT_MSG_LAT_nBUCKETS - 1);
+    }
+
+    /* the bits below the msb select the sub bucket */
+    return (((b - MT_MSG_LAT_SUB_BITS + 1) << MT_MSG_LAT_SUB_BITS) +
+            (int)((v >> (b - MT_MSG_LAT_SUB_BITS)) &
+                  ((1 << MT_MSG_LAT_SUB_BITS) - 1)));
+}
+
+/*!
+ * @brief Determine the largest value that is put in a bucket
+ * @param idx - the bucket index
+ * @returns value in nSecs
+ */
+static uint64_t lat_bucket_value(int idx)
+{
+    uint64_t sub;
+    int b;
+
+    if(idx < (1 << MT_MSG_LAT_SUB_BITS))
+    {
+        return ((uint64_t)(idx));
+    }
+
+    b = (idx >> MT_MSG_LAT_SUB_BITS) + MT_MSG_LAT_SUB_BITS - 1;
+    sub = (uint64_t)(idx & ((1 << MT_MSG_LAT_SUB_BITS) - 1));
+    sub = sub | (1 << MT_MSG_LAT_SUB_BITS);
+
+    return (((sub + 1) << (b - MT_MSG_LAT_SUB_BITS)) - 1);
+}
+
+/*!
+ * @brief Find a percentile in a histogram
+ * @param pH - the histogram
+ * @param pct - the percentile, 1..100
+ * @returns value in nSecs
+ */
+static uint64_t lat_percentile(const struct mt_msg_lat_hist *pH, int pct)
+{
+    uint64_t rank;
+    uint64_t n;
+    uint64_t v;
+    int x;
+
+    if(pH->count == 0)
+    {
+        return (0);
+    }
+
+    /* the sample at this rank (1 based) is the answer */
+    rank = (((uint64_t)(pH->count) * pct) + 99) / 100;
+
+    n = 0;
+    for(x = 0 ; x < MT_MSG_LAT_nBUCKETS ; x++)
+    {
+        n += pH->buckets[x];
+        if(n >= rank)
+        {
+            break;
+        }
+    }
+
+    /* the bucket value might be larger than any sample */
+    v = lat_bucket_value(x);
+    if(v > pH->max_nSecs)
+    {
+        v = pH->max_nSecs;
+    }
+    return (v);
+}
+
+/*
+  Add a sample to a latency histogram
+  Public function defined in mt_msg.h
+*/
+void MT_MSG_LAT_add(struct mt_msg_interface *pMI,
+                    enum mt_msg_lat_which which,
+                    uint64_t t_start,
+                    uint64_t t_end)
+{
+    if((pMI == NULL) || (pMI->pLatency == NULL))
+    {
+        return;
+    }
+    if((t_start == 0) || (t_end < t_start) ||
+       !_inrange(which, 0, MT_MSG_LAT_nHists))
+    {
+        return;
+    }
+
+    MT_MSG_LAT_histAdd(&(pMI->pLatency[which]), t_end - t_start);
+}
+
+/*
+  Add a sample to a standalone histogram
+  Public function defined in mt_msg.h
+*/
+void MT_MSG_LAT_histAdd(struct mt_msg_lat_hist *pH, uint64_t v)
+{
+    pH->count++;
+    pH->sum_nSecs += v;
+    if(v > pH->max_nSecs)
+    {
+        pH->max_nSecs = v;
+    }
+    pH->buckets[ lat_bucket(v) ]++;
+}
+
+/*
+  Add all samples of one histogram to another
+  Public function defined in mt_msg.h
+*/
+void MT_MSG_LAT_histMerge(struct mt_msg_lat_hist *pDst,
+                          const struct mt_msg_lat_hist *pSrc)
+{
+    int x;
+
+    pDst->count += pSrc->count;
+    pDst->sum_nSecs += pSrc->sum_nSecs;
+    if(pSrc->max_nSecs > pDst->max_nSecs)
+    {
+        pDst->max_nSecs = pSrc->max_nSecs;
+    }
+    for(x = 0 ; x < MT_MSG_LAT_nBUCKETS ; x++)
+    {
+        pDst->buckets[x] += pSrc->buckets[x];
+    }
+}
+
+/*
+  Summarize a standalone histogram
+  Public function defined in mt_msg.h
+*/
+void MT_MSG_LAT_histSummary(const struct mt_msg_lat_hist *pH,
+                            struct mt_msg_lat_summary *pSummary)
+{
+    memset((void *)(pSummary), 0, sizeof(*pSummary));
+    pSummary->count = pH->count;
+    if(pH->count)
+    {
+        pSummary->mean_nSecs = pH->sum_nSecs / pH->count;
+    }
+    pSummary->p50_nSecs = lat_percentile(pH, 50);
+    pSummary->p99_nSecs = lat_percentile(pH, 99);
+    pSummary->max_nSecs = pH->max_nSecs;
+}
+
+/*
+  Record a pipeline stage
+  Public function defined in mt_msg.h
+*/
+void MT_MSG_stamp(struct mt_msg *pMsg, enum mt_msg_stamp which)
+{
+    struct mt_msg_interface *pMI;
+    uint64_t *pT;
+
+    if(!_inrange(which, 0, MT_MSG_STAMP_nStamps))
+    {
+        return;
+    }
+
+    pT = pMsg->stamp_nSecs;
+    pT[which] = TIMER_getNow_nSecs();
+
+    switch(which)
+    {
+    default:
+        break;
+    case MT_MSG_STAMP_rx_handled:
+        /* the end of the rx pipeline */
+        pMI = pMsg->pSrcIface;
+        MT_MSG_LAT_add(pMI, MT_MSG_LAT_rx_frame,
+                       pT[MT_MSG_STAMP_rx_first_byte],
+                       pT[MT_MSG_STAMP_rx_frame]);
+        MT_MSG_LAT_add(pMI, MT_MSG_LAT_rx_enqueue,
+                       pT[MT_MSG_STAMP_rx_frame],
+                       pT[MT_MSG_STAMP_rx_enqueue]);
+        MT_MSG_LAT_add(pMI, MT_MSG_LAT_rx_queue,
+                       pT[MT_MSG_STAMP_rx_enqueue],
+                       pT[MT_MSG_STAMP_rx_dequeue]);
+        MT_MSG_LAT_add(pMI, MT_MSG_LAT_rx_handler,
+                       pT[MT_MSG_STAMP_rx_dequeue],
+                       pT[MT_MSG_STAMP_rx_handled]);
+        MT_MSG_LAT_add(pMI, MT_MSG_LAT_rx_total,
+                       pT[MT_MSG_STAMP_rx_first_byte],
+                       pT[MT_MSG_STAMP_rx_handled]);
+        break;
+    case MT_MSG_STAMP_tx_done:
+        MT_MSG_LAT_add(pMsg->pDestIface, MT_MSG_LAT_tx,
+                       pT[MT_MSG_STAMP_tx_start],
+                       pT[MT_MSG_STAMP_tx_done]);
+        break;
+    }
+}
+
+/*
+  Summarize a latency histogram
+  Public function defined in mt_msg.h
+*/
+int MT_MSG_LAT_get(struct mt_msg_interface *pMI,
+                   enum mt_msg_lat_which which,
+                   struct mt_msg_lat_summary *pSummary)
+{
+    if((pMI->pLatency == NULL) || !_inrange(which, 0, MT_MSG_LAT_nHists))
+    {
+        memset((void *)(pSummary), 0, sizeof(*pSummary));
+        return (-1);
+    }
+
+    MT_MSG_LAT_histSummary(&(pMI->pLatency[which]), pSummary);
+    pSummary->dbg_name = lat_names[which];
+    return (0);
+}
+
+/*
+  Clear the latency histograms
+  Public function defined in mt_msg.h
+*/
+void MT_MSG_LAT_reset(struct mt_msg_interface *pMI)
+{
+    if(pMI->pLatency)
+    {
+        memset((void *)(pMI->pLatency), 0,
+               sizeof(pMI->pLatency[0]) * MT_MSG_LAT_nHists);
+    }
+}
+
+/*
+  Log the latency histograms
+  Public function defined in mt_msg.h
+*/
+void MT_MSG_LAT_log(struct mt_msg_interface *pMI, int64_t why)
+{
+    struct mt_msg_lat_summary s;
+    int x;
+
+    if(!LOG_test(why))
+    {
+        return;
+    }
+
+    for(x = 0 ; x < MT_MSG_LAT_nHists ; x++)
+    {
+        if(MT_MSG_LAT_get(pMI, (enum mt_msg_lat_which)x, &s) != 0)
+        {
+            return;
+        }
+        if(s.count == 0)
+        {
+            continue;
+        }
+        LOG_printf(why,
+                   "%s: latency %-10s n: %u mean: %.1f p50: %.1f "
+                   "p99: %.1f max: %.1f (uSecs)\n",
+                   pMI->dbg_name,
+                   s.dbg_name,
+                   s.count,
+                   (double)(s.mean_nSecs) / 1000.0,
+                   (double)(s.p50_nSecs) / 1000.0,
+                   (double)(s.p99_nSecs) / 1000.0,
+                   (double)(s.max_nSecs) / 1000.0);
+    }
+}
+
+/*
+ *  ========================================
+ *  Texas Instruments Micro Controller Style
+ *  ========================================
+ *  Local Variables:
+ *  mode: c
+ *  c-file-style: "bsd"
+ *  tab-width: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  End:
+ *  vim:set  filetype=c tabstop=4 shiftwidth=4 expandtab=true
+ */
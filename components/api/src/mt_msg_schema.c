@@ -0,0 +1,584 @@
+/******************************************************************************
+ @file mt_msg_schema.c
+
+ @brief TIMAC 2.0 API table driven encode/decode of MT payloads
+
+ Group: WCS LPC
+ $Target Device: DEVICES $
+
+ ******************************************************************************
+ $License: BSD3 2016 $
+ ******************************************************************************
+ $Release Name: PACKAGE NAME $
+ $Release Date: PACKAGE RELEASE DATE $
+ *****************************************************************************/
+
+/******************************************************************************
+ Includes
+*****************************************************************************/
+
+#include "compiler.h"
+#include "mt_msg.h"
+#include "mt_msg_schema.h"
+#include "api_mac.h"
+#include "log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/******************************************************************************
+ Constants and definitions
+*****************************************************************************/
+
+/*
+ * Integers are copied with memcpy() only if the host byte order
+ * matches the wire (little endian), otherwise they are done one by one.
+ */
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define SCHEMA_HOST_IS_LE  1
+#else
+#define SCHEMA_HOST_IS_LE  0
+#endif
+
+/******************************************************************************
+ Functions
+*****************************************************************************/
+
+/*!
+ * @brief Can this field be part of a memcpy()?
+ * @param pF - the field
+ * @returns true if the wire and the structure have the same bytes
+ */
+static bool schema_isCopy(const struct mt_msg_schema_field *pF)
+{
+    switch(pF->type)
+    {
+    case MT_MSG_SCHEMA_TYPE_bytes:
+        return (true);
+    case MT_MSG_SCHEMA_TYPE_u8:
+    case MT_MSG_SCHEMA_TYPE_u16:
+    case MT_MSG_SCHEMA_TYPE_u32:
+    case MT_MSG_SCHEMA_TYPE_u64:
+        return (SCHEMA_HOST_IS_LE && (pF->size == pF->wire));
+    default:
+        return (false);
+    }
+}
+
+/*
+  Build the byte runs and the operation list
+
+  Public function defined in mt_msg_schema.h
+*/
+int MT_MSG_SCHEMA_compile(struct mt_msg_schema *pSchema)
+{
+    const struct mt_msg_schema_field *pF;
+    struct mt_msg_schema_field *pOps;
+    struct mt_msg_schema_copy *pCopies;
+    struct mt_msg_schema_copy *pC;
+    bool in_data;
+    int fixed_len;
+    int nCopies;
+    int n;
+
+    if(pSchema->pOps)
+    {
+        return (0);
+    }
+
+    for(n = 0 ; pSchema->pFields[n].type != MT_MSG_SCHEMA_TYPE_end ; n++)
+    {
+        ;
+    }
+
+    /* +1 for the terminators, calloc() makes them MT_MSG_SCHEMA_TYPE_end
+     * and a zero length run */
+    pOps = (struct mt_msg_schema_field *)calloc(n + 1, sizeof(*pOps));
+    pCopies = (struct mt_msg_schema_copy *)calloc(n + 1, sizeof(*pCopies));
+    if((pOps == NULL) || (pCopies == NULL))
+    {
+        LOG_printf(LOG_ERROR, "%s: schema: no memory\n", pSchema->name);
+        free((void *)(pOps));
+        free((void *)(pCopies));
+        return (-1);
+    }
+
+    pC = NULL;
+    n = 0;
+    nCopies = 0;
+    fixed_len = 0;
+    in_data = false;
+    for(pF = pSchema->pFields ; pF->type != MT_MSG_SCHEMA_TYPE_end ; pF++)
+    {
+        if(pF->type == MT_MSG_SCHEMA_TYPE_data)
+        {
+            in_data = true;
+        }
+        else if(in_data)
+        {
+            LOG_printf(LOG_ERROR, "%s: schema: %s follows variable data\n",
+                       pSchema->name, pF->name);
+            free((void *)(pOps));
+            free((void *)(pCopies));
+            return (-1);
+        }
+
+        if(!schema_isCopy(pF))
+        {
+            pOps[n] = *pF;
+            pOps[n].wire_offset = (uint16_t)(fixed_len);
+            n++;
+        }
+        else if(pC &&
+                (pF->offset == (pC->offset + pC->len)) &&
+                (fixed_len == (pC->wire_offset + pC->len)))
+        {
+            /* extend the previous run */
+            pC->len += pF->wire;
+        }
+        else
+        {
+            pC = &(pCopies[nCopies++]);
+            pC->offset = pF->offset;
+            pC->wire_offset = (uint16_t)(fixed_len);
+            pC->len = pF->wire;
+        }
+        fixed_len += pF->wire;
+    }
+
+    pSchema->fixed_len = fixed_len;
+    pSchema->pCopies = pCopies;
+    pSchema->pOps = pOps;
+    LOG_printf(LOG_DBG_MT_MSG_fields, "%s: schema: %d runs, %d ops, "
+               "%d bytes\n", pSchema->name, nCopies, n, fixed_len);
+    return (0);
+}
+
+/*!
+ * @brief Store an integer in a structure member
+ * @param pMember - where to store
+ * @param size - sizeof the member
+ * @param v - the value
+ */
+static void schema_store(void *pMember, int size, uint64_t v)
+{
+    uint8_t  v8;
+    uint16_t v16;
+    uint32_t v32;
+
+    switch(size)
+    {
+    case 1:
+        v8 = (uint8_t)(v);
+        memcpy(pMember, (void *)(&v8), 1);
+        break;
+    case 2:
+        v16 = (uint16_t)(v);
+        memcpy(pMember, (void *)(&v16), 2);
+        break;
+    case 4:
+        v32 = (uint32_t)(v);
+        memcpy(pMember, (void *)(&v32), 4);
+        break;
+    case 8:
+        memcpy(pMember, (void *)(&v), 8);
+        break;
+    default:
+        BUG_HERE("schema: bad member size: %d\n", size);
+        break;
+    }
+}
+
+/*!
+ * @brief Load an integer from a structure member
+ * @param pMember - the member
+ * @param size - sizeof the member
+ * @returns the value
+ */
+static uint64_t schema_load(const void *pMember, int size)
+{
+    uint8_t  v8;
+    uint16_t v16;
+    uint32_t v32;
+    uint64_t v;
+
+    switch(size)
+    {
+    case 1:
+        memcpy((void *)(&v8), pMember, 1);
+        return (v8);
+    case 2:
+        memcpy((void *)(&v16), pMember, 2);
+        return (v16);
+    case 4:
+        memcpy((void *)(&v32), pMember, 4);
+        return (v32);
+    case 8:
+        memcpy((void *)(&v), pMember, 8);
+        return (v);
+    default:
+        BUG_HERE("schema: bad member size: %d\n", size);
+        return (0);
+    }
+}
+
+/*!
+ * @brief Read a little endian value from the wire
+ * @param pWire - the bytes
+ * @param nbytes - how many
+ * @returns the value
+ */
+static uint64_t schema_rdLE(const uint8_t *pWire, int nbytes)
+{
+    uint64_t v;
+
+    v = 0;
+    while(nbytes > 0)
+    {
+        nbytes--;
+        v = (v << 8) | pWire[nbytes];
+    }
+    return (v);
+}
+
+/*!
+ * @brief Write a little endian value to the wire
+ * @param pWire - where to write
+ * @param nbytes - how many
+ * @param v - the value
+ */
+static void schema_wrLE(uint8_t *pWire, int nbytes, uint64_t v)
+{
+    int x;
+
+    for(x = 0 ; x < nbytes ; x++)
+    {
+        pWire[x] = (uint8_t)(v);
+        v = v >> 8;
+    }
+}
+
+/*!
+ * @brief Decode an address, 1 byte mode then 8 bytes
+ * @param pWire - the bytes
+ * @param pAddr - the address
+ */
+static void schema_rdAddr(const uint8_t *pWire, ApiMac_sAddr_t *pAddr)
+{
+    pAddr->addrMode = (ApiMac_addrType_t)(pWire[0]);
+    if(pAddr->addrMode == ApiMac_addrType_short)
+    {
+        memset((void *)(&(pAddr->addr)), 0, sizeof(pAddr->addr));
+        pAddr->addr.shortAddr = (uint16_t)(pWire[1] | (pWire[2] << 8));
+    }
+    else
+    {
+        memcpy((void *)(pAddr->addr.extAddr), (const void *)(pWire + 1), 8);
+    }
+}
+
+/*!
+ * @brief Encode an address, 1 byte mode then 8 bytes
+ * @param pWire - where to write
+ * @param pAddr - the address
+ */
+static void schema_wrAddr(uint8_t *pWire, const ApiMac_sAddr_t *pAddr)
+{
+    pWire[0] = (uint8_t)(pAddr->addrMode);
+    memset((void *)(pWire + 1), 0, 8);
+    switch(pAddr->addrMode)
+    {
+    case ApiMac_addrType_none:
+        break;
+    case ApiMac_addrType_short:
+        pWire[1] = (uint8_t)(pAddr->addr.shortAddr);
+        pWire[2] = (uint8_t)(pAddr->addr.shortAddr >> 8);
+        break;
+    case ApiMac_addrType_extended:
+        memcpy((void *)(pWire + 1), (const void *)(pAddr->addr.extAddr), 8);
+        break;
+    default:
+        BUG_HERE("API error bad address type\n");
+        break;
+    }
+}
+
+/*!
+ * @brief Log the fields, the same as the MT_MSG_rdXX_DBG() functions
+ * @param pMsg - the message
+ * @param pSchema - the schema
+ * @param pWire - start of the fixed part
+ * @param pWhat - "rd" or "wr"
+ */
+static void schema_trace(struct mt_msg *pMsg,
+                         const struct mt_msg_schema *pSchema,
+                         const uint8_t *pWire,
+                         const char *pWhat)
+{
+    const struct mt_msg_schema_field *pF;
+    uint64_t v;
+
+    for(pF = pSchema->pFields ; pF->type != MT_MSG_SCHEMA_TYPE_end ; pF++)
+    {
+        switch(pF->type)
+        {
+        case MT_MSG_SCHEMA_TYPE_u8:
+        case MT_MSG_SCHEMA_TYPE_u16:
+        case MT_MSG_SCHEMA_TYPE_u32:
+        case MT_MSG_SCHEMA_TYPE_u64:
+        case MT_MSG_SCHEMA_TYPE_bool:
+            v = schema_rdLE(pWire, pF->wire);
+            LOG_printf(LOG_DBG_MT_MSG_fields, "%s: %s_u%d: %*s: %lld, 0x%llx\n",
+                       pMsg->pLogPrefix, pWhat, pF->wire * 8, 20, pF->name,
+                       (long long)(v), (unsigned long long)(v));
+            break;
+        case MT_MSG_SCHEMA_TYPE_data:
+            LOG_printf(LOG_DBG_MT_MSG_fields, "%s: %sBuf: %*s, variable\n",
+                       pMsg->pLogPrefix, pWhat, 20, pF->name);
+            break;
+        default:
+            LOG_printf(LOG_DBG_MT_MSG_fields, "%s: %sBuf: %*s, len: %d\n",
+                       pMsg->pLogPrefix, pWhat, 20, pF->name, pF->wire);
+            break;
+        }
+        pWire += pF->wire;
+    }
+}
+
+/*
+  Decode a payload into a structure
+
+  Public function defined in mt_msg_schema.h
+*/
+int MT_MSG_SCHEMA_decode(struct mt_msg *pMsg,
+                         struct mt_msg_schema *pSchema,
+                         void *pStruct)
+{
+    const struct mt_msg_schema_field *pOp;
+    const struct mt_msg_schema_copy *pC;
+    uint8_t *pBase;
+    uint8_t *pWire;
+    uint8_t *pData;
+    uint16_t len;
+    int idx;
+
+    if(pMsg->is_error)
+    {
+        return (-1);
+    }
+    if((pSchema->pOps == NULL) && (MT_MSG_SCHEMA_compile(pSchema) != 0))
+    {
+        pMsg->is_error = true;
+        return (-1);
+    }
+
+    /* one check for the fixed part */
+    idx = pMsg->iobuf_idx;
+    if(idx < 0)
+    {
+        /* same as MT_MSG_rdUX_DBG(), we parse complete messages */
+        idx = 0;
+    }
+    if((idx + pSchema->fixed_len) > pMsg->iobuf_nvalid)
+    {
+        pMsg->is_error = true;
+        MT_MSG_log(LOG_ERROR, pMsg, "%s: short payload, want %d have %d\n",
+                   pSchema->name, pSchema->fixed_len,
+                   pMsg->iobuf_nvalid - idx);
+        return (-1);
+    }
+    pWire = &(pMsg->iobuf[idx]);
+    pMsg->iobuf_idx = idx + pSchema->fixed_len;
+
+    if(LOG_test(LOG_DBG_MT_MSG_fields))
+    {
+        schema_trace(pMsg, pSchema, pWire, "rd");
+    }
+
+    pBase = (uint8_t *)(pStruct);
+    for(pC = pSchema->pCopies ; pC->len ; pC++)
+    {
+        memcpy((void *)(pBase + pC->offset),
+               (const void *)(pWire + pC->wire_offset), pC->len);
+    }
+
+    /* the runs are done, so the lengths of variable data are known */
+    for(pOp = pSchema->pOps ; pOp->type != MT_MSG_SCHEMA_TYPE_end ; pOp++)
+    {
+        switch(pOp->type)
+        {
+        default:
+            BUG_HERE("schema: bad type: %d\n", (int)(pOp->type));
+            break;
+        case MT_MSG_SCHEMA_TYPE_u8:
+        case MT_MSG_SCHEMA_TYPE_u16:
+        case MT_MSG_SCHEMA_TYPE_u32:
+        case MT_MSG_SCHEMA_TYPE_u64:
+            schema_store(pBase + pOp->offset, pOp->size,
+                         schema_rdLE(pWire + pOp->wire_offset, pOp->wire));
+            break;
+        case MT_MSG_SCHEMA_TYPE_bool:
+            *((bool *)(pBase + pOp->offset)) =
+                (pWire[pOp->wire_offset] != 0);
+            break;
+        case MT_MSG_SCHEMA_TYPE_addr:
+            schema_rdAddr(pWire + pOp->wire_offset,
+                          (ApiMac_sAddr_t *)(pBase + pOp->offset));
+            break;
+        case MT_MSG_SCHEMA_TYPE_skip:
+            break;
+        case MT_MSG_SCHEMA_TYPE_custom:
+            (*(pOp->pFn))(false, pWire + pOp->wire_offset,
+                          (void *)(pBase + pOp->offset));
+            break;
+        case MT_MSG_SCHEMA_TYPE_data:
+            /* points into the message, the length was decoded earlier */
+            memcpy((void *)(&len), (void *)(pBase + pOp->len_offset), 2);
+            pData = &(pMsg->iobuf[pMsg->iobuf_idx]);
+            memcpy((void *)(pBase + pOp->offset), (void *)(&pData),
+                   sizeof(pData));
+            MT_MSG_rdBuf_DBG(pMsg, NULL, len, pOp->name);
+            if(pMsg->is_error)
+            {
+                return (-1);
+            }
+            break;
+        }
+    }
+    return (0);
+}
+
+/*
+  Length of an encoded structure
+
+  Public function defined in mt_msg_schema.h
+*/
+int MT_MSG_SCHEMA_encodedLen(struct mt_msg_schema *pSchema,
+                             const void *pStruct)
+{
+    const struct mt_msg_schema_field *pOp;
+    uint16_t len;
+    int n;
+
+    if((pSchema->pOps == NULL) && (MT_MSG_SCHEMA_compile(pSchema) != 0))
+    {
+        return (-1);
+    }
+
+    n = pSchema->fixed_len;
+    for(pOp = pSchema->pOps ; pOp->type != MT_MSG_SCHEMA_TYPE_end ; pOp++)
+    {
+        if(pOp->type == MT_MSG_SCHEMA_TYPE_data)
+        {
+            memcpy((void *)(&len),
+                   (const void *)(((const uint8_t *)pStruct) + pOp->len_offset),
+                   2);
+            n += len;
+        }
+    }
+    return (n);
+}
+
+/*
+  Encode a structure into a payload
+
+  Public function defined in mt_msg_schema.h
+*/
+int MT_MSG_SCHEMA_encode(struct mt_msg *pMsg,
+                         struct mt_msg_schema *pSchema,
+                         const void *pStruct)
+{
+    const struct mt_msg_schema_field *pOp;
+    const struct mt_msg_schema_copy *pC;
+    const uint8_t *pBase;
+    uint8_t *pWire;
+    uint8_t *pData;
+    uint16_t len;
+
+    if(pMsg->is_error)
+    {
+        return (-1);
+    }
+    if((pSchema->pOps == NULL) && (MT_MSG_SCHEMA_compile(pSchema) != 0))
+    {
+        pMsg->is_error = true;
+        return (-1);
+    }
+
+    /* one check for the fixed part, this reserves the space */
+    MT_MSG_wrBuf_DBG(pMsg, NULL, pSchema->fixed_len, NULL);
+    if(pMsg->is_error)
+    {
+        return (-1);
+    }
+    pWire = &(pMsg->iobuf[pMsg->iobuf_idx - pSchema->fixed_len]);
+
+    pBase = (const uint8_t *)(pStruct);
+    for(pC = pSchema->pCopies ; pC->len ; pC++)
+    {
+        memcpy((void *)(pWire + pC->wire_offset),
+               (const void *)(pBase + pC->offset), pC->len);
+    }
+
+    for(pOp = pSchema->pOps ; pOp->type != MT_MSG_SCHEMA_TYPE_end ; pOp++)
+    {
+        switch(pOp->type)
+        {
+        default:
+            BUG_HERE("schema: bad type: %d\n", (int)(pOp->type));
+            break;
+        case MT_MSG_SCHEMA_TYPE_u8:
+        case MT_MSG_SCHEMA_TYPE_u16:
+        case MT_MSG_SCHEMA_TYPE_u32:
+        case MT_MSG_SCHEMA_TYPE_u64:
+            schema_wrLE(pWire + pOp->wire_offset, pOp->wire,
+                        schema_load(pBase + pOp->offset, pOp->size));
+            break;
+        case MT_MSG_SCHEMA_TYPE_bool:
+            pWire[pOp->wire_offset] =
+                *((const bool *)(pBase + pOp->offset)) ? 1 : 0;
+            break;
+        case MT_MSG_SCHEMA_TYPE_addr:
+            schema_wrAddr(pWire + pOp->wire_offset,
+                          (const ApiMac_sAddr_t *)(pBase + pOp->offset));
+            break;
+        case MT_MSG_SCHEMA_TYPE_skip:
+            memset((void *)(pWire + pOp->wire_offset), 0, pOp->wire);
+            break;
+        case MT_MSG_SCHEMA_TYPE_custom:
+            (*(pOp->pFn))(true, pWire + pOp->wire_offset,
+                          (void *)(pBase + pOp->offset));
+            break;
+        case MT_MSG_SCHEMA_TYPE_data:
+            memcpy((void *)(&len), (const void *)(pBase + pOp->len_offset), 2);
+            memcpy((void *)(&pData), (const void *)(pBase + pOp->offset),
+                   sizeof(pData));
+            MT_MSG_wrBuf_DBG(pMsg, pData, len, pOp->name);
+            if(pMsg->is_error)
+            {
+                return (-1);
+            }
+            break;
+        }
+    }
+
+    if(LOG_test(LOG_DBG_MT_MSG_fields))
+    {
+        schema_trace(pMsg, pSchema, pWire, "wr");
+    }
+    return (0);
+}
+
+/*
+ *  ========================================
+ *  Texas Instruments Micro Controller Style
+ *  ========================================
+ *  Local Variables:
+ *  mode: c
+ *  c-file-style: "bsd"
+ *  tab-width: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  End:
+ *  vim:set  filetype=c tabstop=4 shiftwidth=4 expandtab=true
+ */
@@ -102,6 +102,11 @@ void _ATOMIC_sem_put(intptr_t h);
  */
 uint64_t _TIMER_getAbsNow(void);
 
+/*
+ * @brief Get a monotonic time in nano seconds.
+ */
+uint64_t _TIMER_getNow_nSecs(void);
+
 /*
  * @brief Sleep for n Milliseconds
  */
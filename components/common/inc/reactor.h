@@ -0,0 +1,106 @@
+/******************************************************************************
+ @file reactor.h
+
+ @brief TIMAC 2.0 API single thread event loop for many streams
+
+ Group: WCS LPC
+ $Target Device: DEVICES $
+
+ ******************************************************************************
+ $License: BSD3 2016 $
+ ******************************************************************************
+ $Release Name: PACKAGE NAME $
+ $Release Date: PACKAGE RELEASE DATE $
+ *****************************************************************************/
+
+#if !defined(REACTOR_H)
+#define REACTOR_H
+
+/** ============================================================================
+ *  Overview
+ *  ========
+ *
+ *  A reactor is one thread that waits for any number of streams to
+ *  become readable, and calls a handler for each readable stream.
+ *
+ *  Handlers run on the reactor thread one at a time, they must not
+ *  block, ie: use STREAM_rdBytes() with a zero timeout.
+ *
+ *  On Linux this is built on epoll.
+ *
+ *  ============================================================================
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*!
+ * @typedef REACTOR_fn
+ * @brief Called on the reactor thread when a stream is readable
+ * @param cookie - the cookie given to REACTOR_add()
+ *
+ * This is also called on a hangup or error, the handler must
+ * then read (and see the error) or remove the stream, otherwise
+ * it is called again and again.
+ */
+typedef void REACTOR_fn(intptr_t cookie);
+
+/*!
+ * @brief Create a reactor and start its thread
+ * @param name - name for debug purposes
+ * @returns 0 on error, otherwise a reactor handle
+ */
+intptr_t REACTOR_create(const char *name);
+
+/*!
+ * @brief Stop the reactor thread and release the reactor
+ * @param h - the reactor
+ *
+ * Streams that are still registered are not closed.
+ */
+void REACTOR_destroy(intptr_t h);
+
+/*!
+ * @brief Call a handler when a stream is readable
+ * @param h - the reactor
+ * @param hStream - the stream, see STREAM_getFd()
+ * @param pFn - the handler
+ * @param cookie - given to the handler
+ * @returns 0 on success, negative if the stream cannot be waited on
+ */
+int REACTOR_add(intptr_t h, intptr_t hStream, REACTOR_fn *pFn, intptr_t cookie);
+
+/*!
+ * @brief Stop watching a stream
+ * @param h - the reactor
+ * @param hStream - the stream given to REACTOR_add()
+ *
+ * When this returns the handler is not running and is not called
+ * again. This may be called from within a handler.
+ */
+void REACTOR_remove(intptr_t h, intptr_t hStream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+/*
+ *  ========================================
+ *  Texas Instruments Micro Controller Style
+ *  ========================================
+ *  Local Variables:
+ *  mode: c
+ *  c-file-style: "bsd"
+ *  tab-width: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  End:
+ *  vim:set  filetype=c tabstop=4 shiftwidth=4 expandtab=true
+ */
@@ -206,6 +206,15 @@ int STREAM_rdBytes(intptr_t h, void *databytes, size_t nbytes, int timeout_mSecs
  */
 int STREAM_rxAvail(intptr_t h, int mSecs_timeout);
 
+/*!
+ * @brief Get the OS file descriptor to wait on for readability
+ * @param h - the stream
+ * @returns -1 if the stream cannot be waited on, otherwise the fd
+ *
+ * A uart with a read thread returns -1, its data arrives via a fifo.
+ */
+int STREAM_getFd(intptr_t h);
+
 /*!
  * @brief Close the stream
  * @param h - the stream
@@ -121,6 +121,15 @@ struct io_stream_funcs {
      * @param pIO - the io stream
      */
     void (*clear_fn)(struct io_stream *pIO);
+
+    /*!
+     * @brief [optional] get the OS file descriptor behind the stream
+     *
+     * @param pIO - the io stream
+     *
+     * @return -1 if the stream cannot be waited on, otherwise the fd
+     */
+    int  (*fd_fn)(struct io_stream *pIO);
 };
 
 /*!
@@ -37,6 +37,8 @@ struct uart_cfg {
 #define STREAM_UART_FLAG_rd_thread    _bit0
 /*! use hardware handshake */
 #define STREAM_UART_FLAG_hw_handshake _bit1
+/*! devname is /dev/ptmx, unlock the slave side, see ptsname() */
+#define STREAM_UART_FLAG_pty          _bit2
 /*! Basic IO, no thread no nothing blocking IO */
 #define STREAM_UART_FLAG_default     0
 
@@ -81,6 +81,16 @@ uint32_t TIMER_getNow(void);
  */
 uint64_t TIMER_getAbsNow(void);
 
+/*!
+ * @brief Get a monotonic time in nano seconds
+ *
+ * The starting point is arbitrary, only differences are meaningful.
+ * Used to measure short intervals, ie: message latency.
+ *
+ * @returns monotonic time in nano seconds
+ */
+uint64_t TIMER_getNow_nSecs(void);
+
 /*!
  * @brief A timer token.
  *
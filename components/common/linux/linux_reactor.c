@@ -0,0 +1,439 @@
+/******************************************************************************
+ @file linux_reactor.c
+
+ @brief TIMAC 2.0 API Linux specific epoll reactor
+
+ Group: WCS LPC
+ $Target Device: DEVICES $
+
+ ******************************************************************************
+ $License: BSD3 2016 $
+ ******************************************************************************
+ $Release Name: PACKAGE NAME $
+ $Release Date: PACKAGE RELEASE DATE $
+ *****************************************************************************/
+
+#include "compiler.h"
+#include "reactor.h"
+#include "stream.h"
+#include "threads.h"
+#include "mutex.h"
+#include "log.h"
+#include "timer.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+static const int reactor_check = 'R';
+
+/*! How many events are handled per epoll_wait() */
+#define REACTOR_MAX_EVENTS 16
+
+/*! One stream watched by a reactor */
+struct reactor_item {
+    /*! next in the item list, or the zombie list */
+    struct reactor_item *pNext;
+
+    /*! the stream being watched */
+    intptr_t hStream;
+
+    /*! the file descriptor being watched */
+    int fd;
+
+    /*! called when readable */
+    REACTOR_fn *pFn;
+
+    /*! given to pFn */
+    intptr_t cookie;
+
+    /*! set when removed, the reactor thread frees it */
+    bool is_dead;
+};
+
+/*! Private reactor implimentation details */
+struct reactor {
+    /*! used to verify this is a reactor */
+    const int  *test_ptr;
+
+    /*! name of this reactor for debug purposes */
+    char *name;
+
+    /*! the epoll file descriptor */
+    int epoll_fd;
+
+    /*! written to wake the reactor thread */
+    int wake_fd;
+
+    /*! the reactor thread */
+    intptr_t thread;
+
+    /*! held while handlers run and while the lists change */
+    intptr_t lock;
+
+    /*! streams being watched */
+    struct reactor_item *pItems;
+
+    /*! removed streams, freed by the reactor thread */
+    struct reactor_item *pZombies;
+
+    /*! set to stop the reactor thread */
+    volatile bool stop;
+};
+
+/*!
+ * @brief [private] convert a reactor handle into a reactor and verify it
+ * @param h - the reactor handle
+ * @return pointer to reactor details, or null if invalid
+ */
+static struct reactor *h2r(intptr_t h)
+{
+    struct reactor *pR;
+
+    if(h)
+    {
+        pR = (struct reactor *)h;
+        if(pR->test_ptr == &reactor_check)
+        {
+            return (pR);
+        }
+    }
+    LOG_printf(LOG_ERROR, "not a reactor: %p\n", (void *)(h));
+    return (NULL);
+}
+
+/*!
+ * @brief [private] Release removed items
+ * @param pR - the reactor, the lock must be held
+ */
+static void reactor_free_zombies(struct reactor *pR)
+{
+    struct reactor_item *pItem;
+
+    while(pR->pZombies)
+    {
+        pItem = pR->pZombies;
+        pR->pZombies = pItem->pNext;
+        free((void *)(pItem));
+    }
+}
+
+/*!
+ * @brief [private] The reactor thread
+ * @param cookie - the reactor in disguise
+ * @return nothing meaningful
+ */
+static intptr_t reactor_thread(intptr_t cookie)
+{
+    struct epoll_event events[ REACTOR_MAX_EVENTS ];
+    struct reactor_item *pItem;
+    struct reactor *pR;
+    uint64_t junk;
+    int n;
+    int x;
+
+    pR = (struct reactor *)(cookie);
+    while(!(pR->stop))
+    {
+        n = epoll_wait(pR->epoll_fd, events, REACTOR_MAX_EVENTS, -1);
+        if(n < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            LOG_printf(LOG_ERROR, "%s: epoll_wait() errno: %d %s\n",
+                       pR->name, errno, strerror(errno));
+            break;
+        }
+
+        /* a remove waits for this, so it knows the handler is not running */
+        MUTEX_lock(pR->lock, -1);
+        for(x = 0 ; x < n ; x++)
+        {
+            pItem = (struct reactor_item *)(events[x].data.ptr);
+            if(pItem == NULL)
+            {
+                /* our wake up call */
+                if(read(pR->wake_fd, &junk, sizeof(junk)) < 0)
+                {
+                    /* nothing to do, it is a counter */
+                }
+                continue;
+            }
+            /* an earlier handler might have removed it */
+            if(pItem->is_dead)
+            {
+                continue;
+            }
+            (*(pItem->pFn))(pItem->cookie);
+        }
+        /* no event from an earlier wait can refer to these */
+        reactor_free_zombies(pR);
+        MUTEX_unLock(pR->lock);
+    }
+    return (0);
+}
+
+/*!
+ * @brief [private] Wake the reactor thread
+ * @param pR - the reactor
+ */
+static void reactor_wake(struct reactor *pR)
+{
+    uint64_t one;
+
+    one = 1;
+    if(write(pR->wake_fd, &one, sizeof(one)) < 0)
+    {
+        LOG_printf(LOG_ERROR, "%s: cannot wake\n", pR->name);
+    }
+}
+
+/*
+ * Create a reactor
+ *
+ * Public function defined in reactor.h
+ */
+intptr_t REACTOR_create(const char *name)
+{
+    struct epoll_event ev;
+    struct reactor *pR;
+
+    pR = calloc(1, sizeof(*pR));
+    if(pR == NULL)
+    {
+        return (0);
+    }
+    pR->test_ptr = &reactor_check;
+    pR->epoll_fd = -1;
+    pR->wake_fd = -1;
+
+    pR->name = strdup(name);
+    pR->lock = MUTEX_create(name);
+    if((pR->name == NULL) || (pR->lock == 0))
+    {
+        goto fail;
+    }
+
+    pR->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    pR->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if((pR->epoll_fd < 0) || (pR->wake_fd < 0))
+    {
+        LOG_printf(LOG_ERROR, "%s: epoll/eventfd errno: %d %s\n",
+                   name, errno, strerror(errno));
+        goto fail;
+    }
+
+    memset((void *)(&ev), 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if(epoll_ctl(pR->epoll_fd, EPOLL_CTL_ADD, pR->wake_fd, &ev) != 0)
+    {
+        goto fail;
+    }
+
+    pR->thread = THREAD_create(name,
+                               reactor_thread,
+                               (intptr_t)(pR),
+                               THREAD_FLAGS_DEFAULT);
+    if(pR->thread == 0)
+    {
+        goto fail;
+    }
+    return ((intptr_t)(pR));
+
+fail:
+    LOG_printf(LOG_ERROR, "%s: cannot create reactor\n", name);
+    pR->thread = 0;
+    REACTOR_destroy((intptr_t)(pR));
+    return (0);
+}
+
+/*
+ * Destroy a reactor
+ *
+ * Public function defined in reactor.h
+ */
+void REACTOR_destroy(intptr_t h)
+{
+    struct reactor_item *pItem;
+    struct reactor *pR;
+
+    pR = h2r(h);
+    if(pR == NULL)
+    {
+        return;
+    }
+
+    if(pR->thread)
+    {
+        pR->stop = true;
+        reactor_wake(pR);
+        while(THREAD_isAlive(pR->thread))
+        {
+            TIMER_sleep(1);
+        }
+        THREAD_destroy(pR->thread);
+        pR->thread = 0;
+    }
+
+    while(pR->pItems)
+    {
+        pItem = pR->pItems;
+        pR->pItems = pItem->pNext;
+        free((void *)(pItem));
+    }
+    reactor_free_zombies(pR);
+
+    if(pR->epoll_fd >= 0)
+    {
+        close(pR->epoll_fd);
+    }
+    if(pR->wake_fd >= 0)
+    {
+        close(pR->wake_fd);
+    }
+    if(pR->lock)
+    {
+        MUTEX_destroy(pR->lock);
+    }
+    if(pR->name)
+    {
+        free((void *)(pR->name));
+    }
+    pR->test_ptr = NULL;
+    free((void *)(pR));
+}
+
+/*
+ * Watch a stream
+ *
+ * Public function defined in reactor.h
+ */
+int REACTOR_add(intptr_t h, intptr_t hStream, REACTOR_fn *pFn, intptr_t cookie)
+{
+    struct reactor_item *pItem;
+    struct epoll_event ev;
+    struct reactor *pR;
+    bool is_self;
+    int fd;
+    int r;
+
+    pR = h2r(h);
+    if(pR == NULL)
+    {
+        return (-1);
+    }
+    fd = STREAM_getFd(hStream);
+    if(fd < 0)
+    {
+        return (-1);
+    }
+
+    pItem = calloc(1, sizeof(*pItem));
+    if(pItem == NULL)
+    {
+        return (-1);
+    }
+    pItem->hStream = hStream;
+    pItem->fd = fd;
+    pItem->pFn = pFn;
+    pItem->cookie = cookie;
+
+    memset((void *)(&ev), 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = pItem;
+
+    /* a handler may add a stream, it already holds the lock */
+    is_self = (THREAD_self() == pR->thread);
+    if(!is_self)
+    {
+        MUTEX_lock(pR->lock, -1);
+    }
+    r = epoll_ctl(pR->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    if(r == 0)
+    {
+        pItem->pNext = pR->pItems;
+        pR->pItems = pItem;
+    }
+    if(!is_self)
+    {
+        MUTEX_unLock(pR->lock);
+    }
+
+    if(r != 0)
+    {
+        LOG_printf(LOG_ERROR, "%s: epoll_ctl(add, %d) errno: %d %s\n",
+                   pR->name, fd, errno, strerror(errno));
+        free((void *)(pItem));
+        return (-1);
+    }
+    return (0);
+}
+
+/*
+ * Stop watching a stream
+ *
+ * Public function defined in reactor.h
+ */
+void REACTOR_remove(intptr_t h, intptr_t hStream)
+{
+    struct reactor_item **ppItem;
+    struct reactor_item *pItem;
+    struct reactor *pR;
+    bool is_self;
+
+    pR = h2r(h);
+    if(pR == NULL)
+    {
+        return;
+    }
+
+    /* once we hold the lock, the handler is not running */
+    is_self = (THREAD_self() == pR->thread);
+    if(!is_self)
+    {
+        MUTEX_lock(pR->lock, -1);
+    }
+
+    for(ppItem = &(pR->pItems) ; *ppItem ; ppItem = &((*ppItem)->pNext))
+    {
+        if((*ppItem)->hStream == hStream)
+        {
+            break;
+        }
+    }
+    pItem = *ppItem;
+    if(pItem)
+    {
+        *ppItem = pItem->pNext;
+        (void)epoll_ctl(pR->epoll_fd, EPOLL_CTL_DEL, pItem->fd, NULL);
+        /* an event might already be pending, the thread frees it */
+        pItem->is_dead = true;
+        pItem->pNext = pR->pZombies;
+        pR->pZombies = pItem;
+    }
+
+    if(!is_self)
+    {
+        MUTEX_unLock(pR->lock);
+    }
+}
+
+/*
+ *  ========================================
+ *  Texas Instruments Micro Controller Style
+ *  ========================================
+ *  Local Variables:
+ *  mode: c
+ *  c-file-style: "bsd"
+ *  tab-width: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  End:
+ *  vim:set  filetype=c tabstop=4 shiftwidth=4 expandtab=true
+ */
@@ -682,6 +682,20 @@ uint64_t _TIMER_getAbsNow(void)
     return (r);
 }
 
+/*
+ * Linux specific monotonic nano second time
+ *
+ * Defined in hlos_specific.h
+ */
+uint64_t _TIMER_getNow_nSecs(void)
+{
+    struct timespec tv;
+
+    clock_gettime(CLOCK_MONOTONIC, &tv);
+
+    return (((uint64_t)(tv.tv_sec) * 1000000000ULL) + tv.tv_nsec);
+}
+
 /*
  * Linux specific sleep function
  *
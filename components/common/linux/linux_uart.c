@@ -13,6 +13,7 @@
  $Release Date: PACKAGE RELEASE DATE $
  *****************************************************************************/
 
+#define _GNU_SOURCE 1  /* grantpt() and unlockpt() */
 #include "stream.h"
 #include "fifo.h"
 #include "threads.h"
@@ -27,6 +28,7 @@
 #include "stream_private.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -559,6 +561,23 @@ static int _uart_flush(struct io_stream *pIO)
     return (r);
 }
 
+/*!
+ * @brief Get the file descriptor of the uart, see STREAM_getFd()
+ * @param pIO - the uart stream
+ * @returns -1 if a read thread owns the fd, otherwise the fd
+ */
+static int _uart_fd(struct io_stream *pIO)
+{
+    struct linux_uart *pLU;
+
+    pLU = uart_pio_to_plu(pIO);
+    if((pLU == NULL) || (pLU->rx_fifo))
+    {
+        return (-1);
+    }
+    return (pLU->h);
+}
+
 /*!
  * @var STREAM_uart_funcs
  * @brief [private]
@@ -571,7 +590,8 @@ static const struct io_stream_funcs STREAM_uart_funcs = {
     .wr_fn         = _uart_wrBytes,
     .rd_fn         = _uart_rdBytes,
     .flush_fn      = _uart_flush,
-    .poll_fn       = _uart_pollRxAvail
+    .poll_fn       = _uart_pollRxAvail,
+    .fd_fn         = _uart_fd
 };
 
 /*
@@ -753,6 +773,26 @@ intptr_t STREAM_createUart(const struct uart_cfg *pCFG)
     bits |= TIOCM_RTS;
     bits |= TIOCM_DTR;
     r = ioctl(pLU->h, TIOCMSET, &bits);
+    if((r < 0) && (errno == ENOTTY))
+    {
+        /* pseudo terminals have no modem lines */
+        LOG_printf(LOG_DBG_UART, "%s: no modem lines\n", pLU->cfg.devname);
+        r = 0;
+    }
+
+    if((r == 0) && UF_isSet(pLU, pty))
+    {
+        /* we are the master, let the other side open the slave */
+        r = grantpt(pLU->h);
+        if(r == 0)
+        {
+            r = unlockpt(pLU->h);
+        }
+        if(r < 0)
+        {
+            _uart_error(pLU, "unlockpt", NULL);
+        }
+    }
 
     /* we set this, so we need to put it back later */
     pLU->tcs_set = true;
@@ -518,6 +518,23 @@ int STREAM_rxAvail(intptr_t h, int timeout_mSec)
     return ((*(pIO->pFuncs->poll_fn))(pIO,timeout_mSec));
 }
 
+/*
+ * Get the OS file descriptor behind a stream
+ *
+ * Public function defined in stream.h
+ */
+int STREAM_getFd(intptr_t h)
+{
+    struct io_stream *pIO;
+
+    pIO = STREAM_hToStruct(h);
+    if((pIO == NULL) || (pIO->pFuncs->fd_fn == NULL))
+    {
+        return (-1);
+    }
+    return ((*(pIO->pFuncs->fd_fn))(pIO));
+}
+
 /*
  * Flush (write-commit) all data in a stream to the output device
  *
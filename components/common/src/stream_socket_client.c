@@ -213,7 +213,8 @@ static const struct io_stream_funcs socket_client_funcs = {
     .rd_fn = socket_client_rd,
     .close_fn = socket_client_close,
     .poll_fn  = socket_client_poll,
-    .flush_fn = socket_client_flush
+    .flush_fn = socket_client_flush,
+    .fd_fn    = _stream_socket_fd
 };
 
 /*
@@ -491,6 +491,24 @@ void _stream_socket_close(struct linux_socket *pS)
     }
 }
 
+/*
+ * Pseudo private function to get the fd of a socket
+ * Shared between client and server sockets.
+ *
+ * Pseudo-private function defined in stream_socket_private.h
+ */
+int _stream_socket_fd(struct io_stream *pIO)
+{
+    struct linux_socket *pS;
+
+    pS = _stream_socket_io2ps(pIO, 0);
+    if(pS == NULL)
+    {
+        return (-1);
+    }
+    return ((int)(pS->h));
+}
+
 /*
  * Pseudo private function to poll (read) a socket
  * Shared between client and server sockets.
@@ -129,6 +129,13 @@ void _stream_socket_close(struct linux_socket *pS);
  */
 bool _stream_socket_poll(struct linux_socket *pS, int mSecs_timeout);
 
+/*!
+ * @brief Get the file descriptor of a socket, see STREAM_getFd()
+ * @param pIO - the io stream
+ * @returns -1 if this is not a socket, otherwise the fd
+ */
+int _stream_socket_fd(struct io_stream *pIO);
+
 /*!
  * @brief bind this socket (server/client) to a specific interface.
  * @param pS - the socket information
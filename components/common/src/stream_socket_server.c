@@ -194,7 +194,8 @@ static bool socket_server_poll(struct io_stream *pIO, int mSec_timeout)
 {
     struct linux_socket *pS;
 
-    pS = _stream_socket_io2ps(pIO, 's');
+    /* only an accepted socket carries data */
+    pS = _stream_socket_io2ps(pIO, 'a');
     if(pS == NULL)
     {
         return (false);
@@ -242,7 +243,8 @@ static const struct io_stream_funcs socket_server_funcs = {
     .rd_fn = socket_server_rd,
     .close_fn = socket_server_close,
     .poll_fn  = socket_server_poll,
-    .flush_fn = socket_server_flush
+    .flush_fn = socket_server_flush,
+    .fd_fn    = _stream_socket_fd
 };
 
 /*
@@ -62,6 +62,7 @@ int UART_INI_settingsOne(struct ini_parser *pINI,
 static const struct ini_flag_name uart_ini_cfg_flags[] = {
     { .name = "rd_thread", .value = STREAM_UART_FLAG_rd_thread },
     { .name = "hw_handshake", .value = STREAM_UART_FLAG_hw_handshake },
+    { .name = "pty", .value = STREAM_UART_FLAG_pty },
     { .name = "default", .value = STREAM_UART_FLAG_default },
     { .name = NULL }
 };
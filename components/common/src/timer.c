@@ -151,6 +151,11 @@ uint64_t TIMER_getAbsNow(void)
     return (_TIMER_getAbsNow());
 }
 
+uint64_t TIMER_getNow_nSecs(void)
+{
+    return (_TIMER_getNow_nSecs());
+}
+
 void TIMER_sleep(uint32_t mSecs)
 {
     _TIMER_sleep(mSecs);
@@ -337,7 +337,9 @@ static int _simple_rw(struct unix_fdrw *pRW)
         }
         else
         {
-            if(pRW->mSecs_timeout > 0)
+            /* a zero timeout takes only what is there, never blocks */
+            if((pRW->mSecs_timeout > 0) ||
+               ((pRW->mSecs_timeout == 0) && (pRW->type != 'f')))
             {
                 r = POLL_readable(pRW);
                 if(r < 1)
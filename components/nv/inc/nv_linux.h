@@ -109,9 +109,109 @@ void NV_LINUX_load(void);
 
 /*!
  * @brief Save the NV simulation file to disk
+ *
+ * With the journal ([nv] journal = true, the default) only the changes
+ * since the last save are written, to "<filename>.jnl", and synced.
+ * That happens in the background, within [nv] flush-deadline-msecs,
+ * use NV_LINUX_sync() when the changes must be on disk now.
  */
 void NV_LINUX_save(void);
 
+/*!
+ * @brief Write all saved NV changes to disk before returning
+ */
+void NV_LINUX_sync(void);
+
+/*!
+ * @brief Name of the NV simulation file, [nv] filename
+ * @returns the name, do not free
+ */
+const char *NV_LINUX_getFilename(void);
+
+/*!
+ * @brief Is the log structured driver selected? [nv] backend = log
+ * @returns true for the log driver, false for NVOCMP
+ */
+bool NV_LINUX_isLog(void);
+
+/*!
+ * @brief Use another NV simulation file
+ * @param pName - the file, must remain valid while it is in use
+ * @returns the file used before, give it back when done
+ *
+ * For tools that work on a scratch copy instead of [nv] filename,
+ * call before the NV is initialized.
+ */
+const char *NV_LINUX_setFilename(const char *pName);
+
+/*!
+ * @brief Return the API of the NV driver selected by [nv] backend
+ * @param pfn - pointer to the caller's structure of NV function pointers
+ *
+ * "flash" (the default) is NVOCMP over the NV simulation file, "log"
+ * is the log structured store in nvlog.h. With [nv] migrate = true,
+ * the log driver's initNV() copies the items from an existing NV
+ * simulation file when there is no log yet, or when an earlier copy
+ * did not finish, see NV_LINUX_migrateState().
+ */
+void NV_LINUX_loadApiPtrs(NVINTF_nvFuncts_t *pfn);
+
+/*! No migration into this driver, see NV_LINUX_migrateState() */
+#define NV_LINUX_MIGRATE_none     0
+/*! A migration started and did not finish */
+#define NV_LINUX_MIGRATE_started  1
+/*! A migration finished, or the store started out empty */
+#define NV_LINUX_MIGRATE_done     2
+
+/*!
+ * @brief Copy every item in the NV simulation file to another driver
+ * @param pTo - the destination driver, initialized
+ * @returns number of items copied, -1 on error
+ *
+ * Items already in the destination are left alone. A marker item
+ * (system id NVINTF_SYSID_NVDRVR) records the migration as started
+ * before the copy and as done after it, so an interrupted copy is
+ * run again.
+ */
+int NV_LINUX_migrate(const NVINTF_nvFuncts_t *pTo);
+
+/*!
+ * @brief Where is the migration into this driver?
+ * @param pNv - the driver, initialized
+ * @returns NV_LINUX_MIGRATE_none, _started or _done
+ */
+int NV_LINUX_migrateState(const NVINTF_nvFuncts_t *pNv);
+
+/*!
+ * @brief CRC-32 (IEEE 802.3)
+ * @param crc - crc so far, start with 0
+ * @param pData - bytes to add
+ * @param n - number of bytes
+ * @returns the updated crc
+ */
+uint32_t NV_LINUX_crc32(uint32_t crc, const uint8_t *pData, unsigned n);
+
+/*!
+ * @brief Push a file stream to the disk, fatal on error
+ * @param s - the file stream
+ * @param pName - for the error message
+ */
+void NV_LINUX_syncFile(intptr_t s, const char *pName);
+
+/*!
+ * @brief Push a create, rename or unlink in the directory holding
+ *        a file to the disk
+ * @param pName - the file
+ */
+void NV_LINUX_syncDir(const char *pName);
+
+/*!
+ * @brief Simulation of NVS_getAttrs(), the NV size from the [nv] settings
+ * @param pAttrs - set to the page size ([nv] page-size-bytes) and the
+ *                 size of all pages ([nv] num-pages)
+ */
+void NV_LINUX_getAttrs(NVS_Attrs *pAttrs);
+
 /*!
  *@brief Simulation of embedded macro NVS_read
  */
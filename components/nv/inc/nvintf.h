@@ -154,7 +154,11 @@ typedef uint8_t (*NVINTF_readItem)(NVINTF_itemID_t id,
                                    uint16_t length,
                                    void *buffer );
 
-//! Function pointer definition for the NVINTF_readContItem() function
+//! Function pointer definition for the NVINTF_readContItem() function.
+//! Reads the newest item of the system and item ID whose clength bytes
+//! at coffset match cbuffer. Every item of that ID is compared, so the
+//! cost grows with their number. NVOCMP compares the first 16 data
+//! bytes in RAM, content further in is read from flash per item.
 typedef uint8_t (*NVINTF_readContItem)(NVINTF_itemID_t id,
                                     uint16_t offset,
                                     uint16_t rlength,
@@ -181,6 +185,9 @@ typedef void (*NVINTF_unlockNV)(IArg);
 //! Function pointer definition for the NVINTF_doNext() function
 typedef uint8_t (*NVINTF_doNext)(NVINTF_nvProxy_t *nvProxy);
 
+//! Function pointer definition for the NVINTF_syncNV() function
+typedef uint8_t (*NVINTF_syncNV)(void);
+
 //! Structure of NV API function pointers
 typedef struct nvintf_nvfuncts_t
 {
@@ -208,6 +215,8 @@ typedef struct nvintf_nvfuncts_t
     NVINTF_lockNV lockNV;
     //! Unlock item function
     NVINTF_unlockNV unlockNV;
+    //! Write pending changes to storage now, NULL if always written
+    NVINTF_syncNV syncNV;
 } NVINTF_nvFuncts_t;
 
 //*****************************************************************************
@@ -0,0 +1,126 @@
+/******************************************************************************
+ @file nvlog.h
+
+ @brief TIMAC 2.0 API Log structured NV store for Linux
+
+ Group: CMCU LPC
+ $Target Device: DEVICES $
+
+ ******************************************************************************
+ $License: BSD3 2019 $
+ ******************************************************************************
+ $Release Name: PACKAGE NAME $
+ $Release Date: PACKAGE RELEASE DATE $
+ *****************************************************************************/
+
+#ifndef NVLOG_H
+#define NVLOG_H
+
+/******************************************************************************
+ Includes
+ *****************************************************************************/
+
+#include "nvintf.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*
+ * Overview
+ * ========
+ *
+ * NVOCMP simulates a few pages of on chip flash, the capacity is
+ * limited by the page count and every lookup walks the pages. On
+ * Linux there is a file system, this NV driver uses it directly:
+ *
+ *  - Items are records appended to segment files "<filename>.NNNNNN"
+ *  - Every record has a crc32, a torn write at the end of the newest
+ *    segment is cut off on load.
+ *  - A RAM hash table maps the item ID to the newest record, the item
+ *    data is kept in RAM too, so reads never touch the disk.
+ *  - A background thread syncs the appended records within
+ *    flush_msecs and compacts: when enough of the segments is old
+ *    records, the live items of the oldest segment are copied to the
+ *    newest and the oldest segment is deleted.
+ *
+ * The driver has the same API as NVOCMP, see NVLOG_loadApiPtrs().
+ * NV_LINUX_loadApiPtrs() picks the driver from the [nv] backend setting
+ * and NV_LINUX_migrate() copies the items from the NVOCMP image.
+ */
+
+/*!
+ * @struct nvlog_cfg
+ * @brief Settings for the log NV driver, set before initNV()
+ */
+struct nvlog_cfg {
+    /*! segment files are named "<filename>.NNNNNN" */
+    const char *filename;
+
+    /*! start a new segment when the newest is this big */
+    unsigned segment_bytes;
+
+    /*! compact when this percent of the closed segments is old records,
+        0 = only when compactNV() is called */
+    int compact_percent;
+
+    /*! records are synced within this, 0 = before the write returns */
+    int flush_msecs;
+};
+
+/*! The log NV driver settings */
+extern struct nvlog_cfg NVLOG_cfg;
+
+/*!
+ * @struct nvlog_stats
+ * @brief What is in the log, see NVLOG_getStats()
+ */
+struct nvlog_stats {
+    /*! items stored */
+    unsigned n_items;
+    /*! segment files */
+    unsigned n_segments;
+    /*! bytes in the segment files */
+    uint64_t total_bytes;
+    /*! bytes of records that are the newest copy of an item */
+    uint64_t live_bytes;
+    /*! segments compacted since initNV() */
+    unsigned n_compactions;
+    /*! true if there were no segment files when initNV() was called */
+    bool is_new;
+};
+
+/*!
+ * @brief Return the log NV driver API function pointers
+ * @param pfn - pointer to the caller's structure of NV function pointers
+ */
+void NVLOG_loadApiPtrs(NVINTF_nvFuncts_t *pfn);
+
+/*!
+ * @brief Get the log statistics
+ * @param pStats - filled in
+ */
+void NVLOG_getStats(struct nvlog_stats *pStats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NVLOG_H */
+
+/*
+ *  ========================================
+ *  Texas Instruments Micro Controller Style
+ *  ========================================
+ *  Local Variables:
+ *  mode: c
+ *  c-file-style: "bsd"
+ *  tab-width: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  End:
+ *  vim:set  filetype=c tabstop=4 shiftwidth=4 expandtab=true
+ */
@@ -109,6 +109,20 @@ extern void NVOCMP_loadApiPtrsMin(NVINTF_nvFuncts_t *pfn);
  */
 extern void NVOCMP_setCheckVoltage(void *funcPtr);
 
+/**
+ * @fn      NVOCMP_setItemIndex
+ *
+ * @brief   Global function to turn the RAM item index on (the default) or
+ *          off. The index maps each active item ID to its location, so
+ *          reads, updates and existence checks do not search the pages.
+ *          Call this before initNV(), or between lockNV() and unlockNV().
+ *
+ * @param   enable - true to use the index
+ *
+ * @return  none
+ */
+extern void NVOCMP_setItemIndex(bool enable);
+
 // Exception function can be defined to handle NV corruption issues
 // If none provided, NV module attempts to proceed ignoring problem
 #if !defined (NVOCMP_EXCEPTION)
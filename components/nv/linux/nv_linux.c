@@ -18,6 +18,7 @@
 ******************************************************************************/
 
 #include "nv_linux.h"
+#include "nvlog.h"
 
 #include "stream.h"
 #include "log.h"
@@ -25,9 +26,16 @@
 #include "fatal.h"
 #include "ini_file.h"
 #include "bitsnbits.h"
+#include "threads.h"
+#include "ti_semaphore.h"
+#include "timer.h"
 
 #include <string.h>
 #include <malloc.h>    /* for calloc */
+#include <stdio.h>
+#include <unistd.h>    /* for fdatasync */
+#include <fcntl.h>
+#include <libgen.h>    /* for dirname */
 
 /******************************************************************************
  Constants and definitions
@@ -35,18 +43,16 @@
 
 // nvocmp.c defines
 
-// CC26x2/CC13x2 devices flash page size is (1 << 13) or 0x2000
+// CC26x2/CC13x2 devices flash page size is (1 << 13) or 0x2000, the
+// default, [nv] page-size-bytes sets it
 #define PAGE_SIZE_LSHIFT 13
 #if !defined (FLASH_PAGE_SIZE)
 #define FLASH_PAGE_SIZE  (1 << PAGE_SIZE_LSHIFT)
 #endif // FLASH_PAGE_SIZE
 
+// Default page count, [nv] num-pages sets it
 #ifndef NVOCMP_NVPAGES
-#define NVOCMP_NVPAGES      2     //1 ~ 5 are supported
-#endif
-
-#if (NVOCMP_NVPAGES > 5)
-#error "NVOCMP_NVPAGES should be in between 1 and 5"
+#define NVOCMP_NVPAGES      2
 #endif
 
 // NVS.h defines
@@ -57,8 +63,39 @@
 #define SNV_FIRST_PAGE  0x00
 #endif
 
+/*
+ * The journal
+ * ===========
+ *
+ * Writing the whole image for every NV change costs NV size bytes of
+ * I/O each time. Instead each NV_LINUX_write() and NV_LINUX_erase()
+ * adds a small record to a RAM buffer and NV_LINUX_save() marks a save
+ * point. The flusher thread appends the records up to the last save
+ * point and a commit record to "<filename>.jnl" and syncs it, within
+ * NV_flushMsecs of the first unwritten save, sooner when NV_flushBytes
+ * are waiting or when NV_LINUX_sync() is called. Saves made meanwhile
+ * share one write and one sync.
+ *
+ * Record: type(1) page(1) offset(2) length(2) spare(2), then data
+ *         Commit records hold: byte count(4) crc32(4) of the records
+ *         since the previous commit.
+ *
+ * On load the committed records are replayed over the image, a torn
+ * tail (no commit, bad crc) is dropped. When the journal is larger
+ * than NV_jnlMaxBytes the records are committed, then the image is
+ * rewritten (tmp file, sync, rename) and the journal emptied. The
+ * journal then ends at the state of the new image; a crash before it
+ * is emptied replays it over that image, and as each byte ends up
+ * with the last value the journal gave it, the image is unchanged.
+ * A journal that stopped short of the image would undo newer writes.
+ */
+#define NV_JNL_HDR_SIZE  8
+#define NV_JNL_WRITE     'W'
+#define NV_JNL_ERASE     'E'
+#define NV_JNL_COMMIT    'C'
+
 static uint32_t nvBegPage = SNV_FIRST_PAGE;
-static uint32_t nvEndPage = (SNV_FIRST_PAGE + NVOCMP_NVPAGES - 1);
+static uint32_t nvNumPages = NVOCMP_NVPAGES;
 static uint32_t nvPageSize = FLASH_PAGE_SIZE;
 
 /******************************************************************************
@@ -73,6 +110,57 @@ static const char *NV_filename = _nv_default_filename;
 static uint8_t    *NV_ramSim;
 static unsigned    NV_ramLength;
 
+/*! Use the journal? if not, the image is rewritten on every save */
+static bool        NV_jnlEnable = true;
+/*! Rewrite the image when the journal is bigger, 0 = NV size */
+static unsigned    NV_jnlMaxBytes;
+/*! Open journal file, 0 if not open */
+static intptr_t    NV_jnlStream;
+/*! Bytes in the journal file */
+static unsigned    NV_jnlFileBytes;
+/*! Records not committed yet */
+static uint8_t    *NV_jnlBuf;
+/*! Bytes used in NV_jnlBuf */
+static unsigned    NV_jnlLen;
+/*! Size of NV_jnlBuf */
+static unsigned    NV_jnlSize;
+/*! Bytes of NV_jnlBuf up to the last NV_LINUX_save() */
+static unsigned    NV_jnlSaved;
+/*! When NV_jnlSaved became non zero, TIMER_getNow() */
+static uint32_t    NV_jnlDirtyTime;
+/*! Saved changes reach the disk within this, 0 = in NV_LINUX_save() */
+static int         NV_flushMsecs = 200;
+/*! Flush early when this many bytes are waiting */
+static unsigned    NV_flushBytes = 4096;
+
+/*! Use the log structured driver (nvlog.h) instead of NVOCMP? */
+static bool        NV_useLog;
+/*! Copy the NV simulation file into a new log? */
+static bool        NV_migrateEnable = true;
+/*! The log driver, initNV() is wrapped by NV_LINUX_initLog() */
+static NVINTF_nvFuncts_t NV_logFns;
+/*! The migration marker item, see NV_LINUX_migrateState() */
+static const NVINTF_itemID_t NV_migrateId = {
+    .systemID = NVINTF_SYSID_NVDRVR,
+    .itemID   = 0x4d47,
+    .subID    = 0
+};
+
+/*! Only one flush at a time, see NV_LINUX_flush() */
+static intptr_t    nvIoMutex;
+/*! Wakes the flusher thread */
+static intptr_t    nvFlushSem;
+/*! The flusher thread, 0 if none */
+static intptr_t    nvFlushThread;
+/*! Journal records being written */
+static uint8_t    *NV_ioBuf;
+/*! Size of NV_ioBuf */
+static unsigned    NV_ioSize;
+/*! Copy of the image being checkpointed */
+static uint8_t    *NV_ioImage;
+
+static intptr_t NV_LINUX_flusher(intptr_t cookie);
+
 const struct ini_flag_name nv_log_flags[] = {
     { .name = "nv-debug" , .value = LOG_DBG_NV_dbg  },
     { .name = "nv-rdwr"  , .value = LOG_DBG_NV_rdwr },
@@ -96,13 +184,352 @@ static uint8_t *NVOCMP_FLASHADDR(uint32_t pg, uint32_t ofs)
     uint8_t *p;
     uint32_t x;
 
-    x = (((pg) * FLASH_PAGE_SIZE) + ofs);
+    x = (((pg) * nvPageSize) + ofs);
     p = NV_ramSim;
     p = p + x;
     return (p);
 }
 
 
+/*
+  CRC-32 (IEEE 802.3) for the journal commit records
+
+  Public function defined in nv_linux.h
+ */
+uint32_t NV_LINUX_crc32(uint32_t crc, const uint8_t *pData, unsigned n)
+{
+    int b;
+
+    crc = ~crc;
+    while(n)
+    {
+        crc = crc ^ (*pData);
+        for(b = 0 ; b < 8 ; b++)
+        {
+            crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+        }
+        pData++;
+        n--;
+    }
+    return (~crc);
+}
+
+/*!
+ * @brief Name of a file next to the NV simulation file
+ * @param suffix - added to the NV filename
+ * @returns malloc'ed name, free with free()
+ */
+static char *NV_LINUX_fileName(const char *suffix)
+{
+    char *cp;
+    size_t n;
+
+    n = strlen(NV_filename) + strlen(suffix) + 1;
+    cp = calloc(1, n);
+    if(cp == NULL)
+    {
+        FATAL_printf("NV no ram\n");
+    }
+    snprintf(cp, n, "%s%s", NV_filename, suffix);
+    return (cp);
+}
+
+/*
+  Push a file stream to the disk
+
+  Public function defined in nv_linux.h
+ */
+void NV_LINUX_syncFile(intptr_t s, const char *pName)
+{
+    FILE *fp;
+
+    fp = STREAM_getFp(s);
+    if((STREAM_flush(s) != 0) || (fp == NULL) || (fdatasync(fileno(fp)) != 0))
+    {
+        FATAL_perror(pName);
+    }
+}
+
+/*
+  Push a rename in the directory holding a file to the disk
+
+  Public function defined in nv_linux.h
+ */
+void NV_LINUX_syncDir(const char *pName)
+{
+    char *cp;
+    int fd;
+
+    cp = strdup(pName);
+    if(cp == NULL)
+    {
+        FATAL_printf("NV no ram\n");
+    }
+    fd = open(dirname(cp), O_RDONLY);
+    if(fd >= 0)
+    {
+        /* not all file systems can, it is only a hint then */
+        (void)fsync(fd);
+        close(fd);
+    }
+    free(cp);
+}
+
+/*!
+ * @brief Write the image to a file
+ * @param pName - the file
+ * @param pImage - the image, NV_ramLength bytes
+ * @param do_sync - push it to the disk before returning
+ */
+static void NV_LINUX_wrImage(const char *pName,
+                             const uint8_t *pImage,
+                             bool do_sync)
+{
+    intptr_t s;
+    int r;
+
+    s = STREAM_createWrFile(pName);
+    if(s == 0)
+    {
+        FATAL_perror(pName);
+    }
+    r = STREAM_wrBytes(s, pImage, NV_ramLength, 0);
+    if(do_sync && (r == (int)NV_ramLength))
+    {
+        NV_LINUX_syncFile(s, pName);
+    }
+    STREAM_close(s);
+
+    if(r != (int)NV_ramLength)
+    {
+        FATAL_printf("%s: Cannot write %d bytes, wrote: %d instead\n",
+                     pName,
+                     NV_ramLength,
+                     r);
+    }
+}
+
+/*!
+ * @brief Add a record to the uncommitted journal records
+ * @param type - NV_JNL_xxx
+ * @param pg - page
+ * @param off - offset in the page
+ * @param pData - bytes for write records
+ * @param len - number of bytes
+ */
+static void NV_LINUX_jnlAdd(int type,
+                            uint8_t pg,
+                            uint16_t off,
+                            const uint8_t *pData,
+                            uint16_t len)
+{
+    uint8_t *p;
+    unsigned n;
+
+    n = NV_jnlLen + NV_JNL_HDR_SIZE + len;
+    if(n > NV_jnlSize)
+    {
+        n = n + 1024;
+        p = realloc(NV_jnlBuf, n);
+        if(p == NULL)
+        {
+            FATAL_printf("NV no ram\n");
+        }
+        NV_jnlBuf = p;
+        NV_jnlSize = n;
+    }
+
+    p = NV_jnlBuf + NV_jnlLen;
+    p[0] = (uint8_t)type;
+    p[1] = pg;
+    p[2] = (uint8_t)(off >> 0);
+    p[3] = (uint8_t)(off >> 8);
+    p[4] = (uint8_t)(len >> 0);
+    p[5] = (uint8_t)(len >> 8);
+    p[6] = 0;
+    p[7] = 0;
+    if(len)
+    {
+        memcpy(p + NV_JNL_HDR_SIZE, pData, len);
+    }
+    NV_jnlLen += NV_JNL_HDR_SIZE + len;
+}
+
+/*!
+ * @brief Rewrite the image file and empty the journal
+ * @param pImage - the image, at a save point
+ *
+ * The image is written to a temporary file first and renamed, a crash
+ * at any point leaves either the old image and the full journal, or
+ * the new image with or without the journal. The journal must already
+ * hold every change up to pImage, replaying it is then harmless.
+ */
+static void NV_LINUX_checkpoint(const uint8_t *pImage)
+{
+    char *pTmp;
+    char *pJnl;
+
+    pTmp = NV_LINUX_fileName(".tmp");
+    pJnl = NV_LINUX_fileName(".jnl");
+
+    LOG_printf(LOG_DBG_NV_dbg, "nvram: checkpoint: %s, journal=%u\n",
+               NV_filename, NV_jnlFileBytes);
+
+    NV_LINUX_wrImage(pTmp, pImage, true);
+    if(rename(pTmp, NV_filename) != 0)
+    {
+        FATAL_perror(NV_filename);
+    }
+    NV_LINUX_syncDir(NV_filename);
+
+    /* the image has everything, start a new journal */
+    if(NV_jnlStream)
+    {
+        STREAM_close(NV_jnlStream);
+    }
+    NV_jnlStream = STREAM_createWrFile(pJnl);
+    if(NV_jnlStream == 0)
+    {
+        FATAL_perror(pJnl);
+    }
+    NV_LINUX_syncFile(NV_jnlStream, pJnl);
+    NV_jnlFileBytes = 0;
+
+    free(pTmp);
+    free(pJnl);
+}
+
+/*!
+ * @brief Read 16 or 32bit little endian values from a journal record
+ */
+static uint32_t NV_LINUX_rdLE(const uint8_t *p, int n)
+{
+    uint32_t v;
+
+    v = 0;
+    while(n)
+    {
+        n--;
+        v = (v << 8) | p[n];
+    }
+    return (v);
+}
+
+/*!
+ * @brief Apply the committed records in the journal file to the image
+ */
+static void NV_LINUX_replay(void)
+{
+    char *pJnl;
+    uint8_t *pBuf;
+    uint8_t *p;
+    int64_t filesize;
+    intptr_t s;
+    unsigned n;
+    unsigned pos;
+    unsigned start;
+    unsigned x;
+    unsigned len;
+    unsigned addr;
+    int ncommits;
+
+    pJnl = NV_LINUX_fileName(".jnl");
+    filesize = STREAM_FS_getSize(pJnl);
+    if(filesize <= 0)
+    {
+        free(pJnl);
+        return;
+    }
+    n = (unsigned)filesize;
+    pBuf = calloc(1, n);
+    if(pBuf == NULL)
+    {
+        FATAL_printf("NV no ram\n");
+    }
+    s = STREAM_createRdFile(pJnl);
+    if(s == 0)
+    {
+        FATAL_perror(pJnl);
+    }
+    if(STREAM_rdBytes(s, pBuf, n, 0) != (int)n)
+    {
+        FATAL_printf("nvram: %s, cannot read %u bytes\n", pJnl, n);
+    }
+    STREAM_close(s);
+
+    ncommits = 0;
+    pos = 0;
+    start = 0;
+    while((pos + NV_JNL_HDR_SIZE) <= n)
+    {
+        p = pBuf + pos;
+        len = NV_LINUX_rdLE(p + 4, 2);
+        if((pos + NV_JNL_HDR_SIZE + len) > n)
+        {
+            break;
+        }
+        if(p[0] == NV_JNL_WRITE)
+        {
+            addr = (p[1] * nvPageSize) + NV_LINUX_rdLE(p + 2, 2);
+            if((addr + len) > NV_ramLength)
+            {
+                break;
+            }
+        }
+        else if(p[0] == NV_JNL_ERASE)
+        {
+            if(((p[1] + 1) * nvPageSize) > NV_ramLength)
+            {
+                break;
+            }
+        }
+        else if(p[0] == NV_JNL_COMMIT)
+        {
+            if((len != 8) ||
+               (NV_LINUX_rdLE(p + NV_JNL_HDR_SIZE, 4) != (pos - start)) ||
+               (NV_LINUX_rdLE(p + NV_JNL_HDR_SIZE + 4, 4) !=
+                NV_LINUX_crc32(0, pBuf + start, pos - start)))
+            {
+                break;
+            }
+            /* good, apply the records */
+            for(x = start ; x < pos ; x += NV_JNL_HDR_SIZE + len)
+            {
+                p = pBuf + x;
+                len = NV_LINUX_rdLE(p + 4, 2);
+                if(p[0] == NV_JNL_WRITE)
+                {
+                    memmove(NVOCMP_FLASHADDR(p[1], NV_LINUX_rdLE(p + 2, 2)),
+                            p + NV_JNL_HDR_SIZE, len);
+                }
+                else
+                {
+                    memset(NVOCMP_FLASHADDR(p[1], 0),
+                           NVOCMP_ERASEDBYTE, nvPageSize);
+                }
+            }
+            len = 8;
+            ncommits++;
+            start = pos + NV_JNL_HDR_SIZE + len;
+        }
+        else
+        {
+            break;
+        }
+        pos += NV_JNL_HDR_SIZE + len;
+    }
+
+    LOG_printf(LOG_DBG_NV_dbg, "nvram: %s: replayed %d commits\n",
+               pJnl, ncommits);
+    if(start != n)
+    {
+        LOG_printf(LOG_ERROR, "nvram: %s: dropped %u uncommitted bytes\n",
+                   pJnl, n - start);
+    }
+    free(pBuf);
+    free(pJnl);
+}
+
 /*
   Initialize the NV simulation.
 
@@ -110,12 +537,41 @@ static uint8_t *NVOCMP_FLASHADDR(uint32_t pg, uint32_t ofs)
  */
 void NV_LINUX_init(void)
 {
+    if(nvMutex == 0)
+    {
+        nvMutex = MUTEX_create("nv-mutex");
+        nvIoMutex = MUTEX_create("nv-io-mutex");
+        if((nvMutex == 0) || (nvIoMutex == 0))
+        {
+            FATAL_printf("NV no mutex\n");
+        }
+    }
+
     /* Load the simulation file.. */
     NV_LINUX_load();
 
-    if(nvMutex == 0)
+    if(NV_jnlEnable && (NV_flushMsecs > 0) && (nvFlushThread == 0))
     {
-        nvMutex = MUTEX_create("nv-mutex");
+        NV_ioImage = calloc(1, NV_ramLength);
+        nvFlushSem = SEMAPHORE_create("nv-flush", 0);
+        if((NV_ioImage == NULL) || (nvFlushSem == 0))
+        {
+            FATAL_printf("NV no ram\n");
+        }
+        nvFlushThread = THREAD_create("nv-flusher", NV_LINUX_flusher, 0,
+                                      THREAD_FLAGS_DEFAULT);
+        if(nvFlushThread == 0)
+        {
+            FATAL_printf("Cannot create NV flusher\n");
+        }
+    }
+    else if(NV_ioImage == NULL)
+    {
+        NV_ioImage = calloc(1, NV_ramLength);
+        if(NV_ioImage == NULL)
+        {
+            FATAL_printf("NV no ram\n");
+        }
     }
 }
 
@@ -124,11 +580,12 @@ void NV_LINUX_init(void)
  */
 void NV_LINUX_load(void)
 {
+    char *pJnl;
     int r;
     int64_t filesize;
     intptr_t s;
 
-    NV_ramLength = (nvEndPage - nvBegPage + 1) * nvPageSize;
+    NV_ramLength = nvNumPages * nvPageSize;
 
     /* Get memory for the NV implimentation */
     NV_ramSim = calloc(1,NV_ramLength);
@@ -170,48 +627,257 @@ void NV_LINUX_load(void)
                          NV_ramLength,
                          r);
         }
+        STREAM_close(s);
         LOG_printf(LOG_DBG_NV_dbg,
                    "nvram: Loaded: %s, length=%d\n",
                    NV_filename,
                    NV_ramLength);
+        /* bring it up to date, then start a new journal */
+        NV_LINUX_replay();
     }
     else
     {
+        if(filesize > 0)
+        {
+            /* [nv] num-pages or page-size-bytes changed */
+            LOG_printf(LOG_ERROR, "nvram: %s: %lld bytes, expected %u, "
+                       "not loaded\n", NV_filename, (long long)filesize,
+                       NV_ramLength);
+        }
     over_write:
         LOG_printf(LOG_DBG_NV_dbg,
                    "nvram: creating: %s\n", NV_filename);
-        /* we just write it */
-        NV_LINUX_save();
+        /* the journal belongs to the old image, it must not be
+         * replayed over the new one */
+        pJnl = NV_LINUX_fileName(".jnl");
+        if((unlink(pJnl) == 0) && NV_jnlEnable)
+        {
+            NV_LINUX_syncDir(pJnl);
+        }
+        free(pJnl);
+    }
+
+    /* we just write it */
+    if(NV_jnlEnable)
+    {
+        NV_LINUX_checkpoint(NV_ramSim);
+    }
+    else
+    {
+        NV_LINUX_wrImage(NV_filename, NV_ramSim, true);
+        pJnl = NV_LINUX_fileName(".jnl");
+        (void)unlink(pJnl);
+        free(pJnl);
     }
 }
 
 /*!
- * @brief  Save the NV simulation to disk
+ * @brief Write the journal records up to the last save point to disk
+ *
+ * Only one flush runs at a time, so a caller of NV_LINUX_sync() also
+ * waits for a flush the flusher thread started with its records.
+ * The disk I/O is done without holding nvMutex, NV writes continue.
  */
-void NV_LINUX_save(void)
+static void NV_LINUX_flush(void)
 {
-    intptr_t s;
+    char *pJnl;
+    uint8_t *p;
+    uint32_t crc;
+    unsigned n;
+    bool is_checkpoint;
     int r;
 
-    LOG_printf(LOG_DBG_NV_dbg, "nvram: save: %s, length=%d\n",
-               NV_filename,
-               NV_ramLength);
+    MUTEX_lock(nvIoMutex, -1);
+    MUTEX_lock(nvMutex, -1);
 
-    s = STREAM_createWrFile(NV_filename);
-    if(s == 0)
+    n = NV_jnlSaved;
+    if(n == 0)
     {
-        FATAL_perror(NV_filename);
+        /* nothing to do */
+        MUTEX_unLock(nvMutex);
+        MUTEX_unLock(nvIoMutex);
+        return;
     }
-    r = STREAM_wrBytes(s, NV_ramSim, NV_ramLength, 0);
-    STREAM_close(s);
 
-    if(r != (int)NV_ramLength)
+    /* the image is only consistent at a save point */
+    is_checkpoint =
+        ((NV_jnlFileBytes + n) >
+         (NV_jnlMaxBytes ? NV_jnlMaxBytes : NV_ramLength)) &&
+        (NV_jnlLen == n);
+    if(is_checkpoint)
+    {
+        memcpy(NV_ioImage, NV_ramSim, NV_ramLength);
+    }
+    if((n + NV_JNL_HDR_SIZE + 8) > NV_ioSize)
+    {
+        p = realloc(NV_ioBuf, n + NV_JNL_HDR_SIZE + 8 + 1024);
+        if(p == NULL)
+        {
+            FATAL_printf("NV no ram\n");
+        }
+        NV_ioBuf = p;
+        NV_ioSize = n + NV_JNL_HDR_SIZE + 8 + 1024;
+    }
+    memcpy(NV_ioBuf, NV_jnlBuf, n);
+    NV_jnlLen -= n;
+    memmove(NV_jnlBuf, NV_jnlBuf + n, NV_jnlLen);
+    NV_jnlSaved = 0;
+    MUTEX_unLock(nvMutex);
+
+    /* committed even before a checkpoint, the journal must end at the
+     * state of the new image, see NV_LINUX_checkpoint() */
+    crc = NV_LINUX_crc32(0, NV_ioBuf, n);
+    p = NV_ioBuf + n;
+    memset(p, 0, NV_JNL_HDR_SIZE);
+    p[0] = NV_JNL_COMMIT;
+    p[4] = 8;
+    p[NV_JNL_HDR_SIZE + 0] = (uint8_t)(n >> 0);
+    p[NV_JNL_HDR_SIZE + 1] = (uint8_t)(n >> 8);
+    p[NV_JNL_HDR_SIZE + 2] = (uint8_t)(n >> 16);
+    p[NV_JNL_HDR_SIZE + 3] = (uint8_t)(n >> 24);
+    p[NV_JNL_HDR_SIZE + 4] = (uint8_t)(crc >> 0);
+    p[NV_JNL_HDR_SIZE + 5] = (uint8_t)(crc >> 8);
+    p[NV_JNL_HDR_SIZE + 6] = (uint8_t)(crc >> 16);
+    p[NV_JNL_HDR_SIZE + 7] = (uint8_t)(crc >> 24);
+    n += NV_JNL_HDR_SIZE + 8;
+
+    pJnl = NV_LINUX_fileName(".jnl");
+    r = STREAM_wrBytes(NV_jnlStream, NV_ioBuf, n, 0);
+    if(r != (int)n)
     {
         FATAL_printf("%s: Cannot write %d bytes, wrote: %d instead\n",
-                     NV_filename,
-                     NV_ramLength,
+                     pJnl,
+                     n,
                      r);
     }
+    NV_LINUX_syncFile(NV_jnlStream, pJnl);
+    free(pJnl);
+
+    LOG_printf(LOG_DBG_NV_dbg, "nvram: commit: %u bytes\n", n);
+    NV_jnlFileBytes += n;
+    if(is_checkpoint)
+    {
+        NV_LINUX_checkpoint(NV_ioImage);
+    }
+    MUTEX_unLock(nvIoMutex);
+}
+
+/*!
+ * @brief Background thread, flushes the journal on the deadline
+ * @param cookie - not used
+ * @returns never
+ */
+static intptr_t NV_LINUX_flusher(intptr_t cookie)
+{
+    int t;
+
+    (void)(cookie);
+
+    for(;;)
+    {
+        MUTEX_lock(nvMutex, -1);
+        if(NV_jnlSaved == 0)
+        {
+            t = -1;
+        }
+        else if(NV_jnlSaved >= NV_flushBytes)
+        {
+            t = 0;
+        }
+        else
+        {
+            t = NV_flushMsecs - (int)(TIMER_getNow() - NV_jnlDirtyTime);
+            if(t < 0)
+            {
+                t = 0;
+            }
+        }
+        MUTEX_unLock(nvMutex);
+
+        if(t == 0)
+        {
+            NV_LINUX_flush();
+        }
+        else
+        {
+            /* woken early by NV_LINUX_save() */
+            SEMAPHORE_waitWithTimeout(nvFlushSem, t);
+        }
+    }
+    return (0);
+}
+
+/*!
+ * @brief  Save the NV simulation to disk
+ *
+ * With the journal, marks a save point. The changes up to here are
+ * written by the flusher thread within NV_flushMsecs, or now if there
+ * is no flusher thread.
+ */
+void NV_LINUX_save(void)
+{
+    bool kick;
+
+    if(!NV_jnlEnable)
+    {
+        LOG_printf(LOG_DBG_NV_dbg, "nvram: save: %s, length=%d\n",
+                   NV_filename,
+                   NV_ramLength);
+        NV_LINUX_wrImage(NV_filename, NV_ramSim, false);
+        return;
+    }
+
+    MUTEX_lock(nvMutex, -1);
+    kick = false;
+    if(NV_jnlLen != NV_jnlSaved)
+    {
+        if(NV_jnlSaved == 0)
+        {
+            /* the deadline starts now */
+            NV_jnlDirtyTime = TIMER_getNow();
+            kick = true;
+        }
+        NV_jnlSaved = NV_jnlLen;
+        if(NV_jnlSaved >= NV_flushBytes)
+        {
+            kick = true;
+        }
+    }
+    MUTEX_unLock(nvMutex);
+
+    if(nvFlushThread == 0)
+    {
+        NV_LINUX_flush();
+    }
+    else if(kick)
+    {
+        SEMAPHORE_put(nvFlushSem);
+    }
+}
+
+/*
+  Write everything saved so far to disk
+
+  Public function defined in nv_linux.h
+ */
+void NV_LINUX_sync(void)
+{
+    if(NV_jnlEnable && (nvIoMutex != 0))
+    {
+        NV_LINUX_flush();
+    }
+}
+
+/*
+  Size of the NV simulation, for NVOCMP
+
+  Public function defined in nv_linux.h
+ */
+void NV_LINUX_getAttrs(NVS_Attrs *pAttrs)
+{
+    pAttrs->regionBase = NV_ramSim;
+    pAttrs->regionSize = NV_ramLength;
+    pAttrs->sectorSize = nvPageSize;
 }
 
 /*!
@@ -236,7 +902,13 @@ int_fast16_t NV_LINUX_write(uint8_t dstPg, uint16_t off, uint8_t *pBuf, uint16_t
     pDst = NVOCMP_FLASHADDR(dstPg, off);
     LOG_printf(LOG_DBG_NV_rdwr, "write: pg:%d, ofs=0x%04x, num=%d\n", dstPg, off, len);
     LOG_hexdump(LOG_DBG_NV_rdwr, (dstPg * nvPageSize) + off, pBuf, len);
+    MUTEX_lock(nvMutex, -1);
     memmove(pDst, pBuf, len);
+    if(NV_jnlEnable)
+    {
+        NV_LINUX_jnlAdd(NV_JNL_WRITE, dstPg, off, pBuf, len);
+    }
+    MUTEX_unLock(nvMutex);
     return NVS_STATUS_SUCCESS;
 }
 
@@ -247,10 +919,232 @@ int_fast16_t NV_LINUX_erase(uint8_t dstPg)
 {
     uint8_t *pBuf;
     pBuf = NVOCMP_FLASHADDR(dstPg, 0);
+    MUTEX_lock(nvMutex, -1);
     memset((void *)(pBuf), NVOCMP_ERASEDBYTE, nvPageSize);
+    if(NV_jnlEnable)
+    {
+        NV_LINUX_jnlAdd(NV_JNL_ERASE, dstPg, 0, NULL, 0);
+    }
+    MUTEX_unLock(nvMutex);
     return NVS_STATUS_SUCCESS;
 }
 
+/*
+  Name of the NV simulation file
+
+  Public function defined in nv_linux.h
+*/
+const char *NV_LINUX_getFilename(void)
+{
+    return (NV_filename);
+}
+
+/*
+  Is the log structured driver selected?
+
+  Public function defined in nv_linux.h
+*/
+bool NV_LINUX_isLog(void)
+{
+    return (NV_useLog);
+}
+
+/*
+  Use another NV simulation file
+
+  Public function defined in nv_linux.h
+*/
+const char *NV_LINUX_setFilename(const char *pName)
+{
+    const char *pOld;
+
+    pOld = NV_filename;
+    NV_filename = pName;
+    return (pOld);
+}
+
+/*!
+ * @brief Record the migration state in the marker item, and sync
+ * @param pNv - the driver
+ * @param state - NV_LINUX_MIGRATE_started or _done
+ * @returns NVINTF_SUCCESS or the error
+ */
+static uint8_t NV_LINUX_migrateMark(const NVINTF_nvFuncts_t *pNv, int state)
+{
+    uint8_t v;
+    uint8_t r;
+
+    v = (uint8_t)(state);
+    r = pNv->writeItem(NV_migrateId, sizeof(v), &v);
+    if((r == NVINTF_SUCCESS) && (pNv->syncNV != NULL))
+    {
+        r = pNv->syncNV();
+    }
+    if(r != NVINTF_SUCCESS)
+    {
+        LOG_printf(LOG_ERROR, "nv: migrate: cannot mark %d, error: %d\n",
+                   state, r);
+    }
+    return (r);
+}
+
+/*
+  Where is the migration into this driver?
+
+  Public function defined in nv_linux.h
+*/
+int NV_LINUX_migrateState(const NVINTF_nvFuncts_t *pNv)
+{
+    uint8_t v;
+
+    if(pNv->readItem(NV_migrateId, 0, sizeof(v), &v) != NVINTF_SUCCESS)
+    {
+        return (NV_LINUX_MIGRATE_none);
+    }
+    return (v);
+}
+
+/*!
+ * @brief initNV() of the log driver, migrates the NV simulation file
+ * @param param - passed to the log driver
+ * @returns NVINTF_SUCCESS or the error
+ */
+static uint8_t NV_LINUX_initLog(void *param)
+{
+    struct nvlog_stats stats;
+    uint8_t r;
+    int state;
+    int n;
+
+    r = NV_logFns.initNV(param);
+    if(r != NVINTF_SUCCESS)
+    {
+        return (r);
+    }
+
+    if(!CONFIG_NV_RESTORE)
+    {
+        return (r);
+    }
+
+    /* only into an empty log, deleted items stay deleted */
+    /* or to finish a copy that was interrupted */
+    NVLOG_getStats(&stats);
+    state = NV_LINUX_migrateState(&NV_logFns);
+    if((state == NV_LINUX_MIGRATE_started) ||
+       ((state == NV_LINUX_MIGRATE_none) && (stats.n_items == 0) &&
+        NV_migrateEnable && STREAM_FS_fileExists(NV_filename)))
+    {
+        n = NV_LINUX_migrate(&NV_logFns);
+        if(n < 0)
+        {
+            return (NVINTF_FAILURE);
+        }
+        LOG_printf(LOG_ALWAYS, "nv: migrated %d items from %s to %s\n",
+                   n, NV_filename, NVLOG_cfg.filename);
+    }
+    else if((state == NV_LINUX_MIGRATE_none) && (stats.n_items == 0))
+    {
+        /* nothing to copy, a later NV file is not copied either */
+        return (NV_LINUX_migrateMark(&NV_logFns, NV_LINUX_MIGRATE_done));
+    }
+    return (r);
+}
+
+/*
+  Return the API of the selected NV driver
+
+  Public function defined in nv_linux.h
+*/
+void NV_LINUX_loadApiPtrs(NVINTF_nvFuncts_t *pfn)
+{
+    if(!NV_useLog)
+    {
+        NVOCMP_loadApiPtrs(pfn);
+        return;
+    }
+
+    NVLOG_loadApiPtrs(&NV_logFns);
+    *pfn = NV_logFns;
+    pfn->initNV = NV_LINUX_initLog;
+}
+
+/*
+  Copy the NV simulation file items to another driver
+
+  Public function defined in nv_linux.h
+*/
+int NV_LINUX_migrate(const NVINTF_nvFuncts_t *pTo)
+{
+    static uint8_t buf[4096];
+    NVINTF_nvFuncts_t nv;
+    NVINTF_nvProxy_t prx;
+    NVINTF_itemID_t id;
+    IArg key;
+    uint8_t r;
+    int n;
+
+    if(!CONFIG_NV_RESTORE || !STREAM_FS_fileExists(NV_filename))
+    {
+        LOG_printf(LOG_ERROR, "nv: migrate: %s: not found\n", NV_filename);
+        return (-1);
+    }
+
+    NVOCMP_loadApiPtrsExt(&nv);
+    if(nv.initNV(NULL) != NVINTF_SUCCESS)
+    {
+        LOG_printf(LOG_ERROR, "nv: migrate: %s: cannot init\n", NV_filename);
+        return (-1);
+    }
+
+    /* before the first item, so a partial copy is seen as such */
+    if(NV_LINUX_migrateMark(pTo, NV_LINUX_MIGRATE_started) != NVINTF_SUCCESS)
+    {
+        return (-1);
+    }
+
+    memset(&prx, 0, sizeof(prx));
+    prx.buffer = buf;
+    prx.len = sizeof(buf);
+    prx.flag = NVINTF_DOSTART | NVINTF_DOANYID | NVINTF_DOREAD;
+
+    n = 0;
+    key = nv.lockNV();
+    /* newest first, so older copies of an item are seen as NVINTF_EXIST */
+    while(nv.doNext(&prx) == NVINTF_SUCCESS)
+    {
+        if(prx.sysid == NVINTF_SYSID_NVDRVR)
+        {
+            continue;
+        }
+        id.systemID = prx.sysid;
+        id.itemID = prx.itemid;
+        id.subID = prx.subid;
+        r = pTo->createItem(id, prx.len, buf);
+        if(r == NVINTF_SUCCESS)
+        {
+            n++;
+        }
+        else if(r != NVINTF_EXIST)
+        {
+            LOG_printf(LOG_ERROR,
+                       "nv: migrate: item %d/%d/%d, error: %d\n",
+                       id.systemID, id.itemID, id.subID, r);
+            n = -1;
+            break;
+        }
+    }
+    nv.unlockNV(key);
+
+    /* the items are synced with the marker, after the last item */
+    if((n >= 0) &&
+       (NV_LINUX_migrateMark(pTo, NV_LINUX_MIGRATE_done) != NVINTF_SUCCESS))
+    {
+        n = -1;
+    }
+    return (n);
+}
+
 /*
    Process the INI file settings
 
@@ -277,28 +1171,121 @@ int NV_LINUX_INI_settings(struct ini_parser *pINI, bool *handled)
         return (0);
     }
 
-    if(INI_itemMatches(pINI, "nv", "page-size-bytes"))
+    if(INI_itemMatches(pINI, "nv", "backend"))
+    {
+        *handled = true;
+        if(0 == strcmp("flash", pINI->item_value))
+        {
+            NV_useLog = false;
+            return (0);
+        }
+        if(0 == strcmp("log", pINI->item_value))
+        {
+            NV_useLog = true;
+            return (0);
+        }
+        INI_syntaxError(pINI, "expected: flash or log\n");
+        return (-1);
+    }
+
+    if(INI_itemMatches(pINI, "nv", "migrate"))
+    {
+        NV_migrateEnable = INI_valueAsBool(pINI);
+        *handled = true;
+        return (0);
+    }
+
+    if(INI_itemMatches(pINI, "nv", "log-filename"))
     {
-        nvPageSize = INI_valueAsInt(pINI);
+        /* the default is a constant string, this one is never freed */
+        NVLOG_cfg.filename = INI_itemValue_strdup(pINI);
         *handled = true;
         return (0);
     }
 
+    if(INI_itemMatches(pINI, "nv", "log-segment-bytes"))
+    {
+        NVLOG_cfg.segment_bytes = INI_valueAsInt(pINI);
+        *handled = true;
+        return (0);
+    }
+
+    if(INI_itemMatches(pINI, "nv", "log-compact-percent"))
+    {
+        NVLOG_cfg.compact_percent = INI_valueAsInt(pINI);
+        *handled = true;
+        return (0);
+    }
+
+    if(INI_itemMatches(pINI, "nv", "item-index"))
+    {
+        NVOCMP_setItemIndex(INI_valueAsBool(pINI));
+        *handled = true;
+        return (0);
+    }
+
+    if(INI_itemMatches(pINI, "nv", "journal"))
+    {
+        NV_jnlEnable = INI_valueAsBool(pINI);
+        *handled = true;
+        return (0);
+    }
+
+    if(INI_itemMatches(pINI, "nv", "flush-deadline-msecs"))
+    {
+        NV_flushMsecs = INI_valueAsInt(pINI);
+        NVLOG_cfg.flush_msecs = NV_flushMsecs;
+        *handled = true;
+        return (0);
+    }
+
+    if(INI_itemMatches(pINI, "nv", "flush-dirty-bytes"))
+    {
+        NV_flushBytes = INI_valueAsInt(pINI);
+        *handled = true;
+        return (0);
+    }
+
+    if(INI_itemMatches(pINI, "nv", "journal-max-bytes"))
+    {
+        NV_jnlMaxBytes = INI_valueAsInt(pINI);
+        *handled = true;
+        return (0);
+    }
+
+    if(INI_itemMatches(pINI, "nv", "page-size-bytes"))
+    {
+        *handled = true;
+        switch(INI_valueAsInt(pINI))
+        {
+        case 0x1000:
+        case 0x2000:
+        case 0x4000:
+            nvPageSize = INI_valueAsInt(pINI);
+            return (0);
+        default:
+            INI_syntaxError(pINI, "expected: 4096, 8192 or 16384\n");
+            return (-1);
+        }
+    }
+
     if(INI_itemMatches(pINI, "nv", "num-pages"))
     {
-        nvEndPage = nvBegPage + INI_valueAsInt(pINI);
         *handled = true;
+        /* one is the compaction page, 0xff means no page */
+        if((INI_valueAsInt(pINI) < 2) || (INI_valueAsInt(pINI) > 254))
+        {
+            INI_syntaxError(pINI, "expected: 2 to 254 pages\n");
+            return (-1);
+        }
+        nvNumPages = INI_valueAsInt(pINI);
         return (0);
     }
 
     if(INI_itemMatches(pINI, "nv", "reserved-pages"))
     {
-        /* how many pages do we have now? */
-        int n;
-        n = nvEndPage - nvBegPage;
+        /* the simulation file starts at the first NV page */
         nvBegPage = INI_valueAsInt(pINI);
-        nvEndPage = nvBegPage + n;
-
         *handled = true;
         return (0);
     }
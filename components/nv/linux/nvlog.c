@@ -0,0 +1,1648 @@
+/******************************************************************************
+ @file nvlog.c
+
+ @brief TIMAC 2.0 API Log structured NV store for Linux
+
+ Group: CMCU LPC
+ $Target Device: DEVICES $
+
+ ******************************************************************************
+ $License: BSD3 2019 $
+ ******************************************************************************
+ $Release Name: PACKAGE NAME $
+ $Release Date: PACKAGE RELEASE DATE $
+******************************************************************************/
+
+/******************************************************************************
+ Includes
+******************************************************************************/
+
+#include "nv_linux.h"
+#include "nvlog.h"
+
+#include "stream.h"
+#include "log.h"
+#include "mutex.h"
+#include "fatal.h"
+#include "threads.h"
+#include "ti_semaphore.h"
+#include "timer.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>    /* for unlink, dup, fdatasync */
+#include <dirent.h>
+#include <libgen.h>    /* for dirname, basename */
+
+/******************************************************************************
+ Constants and definitions
+******************************************************************************/
+
+/*
+ * Record: crc32(4) type(1) sysid(1) itemid(2) subid(2) spare(2) length(4)
+ *         then length bytes of data for put records.
+ *         The crc covers everything after the crc field.
+ *
+ * Every item has a put record, the newest one is "live", the others are
+ * old. Delete records are never live. Segments are compacted oldest
+ * first, so an old put record never outlives a delete record after it.
+ */
+#define NVLOG_HDR_SIZE      16
+#define NVLOG_PUT           'P'
+#define NVLOG_DEL           'D'
+
+/*! Largest item, the NVINTF read/write lengths are 16 bits */
+#define NVLOG_MAXLEN        0xFFFF
+
+/*! Same as NVOCMP, returned by readContItem() when nothing matches */
+#define NVLOG_INVALIDSUBID  0xFFFF
+
+/*! Smallest hash table, must be a power of 2 */
+#define NVLOG_MINSLOTS      256
+
+/*! Hash key of an item ID */
+#define NVLOG_KEY(SYSID, ITEMID, SUBID)         \
+    ((((uint64_t)(SYSID)) << 32) |              \
+     (((uint64_t)(ITEMID)) << 16) |             \
+     ((uint64_t)(SUBID)))
+
+/*!
+ * @struct nvlog_item
+ * @brief An item, NVLOG_items[] holds them without gaps
+ */
+struct nvlog_item {
+    /*! NVLOG_KEY() of the item */
+    uint64_t key;
+    /*! segment number holding the newest put record */
+    uint32_t seg;
+    /*! data length */
+    uint32_t len;
+    /*! copy of the data, reads come from here */
+    uint8_t *pData;
+};
+
+/*!
+ * @struct nvlog_seg
+ * @brief A segment file, NVLOG_segs[] is sorted oldest first
+ */
+struct nvlog_seg {
+    /*! the NNNNNN in the file name */
+    uint32_t num;
+    /*! bytes in the file */
+    uint32_t bytes;
+    /*! bytes of live records */
+    uint32_t live;
+};
+
+/******************************************************************************
+ Local variables
+******************************************************************************/
+
+struct nvlog_cfg NVLOG_cfg = {
+    .filename        = "nv-log",
+    .segment_bytes   = 1024 * 1024,
+    .compact_percent = 50,
+    .flush_msecs     = 200
+};
+
+static intptr_t nvlogMutex;
+/*! Wakes the worker thread */
+static intptr_t nvlogSem;
+/*! Syncs and compacts in the background */
+static intptr_t nvlogThread;
+/*! Set when initNV() is done */
+static bool     NVLOG_ready;
+
+/*! The items, in no particular order */
+static struct nvlog_item *NVLOG_items;
+static unsigned NVLOG_nItems;
+static unsigned NVLOG_itemsSize;
+
+/*! Open addressing hash, NVLOG_items[] index + 1, 0 if the slot is free */
+static uint32_t *NVLOG_hash;
+static unsigned  NVLOG_hashSize;
+
+/*! The segment files, the last one is open for appending */
+static struct nvlog_seg *NVLOG_segs;
+static unsigned NVLOG_nSegs;
+static unsigned NVLOG_segsSize;
+static intptr_t NVLOG_stream;
+static char    *NVLOG_streamName;
+
+/*! A record being written */
+static uint8_t *NVLOG_buf;
+static unsigned NVLOG_bufSize;
+
+/*! Are there appended records that are not synced? */
+static bool     NVLOG_dirty;
+/*! When NVLOG_dirty was set, TIMER_getNow() */
+static uint32_t NVLOG_dirtyTime;
+/*! The worker has something new to do, see NVLOG_changed() */
+static bool     NVLOG_kick;
+
+static unsigned NVLOG_compactions;
+static bool     NVLOG_isNew;
+
+static void NVLOG_roll(void);
+
+/******************************************************************************
+ Local functions
+******************************************************************************/
+
+/*!
+ * @brief Read a little endian number
+ * @param p - the bytes
+ * @param n - how many
+ * @returns the number
+ */
+static uint32_t NVLOG_rdLE(const uint8_t *p, int n)
+{
+    uint32_t v;
+
+    v = 0;
+    while(n > 0)
+    {
+        n--;
+        v = (v << 8) | p[n];
+    }
+    return (v);
+}
+
+/*!
+ * @brief Write a little endian number
+ * @param p - where
+ * @param v - the number
+ * @param n - how many bytes
+ */
+static void NVLOG_wrLE(uint8_t *p, uint32_t v, int n)
+{
+    while(n > 0)
+    {
+        *p++ = (uint8_t)v;
+        v = v >> 8;
+        n--;
+    }
+}
+
+/*!
+ * @brief Home slot of a key in NVLOG_hash
+ * @param key - NVLOG_KEY()
+ * @returns slot number
+ */
+static unsigned NVLOG_hashSlot(uint64_t key)
+{
+    uint32_t h;
+
+    h = ((uint32_t)key) ^ (((uint32_t)(key >> 32)) * 0x85EBCA6B);
+    h = h * 0x9E3779B1;
+    h = h ^ (h >> 16);
+    return (h & (NVLOG_hashSize - 1));
+}
+
+/*!
+ * @brief Look up an item
+ * @param key - NVLOG_KEY()
+ * @param pSlot - set to the slot holding it, or the free slot for it
+ * @returns NVLOG_items[] index, -1 if not found
+ */
+static int NVLOG_find(uint64_t key, unsigned *pSlot)
+{
+    unsigned s;
+    uint32_t v;
+
+    s = NVLOG_hashSlot(key);
+    for(;;)
+    {
+        v = NVLOG_hash[s];
+        if(v == 0)
+        {
+            break;
+        }
+        if(NVLOG_items[v - 1].key == key)
+        {
+            *pSlot = s;
+            return ((int)(v - 1));
+        }
+        s = (s + 1) & (NVLOG_hashSize - 1);
+    }
+    *pSlot = s;
+    return (-1);
+}
+
+/*!
+ * @brief Rebuild the hash table
+ * @param n - new size, a power of 2
+ */
+static void NVLOG_hashResize(unsigned n)
+{
+    unsigned x;
+    unsigned s;
+
+    free(NVLOG_hash);
+    NVLOG_hash = calloc(n, sizeof(NVLOG_hash[0]));
+    if(NVLOG_hash == NULL)
+    {
+        FATAL_printf("NV no ram\n");
+    }
+    NVLOG_hashSize = n;
+
+    for(x = 0 ; x < NVLOG_nItems ; x++)
+    {
+        (void)NVLOG_find(NVLOG_items[x].key, &s);
+        NVLOG_hash[s] = x + 1;
+    }
+}
+
+/*!
+ * @brief Add an item, without data
+ * @param key - NVLOG_KEY(), not in the table yet
+ * @returns NVLOG_items[] index
+ */
+static int NVLOG_newItem(uint64_t key)
+{
+    struct nvlog_item *p;
+    unsigned n;
+    unsigned s;
+
+    if(NVLOG_nItems == NVLOG_itemsSize)
+    {
+        n = NVLOG_itemsSize ? (NVLOG_itemsSize * 2) : NVLOG_MINSLOTS;
+        p = realloc(NVLOG_items, n * sizeof(NVLOG_items[0]));
+        if(p == NULL)
+        {
+            FATAL_printf("NV no ram\n");
+        }
+        NVLOG_items = p;
+        NVLOG_itemsSize = n;
+    }
+
+    /* keep the table at most 3/4 full */
+    if(((NVLOG_nItems + 1) * 4) > (NVLOG_hashSize * 3))
+    {
+        NVLOG_hashResize(NVLOG_hashSize * 2);
+    }
+
+    (void)NVLOG_find(key, &s);
+    p = &NVLOG_items[NVLOG_nItems];
+    memset(p, 0, sizeof(*p));
+    p->key = key;
+    NVLOG_hash[s] = NVLOG_nItems + 1;
+    NVLOG_nItems++;
+    return ((int)(NVLOG_nItems - 1));
+}
+
+/*!
+ * @brief Remove an item, the last item moves into its place
+ * @param x - NVLOG_items[] index
+ * @param slot - the hash slot of the item
+ */
+static void NVLOG_removeItem(int x, unsigned slot)
+{
+    unsigned mask;
+    unsigned home;
+    unsigned j;
+    unsigned s;
+
+    free(NVLOG_items[x].pData);
+
+    /* backward shift delete, no tombstones in the table */
+    mask = NVLOG_hashSize - 1;
+    for(;;)
+    {
+        NVLOG_hash[slot] = 0;
+        j = slot;
+        for(;;)
+        {
+            j = (j + 1) & mask;
+            if(NVLOG_hash[j] == 0)
+            {
+                goto shifted;
+            }
+            home = NVLOG_hashSlot(NVLOG_items[NVLOG_hash[j] - 1].key);
+            /* can the entry at j move to the free slot? */
+            if(j > slot)
+            {
+                if((home <= slot) || (home > j))
+                {
+                    break;
+                }
+            }
+            else
+            {
+                if((home <= slot) && (home > j))
+                {
+                    break;
+                }
+            }
+        }
+        NVLOG_hash[slot] = NVLOG_hash[j];
+        slot = j;
+    }
+shifted:
+
+    NVLOG_nItems--;
+    if((unsigned)x != NVLOG_nItems)
+    {
+        NVLOG_items[x] = NVLOG_items[NVLOG_nItems];
+        (void)NVLOG_find(NVLOG_items[x].key, &s);
+        NVLOG_hash[s] = x + 1;
+    }
+}
+
+/*!
+ * @brief File name of a segment
+ * @param num - segment number
+ * @returns malloc'ed name, free with free()
+ */
+static char *NVLOG_segName(uint32_t num)
+{
+    char *cp;
+    size_t n;
+
+    n = strlen(NVLOG_cfg.filename) + 16;
+    cp = calloc(1, n);
+    if(cp == NULL)
+    {
+        FATAL_printf("NV no ram\n");
+    }
+    snprintf(cp, n, "%s.%06u", NVLOG_cfg.filename, (unsigned)num);
+    return (cp);
+}
+
+/*!
+ * @brief Find a segment
+ * @param num - segment number
+ * @returns NVLOG_segs[] index, -1 if not found
+ */
+static int NVLOG_segIndex(uint32_t num)
+{
+    int lo;
+    int hi;
+    int mid;
+
+    lo = 0;
+    hi = (int)NVLOG_nSegs - 1;
+    while(lo <= hi)
+    {
+        mid = (lo + hi) / 2;
+        if(NVLOG_segs[mid].num == num)
+        {
+            return (mid);
+        }
+        if(NVLOG_segs[mid].num < num)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+    return (-1);
+}
+
+/*!
+ * @brief Add a segment at the end of NVLOG_segs[]
+ * @param num - segment number, larger than the others
+ */
+static void NVLOG_segAdd(uint32_t num)
+{
+    struct nvlog_seg *p;
+    unsigned n;
+
+    if(NVLOG_nSegs == NVLOG_segsSize)
+    {
+        n = NVLOG_segsSize + 16;
+        p = realloc(NVLOG_segs, n * sizeof(NVLOG_segs[0]));
+        if(p == NULL)
+        {
+            FATAL_printf("NV no ram\n");
+        }
+        NVLOG_segs = p;
+        NVLOG_segsSize = n;
+    }
+    p = &NVLOG_segs[NVLOG_nSegs];
+    memset(p, 0, sizeof(*p));
+    p->num = num;
+    NVLOG_nSegs++;
+}
+
+/*!
+ * @brief An item's live record is no longer live
+ * @param p - the item
+ */
+static void NVLOG_kill(const struct nvlog_item *p)
+{
+    int s;
+
+    s = NVLOG_segIndex(p->seg);
+    if(s >= 0)
+    {
+        NVLOG_segs[s].live -= (NVLOG_HDR_SIZE + p->len);
+    }
+}
+
+/*!
+ * @brief Store an item in RAM
+ * @param key - NVLOG_KEY()
+ * @param seg - segment number of the record
+ * @param pData - the data
+ * @param len - data length
+ */
+static void NVLOG_setItem(uint64_t key, uint32_t seg,
+                          const uint8_t *pData, uint32_t len)
+{
+    struct nvlog_item *p;
+    uint8_t *pNew;
+    unsigned s;
+    int x;
+
+    x = NVLOG_find(key, &s);
+    if(x < 0)
+    {
+        x = NVLOG_newItem(key);
+    }
+    else
+    {
+        NVLOG_kill(&NVLOG_items[x]);
+    }
+    p = &NVLOG_items[x];
+
+    if((p->pData == NULL) || (len != p->len))
+    {
+        /* +1, so a zero length item has a pointer */
+        pNew = realloc(p->pData, len + 1);
+        if(pNew == NULL)
+        {
+            FATAL_printf("NV no ram\n");
+        }
+        p->pData = pNew;
+    }
+    memcpy(p->pData, pData, len);
+    p->len = len;
+    p->seg = seg;
+
+    x = NVLOG_segIndex(seg);
+    if(x >= 0)
+    {
+        NVLOG_segs[x].live += (NVLOG_HDR_SIZE + len);
+    }
+}
+
+/*!
+ * @brief Remove an item from RAM
+ * @param key - NVLOG_KEY()
+ * @returns true if the item was found
+ */
+static bool NVLOG_clearItem(uint64_t key)
+{
+    unsigned s;
+    int x;
+
+    x = NVLOG_find(key, &s);
+    if(x < 0)
+    {
+        return (false);
+    }
+    NVLOG_kill(&NVLOG_items[x]);
+    NVLOG_removeItem(x, s);
+    return (true);
+}
+
+/*!
+ * @brief Open a segment for appending
+ * @param num - segment number
+ */
+static void NVLOG_open(uint32_t num)
+{
+    FILE *fp;
+
+    NVLOG_streamName = NVLOG_segName(num);
+    fp = fopen(NVLOG_streamName, "ab");
+    if(fp == NULL)
+    {
+        FATAL_perror(NVLOG_streamName);
+    }
+    NVLOG_stream = STREAM_createFpFile(fp);
+    if(NVLOG_stream == 0)
+    {
+        FATAL_printf("%s: no stream\n", NVLOG_streamName);
+    }
+}
+
+/*!
+ * @brief Append a record to the newest segment
+ * @param type - NVLOG_PUT or NVLOG_DEL
+ * @param key - NVLOG_KEY()
+ * @param pData - data for put records
+ * @param len - data length
+ * @returns the segment number holding the record
+ *
+ * The record is not synced, see NVLOG_sync().
+ */
+static uint32_t NVLOG_append(int type, uint64_t key,
+                             const uint8_t *pData, uint32_t len)
+{
+    struct nvlog_seg *pSeg;
+    uint32_t num;
+    unsigned n;
+    uint8_t *p;
+
+    n = NVLOG_HDR_SIZE + len;
+    if(n > NVLOG_bufSize)
+    {
+        p = realloc(NVLOG_buf, n + 256);
+        if(p == NULL)
+        {
+            FATAL_printf("NV no ram\n");
+        }
+        NVLOG_buf = p;
+        NVLOG_bufSize = n + 256;
+    }
+
+    p = NVLOG_buf;
+    p[4] = (uint8_t)type;
+    p[5] = (uint8_t)(key >> 32);
+    NVLOG_wrLE(p + 6, (uint32_t)(key >> 16), 2);
+    NVLOG_wrLE(p + 8, (uint32_t)key, 2);
+    NVLOG_wrLE(p + 10, 0, 2);
+    NVLOG_wrLE(p + 12, len, 4);
+    if(len)
+    {
+        memcpy(p + NVLOG_HDR_SIZE, pData, len);
+    }
+    NVLOG_wrLE(p, NV_LINUX_crc32(0, p + 4, n - 4), 4);
+
+    if(STREAM_wrBytes(NVLOG_stream, p, n, 0) != (int)n)
+    {
+        FATAL_perror(NVLOG_streamName);
+    }
+
+    pSeg = &NVLOG_segs[NVLOG_nSegs - 1];
+    pSeg->bytes += n;
+    num = pSeg->num;
+
+    if(!NVLOG_dirty)
+    {
+        /* the deadline starts now */
+        NVLOG_dirty = true;
+        NVLOG_dirtyTime = TIMER_getNow();
+        NVLOG_kick = true;
+    }
+
+    if(pSeg->bytes >= NVLOG_cfg.segment_bytes)
+    {
+        /* a closed segment, maybe time to compact */
+        NVLOG_roll();
+        NVLOG_kick = true;
+    }
+    return (num);
+}
+
+/*!
+ * @brief Close the newest segment and start a new one
+ */
+static void NVLOG_roll(void)
+{
+    uint32_t num;
+
+    num = 1;
+    if(NVLOG_nSegs)
+    {
+        num = NVLOG_segs[NVLOG_nSegs - 1].num + 1;
+    }
+
+    if(NVLOG_stream)
+    {
+        NV_LINUX_syncFile(NVLOG_stream, NVLOG_streamName);
+        STREAM_close(NVLOG_stream);
+        NVLOG_stream = 0;
+        free(NVLOG_streamName);
+        NVLOG_streamName = NULL;
+        NVLOG_dirty = false;
+    }
+
+    NVLOG_segAdd(num);
+    NVLOG_open(num);
+    NV_LINUX_syncDir(NVLOG_streamName);
+}
+
+/*!
+ * @brief Is it time to compact?
+ * @returns true if old records are compact_percent of the closed segments
+ */
+static bool NVLOG_needCompact(void)
+{
+    uint64_t total;
+    uint64_t live;
+    unsigned x;
+
+    if((NVLOG_nSegs < 2) || (NVLOG_cfg.compact_percent <= 0))
+    {
+        return (false);
+    }
+
+    total = 0;
+    live = 0;
+    for(x = 0 ; x < (NVLOG_nSegs - 1) ; x++)
+    {
+        total += NVLOG_segs[x].bytes;
+        live += NVLOG_segs[x].live;
+    }
+    return (((total - live) * 100) >= (total * NVLOG_cfg.compact_percent));
+}
+
+/*!
+ * @brief Compact the oldest segment, it must not be the newest
+ *
+ * The live items are appended again, synced, then the segment is deleted.
+ */
+static void NVLOG_compactOne(void)
+{
+    struct nvlog_item *p;
+    uint32_t num;
+    uint32_t seg;
+    unsigned copied;
+    unsigned x;
+    char *cp;
+
+    num = NVLOG_segs[0].num;
+    copied = 0;
+    for(x = 0 ; x < NVLOG_nItems ; x++)
+    {
+        p = &NVLOG_items[x];
+        if(p->seg != num)
+        {
+            continue;
+        }
+        seg = NVLOG_append(NVLOG_PUT, p->key, p->pData, p->len);
+        NVLOG_kill(p);
+        p->seg = seg;
+        NVLOG_segs[NVLOG_segIndex(seg)].live += (NVLOG_HDR_SIZE + p->len);
+        copied += (NVLOG_HDR_SIZE + p->len);
+    }
+
+    /* the copies must be on disk before the originals go */
+    if(NVLOG_dirty)
+    {
+        NV_LINUX_syncFile(NVLOG_stream, NVLOG_streamName);
+        NVLOG_dirty = false;
+    }
+
+    cp = NVLOG_segName(num);
+    if(unlink(cp) != 0)
+    {
+        FATAL_perror(cp);
+    }
+    NV_LINUX_syncDir(cp);
+    free(cp);
+
+    NVLOG_nSegs--;
+    memmove(&NVLOG_segs[0], &NVLOG_segs[1],
+            NVLOG_nSegs * sizeof(NVLOG_segs[0]));
+    NVLOG_compactions++;
+
+    LOG_printf(LOG_DBG_NV_dbg,
+               "nvlog: compacted segment %u, copied %u bytes\n",
+               (unsigned)num, copied);
+}
+
+/*!
+ * @brief Push the appended records to the disk
+ * @param force - sync even if nothing was appended since the last sync
+ *
+ * The fdatasync() is done without holding the mutex, on a dup() of
+ * the file so a segment roll meanwhile does not matter. Forced syncs
+ * also wait for a sync started by the worker thread.
+ */
+static void NVLOG_sync(bool force)
+{
+    FILE *fp;
+    int fd;
+
+    fd = -1;
+    MUTEX_lock(nvlogMutex, -1);
+    if((NVLOG_stream != 0) && (NVLOG_dirty || force))
+    {
+        fp = STREAM_getFp(NVLOG_stream);
+        if((STREAM_flush(NVLOG_stream) != 0) || (fp == NULL))
+        {
+            FATAL_perror(NVLOG_streamName);
+        }
+        fd = dup(fileno(fp));
+        if(fd < 0)
+        {
+            FATAL_perror(NVLOG_streamName);
+        }
+        NVLOG_dirty = false;
+    }
+    MUTEX_unLock(nvlogMutex);
+
+    if(fd >= 0)
+    {
+        if(fdatasync(fd) != 0)
+        {
+            FATAL_perror(NVLOG_cfg.filename);
+        }
+        close(fd);
+    }
+}
+
+/*!
+ * @brief Called after a change, outside of the mutex
+ *
+ * Without a flush deadline the change is synced now. The worker is
+ * woken when a deadline starts or a segment was closed.
+ */
+static void NVLOG_changed(void)
+{
+    bool kick;
+
+    if(NVLOG_cfg.flush_msecs <= 0)
+    {
+        NVLOG_sync(false);
+    }
+
+    MUTEX_lock(nvlogMutex, -1);
+    kick = NVLOG_kick;
+    NVLOG_kick = false;
+    MUTEX_unLock(nvlogMutex);
+
+    if(kick)
+    {
+        SEMAPHORE_put(nvlogSem);
+    }
+}
+
+/*!
+ * @brief Background thread, syncs on the deadline and compacts
+ * @param cookie - not used
+ * @returns never
+ */
+static intptr_t NVLOG_worker(intptr_t cookie)
+{
+    bool compacted;
+    int t;
+
+    (void)(cookie);
+
+    for(;;)
+    {
+        MUTEX_lock(nvlogMutex, -1);
+        /* one segment at a time, so writers are not held up long */
+        compacted = NVLOG_needCompact();
+        if(compacted)
+        {
+            NVLOG_compactOne();
+        }
+        if(!NVLOG_dirty)
+        {
+            t = -1;
+        }
+        else
+        {
+            t = NVLOG_cfg.flush_msecs - (int)(TIMER_getNow() - NVLOG_dirtyTime);
+            if(t < 0)
+            {
+                t = 0;
+            }
+        }
+        MUTEX_unLock(nvlogMutex);
+
+        if(compacted)
+        {
+            continue;
+        }
+        if(t == 0)
+        {
+            NVLOG_sync(false);
+        }
+        else
+        {
+            /* woken early by NVLOG_changed() */
+            SEMAPHORE_waitWithTimeout(nvlogSem, t);
+        }
+    }
+    return (0);
+}
+
+/*!
+ * @brief Read the records in a segment into RAM
+ * @param num - segment number, the last one in NVLOG_segs[]
+ * @param is_newest - true if this is the newest segment
+ */
+static void NVLOG_loadSeg(uint32_t num, bool is_newest)
+{
+    struct nvlog_seg *pSeg;
+    uint8_t *pBuf;
+    uint8_t *p;
+    uint64_t key;
+    uint32_t len;
+    int64_t size;
+    int64_t ofs;
+    intptr_t s;
+    char *cp;
+
+    cp = NVLOG_segName(num);
+    size = STREAM_FS_getSize(cp);
+    if(size < 0)
+    {
+        FATAL_perror(cp);
+    }
+    pBuf = malloc(size + 1);
+    if(pBuf == NULL)
+    {
+        FATAL_printf("NV no ram\n");
+    }
+    s = STREAM_createRdFile(cp);
+    if(s == 0)
+    {
+        FATAL_perror(cp);
+    }
+    if(STREAM_rdBytes(s, pBuf, (int)size, 0) != (int)size)
+    {
+        FATAL_printf("%s: cannot read %d bytes\n", cp, (int)size);
+    }
+    STREAM_close(s);
+
+    ofs = 0;
+    while((ofs + NVLOG_HDR_SIZE) <= size)
+    {
+        p = pBuf + ofs;
+        len = NVLOG_rdLE(p + 12, 4);
+        if((len > NVLOG_MAXLEN) || ((ofs + NVLOG_HDR_SIZE + len) > size))
+        {
+            break;
+        }
+        if(NV_LINUX_crc32(0, p + 4, NVLOG_HDR_SIZE - 4 + len) !=
+           NVLOG_rdLE(p, 4))
+        {
+            break;
+        }
+        key = NVLOG_KEY(p[5], NVLOG_rdLE(p + 6, 2), NVLOG_rdLE(p + 8, 2));
+        if(p[4] == NVLOG_PUT)
+        {
+            NVLOG_setItem(key, num, p + NVLOG_HDR_SIZE, len);
+        }
+        else if(p[4] == NVLOG_DEL)
+        {
+            (void)NVLOG_clearItem(key);
+        }
+        else
+        {
+            break;
+        }
+        ofs += (NVLOG_HDR_SIZE + len);
+    }
+
+    if(ofs != size)
+    {
+        if(is_newest)
+        {
+            /* a torn write, the records after it were never synced */
+            LOG_printf(LOG_ERROR, "%s: dropping %d bytes at the end\n",
+                       cp, (int)(size - ofs));
+            if(truncate(cp, ofs) != 0)
+            {
+                FATAL_perror(cp);
+            }
+            size = ofs;
+        }
+        else
+        {
+            LOG_printf(LOG_ERROR, "%s: corrupt at offset %d, rest ignored\n",
+                       cp, (int)ofs);
+        }
+    }
+
+    pSeg = &NVLOG_segs[NVLOG_nSegs - 1];
+    pSeg->bytes = (uint32_t)size;
+    free(pBuf);
+    free(cp);
+}
+
+/*!
+ * @brief qsort() helper for segment numbers
+ */
+static int NVLOG_cmpNum(const void *pA, const void *pB)
+{
+    uint32_t a;
+    uint32_t b;
+
+    a = *((const uint32_t *)pA);
+    b = *((const uint32_t *)pB);
+    return ((a > b) - (a < b));
+}
+
+/*!
+ * @brief Find the segment files
+ * @param pN - set to the number found
+ * @returns malloc'ed sorted segment numbers, NULL if none
+ */
+static uint32_t *NVLOG_listSegs(unsigned *pN)
+{
+    struct dirent *pDE;
+    uint32_t *pNums;
+    uint32_t *p;
+    unsigned size;
+    size_t len;
+    char *pDir;
+    char *pBase;
+    char *pName;
+    char *ep;
+    DIR *d;
+    unsigned long v;
+
+    *pN = 0;
+    pNums = NULL;
+    size = 0;
+
+    pDir = strdup(NVLOG_cfg.filename);
+    pBase = strdup(NVLOG_cfg.filename);
+    if((pDir == NULL) || (pBase == NULL))
+    {
+        FATAL_printf("NV no ram\n");
+    }
+    pName = basename(pBase);
+    len = strlen(pName);
+
+    d = opendir(dirname(pDir));
+    if(d == NULL)
+    {
+        FATAL_perror(pDir);
+    }
+    while((pDE = readdir(d)) != NULL)
+    {
+        if((strncmp(pDE->d_name, pName, len) != 0) ||
+           (pDE->d_name[len] != '.') ||
+           (pDE->d_name[len + 1] < '0') ||
+           (pDE->d_name[len + 1] > '9'))
+        {
+            continue;
+        }
+        v = strtoul(pDE->d_name + len + 1, &ep, 10);
+        if((*ep != 0) || (v == 0) || (v > 999999))
+        {
+            continue;
+        }
+        if(*pN == size)
+        {
+            size = size + 16;
+            p = realloc(pNums, size * sizeof(pNums[0]));
+            if(p == NULL)
+            {
+                FATAL_printf("NV no ram\n");
+            }
+            pNums = p;
+        }
+        pNums[*pN] = (uint32_t)v;
+        (*pN)++;
+    }
+    closedir(d);
+    free(pDir);
+    free(pBase);
+
+    if(*pN)
+    {
+        qsort(pNums, *pN, sizeof(pNums[0]), NVLOG_cmpNum);
+    }
+    return (pNums);
+}
+
+/*!
+ * @brief Load the segments, or remove them if not restoring
+ */
+static void NVLOG_load(void)
+{
+    uint32_t *pNums;
+    unsigned n;
+    unsigned x;
+    char *cp;
+
+    pNums = NVLOG_listSegs(&n);
+    NVLOG_isNew = (n == 0);
+
+    if(!CONFIG_NV_RESTORE)
+    {
+        LOG_printf(LOG_DBG_NV_dbg, "config: No load NV, clearing old NV log\n");
+        for(x = 0 ; x < n ; x++)
+        {
+            cp = NVLOG_segName(pNums[x]);
+            (void)unlink(cp);
+            free(cp);
+        }
+        n = 0;
+    }
+
+    for(x = 0 ; x < n ; x++)
+    {
+        NVLOG_segAdd(pNums[x]);
+        NVLOG_loadSeg(pNums[x], (x + 1) == n);
+    }
+    free(pNums);
+
+    if((NVLOG_nSegs == 0) ||
+       (NVLOG_segs[NVLOG_nSegs - 1].bytes >= NVLOG_cfg.segment_bytes))
+    {
+        NVLOG_roll();
+    }
+    else
+    {
+        NVLOG_open(NVLOG_segs[NVLOG_nSegs - 1].num);
+    }
+}
+
+/*!
+ * @brief Check the common API parameters
+ * @param pId - the item ID
+ * @param len - data length
+ * @returns NVINTF_SUCCESS or the error
+ */
+static uint8_t NVLOG_checkItem(const NVINTF_itemID_t *pId, uint32_t len)
+{
+    (void)(pId);
+
+    if(len > NVLOG_MAXLEN)
+    {
+        return (NVINTF_BADLENGTH);
+    }
+    if(!NVLOG_ready)
+    {
+        return (NVINTF_NOTREADY);
+    }
+    return (NVINTF_SUCCESS);
+}
+
+/******************************************************************************
+ API Functions - NV driver
+******************************************************************************/
+
+/*!
+ * @brief Load the log, start the worker thread
+ * @param param - not used
+ * @returns NVINTF_SUCCESS
+ */
+static uint8_t NVLOG_initNvApi(void *param)
+{
+    (void)(param);
+
+    if(NVLOG_ready)
+    {
+        return (NVINTF_SUCCESS);
+    }
+
+    nvlogMutex = MUTEX_create("nvlog-mutex");
+    nvlogSem = SEMAPHORE_create("nvlog-worker", 0);
+    if((nvlogMutex == 0) || (nvlogSem == 0))
+    {
+        FATAL_printf("NV no mutex\n");
+    }
+
+    MUTEX_lock(nvlogMutex, -1);
+    NVLOG_hashResize(NVLOG_MINSLOTS);
+    NVLOG_load();
+    MUTEX_unLock(nvlogMutex);
+
+    nvlogThread = THREAD_create("nvlog-worker", NVLOG_worker, 0,
+                                THREAD_FLAGS_DEFAULT);
+    if(nvlogThread == 0)
+    {
+        FATAL_printf("Cannot create NV log worker\n");
+    }
+
+    NVLOG_ready = true;
+    LOG_printf(LOG_DBG_NV_dbg, "nvlog: %s: %u items in %u segments\n",
+               NVLOG_cfg.filename, NVLOG_nItems, NVLOG_nSegs);
+    return (NVINTF_SUCCESS);
+}
+
+/*!
+ * @brief Compact every closed segment now
+ * @param minBytes - not used, all old records are removed
+ * @returns NVINTF_SUCCESS or NVINTF_NOTREADY
+ */
+static uint8_t NVLOG_compactNvApi(uint16_t minBytes)
+{
+    uint32_t last;
+
+    (void)(minBytes);
+
+    if(!NVLOG_ready)
+    {
+        return (NVINTF_NOTREADY);
+    }
+
+    MUTEX_lock(nvlogMutex, -1);
+    if(NVLOG_segs[NVLOG_nSegs - 1].bytes)
+    {
+        NVLOG_roll();
+    }
+    /* copies can roll into more segments, those are new enough */
+    last = NVLOG_segs[NVLOG_nSegs - 1].num;
+    while(NVLOG_segs[0].num != last)
+    {
+        NVLOG_compactOne();
+    }
+    MUTEX_unLock(nvlogMutex);
+    return (NVINTF_SUCCESS);
+}
+
+/*!
+ * @brief Create an item, fails if it exists
+ * @param id - item ID
+ * @param len - data length
+ * @param pBuf - the data
+ * @returns NVINTF_SUCCESS or the error
+ */
+static uint8_t NVLOG_createItemApi(NVINTF_itemID_t id, uint32_t len,
+                                   void *pBuf)
+{
+    uint64_t key;
+    unsigned s;
+    uint8_t err;
+
+    if((pBuf == NULL) || (len == 0))
+    {
+        return (NVINTF_BADPARAM);
+    }
+    err = NVLOG_checkItem(&id, len);
+    if(err)
+    {
+        return (err);
+    }
+
+    key = NVLOG_KEY(id.systemID, id.itemID, id.subID);
+    MUTEX_lock(nvlogMutex, -1);
+    if(NVLOG_find(key, &s) >= 0)
+    {
+        err = NVINTF_EXIST;
+    }
+    else
+    {
+        NVLOG_setItem(key, NVLOG_append(NVLOG_PUT, key, pBuf, len),
+                      pBuf, len);
+    }
+    MUTEX_unLock(nvlogMutex);
+
+    if(err == NVINTF_SUCCESS)
+    {
+        NVLOG_changed();
+    }
+    return (err);
+}
+
+/*!
+ * @brief Replace an item, fails if it does not exist
+ * @param id - item ID
+ * @param len - data length
+ * @param pBuf - the data
+ * @returns NVINTF_SUCCESS or the error
+ */
+static uint8_t NVLOG_updateItemApi(NVINTF_itemID_t id, uint32_t len,
+                                   void *pBuf)
+{
+    uint64_t key;
+    unsigned s;
+    uint8_t err;
+
+    if((pBuf == NULL) || (len == 0))
+    {
+        return (NVINTF_BADPARAM);
+    }
+    err = NVLOG_checkItem(&id, len);
+    if(err)
+    {
+        return (err);
+    }
+
+    key = NVLOG_KEY(id.systemID, id.itemID, id.subID);
+    MUTEX_lock(nvlogMutex, -1);
+    if(NVLOG_find(key, &s) < 0)
+    {
+        err = NVINTF_NOTFOUND;
+    }
+    else
+    {
+        NVLOG_setItem(key, NVLOG_append(NVLOG_PUT, key, pBuf, len),
+                      pBuf, len);
+    }
+    MUTEX_unLock(nvlogMutex);
+
+    if(err == NVINTF_SUCCESS)
+    {
+        NVLOG_changed();
+    }
+    return (err);
+}
+
+/*!
+ * @brief Delete an item
+ * @param id - item ID
+ * @returns NVINTF_SUCCESS or the error
+ */
+static uint8_t NVLOG_deleteItemApi(NVINTF_itemID_t id)
+{
+    uint64_t key;
+    uint8_t err;
+
+    err = NVLOG_checkItem(&id, 0);
+    if(err)
+    {
+        return (err);
+    }
+
+    key = NVLOG_KEY(id.systemID, id.itemID, id.subID);
+    MUTEX_lock(nvlogMutex, -1);
+    if(NVLOG_clearItem(key))
+    {
+        (void)NVLOG_append(NVLOG_DEL, key, NULL, 0);
+    }
+    else
+    {
+        err = NVINTF_NOTFOUND;
+    }
+    MUTEX_unLock(nvlogMutex);
+
+    if(err == NVINTF_SUCCESS)
+    {
+        NVLOG_changed();
+    }
+    return (err);
+}
+
+/*!
+ * @brief Read an item
+ * @param id - item ID
+ * @param ofs - offset in the item data
+ * @param len - bytes to read
+ * @param pBuf - put the data here
+ * @returns NVINTF_SUCCESS or the error
+ */
+static uint8_t NVLOG_readItemApi(NVINTF_itemID_t id, uint16_t ofs,
+                                 uint16_t len, void *pBuf)
+{
+    struct nvlog_item *p;
+    unsigned s;
+    uint8_t err;
+    int x;
+
+    if((pBuf == NULL) || (len == 0))
+    {
+        return (NVINTF_BADPARAM);
+    }
+    err = NVLOG_checkItem(&id, len);
+    if(err)
+    {
+        return (err);
+    }
+
+    MUTEX_lock(nvlogMutex, -1);
+    x = NVLOG_find(NVLOG_KEY(id.systemID, id.itemID, id.subID), &s);
+    if(x < 0)
+    {
+        err = NVINTF_NOTFOUND;
+    }
+    else
+    {
+        p = &NVLOG_items[x];
+        if(((uint32_t)ofs + len) <= p->len)
+        {
+            memcpy(pBuf, p->pData + ofs, len);
+        }
+        else
+        {
+            err = (len > p->len) ? NVINTF_BADLENGTH : NVINTF_BADOFFSET;
+        }
+    }
+    MUTEX_unLock(nvlogMutex);
+    return (err);
+}
+
+/*!
+ * @brief Find an item by sysid, itemid and content
+ * @param id - item ID, the subid is ignored
+ * @param ofs - not used, like NVOCMP the data is read from the start
+ * @param rlen - bytes to read
+ * @param pRBuf - put the data here
+ * @param clen - bytes to compare
+ * @param coff - where to compare, in the item data
+ * @param pCBuf - the bytes to compare
+ * @param pSubId - set to the subid of the item found
+ * @returns NVINTF_SUCCESS or the error
+ */
+static uint8_t NVLOG_readContItemApi(NVINTF_itemID_t id, uint16_t ofs,
+                                     uint16_t rlen, void *pRBuf,
+                                     uint16_t clen, uint16_t coff,
+                                     void *pCBuf, uint16_t *pSubId)
+{
+    struct nvlog_item *p;
+    uint64_t key;
+    uint8_t err;
+    unsigned x;
+
+    (void)(ofs);
+
+    *pSubId = NVLOG_INVALIDSUBID;
+    if((pRBuf == NULL) || (rlen == 0) || (pCBuf == NULL) || (clen == 0))
+    {
+        return (NVINTF_BADPARAM);
+    }
+    err = NVLOG_checkItem(&id, rlen);
+    if(err)
+    {
+        return (err);
+    }
+
+    /* sysid and itemid, any subid */
+    key = NVLOG_KEY(id.systemID, id.itemID, 0);
+    err = NVINTF_NOTFOUND;
+    MUTEX_lock(nvlogMutex, -1);
+    for(x = 0 ; x < NVLOG_nItems ; x++)
+    {
+        p = &NVLOG_items[x];
+        if(((p->key & ~((uint64_t)0xFFFF)) != key) ||
+           (rlen > p->len) ||
+           (((uint32_t)coff + clen) > rlen) ||
+           (memcmp(p->pData + coff, pCBuf, clen) != 0))
+        {
+            continue;
+        }
+        memcpy(pRBuf, p->pData, rlen);
+        *pSubId = (uint16_t)p->key;
+        err = NVINTF_SUCCESS;
+        break;
+    }
+    MUTEX_unLock(nvlogMutex);
+    return (err);
+}
+
+/*!
+ * @brief Write an item, creating it if needed
+ * @param id - item ID
+ * @param len - data length
+ * @param pBuf - the data
+ * @returns NVINTF_SUCCESS or the error
+ */
+static uint8_t NVLOG_writeItemApi(NVINTF_itemID_t id, uint16_t len,
+                                  void *pBuf)
+{
+    uint64_t key;
+    uint8_t err;
+
+    if((pBuf == NULL) || (len == 0))
+    {
+        return (NVINTF_BADPARAM);
+    }
+    err = NVLOG_checkItem(&id, len);
+    if(err)
+    {
+        return (err);
+    }
+
+    key = NVLOG_KEY(id.systemID, id.itemID, id.subID);
+    MUTEX_lock(nvlogMutex, -1);
+    NVLOG_setItem(key, NVLOG_append(NVLOG_PUT, key, pBuf, len), pBuf, len);
+    MUTEX_unLock(nvlogMutex);
+
+    NVLOG_changed();
+    return (NVINTF_SUCCESS);
+}
+
+/*!
+ * @brief Get the length of an item
+ * @param id - item ID
+ * @returns the length, 0 if not found
+ */
+static uint32_t NVLOG_getItemLenApi(NVINTF_itemID_t id)
+{
+    unsigned s;
+    uint32_t len;
+    int x;
+
+    if(!NVLOG_ready)
+    {
+        return (0);
+    }
+
+    len = 0;
+    MUTEX_lock(nvlogMutex, -1);
+    x = NVLOG_find(NVLOG_KEY(id.systemID, id.itemID, id.subID), &s);
+    if(x >= 0)
+    {
+        len = NVLOG_items[x].len;
+    }
+    MUTEX_unLock(nvlogMutex);
+    return (len);
+}
+
+/*!
+ * @brief Find, read or delete the items one at a time, see NVINTF_doNext
+ * @param prx - the search, set NVINTF_DOSTART to begin a new one
+ * @returns NVINTF_SUCCESS, or NVINTF_NOTFOUND when there are no more
+ *
+ * Items come in no particular order. NVLOG_items[] is walked from the
+ * end, a delete moves the last item into the hole, which was already
+ * visited. Hold lockNV() over the whole search.
+ */
+static uint8_t NVLOG_doNextApi(NVINTF_nvProxy_t *prx)
+{
+    static enum {doFind, doRead, doDelete} op = doFind;
+    static uint8_t search = NVINTF_DOANYID;
+    static unsigned pos;
+    static uint16_t bufLen;
+    struct nvlog_item *p;
+    uint64_t key;
+    bool deleted;
+    uint8_t err;
+
+    if((prx == NULL) || (prx->flag == 0))
+    {
+        return (NVINTF_BADPARAM);
+    }
+    if(!NVLOG_ready)
+    {
+        return (NVINTF_NOTREADY);
+    }
+
+    MUTEX_lock(nvlogMutex, -1);
+
+    if(prx->flag & NVINTF_DOSTART)
+    {
+        prx->flag &= ~NVINTF_DOSTART;
+        pos = NVLOG_nItems;
+        bufLen = prx->len;
+
+        if(prx->flag & NVINTF_DOSYSID)
+        {
+            search = NVINTF_DOSYSID;
+        }
+        else if(prx->flag & NVINTF_DOITMID)
+        {
+            search = NVINTF_DOITMID;
+        }
+        else if(prx->flag & NVINTF_DOANYID)
+        {
+            search = NVINTF_DOANYID;
+        }
+        if(prx->flag & NVINTF_DOFIND)
+        {
+            op = doFind;
+        }
+        else if(prx->flag & NVINTF_DOREAD)
+        {
+            op = doRead;
+        }
+        else if(prx->flag & NVINTF_DODELETE)
+        {
+            op = doDelete;
+        }
+    }
+
+    err = NVINTF_NOTFOUND;
+    deleted = false;
+    while(pos > 0)
+    {
+        pos--;
+        if(pos >= NVLOG_nItems)
+        {
+            /* items were deleted since the last call */
+            continue;
+        }
+        p = &NVLOG_items[pos];
+        key = p->key;
+        if((search == NVINTF_DOSYSID) &&
+           ((uint8_t)(key >> 32) != prx->sysid))
+        {
+            continue;
+        }
+        if((search == NVINTF_DOITMID) &&
+           ((key >> 16) != (((uint64_t)prx->sysid << 16) | prx->itemid)))
+        {
+            continue;
+        }
+
+        prx->sysid = (uint8_t)(key >> 32);
+        prx->itemid = (uint16_t)(key >> 16);
+        prx->subid = (uint16_t)key;
+        prx->len = (uint16_t)p->len;
+        err = NVINTF_SUCCESS;
+
+        if((op == doRead) && (prx->buffer != NULL) && (p->len <= bufLen))
+        {
+            memcpy(prx->buffer, p->pData, p->len);
+        }
+        else if((op == doDelete) && (prx->sysid != NVINTF_SYSID_NVDRVR))
+        {
+            (void)NVLOG_clearItem(key);
+            (void)NVLOG_append(NVLOG_DEL, key, NULL, 0);
+            deleted = true;
+        }
+        break;
+    }
+    MUTEX_unLock(nvlogMutex);
+
+    if(deleted)
+    {
+        NVLOG_changed();
+    }
+    return (err);
+}
+
+/*!
+ * @brief Lock the NV, for doNext() searches
+ * @returns key for unlockNV()
+ */
+static IArg NVLOG_lockNvApi(void)
+{
+    MUTEX_lock(nvlogMutex, -1);
+    return (0);
+}
+
+/*!
+ * @brief Undo lockNV()
+ * @param key - from lockNV()
+ */
+static void NVLOG_unlockNvApi(IArg key)
+{
+    (void)(key);
+    MUTEX_unLock(nvlogMutex);
+}
+
+/*!
+ * @brief Push every change made so far to the disk
+ * @returns NVINTF_SUCCESS or NVINTF_NOTREADY
+ */
+static uint8_t NVLOG_syncNvApi(void)
+{
+    if(!NVLOG_ready)
+    {
+        return (NVINTF_NOTREADY);
+    }
+    NVLOG_sync(true);
+    return (NVINTF_SUCCESS);
+}
+
+/*
+  Return the log NV driver API
+
+  Public function defined in nvlog.h
+*/
+void NVLOG_loadApiPtrs(NVINTF_nvFuncts_t *pfn)
+{
+    pfn->initNV       = &NVLOG_initNvApi;
+    pfn->compactNV    = &NVLOG_compactNvApi;
+    pfn->createItem   = &NVLOG_createItemApi;
+    pfn->updateItem   = &NVLOG_updateItemApi;
+    pfn->deleteItem   = &NVLOG_deleteItemApi;
+    pfn->readItem     = &NVLOG_readItemApi;
+    pfn->readContItem = &NVLOG_readContItemApi;
+    pfn->writeItem    = &NVLOG_writeItemApi;
+    pfn->getItemLen   = &NVLOG_getItemLenApi;
+    pfn->doNext       = &NVLOG_doNextApi;
+    pfn->lockNV       = &NVLOG_lockNvApi;
+    pfn->unlockNV     = &NVLOG_unlockNvApi;
+    pfn->syncNV       = &NVLOG_syncNvApi;
+}
+
+/*
+  Return the log statistics
+
+  Public function defined in nvlog.h
+*/
+void NVLOG_getStats(struct nvlog_stats *pStats)
+{
+    unsigned x;
+
+    memset(pStats, 0, sizeof(*pStats));
+    pStats->is_new = NVLOG_isNew;
+    if(!NVLOG_ready)
+    {
+        return;
+    }
+
+    MUTEX_lock(nvlogMutex, -1);
+    pStats->n_items = NVLOG_nItems;
+    pStats->n_segments = NVLOG_nSegs;
+    for(x = 0 ; x < NVLOG_nSegs ; x++)
+    {
+        pStats->total_bytes += NVLOG_segs[x].bytes;
+        pStats->live_bytes += NVLOG_segs[x].live;
+    }
+    pStats->n_compactions = NVLOG_compactions;
+    MUTEX_unLock(nvlogMutex);
+}
+
+/*
+ *  ========================================
+ *  Texas Instruments Micro Controller Style
+ *  ========================================
+ *  Local Variables:
+ *  mode: c
+ *  c-file-style: "bsd"
+ *  tab-width: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  End:
+ *  vim:set  filetype=c tabstop=4 shiftwidth=4 expandtab=true
+ */
@@ -68,6 +68,9 @@ NVOCMP_NVPAGES = 4 means 3 pages storage and 1 compaction page.
 NVOCMP_NVPAGES = 5 means 4 pages storage and 1 compaction page.
 NVOCMP_NVPAGES can be configured from project option. If this flag is not
 configured, NVOCMP_NVPAGES = 2 will be by default.
+On Linux (NV_LINUX) NVOCMP_NVPAGES is only the default, the number of pages
+and the page size are read from NV_LINUX_getAttrs() by the init function,
+up to NVOCMP_MAXPAGES pages of 4, 8 or 16 kBytes.
 "nvintf.h" describes the generic NV interface which is used to access NVOCMP
 after initialization. Initialization is done by passing a function pointer
 struct to one of NVOCMP pointer loader functions. Once this is done, the
@@ -106,6 +109,8 @@ NVOCMP_CRCONREAD (on:1 off:0) - item crc is checked on read. Disabling this may
 increase driver speed but safety is reduced.
 NVOCMP_NVS_INDEX - The index of the NVS_Config structure which describes the
 flash sector that NVOCMP should use. Default is 0.
+NVOCMP_ITEMINDEX (on:1 off:0) - keep a RAM hash index of the active items, so
+finding an item by its full ID does not search the pages. Default is on.
 
 Dependencies:
 Requires NVS for NV access.
@@ -118,6 +123,7 @@ Requires API's in a crc.h to implement CRC functionality.
 //*****************************************************************************
 
 #include <string.h>
+#include <stdlib.h>
 #ifdef NVOCMP_POSIX_MUTEX
 #include <pthread.h>
 #else
@@ -140,15 +146,29 @@ Requires API's in a crc.h to implement CRC functionality.
 #define NVOCMP_NVPAGES      2     //1 ~ 5 are supported
 #endif
 
+#ifndef NV_LINUX
 #if (NVOCMP_NVPAGES > 5)
 #error "NVOCMP_NVPAGES should be in between 1 and 5"
 #endif
+// Size of the page table in the NV handle
+#define NVOCMP_MAXPAGES     NVOCMP_NVPAGES
+#else
+// On Linux NVOCMP_NVPAGES is the default page count, the NV size is set
+// at run time by NV_LINUX_getAttrs(), up to this many pages (0xFF is
+// NVOCMP_NULLPAGE)
+#if !defined(NVOCMP_MAXPAGES)
+#define NVOCMP_MAXPAGES     254
+#endif
+#endif
 
 #define NVOCMP_FASTCP       1           // Fast Compaction by Skipping All Active Item Pages
 #define NVOCMP_COMPR        0           // Order Change When Compaction
 #define NVOCMP_HDRLE        0           // Little Endian Format Item Header
 #define NVOCMP_FASTOFF      1           // Fast Search Offset
 #define NVOCMP_FASTITEM     0           // Fast Find Item
+#if !defined(NVOCMP_ITEMINDEX)
+#define NVOCMP_ITEMINDEX    1           // RAM Index of Active Items
+#endif
 
 #define NVOCMP_NVONEP       1           // One Page NV
 #define NVOCMP_NVTWOP       2           // Two Page NV
@@ -269,8 +289,18 @@ static void NVOCMP_assert(bool cond, char *message, bool fatal)
 //*****************************************************************************
 // Page and Header Definitions
 //*****************************************************************************
+#ifndef NV_LINUX
 // CC26x2/CC13x2 devices flash page size is (1 << 13) or 0x2000
 #define PAGE_SIZE_LSHIFT 13
+#else
+// Set from the NV_LINUX_getAttrs() sector size by NVOCMP_initNvApi()
+#define PAGE_SIZE_LSHIFT NVOCMP_pageShift
+// Page size limits, offsets are int16_t in places and the largest item
+// (NVOCMP_MAXLEN) must fit in a page
+#define NVOCMP_MINPAGESHIFT 12
+#define NVOCMP_MAXPAGESHIFT 14
+static uint8_t NVOCMP_pageShift = 13;
+#endif
 #if !defined (FLASH_PAGE_SIZE)
 #define FLASH_PAGE_SIZE  (1 << PAGE_SIZE_LSHIFT)
 #endif // FLASH_PAGE_SIZE
@@ -293,7 +323,11 @@ static void NVOCMP_assert(bool cond, char *message, bool fatal)
 #ifdef NVOCMP_GPRAM
 #define RAM_BUFFER_ADDRESS    (uint8_t *)0x11000000
 #else
+#ifndef NV_LINUX
 uint32_t tBuffer[FLASH_PAGE_SIZE >> 2];               // this is for debugging
+#else
+uint32_t tBuffer[(1 << NVOCMP_MAXPAGESHIFT) >> 2];    // largest page
+#endif
 #endif
 
 // Page header structure
@@ -507,7 +541,7 @@ typedef struct
   uint16_t xsrcOffset;  // transfer source page offset
   uint16_t xdstOffset;  // transfer destination page offset
   NVOCMP_compactInfo_t compactInfo;
-  NVOCMP_pageInfo_t pageInfo[NVOCMP_NVPAGES];
+  NVOCMP_pageInfo_t pageInfo[NVOCMP_MAXPAGES];
 } NVOCMP_nvHandle_t;
 //*****************************************************************************
 // Local variables
@@ -561,6 +595,38 @@ static uint16_t NVOCMP_badCRCCount = 0;
 NVOCMP_initAction_t gAction;
 uint8_t NVOCMP_size;
 
+#if NVOCMP_ITEMINDEX
+// Data bytes kept in an index entry, content lookups within them (such as
+// a device by short or extended address) do not read the pages
+#define NVOCMP_INDEXHEAD    16
+
+// Item index entry, the location of the newest active copy of an item
+typedef struct
+{
+  uint32_t cmpid;   // Compressed ID, NVOCMP_INDEXFREE if the slot is empty
+  uint16_t hofs;    // Header offset
+  uint16_t len;     // Data length
+  uint8_t  hpage;   // Header page
+  uint8_t  head[NVOCMP_INDEXHEAD]; // First data bytes, len if shorter
+} NVOCMP_indexEntry_t;
+
+// Compressed IDs have bit31 zero, so this is never a valid ID
+#define NVOCMP_INDEXFREE    0xFFFFFFFF
+// Initial number of index slots (power of 2)
+#define NVOCMP_INDEXMINSIZE 256
+
+// Open addressing (linear probe) hash table keyed by compressed ID
+static NVOCMP_indexEntry_t *NVOCMP_index;
+// Number of slots in NVOCMP_index
+static uint32_t NVOCMP_indexSize;
+// Number of used slots in NVOCMP_index
+static uint32_t NVOCMP_indexCount;
+// Index matches the pages, cleared when items move without it
+static bool NVOCMP_indexValid;
+// Index in use, see NVOCMP_setItemIndex()
+static bool NVOCMP_indexEnable = true;
+#endif
+
 //*****************************************************************************
 // NV API Function Prototypes
 //*****************************************************************************
@@ -580,6 +646,7 @@ static uint8_t    NVOCMP_writeItemApi(NVINTF_itemID_t id, uint16_t len, void *bu
 static uint8_t    NVOCMP_doNextApi(NVINTF_nvProxy_t * prx);
 static IArg       NVOCMP_lockNvApi(void);
 static void       NVOCMP_unlockNvApi(IArg);
+static uint8_t    NVOCMP_syncNvApi(void);
 
 //*****************************************************************************
 // NV Local Function Prototypes
@@ -632,6 +699,28 @@ static void       NVOCMP_migratePage(NVOCMP_nvHandle_t *pNvHandle, uint8_t page)
 #endif
 #endif
 
+#if NVOCMP_ITEMINDEX
+static void       NVOCMP_indexBuild(NVOCMP_nvHandle_t *pNvHandle);
+static bool       NVOCMP_indexFind(NVOCMP_nvHandle_t *pNvHandle, uint32_t cid,
+                                   NVOCMP_itemHdr_t *pHdr, int8_t *pErr);
+static void       NVOCMP_indexAdd(uint32_t cid, uint8_t pg, uint16_t hofs, uint16_t len);
+static void       NVOCMP_indexRemove(uint8_t pg, uint16_t hofs);
+static bool       NVOCMP_indexFindCont(NVOCMP_nvHandle_t *pNvHandle,
+                                       NVOCMP_itemHdr_t *pHdr,
+                                       NVOCMP_itemInfo_t *pInfo, int8_t *pErr);
+static void       NVOCMP_indexPage(NVOCMP_nvHandle_t *pNvHandle, uint8_t dstPg);
+static void       NVOCMP_indexErase(uint8_t pg);
+// Items moved some other way, the index is rebuilt on the next find
+#define NVOCMP_indexInvalidate() { NVOCMP_indexValid = false; }
+#else
+#define NVOCMP_indexBuild(pNvHandle)
+#define NVOCMP_indexAdd(cid, pg, hofs, len)
+#define NVOCMP_indexRemove(pg, hofs)
+#define NVOCMP_indexPage(pNvHandle, dstPg)
+#define NVOCMP_indexErase(pg)
+#define NVOCMP_indexInvalidate()
+#endif
+
 //*****************************************************************************
 // Load Pointer Functions (These are declared in nvoctp.h)
 //*****************************************************************************
@@ -661,6 +750,7 @@ void NVOCMP_loadApiPtrs(NVINTF_nvFuncts_t *pfn)
     pfn->lockNV       = NULL;
     pfn->unlockNV     = NULL;
     pfn->doNext       = NULL;
+    pfn->syncNV       = &NVOCMP_syncNvApi;
 }
 
 /**
@@ -690,6 +780,7 @@ void NVOCMP_loadApiPtrsMin(NVINTF_nvFuncts_t *pfn)
     pfn->lockNV       = NULL;
     pfn->unlockNV     = NULL;
     pfn->doNext       = NULL;
+    pfn->syncNV       = &NVOCMP_syncNvApi;
 }
 
 /**
@@ -718,6 +809,7 @@ void NVOCMP_loadApiPtrsExt(NVINTF_nvFuncts_t *pfn)
     pfn->lockNV       = &NVOCMP_lockNvApi;
     pfn->unlockNV     = &NVOCMP_unlockNvApi;
     pfn->doNext       = &NVOCMP_doNextApi;
+    pfn->syncNV       = &NVOCMP_syncNvApi;
 }
 
 /**
@@ -744,6 +836,35 @@ extern void NVOCMP_setCheckVoltage(void *funcPtr)
 #endif
 }
 
+/**
+ * @fn      NVOCMP_setItemIndex
+ *
+ * @brief   Global function to turn the RAM item index on or off. With the
+ *          index off every item lookup searches the NV pages, as the
+ *          driver did before the index existed. Call this before initNV(),
+ *          or between lockNV() and unlockNV().
+ *
+ * @param   enable - true to use the index
+ *
+ * @return  none
+ */
+extern void NVOCMP_setItemIndex(bool enable)
+{
+#if NVOCMP_ITEMINDEX
+    NVOCMP_indexEnable = enable;
+    NVOCMP_indexValid = false;
+    if(!enable)
+    {
+        free(NVOCMP_index);
+        NVOCMP_index = NULL;
+        NVOCMP_indexSize = 0;
+        NVOCMP_indexCount = 0;
+    }
+#else
+    (void)enable;
+#endif
+}
+
 /******************************************************************************
  * @fn      NVOCMP_initNvApi
  *
@@ -765,6 +886,9 @@ static uint8_t NVOCMP_initNvApi(void *param)
 #else
         GateMutexPri_Params gateParams;
 #endif
+#ifdef NV_LINUX
+        uint8_t shift;
+#endif
 
         // Only one init per device reset
         NVOCMP_failF = NVINTF_SUCCESS;
@@ -808,16 +932,29 @@ static uint8_t NVOCMP_initNvApi(void *param)
         NV_LINUX_init();
         
         NVOCMP_nvsHandle = NVS_HANDLE;
-        NVOCMP_nvsAttrs.sectorSize = FLASH_PAGE_SIZE;
-        NVOCMP_nvsAttrs.regionSize = FLASH_PAGE_SIZE * NVOCMP_NVPAGES;
+        NV_LINUX_getAttrs(&NVOCMP_nvsAttrs);
+
+        // The page size is a power of 2 in the supported range
+        for (shift = NVOCMP_MINPAGESHIFT; shift < NVOCMP_MAXPAGESHIFT; shift++)
+        {
+            if ((1U << shift) >= NVOCMP_nvsAttrs.sectorSize)
+            {
+                break;
+            }
+        }
+        NVOCMP_pageShift = shift;
 #endif
 
         NVOCMP_nvHandle.nvSize = NVOCMP_nvsAttrs.regionSize/NVOCMP_nvsAttrs.sectorSize;
-        NVOCMP_nvHandle.nvSize = NVOCMP_nvHandle.nvSize > NVOCMP_NVPAGES ? NVOCMP_NVPAGES : NVOCMP_nvHandle.nvSize;
+        NVOCMP_nvHandle.nvSize = NVOCMP_nvHandle.nvSize > NVOCMP_MAXPAGES ? NVOCMP_MAXPAGES : NVOCMP_nvHandle.nvSize;
         NVOCMP_size = NVOCMP_nvHandle.nvSize;
 
         // Confirm NV region has expected characteristics
         if (FLASH_PAGE_SIZE != NVOCMP_nvsAttrs.sectorSize ||
+#if (NVOCMP_NVPAGES != NVOCMP_NVONEP)
+                // The multi page driver needs a compaction page
+                (NVOCMP_NVSIZE < NVOCMP_NVTWOP) ||
+#endif
                 (NVOCMP_NVSIZE * FLASH_PAGE_SIZE > NVOCMP_nvsAttrs.regionSize))
         {
             NVOCMP_failF = NVINTF_FAILURE;
@@ -1345,6 +1482,22 @@ static void NVOCMP_unlockNvApi(IArg key)
 #endif
 }
 
+/**
+ * @fn      NVOCMP_syncNvApi
+ *
+ * @brief   Global function to write pending NV changes to storage now
+ *
+ * @return  NVINTF_SUCCESS
+ */
+static uint8_t NVOCMP_syncNvApi(void)
+{
+#ifdef NV_LINUX
+    // Writes are saved in the background, wait for them
+    NV_LINUX_sync();
+#endif
+    return(NVINTF_SUCCESS);
+}
+
 /******************************************************************************
  * @fn      NVOCMP_doNextApi
  *
@@ -1399,8 +1552,12 @@ static uint8_t NVOCMP_doNextApi(NVINTF_nvProxy_t * prx)
     NVOCMP_itemHdr_t hdr;
     static uint8_t search;
     static uint8_t sPage;
-    static int16_t fOfs    = FLASH_PAGE_SIZE;
+    static int16_t fOfs;
     static uint16_t bufLen = 0;
+    static uint8_t startPage;
+    static uint8_t lastDist;
+    static uint16_t lastOfs;
+    uint8_t dist;
     uint8_t status         = NVINTF_SUCCESS;
     int16_t iOfs           = NVOCMP_nvHandle.actOffset;
 
@@ -1425,6 +1582,10 @@ static uint8_t NVOCMP_doNextApi(NVINTF_nvProxy_t * prx)
         // Start at latest item
         sPage = NVOCMP_nvHandle.actPage;
         fOfs = NVOCMP_nvHandle.actOffset;
+        // Where the walk started, see the wrap check below
+        startPage = sPage;
+        lastDist = 0;
+        lastOfs = fOfs;
         // Read in buffer len
         bufLen = prx->len;
 
@@ -1460,7 +1621,20 @@ static uint8_t NVOCMP_doNextApi(NVINTF_nvProxy_t * prx)
     hdr.subid = prx->subid;
 
     // Look for item
-    if (!NVOCMP_findItem(&NVOCMP_nvHandle, sPage, fOfs, &hdr, search, NULL))
+    status = NVOCMP_findItem(&NVOCMP_nvHandle, sPage, fOfs, &hdr, search, NULL);
+    if (!status)
+    {
+        // findItem() searches all pages from where it is told to start, so
+        // the walk comes around to the newest items again, stop there
+        dist = (uint8_t)((startPage + NVOCMP_NVSIZE - hdr.hpage) % NVOCMP_NVSIZE);
+        if ((dist < lastDist) || ((dist == lastDist) && (hdr.hofs >= lastOfs)))
+        {
+            status = NVINTF_NOTFOUND;
+        }
+        lastDist = dist;
+        lastOfs = hdr.hofs;
+    }
+    if (!status)
     {
         iOfs = hdr.hofs;
         // store its attributes
@@ -1592,6 +1766,8 @@ static void NVOCMP_migratePage(NVOCMP_nvHandle_t *pNvHandle, uint8_t page)
   uint16_t offset2;
   NVOCMP_itemHdr_t iHdr;
 
+  NVOCMP_indexInvalidate();
+
   offset1 = pNvHandle->pageInfo[page].offset;
   offset2 = NVOCTP_PGDATAOFS;
   if(offset1 - NVOCTP_PGDATAOFS > FLASH_PAGE_SIZE - NVOCMP_PGDATAOFS)
@@ -2082,6 +2258,9 @@ static void NVOCMP_initNv(NVOCMP_nvHandle_t *pNvHandle)
       break;
   }
 #endif
+
+  // Index the active items, so finds do not search the pages
+  NVOCMP_indexBuild(pNvHandle);
 }
 
 /******************************************************************************
@@ -2335,6 +2514,8 @@ static uint8_t NVOCMP_erase(NVOCMP_nvHandle_t *pNvHandle, uint8_t dstPg)
     uint8_t err = NVINTF_SUCCESS;
     int_fast16_t nvsRes = 0;
 
+    NVOCMP_indexErase(dstPg);
+
     // Check voltage if possible
     NVOCMP_FLASHACCESS(err)
 
@@ -2516,6 +2697,11 @@ static void NVOCMP_writeItem(NVOCMP_nvHandle_t *pNvHandle, NVOCMP_itemHdr_t *pHd
         {
             NVOCMP_setItemInactive(pNvHandle, dstPg, hOfs);
         }
+        else
+        {
+            NVOCMP_indexAdd(NVOCMP_CMPRID(pHdr->sysid, pHdr->itemid, pHdr->subid),
+                            dstPg, hOfs, dLen);
+        }
     }
     else
     {
@@ -2683,6 +2869,8 @@ static void NVOCMP_setItemInactive(NVOCMP_nvHandle_t *pNvHandle, uint8_t pg,
 {
     uint8_t tmp;
 
+    NVOCMP_indexRemove(pg, iOfs);
+
     // Get byte with validity bit
     tmp = NVOCMP_readByte(pg, iOfs + NVOCMP_HDRVLDOFS);
 
@@ -2899,6 +3087,548 @@ static uint16_t NVOCMP_findOffset(uint8_t pg, uint16_t ofs)
 }
 #endif
 
+#if NVOCMP_ITEMINDEX
+/******************************************************************************
+ * @fn      NVOCMP_indexHash
+ *
+ * @brief   Home slot of a compressed ID in the item index
+ *
+ * @param   cid - compressed ID
+ *
+ * @return  Slot number
+ */
+static uint32_t NVOCMP_indexHash(uint32_t cid)
+{
+    // Sub IDs are often sequential, spread them over the table
+    cid *= 0x9E3779B1;
+    cid ^= cid >> 16;
+    return(cid & (NVOCMP_indexSize - 1));
+}
+
+/******************************************************************************
+ * @fn      NVOCMP_indexSlot
+ *
+ * @brief   Find the index slot of an item, or the empty slot it would use
+ *
+ * @param   cid - compressed ID
+ *
+ * @return  Pointer to the slot
+ */
+static NVOCMP_indexEntry_t *NVOCMP_indexSlot(uint32_t cid)
+{
+    uint32_t i;
+
+    i = NVOCMP_indexHash(cid);
+    while((NVOCMP_index[i].cmpid != NVOCMP_INDEXFREE) &&
+          (NVOCMP_index[i].cmpid != cid))
+    {
+        i = (i + 1) & (NVOCMP_indexSize - 1);
+    }
+    return(&NVOCMP_index[i]);
+}
+
+/******************************************************************************
+ * @fn      NVOCMP_indexResize
+ *
+ * @brief   Move the item index to a table with a new number of slots
+ *
+ * @param   size - number of slots, a power of 2
+ *
+ * @return  true on success, false (index dropped) if out of memory
+ */
+static bool NVOCMP_indexResize(uint32_t size)
+{
+    NVOCMP_indexEntry_t *pOld = NVOCMP_index;
+    uint32_t oldSize = NVOCMP_indexSize;
+    uint32_t i;
+
+    NVOCMP_index = malloc(size * sizeof(NVOCMP_indexEntry_t));
+    if(NVOCMP_index == NULL)
+    {
+        NVOCMP_ALERT(FALSE, "No memory for the item index.")
+        free(pOld);
+        NVOCMP_indexSize = 0;
+        NVOCMP_indexCount = 0;
+        NVOCMP_indexValid = false;
+        return(false);
+    }
+    // All slots empty (NVOCMP_INDEXFREE)
+    memset(NVOCMP_index, 0xFF, size * sizeof(NVOCMP_indexEntry_t));
+    NVOCMP_indexSize = size;
+
+    for(i = 0; i < oldSize; i++)
+    {
+        if(pOld[i].cmpid != NVOCMP_INDEXFREE)
+        {
+            *NVOCMP_indexSlot(pOld[i].cmpid) = pOld[i];
+        }
+    }
+    free(pOld);
+    return(true);
+}
+
+/******************************************************************************
+ * @fn      NVOCMP_indexPut
+ *
+ * @brief   Set the location of an item in the item index
+ *
+ * @param   cid  - compressed ID
+ * @param   pg   - page of the item header
+ * @param   hofs - offset of the item header
+ * @param   len  - item data length
+ *
+ * @return  true on success, false (index dropped) if out of memory
+ */
+static bool NVOCMP_indexPut(uint32_t cid, uint8_t pg, uint16_t hofs, uint16_t len)
+{
+    NVOCMP_indexEntry_t *pEntry;
+
+    // Keep the table at most 3/4 full
+    if(((NVOCMP_indexCount + 1) * 4) > (NVOCMP_indexSize * 3))
+    {
+        if(!NVOCMP_indexResize(NVOCMP_indexSize ?
+                               (NVOCMP_indexSize * 2) : NVOCMP_INDEXMINSIZE))
+        {
+            return(false);
+        }
+    }
+
+    pEntry = NVOCMP_indexSlot(cid);
+    if(pEntry->cmpid == NVOCMP_INDEXFREE)
+    {
+        NVOCMP_indexCount++;
+    }
+    pEntry->cmpid = cid;
+    pEntry->hpage = pg;
+    pEntry->hofs = hofs;
+    pEntry->len = len;
+    // The data ends at the header
+    NVOCMP_read(pg, hofs - len, pEntry->head,
+                (len < NVOCMP_INDEXHEAD) ? len : NVOCMP_INDEXHEAD);
+    return(true);
+}
+
+/******************************************************************************
+ * @fn      NVOCMP_indexBuild
+ *
+ * @brief   Rebuild the item index from the NV pages. The pages are walked
+ *          the same way NVOCMP_findItem() walks them, newest item first,
+ *          so the index holds the copy a search would have found. On a
+ *          corrupt page the index stays invalid, the search that follows
+ *          finds the corruption and compacts.
+ *
+ * @param   pNvHandle - pointer to NV handle
+ *
+ * @return  none
+ */
+static void NVOCMP_indexBuild(NVOCMP_nvHandle_t *pNvHandle)
+{
+    uint8_t p;
+    uint16_t ofs;
+    uint16_t nvSearched = 0;
+    NVOCMP_itemHdr_t iHdr;
+
+    NVOCMP_indexValid = false;
+    if(!NVOCMP_indexEnable || (pNvHandle->actPage == NVOCMP_NULLPAGE))
+    {
+        return;
+    }
+
+    if(NVOCMP_index == NULL)
+    {
+        if(!NVOCMP_indexResize(NVOCMP_INDEXMINSIZE))
+        {
+            return;
+        }
+    }
+    memset(NVOCMP_index, 0xFF, NVOCMP_indexSize * sizeof(NVOCMP_indexEntry_t));
+    NVOCMP_indexCount = 0;
+
+    ofs = pNvHandle->actOffset;
+    for(p = pNvHandle->actPage; nvSearched < NVOCMP_NVSIZE; p = NVOCMP_DECPAGE(p), ofs = pNvHandle->pageInfo[p].offset)
+    {
+      nvSearched++;
+#if (NVOCMP_NVPAGES != NVOCMP_NVONEP)
+      if(p == pNvHandle->tailPage)
+      {
+        continue;
+      }
+#endif
+      while(ofs >= (NVOCMP_PGDATAOFS + NVOCMP_ITEMHDRLEN))
+      {
+          // Align to start of item header
+          ofs -= NVOCMP_ITEMHDRLEN;
+
+          NVOCMP_readHeader(p, ofs, &iHdr, false);
+
+          if(!(iHdr.stats & NVOCMP_FOLLOWBIT) || (iHdr.len >= ofs))
+          {
+              NVOCMP_ALERT(FALSE, "Item index not built, page corrupted.")
+              return;
+          }
+
+          if((iHdr.stats & NVOCMP_ACTIVEIDBIT) &&
+            !(iHdr.stats & NVOCMP_VALIDIDBIT) &&
+            (NVOCMP_indexSlot(iHdr.cmpid)->cmpid != iHdr.cmpid))
+          {
+              if(!NVOCMP_indexPut(iHdr.cmpid, p, ofs, iHdr.len))
+              {
+                  return;
+              }
+          }
+
+          // Next item
+          ofs -= iHdr.len;
+      }
+    }
+
+    NVOCMP_indexValid = true;
+}
+
+/******************************************************************************
+ * @fn      NVOCMP_indexFind
+ *
+ * @brief   Look up the newest active copy of an item in the item index
+ *
+ * @param   pNvHandle - pointer to NV handle
+ * @param   cid  - compressed ID
+ * @param   pHdr - pointer to item header, filled in if found
+ * @param   pErr - NVINTF_SUCCESS or NVINTF_NOTFOUND, when true is returned
+ *
+ * @return  true if answered, false if the pages must be searched instead
+ */
+static bool NVOCMP_indexFind(NVOCMP_nvHandle_t *pNvHandle, uint32_t cid,
+                             NVOCMP_itemHdr_t *pHdr, int8_t *pErr)
+{
+    NVOCMP_indexEntry_t *pEntry;
+    NVOCMP_itemHdr_t iHdr;
+
+    if(!NVOCMP_indexEnable)
+    {
+        return(false);
+    }
+    if(!NVOCMP_indexValid)
+    {
+        // First find since a compaction
+        NVOCMP_indexBuild(pNvHandle);
+        if(!NVOCMP_indexValid)
+        {
+            return(false);
+        }
+    }
+
+    pEntry = NVOCMP_indexSlot(cid);
+    if(pEntry->cmpid == NVOCMP_INDEXFREE)
+    {
+        pHdr->hofs = 0;
+        *pErr = NVINTF_NOTFOUND;
+        return(true);
+    }
+
+    NVOCMP_readHeader(pEntry->hpage, pEntry->hofs, &iHdr, false);
+    if((iHdr.stats & NVOCMP_ACTIVEIDBIT) &&
+      !(iHdr.stats & NVOCMP_VALIDIDBIT) &&
+       (iHdr.cmpid == cid) && (iHdr.len == pEntry->len))
+    {
+        memcpy(pHdr, &iHdr, sizeof(NVOCMP_itemHdr_t));
+        *pErr = NVINTF_SUCCESS;
+        return(true);
+    }
+
+    // The pages changed under the index, search them and rebuild later
+    NVOCMP_ALERT(FALSE, "Item index out of date.")
+    NVOCMP_indexValid = false;
+    return(false);
+}
+
+/******************************************************************************
+ * @fn      NVOCMP_indexAdd
+ *
+ * @brief   Record a newly written item in the item index
+ *
+ * @param   cid  - compressed ID
+ * @param   pg   - page of the item header
+ * @param   hofs - offset of the item header
+ * @param   len  - item data length
+ *
+ * @return  none
+ */
+static void NVOCMP_indexAdd(uint32_t cid, uint8_t pg, uint16_t hofs, uint16_t len)
+{
+    if(NVOCMP_indexValid)
+    {
+        (void)NVOCMP_indexPut(cid, pg, hofs, len);
+    }
+}
+
+/******************************************************************************
+ * @fn      NVOCMP_indexRemove
+ *
+ * @brief   Remove an item being marked inactive from the item index. If
+ *          the index points to another (newer) copy it is left alone.
+ *
+ * @param   pg   - page of the item header
+ * @param   hofs - offset of the item header
+ *
+ * @return  none
+ */
+static void NVOCMP_indexRemove(uint8_t pg, uint16_t hofs)
+{
+    NVOCMP_indexEntry_t *pEntry;
+    NVOCMP_itemHdr_t iHdr;
+    uint32_t mask = NVOCMP_indexSize - 1;
+    uint32_t i, j, k;
+
+    if(!NVOCMP_indexValid)
+    {
+        return;
+    }
+
+    NVOCMP_readHeader(pg, hofs, &iHdr, false);
+    pEntry = NVOCMP_indexSlot(iHdr.cmpid);
+    if((pEntry->cmpid != iHdr.cmpid) ||
+       (pEntry->hpage != pg) || (pEntry->hofs != hofs))
+    {
+        return;
+    }
+
+    // Linear probe delete, move later entries of the run back into the gap
+    i = pEntry - NVOCMP_index;
+    j = i;
+    for(;;)
+    {
+        j = (j + 1) & mask;
+        if(NVOCMP_index[j].cmpid == NVOCMP_INDEXFREE)
+        {
+            break;
+        }
+        k = NVOCMP_indexHash(NVOCMP_index[j].cmpid);
+        // Entry j stays if its home slot k is cyclically in (i, j]
+        if((i <= j) ? ((i < k) && (k <= j)) : ((i < k) || (k <= j)))
+        {
+            continue;
+        }
+        NVOCMP_index[i] = NVOCMP_index[j];
+        i = j;
+    }
+    NVOCMP_index[i].cmpid = NVOCMP_INDEXFREE;
+    NVOCMP_indexCount--;
+}
+
+/******************************************************************************
+ * @fn      NVOCMP_indexFindCont
+ *
+ * @brief   Look up the newest active item of a system and item ID with the
+ *          given content. Content within the first NVOCMP_INDEXHEAD bytes
+ *          is compared in the index, further in only the indexed items are
+ *          read, not the older copies in the pages. The item found is
+ *          checked.
+ *
+ * @param   pNvHandle - pointer to NV handle
+ * @param   pHdr  - system and item ID to match, filled in if found
+ * @param   pInfo - content to match, the item is read into pInfo->rBuf
+ * @param   pErr  - NVINTF_SUCCESS or NVINTF_NOTFOUND, when true is returned
+ *
+ * @return  true if answered, false if the pages must be searched instead
+ */
+static bool NVOCMP_indexFindCont(NVOCMP_nvHandle_t *pNvHandle,
+                                 NVOCMP_itemHdr_t *pHdr,
+                                 NVOCMP_itemInfo_t *pInfo, int8_t *pErr)
+{
+    NVOCMP_indexEntry_t *pEntry;
+    NVOCMP_indexEntry_t *pBest = NULL;
+    NVOCMP_itemHdr_t iHdr;
+    uint8_t buf[NVOCMP_XFERBLKMAX];
+    uint32_t key;
+    uint32_t i;
+    uint16_t ofs;
+    uint16_t len;
+    uint16_t n;
+    uint8_t dist;
+    uint8_t bestDist = 0;
+
+    if(!NVOCMP_indexEnable)
+    {
+        return(false);
+    }
+    if(!NVOCMP_indexValid)
+    {
+        NVOCMP_indexBuild(pNvHandle);
+        if(!NVOCMP_indexValid)
+        {
+            return(false);
+        }
+    }
+
+    key = NVOCMP_CMPRID(pHdr->sysid, pHdr->itemid, 0) >> NVOCMP_CMPSPACE;
+    for(i = 0; i < NVOCMP_indexSize; i++)
+    {
+        pEntry = &NVOCMP_index[i];
+        if((pEntry->cmpid == NVOCMP_INDEXFREE) ||
+           ((pEntry->cmpid >> NVOCMP_CMPSPACE) != key))
+        {
+            continue;
+        }
+
+        // Pages back from the active page, the page search order
+        dist = (uint8_t)((pNvHandle->actPage + NVOCMP_NVSIZE - pEntry->hpage) %
+                         NVOCMP_NVSIZE);
+        if(pBest && ((dist > bestDist) ||
+                     ((dist == bestDist) && (pEntry->hofs < pBest->hofs))))
+        {
+            // Found already in a newer item
+            continue;
+        }
+
+        // Compare the content in place, the data ends at the header
+        if((pInfo->rlength > pEntry->len) ||
+           (((uint32_t)pInfo->coff + pInfo->clength) > pEntry->len))
+        {
+            continue;
+        }
+        if(((uint32_t)pInfo->coff + pInfo->clength) <= NVOCMP_INDEXHEAD)
+        {
+            if(!memcmp(pEntry->head + pInfo->coff, pInfo->cBuf,
+                       pInfo->clength))
+            {
+                pBest = pEntry;
+                bestDist = dist;
+            }
+            continue;
+        }
+        ofs = pEntry->hofs - pEntry->len + pInfo->coff;
+        for(n = 0; n < pInfo->clength; n += len)
+        {
+            len = pInfo->clength - n;
+            len = (len < NVOCMP_XFERBLKMAX) ? len : NVOCMP_XFERBLKMAX;
+            NVOCMP_read(pEntry->hpage, ofs + n, buf, len);
+            if(memcmp(buf, (uint8_t *)pInfo->cBuf + n, len))
+            {
+                break;
+            }
+        }
+        if(n >= pInfo->clength)
+        {
+            pBest = pEntry;
+            bestDist = dist;
+        }
+    }
+
+    if(pBest == NULL)
+    {
+        pHdr->hofs = 0;
+        *pErr = NVINTF_NOTFOUND;
+        return(true);
+    }
+
+    NVOCMP_readHeader(pBest->hpage, pBest->hofs, &iHdr, false);
+    if(!(iHdr.stats & NVOCMP_ACTIVEIDBIT) ||
+        (iHdr.stats & NVOCMP_VALIDIDBIT) ||
+        (iHdr.cmpid != pBest->cmpid) || (iHdr.len != pBest->len) ||
+        NVOCMP_readItem(&iHdr, 0, pInfo->rlength, pInfo->rBuf, false))
+    {
+        NVOCMP_ALERT(FALSE, "Item index out of date.")
+        NVOCMP_indexValid = false;
+        return(false);
+    }
+    memcpy(pHdr, &iHdr, sizeof(NVOCMP_itemHdr_t));
+    *pErr = NVINTF_SUCCESS;
+    return(true);
+}
+
+/******************************************************************************
+ * @fn      NVOCMP_indexPage
+ *
+ * @brief   Move the item index to the copies a compaction pass made. The
+ *          items of the source pages (compactInfo xSrcSPage to xSrcEPage)
+ *          now on the destination page are pointed at their copy, so the
+ *          cost follows the page compacted, not the NV size.
+ *
+ * @param   pNvHandle - pointer to NV handle
+ * @param   dstPg - compaction destination page
+ *
+ * @return  none
+ */
+static void NVOCMP_indexPage(NVOCMP_nvHandle_t *pNvHandle, uint8_t dstPg)
+{
+    NVOCMP_indexEntry_t *pEntry;
+    NVOCMP_itemHdr_t iHdr;
+    uint8_t srcPg = pNvHandle->compactInfo.xSrcSPage;
+    uint8_t srcPages;
+    uint16_t ofs;
+
+    if(!NVOCMP_indexValid)
+    {
+        return;
+    }
+
+    srcPages = (uint8_t)((pNvHandle->compactInfo.xSrcEPage + NVOCMP_NVSIZE - srcPg) %
+                         NVOCMP_NVSIZE);
+
+    // Newest first, the same order as NVOCMP_indexBuild()
+    ofs = pNvHandle->pageInfo[dstPg].offset;
+    while(ofs >= (NVOCMP_PGDATAOFS + NVOCMP_ITEMHDRLEN))
+    {
+        ofs -= NVOCMP_ITEMHDRLEN;
+
+        NVOCMP_readHeader(dstPg, ofs, &iHdr, false);
+        if(!(iHdr.stats & NVOCMP_FOLLOWBIT) || (iHdr.len >= ofs))
+        {
+            NVOCMP_ALERT(FALSE, "Item index dropped, page corrupted.")
+            NVOCMP_indexValid = false;
+            return;
+        }
+
+        if((iHdr.stats & NVOCMP_ACTIVEIDBIT) &&
+          !(iHdr.stats & NVOCMP_VALIDIDBIT))
+        {
+            pEntry = NVOCMP_indexSlot(iHdr.cmpid);
+            // A newer copy outside the compacted pages keeps its entry
+            if((pEntry->cmpid == NVOCMP_INDEXFREE) ||
+               ((pEntry->hpage != dstPg) &&
+                (((pEntry->hpage + NVOCMP_NVSIZE - srcPg) % NVOCMP_NVSIZE) <= srcPages)))
+            {
+                if(!NVOCMP_indexPut(iHdr.cmpid, dstPg, ofs, iHdr.len))
+                {
+                    return;
+                }
+            }
+        }
+
+        ofs -= iHdr.len;
+    }
+}
+
+/******************************************************************************
+ * @fn      NVOCMP_indexErase
+ *
+ * @brief   Keep the item index over a page erase if no entry is on the
+ *          page, as after a compaction pass, else it is rebuilt later
+ *
+ * @param   pg - page being erased
+ *
+ * @return  none
+ */
+static void NVOCMP_indexErase(uint8_t pg)
+{
+    uint32_t i;
+
+    if(!NVOCMP_indexValid)
+    {
+        return;
+    }
+    for(i = 0; i < NVOCMP_indexSize; i++)
+    {
+        if((NVOCMP_index[i].cmpid != NVOCMP_INDEXFREE) &&
+           (NVOCMP_index[i].hpage == pg))
+        {
+            NVOCMP_indexValid = false;
+            return;
+        }
+    }
+}
+#endif
+
 /******************************************************************************
  * @fn      NVOCMP_findItem
  *
@@ -2930,6 +3660,24 @@ static int8_t NVOCMP_findItem(NVOCMP_nvHandle_t *pNvHandle, uint8_t pg, uint16_t
     uint8_t *pTBuffer = (uint8_t *)tBuffer;
 #endif
     uint32_t cid = NVOCMP_CMPRID(pHdr->sysid,pHdr->itemid,pHdr->subid);
+#if NVOCMP_ITEMINDEX
+    int8_t err;
+
+    // Newest copy of a specific item, the index knows where it is
+    if((flag == NVOCMP_FINDSTRICT) && (pg == pNvHandle->actPage) &&
+       (ofs == pNvHandle->actOffset) &&
+       NVOCMP_indexFind(pNvHandle, cid, pHdr, &err))
+    {
+        return(err);
+    }
+    // Newest item with the content, only the indexed items can match
+    if((flag == (NVOCMP_FINDITMID | NVOCMP_FINDCONTENT)) && (pInfo) &&
+       (pg == pNvHandle->actPage) && (ofs == pNvHandle->actOffset) &&
+       NVOCMP_indexFindCont(pNvHandle, pHdr, pInfo, &err))
+    {
+        return(err);
+    }
+#endif
 
 #ifdef NVOCMP_GPRAM
     NVOCMP_disableCache(&vm);
@@ -3078,6 +3826,24 @@ static int8_t NVOCMP_findItem(NVOCMP_nvHandle_t *pNvHandle, uint8_t pg, uint16_t
     uint16_t items = 0;
     uint16_t nvSearched = 0;
     uint32_t cid = NVOCMP_CMPRID(pHdr->sysid,pHdr->itemid,pHdr->subid);
+#if NVOCMP_ITEMINDEX
+    int8_t err;
+
+    // Newest copy of a specific item, the index knows where it is
+    if((flag == NVOCMP_FINDSTRICT) && (pg == pNvHandle->actPage) &&
+       (ofs == pNvHandle->actOffset) &&
+       NVOCMP_indexFind(pNvHandle, cid, pHdr, &err))
+    {
+        return(err);
+    }
+    // Newest item with the content, only the indexed items can match
+    if((flag == (NVOCMP_FINDITMID | NVOCMP_FINDCONTENT)) && (pInfo) &&
+       (pg == pNvHandle->actPage) && (ofs == pNvHandle->actOffset) &&
+       NVOCMP_indexFindCont(pNvHandle, pHdr, pInfo, &err))
+    {
+        return(err);
+    }
+#endif
 
     for(p = pg; nvSearched < NVOCMP_NVSIZE; p = NVOCMP_DECPAGE(p), ofs = pNvHandle->pageInfo[p].offset)
     {
@@ -3379,8 +4145,11 @@ static int16_t NVOCMP_compactPage(NVOCMP_nvHandle_t *pNvHandle, uint16_t nBytes)
 
     if(status == NVOCMP_COMPACT_FAILURE)
     {
+      NVOCMP_indexInvalidate();
       return(0);
     }
+    // Point the index at the copies before the source pages are erased
+    NVOCMP_indexPage(pNvHandle, dstPg);
 
     needBytes = nBytes ? nBytes : 16;
 
@@ -3491,6 +4260,8 @@ static int16_t NVOCMP_compactPage(NVOCMP_nvHandle_t *pNvHandle, uint16_t nBytes)
   NVOCMP_pageHdr_t pageHdr;
   uint8_t allActivePages = 0;
 
+  NVOCMP_indexInvalidate();
+
   srcPg = 0;
   dstPg = 0;
   pNvHandle->compactInfo.xSrcPages = 1;
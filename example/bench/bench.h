@@ -0,0 +1,87 @@
+/******************************************************************************
+ @file bench.h
+
+ @brief TIMAC 2.0 API benchmark tool header
+
+ Group: CMCU LPC
+ $Target Device: DEVICES $
+
+ ******************************************************************************
+ $License: BSD3 2019 $
+ ******************************************************************************
+ $Release Name: PACKAGE NAME $
+ $Release Date: PACKAGE RELEASE DATE $
+ *****************************************************************************/
+
+#if !defined(BENCH_H)
+#define BENCH_H
+
+/*!
+ * @brief Log the result of one benchmark step
+ * @param pName - the benchmark
+ * @param pWhat - what was measured
+ * @param tStart - TIMER_getNow() at the start
+ * @param nMsgs - number of messages handled
+ */
+void BENCH_log(const char *pName, const char *pWhat,
+               unsigned tStart, int nMsgs);
+
+/*!
+ * @brief Log the cost of the MT_MSG field readers and writers
+ * @param nLoops - messages decoded and encoded, 0 = default
+ * @returns 0 on success
+ *
+ * Decodes a data indication and encodes a data request with the
+ * API schemas, these are the most common messages with the most fields.
+ */
+int BENCH_fields(int nLoops);
+
+/*!
+ * @brief Log the per message AREQ dispatch cost
+ * @param nLoops - times each AREQ type is dispatched, 0 = default
+ * @returns 0 on success
+ *
+ * Each message goes through MT_MSG_rxInject() and
+ * ApiMac_processIncoming() to the real handlers, with and without the
+ * debug decode. Runs an interface of its own, no co-processor needed.
+ */
+int BENCH_dispatch(int nLoops);
+
+/*!
+ * @brief Log the NV item lookup cost versus the number of stored items,
+ *        with and without the NVOCMP item index
+ * @param maxItems - fill the NV up to this many items, 0 = default
+ * @returns 0 on success
+ *
+ * Uses a scratch NV file ("<filename>.bench"), in a child process.
+ * Call before anything starts a thread.
+ */
+int BENCH_nvIndex(int maxItems);
+
+/*!
+ * @brief Log the cost of storing a network of devices in NV and of
+ *        restoring it after a restart
+ * @param nDevices - number of devices, 0 = default (5000)
+ * @returns 0 on success, -1 if a device was not restored
+ *
+ * The [nv] backend and size are used, with scratch files
+ * ("<filename>.bench"). The devices are written in one child process
+ * and read back in another. Call before anything starts a thread.
+ */
+int BENCH_nvPersist(int nDevices);
+
+#endif
+
+/*
+ *  ========================================
+ *  Texas Instruments Micro Controller Style
+ *  ========================================
+ *  Local Variables:
+ *  mode: c
+ *  c-file-style: "bsd"
+ *  tab-width: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  End:
+ *  vim:set  filetype=c tabstop=4 shiftwidth=4 expandtab=true
+ */
@@ -0,0 +1,388 @@
+/******************************************************************************
+ @file bench_api_mac.c
+
+ @brief TIMAC 2.0 API benchmarks of the api mac message handling
+
+ Group: CMCU LPC
+ $Target Device: DEVICES $
+
+ ******************************************************************************
+ $License: BSD3 2019 $
+ ******************************************************************************
+ $Release Name: PACKAGE NAME $
+ $Release Date: PACKAGE RELEASE DATE $
+ *****************************************************************************/
+
+#include "compiler.h"
+#include "bench.h"
+
+#include "api_mac.h"
+#include "api_mac_linux.h"
+#include "mt_msg.h"
+#include "mt_msg_dbg.h"
+#include "mt_msg_schema.h"
+#include "log.h"
+#include "timer.h"
+#include "stream.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/*! Messages are laid out as on the uart, nothing is sent */
+static struct mt_msg_interface bench_iface = {
+    .dbg_name       = "bench",
+    .frame_sync     = true,
+    .include_chksum = true
+};
+
+/*! The AREQs dispatched, the ones the API decodes with a schema */
+static const uint8_t bench_areqs[][2] = {
+    { MAC_SYNC_LOSS_IND_cmd0,       MAC_SYNC_LOSS_IND_cmd1       },
+    { MAC_ASSOCIATE_IND_cmd0,       MAC_ASSOCIATE_IND_cmd1       },
+    { MAC_ASSOCIATE_CNF_cmd0,       MAC_ASSOCIATE_CNF_cmd1       },
+    { MAC_DATA_CNF_cmd0,            MAC_DATA_CNF_cmd1            },
+    { MAC_DATA_IND_cmd0,            MAC_DATA_IND_cmd1            },
+    { MAC_DISASSOCIATE_IND_cmd0,    MAC_DISASSOCIATE_IND_cmd1    },
+    { MAC_DISASSOCIATE_CNF_cmd0,    MAC_DISASSOCIATE_CNF_cmd1    },
+    { MAC_ORPHAN_IND_cmd0,          MAC_ORPHAN_IND_cmd1          },
+    { MAC_POLL_CNF_cmd0,            MAC_POLL_CNF_cmd1            },
+    { MAC_COMM_STATUS_IND_cmd0,     MAC_COMM_STATUS_IND_cmd1     },
+    { MAC_START_CNF_cmd0,           MAC_START_CNF_cmd1           },
+    { MAC_PURGE_CNF_cmd0,           MAC_PURGE_CNF_cmd1           },
+    { MAC_WS_ASYNC_CNF_cmd0,        MAC_WS_ASYNC_CNF_cmd1        },
+    { MAC_WS_ASYNC_IND_cmd0,        MAC_WS_ASYNC_IND_cmd1        },
+    { MAC_POLL_IND_cmd0,            MAC_POLL_IND_cmd1            }
+};
+
+/*! An AREQ the API does not know, given to an application handler */
+#define BENCH_CUSTOM_cmd0  0x4f
+#define BENCH_CUSTOM_cmd1  0xff
+
+/*! Messages are received here, nothing is ever written to it */
+static struct mt_msg_interface dispatch_iface = {
+    .dbg_name       = "bench",
+    .frame_sync     = true,
+    .include_chksum = true
+};
+
+/*! Handler calls seen */
+static int bench_n_data_ind;
+static int bench_n_custom;
+
+/*!
+ * @brief The data indication callback, only counts
+ * @param pDataInd - the indication
+ */
+static void bench_data_ind(ApiMac_mcpsDataInd_t *pDataInd)
+{
+    (void)(pDataInd);
+    bench_n_data_ind++;
+}
+
+/*!
+ * @brief The application AREQ handler, only counts
+ * @param pMsg - the message
+ * @param pCookie - not used
+ */
+static void bench_custom_areq(struct mt_msg *pMsg, void *pCookie)
+{
+    (void)(pMsg);
+    (void)(pCookie);
+    bench_n_custom++;
+}
+
+/*!
+ * @brief Dispatch each message nLoops times, as if it was received
+ * @param pWhat - what is measured
+ * @param ppMsgs - the messages, copied for each dispatch
+ * @param nMsgs - number of messages
+ * @param nLoops - how many times
+ * @returns number of handler calls missing
+ */
+static int bench_dispatch_step(const char *pWhat, struct mt_msg **ppMsgs,
+                               int nMsgs, int nLoops)
+{
+    struct mt_msg *pMsg;
+    unsigned tStart;
+    int loop;
+    int x;
+
+    bench_n_data_ind = 0;
+    bench_n_custom = 0;
+    tStart = TIMER_getNow();
+    for(loop = 0 ; loop < nLoops ; loop++)
+    {
+        for(x = 0 ; x < nMsgs ; x++)
+        {
+            pMsg = MT_MSG_clone(ppMsgs[x]);
+            if(pMsg == NULL)
+            {
+                return (nLoops);
+            }
+            MT_MSG_rxInject(&dispatch_iface, pMsg);
+            ApiMac_processIncoming();
+        }
+    }
+    BENCH_log("dispatch-benchmark", pWhat, tStart, nLoops * nMsgs);
+    return ((nLoops - bench_n_data_ind) + (nLoops - bench_n_custom));
+}
+
+/*
+  Log the per message AREQ dispatch cost
+
+  Public function defined in bench.h
+*/
+int BENCH_dispatch(int nLoops)
+{
+    static ApiMac_callbacks_t callbacks;
+    struct mt_msg_interface *pSaveIface;
+    struct mt_msg_schema *pSchema;
+    struct mt_msg *msgs[ 32 ];
+    struct mt_msg *pMsg;
+    logflags_t log_flags;
+    unsigned tStart;
+    FILE *fp;
+    int fds[2];
+    int errors;
+    int nMsgs;
+    int loop;
+    int len;
+    int x;
+
+    if(nLoops <= 0)
+    {
+        nLoops = 100000;
+    }
+
+    /* all msg-dbg-data is built in, for the decode */
+    ApiMacLinux_dbgAddSchemas();
+    MT_MSG_dbg_buildIndex(ALL_MT_MSG_DBG);
+
+    /* as ApiMac_init() would, registering builds the handler index */
+    if(ApiMacLinux_registerAreqHandler(BENCH_CUSTOM_cmd0, BENCH_CUSTOM_cmd1,
+                                       "bench-custom",
+                                       bench_custom_areq, NULL) != 0)
+    {
+        return (-1);
+    }
+    memset((void *)(&callbacks), 0, sizeof(callbacks));
+    callbacks.pDataIndCb = bench_data_ind;
+    ApiMac_registerCallbacks(&callbacks);
+
+    /* a real interface with an rx thread that never gets anything */
+    if(pipe(fds) != 0)
+    {
+        LOG_printf(LOG_ERROR, "dispatch-benchmark: no pipe\n");
+        return (-1);
+    }
+    fp = fdopen(fds[0], "r");
+    dispatch_iface.hndl = fp ? STREAM_createFpFile(fp) : 0;
+    if((dispatch_iface.hndl == 0) ||
+       (MT_MSG_interfaceCreate(&dispatch_iface) != 0))
+    {
+        LOG_printf(LOG_ERROR, "dispatch-benchmark: no interface\n");
+        close(fds[1]);
+        return (-1);
+    }
+    pSaveIface = API_MAC_msg_interface;
+    API_MAC_msg_interface = &dispatch_iface;
+
+    /* one message of each, all zero, the custom one is last */
+    nMsgs = 0;
+    for(x = 0 ; x <= (int)(sizeof(bench_areqs) / sizeof(bench_areqs[0])) ;
+        x++)
+    {
+        if(x < (int)(sizeof(bench_areqs) / sizeof(bench_areqs[0])))
+        {
+            pSchema = ApiMacLinux_findSchema(bench_areqs[x][0],
+                                             bench_areqs[x][1]);
+            if(pSchema == NULL)
+            {
+                continue;
+            }
+            pMsg = MT_MSG_alloc(pSchema->fixed_len,
+                                pSchema->cmd0, pSchema->cmd1);
+        }
+        else
+        {
+            pMsg = MT_MSG_alloc(16, BENCH_CUSTOM_cmd0, BENCH_CUSTOM_cmd1);
+        }
+        if(pMsg == NULL)
+        {
+            break;
+        }
+        MT_MSG_setDestIface(pMsg, &dispatch_iface);
+        MT_MSG_wrBuf(pMsg, NULL, pMsg->expected_len);
+        /* as received, the frame is valid up to the end of the payload */
+        pMsg->iobuf_nvalid = pMsg->iobuf_idx;
+        msgs[nMsgs++] = pMsg;
+    }
+
+    len = 0;
+    for(x = 0 ; x < nMsgs ; x++)
+    {
+        len += msgs[x]->expected_len;
+    }
+    LOG_printf(LOG_ALWAYS, "dispatch-benchmark: %d AREQ types, %d loops, "
+               "%d payload bytes\n", nMsgs, nLoops, len);
+
+    /* what the rx thread does before the dispatch */
+    tStart = TIMER_getNow();
+    for(loop = 0 ; loop < nLoops ; loop++)
+    {
+        for(x = 0 ; x < nMsgs ; x++)
+        {
+            MT_MSG_free(MT_MSG_clone(msgs[x]));
+        }
+    }
+    BENCH_log("dispatch-benchmark", "copy only", tStart, nLoops * nMsgs);
+
+    /* rx dispatch, rx_list, handler, callback, debug decode disabled */
+    log_flags = log_cfg.log_flags;
+    log_cfg.log_flags &= ~((logflags_t)LOG_DBG_MT_MSG_decode);
+    errors = bench_dispatch_step("dispatch, decode off",
+                                 msgs, nMsgs, nLoops);
+
+    /* debug decode enabled, this logs every message so do fewer */
+    nLoops = (nLoops / 1000) + 1;
+    log_cfg.log_flags |= LOG_DBG_MT_MSG_decode;
+    errors += bench_dispatch_step("dispatch, decode on (index)",
+                                  msgs, nMsgs, nLoops);
+
+    /* same without the decode index */
+    MT_MSG_dbg_freeIndex();
+    errors += bench_dispatch_step("dispatch, decode on (list)",
+                                  msgs, nMsgs, nLoops);
+    MT_MSG_dbg_buildIndex(ALL_MT_MSG_DBG);
+    log_cfg.log_flags = log_flags;
+
+    for(x = 0 ; x < nMsgs ; x++)
+    {
+        MT_MSG_free(msgs[x]);
+    }
+    API_MAC_msg_interface = pSaveIface;
+    ApiMac_registerCallbacks(NULL);
+    ApiMacLinux_registerAreqHandler(BENCH_CUSTOM_cmd0, BENCH_CUSTOM_cmd1,
+                                    NULL, NULL, NULL);
+    MT_MSG_interfaceDestroy(&dispatch_iface);
+    close(fds[1]);
+
+    if(errors)
+    {
+        LOG_printf(LOG_ERROR, "dispatch-benchmark: %d handler calls "
+                   "missing\n", errors);
+    }
+    return (errors ? -1 : 0);
+}
+
+/*
+  Log the cost of the MT_MSG field readers and writers
+
+  Public function defined in bench.h
+*/
+int BENCH_fields(int nLoops)
+{
+    static const uint8_t msdu[20] = { 0 };
+    struct mt_msg_schema *pInd;
+    struct mt_msg_schema *pReq;
+    ApiMac_mcpsDataInd_t ind;
+    ApiMac_mcpsDataReq_t req;
+    struct mt_msg *pMsg;
+    unsigned tStart;
+    int errors;
+    int loop;
+    int idx;
+    int len;
+
+    if(nLoops <= 0)
+    {
+        nLoops = 1000000;
+    }
+
+    pInd = ApiMacLinux_findSchema(MAC_DATA_IND_cmd0, MAC_DATA_IND_cmd1);
+    pReq = ApiMacLinux_findSchema(MAC_DATA_REQ_cmd0, MAC_DATA_REQ_cmd1);
+    if((pInd == NULL) || (pReq == NULL))
+    {
+        LOG_printf(LOG_ERROR, "fields-benchmark: no schema\n");
+        return (-1);
+    }
+
+    /* a data indication as the co-processor sends it */
+    memset((void *)(&ind), 0, sizeof(ind));
+    ind.srcAddr.addrMode = ApiMac_addrType_extended;
+    ind.srcAddr.addr.extAddr[0] = 0x01;
+    ind.srcAddr.addr.extAddr[5] = 0x4b;
+    ind.srcAddr.addr.extAddr[6] = 0x12;
+    ind.dstAddr.addrMode = ApiMac_addrType_short;
+    ind.msdu.len = sizeof(msdu);
+    ind.msdu.p = (uint8_t *)msdu;
+    pMsg = MT_MSG_alloc(pInd->fixed_len + sizeof(msdu),
+                        MAC_DATA_IND_cmd0, MAC_DATA_IND_cmd1);
+    if(pMsg == NULL)
+    {
+        return (-1);
+    }
+    MT_MSG_setDestIface(pMsg, &bench_iface);
+    MT_MSG_SCHEMA_encode(pMsg, pInd, &ind);
+    MT_MSG_setSrcIface(pMsg, &bench_iface);
+    idx = pMsg->iobuf_idx - pMsg->expected_len;
+
+    errors = 0;
+    tStart = TIMER_getNow();
+    for(loop = 0 ; loop < nLoops ; loop++)
+    {
+        pMsg->iobuf_idx = idx;
+        MT_MSG_SCHEMA_decode(pMsg, pInd, &ind);
+    }
+    BENCH_log("fields-benchmark", "decode data-ind", tStart, nLoops);
+    if(pMsg->is_error || (ind.msdu.len != sizeof(msdu)))
+    {
+        LOG_printf(LOG_ERROR, "fields-benchmark: data-ind decode error\n");
+        errors++;
+    }
+    MT_MSG_free(pMsg);
+
+    /* the data request, this includes the alloc & free */
+    memset((void *)(&req), 0, sizeof(req));
+    req.dstAddr.addrMode = ApiMac_addrType_short;
+    req.dstAddr.addr.shortAddr = 0x0001;
+    req.msdu.len = sizeof(msdu);
+    req.msdu.p = (uint8_t *)msdu;
+
+    tStart = TIMER_getNow();
+    for(loop = 0 ; loop < nLoops ; loop++)
+    {
+        len = MT_MSG_SCHEMA_encodedLen(pReq, &req);
+        pMsg = MT_MSG_alloc(len, pReq->cmd0, pReq->cmd1);
+        if(pMsg == NULL)
+        {
+            errors++;
+            break;
+        }
+        MT_MSG_setDestIface(pMsg, &bench_iface);
+        MT_MSG_SCHEMA_encode(pMsg, pReq, &req);
+        errors += pMsg->is_error;
+        MT_MSG_free(pMsg);
+    }
+    BENCH_log("fields-benchmark", "encode data-req", tStart, nLoops);
+    if(errors)
+    {
+        LOG_printf(LOG_ERROR, "fields-benchmark: %d errors\n", errors);
+    }
+    return (errors ? -1 : 0);
+}
+
+/*
+ *  ========================================
+ *  Texas Instruments Micro Controller Style
+ *  ========================================
+ *  Local Variables:
+ *  mode: c
+ *  c-file-style: "bsd"
+ *  tab-width: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  End:
+ *  vim:set  filetype=c tabstop=4 shiftwidth=4 expandtab=true
+ */
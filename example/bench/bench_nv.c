@@ -0,0 +1,637 @@
+/******************************************************************************
+ @file bench_nv.c
+
+ @brief TIMAC 2.0 API benchmarks of the NV drivers
+
+ Group: CMCU LPC
+ $Target Device: DEVICES $
+
+ ******************************************************************************
+ $License: BSD3 2019 $
+ ******************************************************************************
+ $Release Name: PACKAGE NAME $
+ $Release Date: PACKAGE RELEASE DATE $
+ *****************************************************************************/
+
+#include "compiler.h"
+#include "bench.h"
+
+#include "nvintf.h"
+#include "nvocmp.h"
+#include "nvlog.h"
+#include "nv_linux.h"
+#include "log.h"
+#include "timer.h"
+#include "fatal.h"
+#include "stream.h"
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#include <glob.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * The NV is initialized once in a process and keeps its files open, so
+ * each NV benchmark runs in a child process. Only a single threaded
+ * process is forked, see bench_nv_child(), so these run before anything
+ * else starts a thread.
+ */
+
+/* items use sub IDs 0..1023 of several item IDs */
+#define BENCH_NV_ITEM_ID   0x100
+
+/*
+ * Item index benchmark
+ * ====================
+ *
+ * The NV is filled with BENCH_NV_ITEM_LEN byte items, in steps, and at
+ * each step reads of stored items and lookups of missing items are
+ * timed with the NVOCMP item index and with the page search it
+ * replaces. The application's NV file is not used.
+ */
+#define BENCH_NV_ITEM_LEN  16
+/* missing items use this item ID */
+#define BENCH_NV_MISS_ID   0x3ff
+/* each measurement runs at least this long */
+#define BENCH_NV_MSECS     100
+
+/*!
+ * @brief Number of threads in this process
+ * @returns the count, -1 if not known
+ */
+static int bench_nv_nThreads(void)
+{
+    struct dirent *pDE;
+    DIR *pDir;
+    int n;
+
+    pDir = opendir("/proc/self/task");
+    if(pDir == NULL)
+    {
+        return (-1);
+    }
+    n = 0;
+    while((pDE = readdir(pDir)) != NULL)
+    {
+        if(pDE->d_name[0] != '.')
+        {
+            n++;
+        }
+    }
+    closedir(pDir);
+    return (n);
+}
+
+/*!
+ * @brief Run part of an NV benchmark in a child process
+ * @param pName - the benchmark, for the log
+ * @param pFn - what the child runs, returns 0 on success
+ * @param arg - its parameter
+ * @returns 0 if the child succeeded
+ */
+static int bench_nv_child(const char *pName, int (*pFn)(int), int arg)
+{
+    int status;
+    pid_t pid;
+
+    /* a forked thread would hold its locks forever in the child */
+    if(bench_nv_nThreads() != 1)
+    {
+        LOG_printf(LOG_ERROR, "%s: threads are running, cannot fork\n",
+                   pName);
+        return (-1);
+    }
+
+    fflush(NULL);
+    pid = fork();
+    if(pid < 0)
+    {
+        LOG_printf(LOG_ERROR, "%s: cannot fork\n", pName);
+        return (-1);
+    }
+    if(pid == 0)
+    {
+        status = (*pFn)(arg);
+        fflush(NULL);
+        _exit((status == 0) ? 0 : 1);
+    }
+    if((waitpid(pid, &status, 0) != pid) ||
+       !WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+    {
+        return (-1);
+    }
+    return (0);
+}
+
+/*!
+ * @brief Name of a file next to another
+ * @param pName - the other file
+ * @param pSuffix - added to pName
+ * @returns malloc'ed name, free with free()
+ */
+static char *bench_nv_fileName(const char *pName, const char *pSuffix)
+{
+    char *cp;
+    size_t n;
+
+    n = strlen(pName) + strlen(pSuffix) + 1;
+    cp = calloc(1, n);
+    if(cp == NULL)
+    {
+        FATAL_printf("no memory\n");
+    }
+    snprintf(cp, n, "%s%s", pName, pSuffix);
+    return (cp);
+}
+
+/*!
+ * @brief ID of the n'th benchmark item
+ * @param pId - set to the ID
+ * @param n - item number
+ */
+static void bench_nv_id(NVINTF_itemID_t *pId, int n)
+{
+    pId->systemID = NVINTF_SYSID_APP;
+    pId->itemID = BENCH_NV_ITEM_ID + (n >> 10);
+    pId->subID = n & 0x3ff;
+}
+
+/*!
+ * @brief Time lookups of benchmark items
+ * @param pNv - the NV functions
+ * @param nItems - number of items stored
+ * @param is_hit - true: read stored items, false: look for missing items
+ * @param pErrors - incremented for each wrong answer
+ * @returns nSecs per lookup
+ */
+static double bench_nv_lookups(NVINTF_nvFuncts_t *pNv, int nItems,
+                               bool is_hit, int *pErrors)
+{
+    NVINTF_itemID_t id;
+    uint8_t data[BENCH_NV_ITEM_LEN];
+    unsigned tStart;
+    unsigned mSecs;
+    uint32_t v;
+    int n;
+    int x;
+    int k;
+
+    n = 0;
+    tStart = TIMER_getNow();
+    do
+    {
+        for(x = 0 ; x < 64 ; x++, n++)
+        {
+            if(is_hit)
+            {
+                /* spread over the whole NV, old and new items */
+                k = (int)((n * 7919u) % nItems);
+                bench_nv_id(&id, k);
+                if(pNv->readItem(id, 0, sizeof(data), data) != NVINTF_SUCCESS)
+                {
+                    (*pErrors)++;
+                    continue;
+                }
+                v = ((uint32_t)(data[0]) << 0) | ((uint32_t)(data[1]) << 8) |
+                    ((uint32_t)(data[2]) << 16) | ((uint32_t)(data[3]) << 24);
+                if(v != (uint32_t)k)
+                {
+                    (*pErrors)++;
+                }
+            }
+            else
+            {
+                bench_nv_id(&id, 0);
+                id.itemID = BENCH_NV_MISS_ID;
+                id.subID = n & 0x3ff;
+                if(pNv->getItemLen(id) != 0)
+                {
+                    (*pErrors)++;
+                }
+            }
+        }
+        mSecs = TIMER_getNow() - tStart;
+    }
+    while(mSecs < BENCH_NV_MSECS);
+
+    return (((double)mSecs) * 1.0e6 / n);
+}
+
+/*!
+ * @brief The item index benchmark, in the child process
+ * @param maxItems - fill the NV up to this many items
+ * @returns 0 on success
+ */
+static int bench_nv_index(int maxItems)
+{
+    NVINTF_nvFuncts_t nv;
+    NVINTF_itemID_t id;
+    uint8_t data[BENCH_NV_ITEM_LEN];
+    const char *pSaveName;
+    bool saveRestore;
+    double t[4];
+    char *pName;
+    char *pJnl;
+    IArg key;
+    int nItems;
+    int target;
+    int errors;
+    int x;
+
+    /* a scratch NV, started empty */
+    pSaveName = NV_LINUX_getFilename();
+    saveRestore = linux_CONFIG_NV_RESTORE;
+    pName = bench_nv_fileName(pSaveName, ".bench");
+    pJnl = bench_nv_fileName(pName, ".jnl");
+    NV_LINUX_setFilename(pName);
+    linux_CONFIG_NV_RESTORE = false;
+
+    NVOCMP_loadApiPtrsExt(&nv);
+    if(nv.initNV(NULL) != NVINTF_SUCCESS)
+    {
+        LOG_printf(LOG_ERROR, "nv-benchmark: cannot init nv\n");
+        errors = 1;
+        goto done;
+    }
+
+    LOG_printf(LOG_ALWAYS, "nv-benchmark: %d byte items, nSecs per lookup, "
+               "index / page search\n", BENCH_NV_ITEM_LEN);
+
+    errors = 0;
+    nItems = 0;
+    target = 16;
+    for(;;)
+    {
+        if(target > maxItems)
+        {
+            target = maxItems;
+        }
+
+        /* fill up to the next step */
+        memset(data, 0x5a, sizeof(data));
+        while(nItems < target)
+        {
+            bench_nv_id(&id, nItems);
+            for(x = 0 ; x < 4 ; x++)
+            {
+                data[x] = (uint8_t)(nItems >> (x * 8));
+            }
+            if(nv.writeItem(id, sizeof(data), data) != NVINTF_SUCCESS)
+            {
+                LOG_printf(LOG_ALWAYS, "nv-benchmark: nv full at %d items\n",
+                           nItems);
+                maxItems = nItems;
+                break;
+            }
+            nItems++;
+        }
+        if(nItems == 0)
+        {
+            break;
+        }
+
+        t[0] = bench_nv_lookups(&nv, nItems, true, &errors);
+        t[2] = bench_nv_lookups(&nv, nItems, false, &errors);
+        key = nv.lockNV();
+        NVOCMP_setItemIndex(false);
+        nv.unlockNV(key);
+        t[1] = bench_nv_lookups(&nv, nItems, true, &errors);
+        t[3] = bench_nv_lookups(&nv, nItems, false, &errors);
+        key = nv.lockNV();
+        NVOCMP_setItemIndex(true);
+        nv.unlockNV(key);
+
+        LOG_printf(LOG_ALWAYS, "nv-benchmark: %5d items  read %7.1f / %9.1f"
+                   "  missing %7.1f / %9.1f\n",
+                   nItems, t[0], t[1], t[2], t[3]);
+
+        if(nItems >= maxItems)
+        {
+            break;
+        }
+        target *= 2;
+    }
+
+    if(errors)
+    {
+        LOG_printf(LOG_ERROR, "nv-benchmark: %d wrong lookups\n", errors);
+    }
+
+    /* everything is on disk, nothing is written after this */
+    NV_LINUX_sync();
+
+done:
+    /* done with the scratch NV */
+    (void)unlink(pName);
+    (void)unlink(pJnl);
+    NV_LINUX_setFilename(pSaveName);
+    linux_CONFIG_NV_RESTORE = saveRestore;
+    free(pJnl);
+    free(pName);
+    return (errors ? -1 : 0);
+}
+
+/*
+  Log the NV lookup cost versus the number of items
+
+  Public function defined in bench.h
+*/
+int BENCH_nvIndex(int maxItems)
+{
+    if(maxItems <= 0)
+    {
+        maxItems = 1000;
+    }
+    return (bench_nv_child("nv-benchmark", bench_nv_index, maxItems));
+}
+
+/*
+ * Persistence benchmark
+ * =====================
+ *
+ * A network of nDevices devices is stored the way the collector stores
+ * its device list: one BENCH_NV_PERSIST_LEN byte item per device, found
+ * by ID or by extended address (readContItem). A child process creates
+ * the items, updates each one BENCH_NV_PERSIST_ROUNDS times (the frame
+ * counter), syncs and exits. Another then restarts from the files and
+ * reads every device back by ID and by address. The NV backend and
+ * size are the [nv] settings, the files are scratch copies
+ * ("<filename>.bench") removed at the end.
+ */
+#define BENCH_NV_PERSIST_LEN     24
+/* offset of the extended address in the item, as in the device list */
+#define BENCH_NV_PERSIST_EXT_OFS 4
+#define BENCH_NV_PERSIST_ROUNDS  4
+
+/*!
+ * @brief Fill in the NV item of a device
+ * @param pData - BENCH_NV_PERSIST_LEN bytes
+ * @param n - device number
+ * @param counter - frame counter
+ */
+static void bench_nv_persistItem(uint8_t *pData, int n, uint32_t counter)
+{
+    int x;
+
+    memset(pData, 0, BENCH_NV_PERSIST_LEN);
+    /* pan id, short address */
+    pData[0] = 0x34;
+    pData[1] = 0x12;
+    pData[2] = (uint8_t)(n >> 0);
+    pData[3] = (uint8_t)(n >> 8);
+    /* extended address, 00:12:4b:00:xx:xx:xx:xx */
+    for(x = 0 ; x < 4 ; x++)
+    {
+        pData[BENCH_NV_PERSIST_EXT_OFS + x] = (uint8_t)(n >> (x * 8));
+    }
+    pData[BENCH_NV_PERSIST_EXT_OFS + 5] = 0x4b;
+    pData[BENCH_NV_PERSIST_EXT_OFS + 6] = 0x12;
+    /* frame counter */
+    for(x = 0 ; x < 4 ; x++)
+    {
+        pData[BENCH_NV_PERSIST_LEN - 4 + x] = (uint8_t)(counter >> (x * 8));
+    }
+}
+
+/*!
+ * @brief Remove the scratch files of the persistence benchmark
+ */
+static void bench_nv_persistClean(void)
+{
+    glob_t g;
+    char *pName;
+    size_t x;
+
+    pName = bench_nv_fileName(NV_LINUX_getFilename(), "");
+    (void)unlink(pName);
+    free(pName);
+    pName = bench_nv_fileName(NV_LINUX_getFilename(), ".jnl");
+    (void)unlink(pName);
+    free(pName);
+
+    pName = bench_nv_fileName(NVLOG_cfg.filename, ".[0-9]*");
+    if(glob(pName, 0, NULL, &g) == 0)
+    {
+        for(x = 0 ; x < g.gl_pathc ; x++)
+        {
+            (void)unlink(g.gl_pathv[x]);
+        }
+        globfree(&g);
+    }
+    free(pName);
+}
+
+/*!
+ * @brief Create and update the devices, in the child process
+ * @param nDevices - number of devices
+ * @returns 0 on success
+ */
+static int bench_nv_persistWrite(int nDevices)
+{
+    NVINTF_nvFuncts_t nv;
+    NVINTF_itemID_t id;
+    uint8_t data[BENCH_NV_PERSIST_LEN];
+    unsigned tStart;
+    unsigned mSecs;
+    int round;
+    int n;
+
+    linux_CONFIG_NV_RESTORE = false;
+    NV_LINUX_loadApiPtrs(&nv);
+    if(nv.initNV(NULL) != NVINTF_SUCCESS)
+    {
+        LOG_printf(LOG_ERROR, "nv-persist: cannot init nv\n");
+        return (-1);
+    }
+
+    for(round = 0 ; round <= BENCH_NV_PERSIST_ROUNDS ; round++)
+    {
+        tStart = TIMER_getNow();
+        for(n = 0 ; n < nDevices ; n++)
+        {
+            bench_nv_id(&id, n);
+            bench_nv_persistItem(data, n, round);
+            if(((round == 0) ?
+                nv.createItem(id, sizeof(data), data) :
+                nv.updateItem(id, sizeof(data), data)) != NVINTF_SUCCESS)
+            {
+                LOG_printf(LOG_ERROR, "nv-persist: nv full at device %d, "
+                           "round %d\n", n, round);
+                return (-1);
+            }
+        }
+        (void)nv.syncNV();
+        mSecs = TIMER_getNow() - tStart;
+        LOG_printf(LOG_ALWAYS, "nv-persist: %s %d devices: %6u mSecs, "
+                   "%7.1f uSecs per device\n",
+                   (round == 0) ? "create" : "update", nDevices, mSecs,
+                   ((double)mSecs) * 1000.0 / nDevices);
+    }
+    return (0);
+}
+
+/*!
+ * @brief Restart from the files and read the devices back, in the
+ *        child process
+ * @param nDevices - number of devices
+ * @returns 0 on success
+ */
+static int bench_nv_persistRead(int nDevices)
+{
+    NVINTF_nvFuncts_t nv;
+    NVINTF_itemID_t id;
+    struct nvlog_stats stats;
+    NVS_Attrs attrs;
+    uint8_t data[BENCH_NV_PERSIST_LEN];
+    uint8_t want[BENCH_NV_PERSIST_LEN];
+    uint16_t subId;
+    unsigned tStart;
+    unsigned mSecs[3];
+    char *pName;
+    int64_t diskBytes;
+    int errors;
+    int n;
+
+    /* restart, load the files and find the first device */
+    linux_CONFIG_NV_RESTORE = true;
+    errors = 0;
+    tStart = TIMER_getNow();
+    NV_LINUX_loadApiPtrs(&nv);
+    if(nv.initNV(NULL) != NVINTF_SUCCESS)
+    {
+        LOG_printf(LOG_ERROR, "nv-persist: cannot restart nv\n");
+        return (-1);
+    }
+    bench_nv_id(&id, 0);
+    (void)nv.getItemLen(id);
+    mSecs[0] = TIMER_getNow() - tStart;
+
+    /* every device by ID */
+    tStart = TIMER_getNow();
+    for(n = 0 ; n < nDevices ; n++)
+    {
+        bench_nv_id(&id, n);
+        bench_nv_persistItem(want, n, BENCH_NV_PERSIST_ROUNDS);
+        if((nv.readItem(id, 0, sizeof(data), data) != NVINTF_SUCCESS) ||
+           memcmp(data, want, sizeof(data)))
+        {
+            errors++;
+        }
+    }
+    mSecs[1] = TIMER_getNow() - tStart;
+
+    /* every device by extended address */
+    tStart = TIMER_getNow();
+    for(n = 0 ; n < nDevices ; n++)
+    {
+        bench_nv_id(&id, n);
+        id.subID = 0;
+        bench_nv_persistItem(want, n, BENCH_NV_PERSIST_ROUNDS);
+        if((nv.readContItem(id, 0, sizeof(data), data, 8,
+                            BENCH_NV_PERSIST_EXT_OFS,
+                            want + BENCH_NV_PERSIST_EXT_OFS,
+                            &subId) != NVINTF_SUCCESS) ||
+           (subId != (n & 0x3ff)) || memcmp(data, want, sizeof(data)))
+        {
+            errors++;
+        }
+    }
+    mSecs[2] = TIMER_getNow() - tStart;
+
+    if(NV_LINUX_isLog())
+    {
+        NVLOG_getStats(&stats);
+        diskBytes = (int64_t)stats.total_bytes;
+        LOG_printf(LOG_ALWAYS, "nv-persist: log backend, segments of %u "
+                   "bytes\n", NVLOG_cfg.segment_bytes);
+    }
+    else
+    {
+        NV_LINUX_sync();
+        pName = bench_nv_fileName(NV_LINUX_getFilename(), ".jnl");
+        diskBytes = STREAM_FS_getSize(NV_LINUX_getFilename()) +
+            STREAM_FS_getSize(pName);
+        free(pName);
+        NV_LINUX_getAttrs(&attrs);
+        LOG_printf(LOG_ALWAYS, "nv-persist: flash backend, %u pages of %u "
+                   "bytes\n", (unsigned)(attrs.regionSize / attrs.sectorSize),
+                   (unsigned)(attrs.sectorSize));
+    }
+
+    LOG_printf(LOG_ALWAYS, "nv-persist: restart: %u mSecs, %lld bytes on "
+               "disk\n", mSecs[0], (long long)diskBytes);
+    LOG_printf(LOG_ALWAYS, "nv-persist: read by id: %7.1f uSecs per device, "
+               "by address: %7.1f uSecs per device\n",
+               ((double)mSecs[1]) * 1000.0 / nDevices,
+               ((double)mSecs[2]) * 1000.0 / nDevices);
+    if(errors)
+    {
+        LOG_printf(LOG_ERROR, "nv-persist: %d devices wrong\n", errors);
+    }
+    NV_LINUX_sync();
+    return (errors ? -1 : 0);
+}
+
+/*
+  Log the cost of storing and restoring a large network
+
+  Public function defined in bench.h
+*/
+int BENCH_nvPersist(int nDevices)
+{
+    const char *pSaveName;
+    const char *pSaveLog;
+    bool saveRestore;
+    char *pName;
+    char *pLogName;
+    int r;
+
+    if(nDevices <= 0)
+    {
+        nDevices = 5000;
+    }
+
+    /* scratch files, started empty */
+    pSaveName = NV_LINUX_getFilename();
+    pSaveLog = NVLOG_cfg.filename;
+    saveRestore = linux_CONFIG_NV_RESTORE;
+    pName = bench_nv_fileName(pSaveName, ".bench");
+    pLogName = bench_nv_fileName(pSaveLog, ".bench");
+    NV_LINUX_setFilename(pName);
+    NVLOG_cfg.filename = pLogName;
+    bench_nv_persistClean();
+
+    /* write and restart in different processes, a real restart */
+    r = bench_nv_child("nv-persist", bench_nv_persistWrite, nDevices);
+    if(r == 0)
+    {
+        r = bench_nv_child("nv-persist", bench_nv_persistRead, nDevices);
+    }
+
+    /* done with the scratch files */
+    bench_nv_persistClean();
+    NV_LINUX_setFilename(pSaveName);
+    NVLOG_cfg.filename = pSaveLog;
+    linux_CONFIG_NV_RESTORE = saveRestore;
+    free(pLogName);
+    free(pName);
+    return (r);
+}
+
+/*
+ *  ========================================
+ *  Texas Instruments Micro Controller Style
+ *  ========================================
+ *  Local Variables:
+ *  mode: c
+ *  c-file-style: "bsd"
+ *  tab-width: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  End:
+ *  vim:set  filetype=c tabstop=4 shiftwidth=4 expandtab=true
+ */
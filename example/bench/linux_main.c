@@ -0,0 +1,565 @@
+/******************************************************************************
+ @file linux_main.c
+
+ @brief TIMAC 2.0 API Linux "main" for the benchmark tool
+
+ Group: CMCU LPC
+ $Target Device: DEVICES $
+
+ ******************************************************************************
+ $License: BSD3 2019 $
+ ******************************************************************************
+ $Release Name: PACKAGE NAME $
+ $Release Date: PACKAGE RELEASE DATE $
+ *****************************************************************************/
+
+/*
+ * Overview
+ * ========
+ *
+ * Runs the benchmarks selected in the [bench] section, see bench.cfg,
+ * then exits. From the other sections only [log], [nv], the links to
+ * the co-processor ([uart-cfg], [uart-interface], [npi-socket-cfg],
+ * [npi-socket-interface]) and the [application] interface are used,
+ * so the collector's own file can come first, for example:
+ *
+ *    bash$ ./host_bench ../collector/collector.cfg bench.cfg
+ *
+ * The loopback benchmark writes to stdout (or loopback-benchmark-output),
+ * the others write to the log.
+ */
+
+#include "compiler.h"
+#include "bench.h"
+
+#include "api_mac.h"
+#include "api_mac_linux.h"
+#include "mt_msg.h"
+#include "ini_file.h"       /* this reads our ini file */
+#include "log.h"            /* our logging scheme */
+#include "timer.h"
+#include "fatal.h"
+#include "stream.h"
+#include "stream_socket.h"
+#include "stream_uart.h"
+#include "nv_linux.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+const struct ini_flag_name * const log_flag_names[] = {
+    /* See log.h */
+    log_builtin_flag_names,
+    /* see mt_msg.h */
+    mt_msg_log_flags,
+    /* see nv_linux.h */
+    nv_log_flags,
+    /* See api_mac_linux.h */
+    api_mac_log_flags,
+    /* Terminate */
+    NULL
+};
+
+/*! The interface the API mac uses, points to either the socket or the uart */
+struct mt_msg_interface *API_MAC_msg_interface;
+/*! Configuration for the link to an npi server */
+static struct socket_cfg npi_socket_cfg;
+/*! Configuration for the link to a uart */
+static struct uart_cfg   uart_cfg;
+
+/*! Link to the co-processor through a uart, as in the collector */
+static struct mt_msg_interface uart_mt_interface = {
+    .dbg_name                  = "uart",
+    .is_NPI                    = false,
+    .frame_sync                = true,
+    .include_chksum            = true,
+    .hndl                      = 0,
+    .s_cfg                     = NULL,
+    .u_cfg                     = &uart_cfg,
+    .rx_thread                 = 0,
+    .tx_frag_size              = 0,
+    .retry_max                 = 0,
+    .frag_timeout_mSecs        = 10000,
+    .intermsg_timeout_mSecs    = 10000,
+    .intersymbol_timeout_mSecs = 100,
+    .srsp_timeout_mSecs        = 300,
+    .stack_id                  = 0,
+    .len_2bytes                = true,
+    .rx_handler_cookie         = 0,
+    .is_dead                   = false,
+    .flush_timeout_mSecs       = 100
+};
+
+/*! Link to the co-processor through an npi server, as in the collector */
+static struct mt_msg_interface npi_mt_interface = {
+    .dbg_name                  = "npi",
+    .is_NPI                    = false,
+    .frame_sync                = true,
+    .include_chksum            = true,
+    .hndl                      = 0,
+    .s_cfg                     = &npi_socket_cfg,
+    .u_cfg                     = NULL,
+    .rx_thread                 = 0,
+    .tx_frag_size              = 0,
+    .retry_max                 = 0,
+    .frag_timeout_mSecs        = 10000,
+    .intermsg_timeout_mSecs    = 10000,
+    .intersymbol_timeout_mSecs = 100,
+    .srsp_timeout_mSecs        = 300,
+    .stack_id                  = 0,
+    .len_2bytes                = true,
+    .rx_handler_cookie         = 0,
+    .is_dead                   = false,
+    .flush_timeout_mSecs       = 100
+};
+
+/*! If non-zero, run BENCH_fields() */
+static int fields_benchmark_loops;
+
+/*! If non-zero, run BENCH_dispatch() */
+static int dispatch_benchmark_loops;
+
+/*! If non-zero, run BENCH_nvIndex() */
+static int nv_benchmark_items;
+
+/*! If non-zero, run BENCH_nvPersist() */
+static int nv_persist_benchmark_devices;
+
+/*! If non-zero, run MT_MSG_loopbackBenchmark(), 'c'sv or 'j'son */
+static int loopback_benchmark_format;
+/*! Transport for the loopback benchmark, NULL means "interface" */
+static const char *loopback_benchmark_transport;
+/*! Payload sizes for the loopback benchmark */
+static int loopback_benchmark_sizes[16] = { 0, 16, 64, 128, 200 };
+static int loopback_benchmark_n_sizes = 5;
+/*! Pipeline depths for the loopback benchmark */
+static int loopback_benchmark_depths[8] = { 1, 2, 4 };
+static int loopback_benchmark_n_depths = 3;
+/*! Loopback requests for each (size, depth) point */
+static int loopback_benchmark_count = 1000;
+/*! Where the loopback benchmark results go, NULL means stdout */
+static const char *loopback_benchmark_output;
+/*! Local port used by the in-process loopback benchmark */
+static const char *loopback_benchmark_port = "45123";
+
+/*
+  Log the result of one benchmark step
+
+  Public function defined in bench.h
+*/
+void BENCH_log(const char *pName, const char *pWhat,
+               unsigned tStart, int nMsgs)
+{
+    unsigned mSecs;
+
+    mSecs = TIMER_getNow() - tStart;
+    LOG_printf(LOG_ALWAYS, "%s: %-28s %9d msgs %6u mSecs "
+               "%8.1f nSecs/msg\n",
+               pName, pWhat, nMsgs, mSecs,
+               (nMsgs > 0) ? (((double)mSecs) * 1.0e6 / nMsgs) : 0.0);
+}
+
+/*!
+ * Parse a list of numbers from the configuration file
+ *
+ * @param pINI - ini file parse info
+ * @param pList - where to put the numbers
+ * @param max - size of pList
+ * @returns number of items, or -1 on error
+ */
+static int do_numlist(struct ini_parser *pINI, int *pList, int max)
+{
+    struct ini_numlist nl;
+    int n;
+
+    n = 0;
+    INI_valueAsNumberList_init(&nl, pINI);
+    while(INI_valueAsNumberList_next(&nl) != EOF)
+    {
+        if(n >= max)
+        {
+            INI_syntaxError(pINI, "too-many-numbers (max: %d)\n", max);
+            return -1;
+        }
+        pList[n] = nl.value;
+        n++;
+    }
+    if((n == 0) || nl.is_error)
+    {
+        INI_syntaxError(pINI, "invalid-number-list\n");
+        return -1;
+    }
+    return n;
+}
+
+/*!
+ * @brief Handle the settings for the links to the co-processor
+ *
+ * @param pINI - ini file parse info
+ * @param handled - set to true if the item was handled
+ * @return 0 success, -1 error
+ */
+static int my_LINK_INI_settings(struct ini_parser *pINI, bool *handled)
+{
+    if(INI_itemMatches(pINI, "uart-cfg", NULL))
+    {
+        return UART_INI_settingsOne(pINI, handled, &uart_cfg);
+    }
+    if(INI_itemMatches(pINI, "npi-socket-cfg", NULL))
+    {
+        return SOCKET_INI_settingsOne(pINI, handled, &npi_socket_cfg);
+    }
+    if(INI_itemMatches(pINI, "uart-interface", NULL))
+    {
+        return MT_MSG_INI_settings(pINI, handled, &uart_mt_interface);
+    }
+    if(INI_itemMatches(pINI, "npi-socket-interface", NULL))
+    {
+        return MT_MSG_INI_settings(pINI, handled, &npi_mt_interface);
+    }
+    if(INI_itemMatches(pINI, "application", "interface"))
+    {
+        if(0 == strcmp("socket", pINI->item_value))
+        {
+            API_MAC_msg_interface = &npi_mt_interface;
+        }
+        if(0 == strcmp("uart", pINI->item_value))
+        {
+            API_MAC_msg_interface = &uart_mt_interface;
+        }
+    }
+    return 0;
+}
+
+
+/*!
+ * @brief Handle the [bench] settings
+ *
+ * @param pINI - ini file parse info
+ * @param handled - set to true if the item was handled
+ * @return 0 success, -1 error
+ */
+static int my_BENCH_settings(struct ini_parser *pINI, bool *handled)
+{
+    if(!INI_itemMatches(pINI, "bench", NULL))
+    {
+        return 0;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "fields-benchmark-loops"))
+    {
+        fields_benchmark_loops = INI_valueAsInt(pINI);
+        *handled = true;
+        return 0;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "dispatch-benchmark-loops"))
+    {
+        dispatch_benchmark_loops = INI_valueAsInt(pINI);
+        *handled = true;
+        return 0;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "nv-benchmark-items"))
+    {
+        nv_benchmark_items = INI_valueAsInt(pINI);
+        *handled = true;
+        return 0;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "nv-persist-benchmark-devices"))
+    {
+        nv_persist_benchmark_devices = INI_valueAsInt(pINI);
+        *handled = true;
+        return 0;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "loopback-benchmark"))
+    {
+        *handled = true;
+        if(0 == strcmp("csv", pINI->item_value))
+        {
+            loopback_benchmark_format = 'c';
+            return 0;
+        }
+        if(0 == strcmp("json", pINI->item_value))
+        {
+            loopback_benchmark_format = 'j';
+            return 0;
+        }
+        if(0 == strcmp("off", pINI->item_value))
+        {
+            loopback_benchmark_format = 0;
+            return 0;
+        }
+        INI_syntaxError(pINI, "expected: csv, json or off\n");
+        return -1;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "loopback-benchmark-transport"))
+    {
+        *handled = true;
+        if((0 == strcmp("uart", pINI->item_value)) ||
+           (0 == strcmp("socket", pINI->item_value)) ||
+           (0 == strcmp("inproc", pINI->item_value)))
+        {
+            loopback_benchmark_transport = INI_itemValue_strdup(pINI);
+            return 0;
+        }
+        INI_syntaxError(pINI, "expected: uart, socket or inproc\n");
+        return -1;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "loopback-benchmark-sizes"))
+    {
+        *handled = true;
+        loopback_benchmark_n_sizes =
+            do_numlist(pINI, loopback_benchmark_sizes,
+                       (int)(sizeof(loopback_benchmark_sizes) /
+                             sizeof(loopback_benchmark_sizes[0])));
+        return (loopback_benchmark_n_sizes < 0) ? -1 : 0;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "loopback-benchmark-depths"))
+    {
+        *handled = true;
+        loopback_benchmark_n_depths =
+            do_numlist(pINI, loopback_benchmark_depths,
+                       (int)(sizeof(loopback_benchmark_depths) /
+                             sizeof(loopback_benchmark_depths[0])));
+        return (loopback_benchmark_n_depths < 0) ? -1 : 0;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "loopback-benchmark-count"))
+    {
+        loopback_benchmark_count = INI_valueAsInt(pINI);
+        *handled = true;
+        return 0;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "loopback-benchmark-output"))
+    {
+        INI_dequote(pINI);
+        loopback_benchmark_output = INI_itemValue_strdup(pINI);
+        *handled = true;
+        return 0;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "loopback-benchmark-port"))
+    {
+        loopback_benchmark_port = INI_itemValue_strdup(pINI);
+        *handled = true;
+        return 0;
+    }
+
+
+    return 0;
+}
+
+/*!
+ * @brief Run the loopback benchmark with the configured settings
+ * @returns 0 if every loopback succeeded
+ */
+static int run_loopback_benchmark(void)
+{
+    struct mt_msg_loopback_bench_cfg cfg;
+    struct mt_msg_interface *pMI;
+    int r;
+
+    memset((void *)(&cfg), 0, sizeof(cfg));
+    cfg.pSizes = loopback_benchmark_sizes;
+    cfg.n_sizes = loopback_benchmark_n_sizes;
+    cfg.pDepths = loopback_benchmark_depths;
+    cfg.n_depths = loopback_benchmark_n_depths;
+    cfg.n_msgs = loopback_benchmark_count;
+    cfg.seed = 0x1234;
+    cfg.format = loopback_benchmark_format;
+    cfg.hOut = STREAM_stdout;
+    if(loopback_benchmark_output)
+    {
+        cfg.hOut = STREAM_createWrFile(loopback_benchmark_output);
+        if(cfg.hOut == 0)
+        {
+            FATAL_printf("Cannot create: %s\n", loopback_benchmark_output);
+        }
+    }
+
+    /* default to the interface the application would use */
+    pMI = API_MAC_msg_interface;
+    cfg.transport = (pMI == &npi_mt_interface) ? "socket" : "uart";
+    if(loopback_benchmark_transport)
+    {
+        cfg.transport = loopback_benchmark_transport;
+    }
+
+    if(0 == strcmp("inproc", cfg.transport))
+    {
+        /* both ends are ours, frame them like the npi socket */
+        r = MT_MSG_loopbackBenchmarkInproc(&npi_mt_interface,
+                                           loopback_benchmark_port,
+                                           &cfg);
+    }
+    else
+    {
+        if(0 == strcmp("socket", cfg.transport))
+        {
+            pMI = &npi_mt_interface;
+        }
+        else
+        {
+            pMI = &uart_mt_interface;
+        }
+        if(MT_MSG_interfaceCreate(pMI) != 0)
+        {
+            FATAL_printf("Cannot create %s interface\n", cfg.transport);
+        }
+        r = MT_MSG_loopbackBenchmark(pMI, &cfg);
+        MT_MSG_interfaceDestroy(pMI);
+    }
+
+    if(loopback_benchmark_output)
+    {
+        STREAM_close(cfg.hOut);
+    }
+    return r;
+}
+
+/* Callback for parsing the INI file. */
+static int cfg_callback(struct ini_parser *pINI, bool *handled)
+{
+    int x;
+    int r;
+
+    static ini_rd_callback * const ini_cb_table[] = {
+        LOG_INI_settings,
+        my_LINK_INI_settings,
+        NV_LINUX_INI_settings,
+        my_BENCH_settings,
+        /* Terminate list */
+        NULL
+    };
+
+    for(x = 0 ; ini_cb_table[x] ; x++)
+    {
+        r = (*(ini_cb_table[x]))(pINI, handled);
+        if(*handled)
+        {
+            return r;
+        }
+    }
+
+    if(INI_itemMatches(pINI, "bench", NULL))
+    {
+        /* an unknown [bench] item is an error, not a skipped benchmark */
+        return 0;
+    }
+
+    /* the rest is for the collector */
+    *handled = true;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int nRun;
+    int nFailed;
+    int r;
+    int x;
+    char *cfg_filenames[3];
+
+    if(argc == 1)
+    {
+        /* Use default config filename */
+        cfg_filenames[0] = argv[0];
+        cfg_filenames[1] = "bench.cfg";
+        cfg_filenames[2] = NULL;
+
+        argc = 2;
+        argv = cfg_filenames;
+    }
+
+    /* Basic initialization */
+    SOCKET_init();
+    STREAM_init();
+    TIMER_init();
+    LOG_init("/dev/stderr");
+    log_cfg.log_flags = LOG_FATAL | LOG_WARN | LOG_ERROR;
+
+    API_MAC_msg_interface = &uart_mt_interface;
+
+    /* Read all configuration files, later files win */
+    for(x = 1 ; x < argc ; x++)
+    {
+        r = INI_read(argv[x], cfg_callback, 0);
+        if(r != 0)
+        {
+            FATAL_printf("Failed to read cfg file\n");
+        }
+    }
+
+    MT_MSG_init();
+
+    nRun = 0;
+    nFailed = 0;
+
+    /* first, these fork and need a single threaded process */
+    if(nv_benchmark_items)
+    {
+        r = BENCH_nvIndex(nv_benchmark_items);
+        nFailed += (r != 0);
+        nRun++;
+    }
+    if(nv_persist_benchmark_devices)
+    {
+        r = BENCH_nvPersist(nv_persist_benchmark_devices);
+        nFailed += (r != 0);
+        nRun++;
+    }
+
+    /* the field readers & writers, see MT_MSG_FAST_FIELDS */
+    if(fields_benchmark_loops)
+    {
+        r = BENCH_fields(fields_benchmark_loops);
+        nFailed += (r != 0);
+        nRun++;
+    }
+
+    /* received AREQs through the rx path to the ApiMac callbacks */
+    if(dispatch_benchmark_loops)
+    {
+        r = BENCH_dispatch(dispatch_benchmark_loops);
+        nFailed += (r != 0);
+        nRun++;
+    }
+
+    /* the link to the co-processor */
+    if(loopback_benchmark_format)
+    {
+        r = run_loopback_benchmark();
+        nFailed += (r != 0);
+        nRun++;
+    }
+
+    if(nRun == 0)
+    {
+        fprintf(stderr, "%s: nothing to do, see [bench] in bench.cfg\n",
+                argv[0]);
+        exit(1);
+    }
+    exit((nFailed == 0) ? 0 : 1);
+}
+
+/*
+ *  ========================================
+ *  Texas Instruments Micro Controller Style
+ *  ========================================
+ *  Local Variables:
+ *  mode: c
+ *  c-file-style: "bsd"
+ *  tab-width: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  End:
+ *  vim:set  filetype=c tabstop=4 shiftwidth=4 expandtab=true
+ */
@@ -363,6 +363,47 @@ static void appsrv_processSetJoinPermitReq(struct appsrv_connection *pCONN,
     send_AppSrvJoinPermitCnf(status);
     }
 
+/*!
+ * @brief handle a (debug) latency request from the gateway
+ * @param pCONN - where the request came from
+ *
+ * The reply holds the latency histograms of the MAC interface:
+ * count, then per histogram: id, count, mean, p50, p99, max (uSecs)
+ */
+static void appsrv_processGetLatencyReq(struct appsrv_connection *pCONN)
+{
+    struct mt_msg_lat_summary s;
+    struct mt_msg *pMsg;
+    int x;
+
+    pMsg = MT_MSG_alloc(
+        1 + (MT_MSG_LAT_nHists * LATENCY_CNF_HIST_LEN),
+        MT_MSG_cmd0_areq(APPSRV_SYS_ID_RPC),
+        APPSRV_GET_LATENCY_CNF);
+    if(pMsg == NULL)
+    {
+        return;
+    }
+
+    MT_MSG_setDestIface(pMsg, &(pCONN->socket_interface));
+    MT_MSG_wrU8(pMsg, MT_MSG_LAT_nHists);
+    for(x = 0 ; x < MT_MSG_LAT_nHists ; x++)
+    {
+        MT_MSG_LAT_get(API_MAC_msg_interface,
+                       (enum mt_msg_lat_which)x, &s);
+        MT_MSG_wrU8(pMsg, x);
+        MT_MSG_wrU32(pMsg, s.count);
+        MT_MSG_wrU32(pMsg, (uint32_t)(s.mean_nSecs / 1000));
+        MT_MSG_wrU32(pMsg, (uint32_t)(s.p50_nSecs / 1000));
+        MT_MSG_wrU32(pMsg, (uint32_t)(s.p99_nSecs / 1000));
+        MT_MSG_wrU32(pMsg, (uint32_t)(s.max_nSecs / 1000));
+    }
+    MT_MSG_LAT_log(API_MAC_msg_interface, LOG_APPSRV_MSG_CONTENT);
+
+    MT_MSG_txrx(pMsg);
+    MT_MSG_free(pMsg);
+}
+
 /*!
  * @brief handle a getnetwork info request from the gateway
  * @param pCONN - where the request came from
@@ -512,7 +553,7 @@ static void appsrv_processGetDeviceArrayReq(struct appsrv_connection *pCONN)
 void appsrv_broadcast(struct mt_msg *pMsg)
 {
     struct appsrv_connection *pCONN;
-    struct mt_msg *pClone;
+    struct mt_msg *pShare;
 
     /* mark all connections as "ready to broadcast" */
     lock_connection_list();
@@ -553,13 +594,13 @@ next_connection:
     /* Did we find a connection? */
     if(pCONN)
     {
-        /* we have a connection we can send */
-        pClone = MT_MSG_clone(pMsg);
-        if(pClone)
+        /* we have a connection we can send, the payload is shared */
+        pShare = MT_MSG_share(pMsg);
+        if(pShare)
         {
-            MT_MSG_setDestIface(pClone, &(pCONN->socket_interface));
-            MT_MSG_txrx(pClone);
-            MT_MSG_free(pClone);
+            MT_MSG_setDestIface(pShare, &(pCONN->socket_interface));
+            MT_MSG_txrx(pShare);
+            MT_MSG_free(pShare);
         }
         /* leave this connection as 'busy'
          * busy really means: "done"
@@ -901,6 +942,10 @@ static void appsrv_handle_appClient_request( struct appsrv_connection *pCONN,
             LOG_printf(LOG_APPSRV_MSG_CONTENT, "______________________________\n");
             appsrv_processRemoveDeviceReq(pCONN, pMsg);
             break;
+        case APPSRV_GET_LATENCY_REQ:
+            LOG_printf(LOG_APPSRV_MSG_CONTENT, "rcvd latency req\n");
+            appsrv_processGetLatencyReq(pCONN);
+            break;
         }
     }
     if(!handled)
@@ -72,6 +72,9 @@ extern struct uart_cfg         uart_cfg;
 #define APPSRV_TX_DATA_CNF 14
 #define APPSRV_RMV_DEVICE_REQ 15
 #define APPSRV_RMV_DEVICE_RSP 16
+/* 17 is used by the gateway (device moved) */
+#define APPSRV_GET_LATENCY_REQ 18
+#define APPSRV_GET_LATENCY_CNF 19
 
 #define HEADER_LEN 4
 #define TX_DATA_CNF_LEN 4
@@ -84,6 +87,7 @@ extern struct uart_cfg         uart_cfg;
 #define DEVICE_NOT_ACTIVE_LEN 13
 #define STATE_CHG_IND_LEN 1
 #define REMOVE_DEVICE_RSP_LEN 0
+#define LATENCY_CNF_HIST_LEN 21
 
 #define BEACON_ENABLED 1
 #define NON_BEACON 2
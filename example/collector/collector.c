@@ -24,6 +24,7 @@
 
 #include "mac_util.h"
 #include "api_mac.h"
+#include "api_mac_linux.h"
 #include "cllc.h"
 #include "csf.h"
 #include "smsgs.h"
@@ -50,6 +51,9 @@
 /* Default MSDU Handle rollover */
 #define MSDU_HANDLE_MAX 0x3F
 
+/* Most config requests sent together, see generateConfigRequests() */
+#define CONFIG_BATCH_MAX 4
+
 /* App marker in MSDU handle */
 #define APP_MARKER_MSDU_HANDLE 0x80
 
@@ -187,6 +191,8 @@ static ApiMac_assocStatus_t cllcDeviceJoiningCB(
                 ApiMac_capabilityInfo_t *pCapInfo);
 static void cllcStateChangedCB(Cllc_states_t state);
 static void dataCnfCB(ApiMac_mcpsDataCnf_t *pDataCnf);
+static void processDataCnf(ApiMac_mcpsDataCnf_t *pDataCnf,
+                           ApiMac_sAddr_t *pAddr);
 static void dataIndCB(ApiMac_mcpsDataInd_t *pDataInd);
 static void disassocIndCB(ApiMac_mlmeDisassociateInd_t *pDisassocInd);
 static void disassocCnfCB(ApiMac_mlmeDisassociateCnf_t *pDisassocCnf);
@@ -201,10 +207,21 @@ static void processDeviceTypeResponse(ApiMac_mcpsDataInd_t *pDataInd);
 static void processOadData(ApiMac_mcpsDataInd_t *pDataInd);
 static Cllc_associated_devices_t *findDevice(ApiMac_sAddr_t *pAddr);
 static Cllc_associated_devices_t *findDeviceStatusBit(uint16_t mask, uint16_t statusBit);
+static Cllc_associated_devices_t *findCnfDevice(ApiMac_sAddr_t *pAddr,
+                                                uint16_t mask,
+                                                uint16_t statusBit);
 static uint8_t getMsduHandle(Smsgs_cmdIds_t msgType);
+static void buildConfigRequest(uint8_t *pBuf, uint16_t frameControl,
+                               uint32_t reportingInterval,
+                               uint32_t pollingInterval);
+static bool buildMsg(Smsgs_cmdIds_t type, uint16_t dstShortAddr, bool rxOnIdle,
+                     uint16_t len, uint8_t *pData,
+                     ApiMac_mcpsDataReq_t *pDataReq);
 static bool sendMsg(Smsgs_cmdIds_t type, uint16_t dstShortAddr, bool rxOnIdle,
                     uint16_t len,
                     uint8_t *pData);
+static void sendMsgCnf(ApiMac_mcpsDataCnf_t *pDataCnf, bool is_refused,
+                       void *pCookie);
 static void generateConfigRequests(void);
 static void generateTrackingRequests(void);
 static void generateBroadcastCmd(void);
@@ -497,20 +514,10 @@ Collector_status_t Collector_sendConfigRequest(ApiMac_sAddr_t *pDstAddr,
         if(Csf_getDevice(pDstAddr, &item))
         {
             uint8_t buffer[SMSGS_CONFIG_REQUEST_MSG_LENGTH];
-            uint8_t *pBuf = buffer;
 
             /* Build the message */
-            *pBuf++ = (uint8_t)Smsgs_cmdIds_configReq;
-            *pBuf++ = Util_loUint16(frameControl);
-            *pBuf++ = Util_hiUint16(frameControl);
-            *pBuf++ = Util_breakUint32(reportingInterval, 0);
-            *pBuf++ = Util_breakUint32(reportingInterval, 1);
-            *pBuf++ = Util_breakUint32(reportingInterval, 2);
-            *pBuf++ = Util_breakUint32(reportingInterval, 3);
-            *pBuf++ = Util_breakUint32(pollingInterval, 0);
-            *pBuf++ = Util_breakUint32(pollingInterval, 1);
-            *pBuf++ = Util_breakUint32(pollingInterval, 2);
-            *pBuf = Util_breakUint32(pollingInterval, 3);
+            buildConfigRequest(buffer, frameControl, reportingInterval,
+                               pollingInterval);
 
             if((sendMsg(Smsgs_cmdIds_configReq, item.devInfo.shortAddress,
                         item.capInfo.rxOnWhenIdle,
@@ -1029,6 +1036,18 @@ static void cllcStateChangedCB(Cllc_states_t state)
  * @param      pDataCnf - pointer to the data confirm information
  */
 static void dataCnfCB(ApiMac_mcpsDataCnf_t *pDataCnf)
+{
+    processDataCnf(pDataCnf, NULL);
+}
+
+/*!
+ * @brief      Process a MAC Data Confirm.
+ *
+ * @param      pDataCnf - pointer to the data confirm information
+ * @param      pAddr - destination of the request, NULL if not known
+ */
+static void processDataCnf(ApiMac_mcpsDataCnf_t *pDataCnf,
+                           ApiMac_sAddr_t *pAddr)
 {
     /* Record statistics */
     if(pDataCnf->status == ApiMac_status_channelAccessFailure)
@@ -1064,7 +1083,7 @@ static void dataCnfCB(ApiMac_mcpsDataCnf_t *pDataCnf)
         {
             /* Config Request */
             Cllc_associated_devices_t *pDev;
-            pDev = findDeviceStatusBit(ASSOC_CONFIG_MASK, ASSOC_CONFIG_SENT);
+            pDev = findCnfDevice(pAddr, ASSOC_CONFIG_MASK, ASSOC_CONFIG_SENT);
             if(pDev != NULL)
             {
                 if(pDataCnf->status != ApiMac_status_success)
@@ -1099,8 +1118,8 @@ static void dataCnfCB(ApiMac_mcpsDataCnf_t *pDataCnf)
         {
             /* Tracking Request */
             Cllc_associated_devices_t *pDev;
-            pDev = findDeviceStatusBit(ASSOC_TRACKING_SENT,
-                                       ASSOC_TRACKING_SENT);
+            pDev = findCnfDevice(pAddr, ASSOC_TRACKING_SENT,
+                                 ASSOC_TRACKING_SENT);
             if(pDev != NULL)
             {
                 if(pDataCnf->status == ApiMac_status_success)
@@ -1715,6 +1734,61 @@ static Cllc_associated_devices_t *findDeviceStatusBit(uint16_t mask, uint16_t st
     return (pItem);
 }
 
+/*!
+ * @brief      Find the device a data confirm is for.
+ *
+ * @param      pAddr - destination of the request, NULL if not known
+ * @param      mask - status bits to check
+ * @param      statusBit - the status bits waiting for the confirm
+ *
+ * @return     pointer to the associated device table entry,
+ *             NULL if not found or not waiting for a confirm.
+ */
+static Cllc_associated_devices_t *findCnfDevice(ApiMac_sAddr_t *pAddr,
+                                                uint16_t mask,
+                                                uint16_t statusBit)
+{
+    Cllc_associated_devices_t *pItem;
+
+    /* Without an address, only one request may be waiting */
+    if(pAddr == NULL)
+    {
+        return (findDeviceStatusBit(mask, statusBit));
+    }
+
+    pItem = findDevice(pAddr);
+    if((pItem != NULL) && ((pItem->status & mask) != statusBit))
+    {
+        pItem = NULL;
+    }
+    return (pItem);
+}
+
+/*!
+ * @brief      Build the payload of a config request.
+ *
+ * @param      pBuf - SMSGS_CONFIG_REQUEST_MSG_LENGTH bytes, filled in
+ * @param      frameControl - Frame Control field
+ * @param      reportingInterval - reporting interval in milliseconds
+ * @param      pollingInterval - polling interval in milliseconds
+ */
+static void buildConfigRequest(uint8_t *pBuf, uint16_t frameControl,
+                               uint32_t reportingInterval,
+                               uint32_t pollingInterval)
+{
+    *pBuf++ = (uint8_t)Smsgs_cmdIds_configReq;
+    *pBuf++ = Util_loUint16(frameControl);
+    *pBuf++ = Util_hiUint16(frameControl);
+    *pBuf++ = Util_breakUint32(reportingInterval, 0);
+    *pBuf++ = Util_breakUint32(reportingInterval, 1);
+    *pBuf++ = Util_breakUint32(reportingInterval, 2);
+    *pBuf++ = Util_breakUint32(reportingInterval, 3);
+    *pBuf++ = Util_breakUint32(pollingInterval, 0);
+    *pBuf++ = Util_breakUint32(pollingInterval, 1);
+    *pBuf++ = Util_breakUint32(pollingInterval, 2);
+    *pBuf = Util_breakUint32(pollingInterval, 3);
+}
+
 /*!
  * @brief      Get the next MSDU Handle
  *             <BR>
@@ -1729,76 +1803,88 @@ static Cllc_associated_devices_t *findDeviceStatusBit(uint16_t mask, uint16_t st
  */
 static uint8_t getMsduHandle(Smsgs_cmdIds_t msgType)
 {
-    uint8_t msduHandle = deviceTxMsduHandle;
+    uint8_t msduHandle;
+    int x;
 
-    /* Increment for the next msdu handle, or roll over */
-    if(deviceTxMsduHandle >= MSDU_HANDLE_MAX)
+    /* Skip handles still waiting for a confirm */
+    for(x = 0 ; x <= MSDU_HANDLE_MAX ; x++)
     {
-        deviceTxMsduHandle = 0;
-    }
-    else
-    {
-        deviceTxMsduHandle++;
-    }
+        msduHandle = deviceTxMsduHandle;
 
-    /* Add the message type bit for ramp data */
-    if(msgType == Smsgs_cmdIds_rampdata)
-    {
-        msduHandle |= RAMP_DATA_MSDU_HANDLE;
-        return (msduHandle);
-    }
+        /* Increment for the next msdu handle, or roll over */
+        if(deviceTxMsduHandle >= MSDU_HANDLE_MAX)
+        {
+            deviceTxMsduHandle = 0;
+        }
+        else
+        {
+            deviceTxMsduHandle++;
+        }
 
-    /* Add the App specific bit */
-    msduHandle |= APP_MARKER_MSDU_HANDLE;
+        /* Add the message type bit for ramp data */
+        if(msgType == Smsgs_cmdIds_rampdata)
+        {
+            msduHandle |= RAMP_DATA_MSDU_HANDLE;
+        }
+        else
+        {
+            /* Add the App specific bit */
+            msduHandle |= APP_MARKER_MSDU_HANDLE;
 
-    /* Add the message type bit */
-    if(msgType == Smsgs_cmdIds_configReq)
-    {
-        msduHandle |= APP_CONFIG_MSDU_HANDLE;
-    }
-    else if(msgType == Smgs_cmdIds_broadcastCtrlMsg)
-    {
-        msduHandle |= APP_BROADCAST_MSDU_HANDLE;
+            /* Add the message type bit */
+            if(msgType == Smsgs_cmdIds_configReq)
+            {
+                msduHandle |= APP_CONFIG_MSDU_HANDLE;
+            }
+            else if(msgType == Smgs_cmdIds_broadcastCtrlMsg)
+            {
+                msduHandle |= APP_BROADCAST_MSDU_HANDLE;
+            }
+        }
+
+        if(!ApiMacLinux_dataReqHandleBusy(msduHandle))
+        {
+            break;
+        }
     }
 
     return (msduHandle);
 }
 
 /*!
- * @brief      Send MAC data request
+ * @brief      Build a MAC data request
  *
  * @param      type - message type
  * @param      dstShortAddr - destination short address
  * @param      rxOnIdle - true if not a sleepy device
  * @param      len - length of payload
- * @param      pData - pointer to the buffer
+ * @param      pData - pointer to the buffer, used until the request is sent
+ * @param      pDataReq - filled in
  *
- * @return  true if sent, false if not
+ * @return  true if built, false if the device is not known
  */
-static bool sendMsg(Smsgs_cmdIds_t type, uint16_t dstShortAddr, bool rxOnIdle,
-                    uint16_t len,
-                    uint8_t *pData)
+static bool buildMsg(Smsgs_cmdIds_t type, uint16_t dstShortAddr, bool rxOnIdle,
+                     uint16_t len, uint8_t *pData,
+                     ApiMac_mcpsDataReq_t *pDataReq)
 {
-    ApiMac_mcpsDataReq_t dataReq;
-
     /* Fill the data request field */
-    memset(&dataReq, 0, sizeof(ApiMac_mcpsDataReq_t));
+    memset(pDataReq, 0, sizeof(ApiMac_mcpsDataReq_t));
 
-    dataReq.dstAddr.addrMode = ApiMac_addrType_short;
-    dataReq.dstAddr.addr.shortAddr = dstShortAddr;
-    dataReq.srcAddrMode = ApiMac_addrType_short;
+    pDataReq->dstAddr.addrMode = ApiMac_addrType_short;
+    pDataReq->dstAddr.addr.shortAddr = dstShortAddr;
+    pDataReq->srcAddrMode = ApiMac_addrType_short;
 
     if(fhEnabled && rxOnIdle)
     {
         Llc_deviceListItem_t item;
 
-        if(Csf_getDevice(&(dataReq.dstAddr), &item))
+        if(Csf_getDevice(&(pDataReq->dstAddr), &item))
         {
             /* Switch to the long address */
-            dataReq.dstAddr.addrMode = ApiMac_addrType_extended;
-            memcpy(&dataReq.dstAddr.addr.extAddr, &item.devInfo.extAddress,
+            pDataReq->dstAddr.addrMode = ApiMac_addrType_extended;
+            memcpy(&pDataReq->dstAddr.addr.extAddr, &item.devInfo.extAddress,
                    (APIMAC_SADDR_EXT_LEN));
-            dataReq.srcAddrMode = ApiMac_addrType_extended;
+            pDataReq->srcAddrMode = ApiMac_addrType_extended;
         }
         else
         {
@@ -1807,26 +1893,58 @@ static bool sendMsg(Smsgs_cmdIds_t type, uint16_t dstShortAddr, bool rxOnIdle,
         }
     }
 
-    dataReq.dstPanId = devicePanId;
+    pDataReq->dstPanId = devicePanId;
 
-    dataReq.msduHandle = getMsduHandle(type);
+    pDataReq->msduHandle = getMsduHandle(type);
 
-    dataReq.txOptions.ack = true;
+    pDataReq->txOptions.ack = true;
     if(rxOnIdle == false)
     {
-        dataReq.txOptions.indirect = true;
+        pDataReq->txOptions.indirect = true;
     }
 
-    dataReq.msdu.len = len;
-    dataReq.msdu.p = pData;
+    pDataReq->msdu.len = len;
+    pDataReq->msdu.p = pData;
 
 #ifdef FEATURE_MAC_SECURITY
     /* Fill in the appropriate security fields */
-    Cllc_securityFill(&dataReq.sec);
+    Cllc_securityFill(&pDataReq->sec);
 #endif /* FEATURE_MAC_SECURITY */
 
-    /* Send the message */
-    if(ApiMac_mcpsDataReq(&dataReq) != ApiMac_status_success)
+    return (true);
+}
+
+/*!
+ * @brief      Send MAC data request
+ *
+ * @param      type - message type
+ * @param      dstShortAddr - destination short address
+ * @param      rxOnIdle - true if not a sleepy device
+ * @param      len - length of payload
+ * @param      pData - pointer to the buffer
+ *
+ * @return  true if sent, false if not
+ *
+ * The request is sent without waiting for the co-processor response,
+ * if it is refused sendMsgCnf() gets a confirm with the response status.
+ */
+static bool sendMsg(Smsgs_cmdIds_t type, uint16_t dstShortAddr, bool rxOnIdle,
+                    uint16_t len,
+                    uint8_t *pData)
+{
+    ApiMac_mcpsDataReq_t dataReq;
+
+    if(!buildMsg(type, dstShortAddr, rxOnIdle, len, pData, &dataReq))
+    {
+        /* Can't send the message */
+        return (false);
+    }
+
+    /* Send the message, without waiting, the confirm goes to sendMsgCnf() */
+    if(ApiMac_mcpsDataReqSubmit(&dataReq, sendMsgCnf,
+                                (void *)(intptr_t)((type << 16) |
+                                                   dstShortAddr))
+       != ApiMac_status_success)
     {
         /*  Transaction overflow occurred */
         return (false);
@@ -1837,6 +1955,44 @@ static bool sendMsg(Smsgs_cmdIds_t type, uint16_t dstShortAddr, bool rxOnIdle,
     }
 }
 
+/*!
+ * @brief      Data confirm of a request sent by sendMsg() or
+ *             generateConfigRequests()
+ *
+ * @param      pDataCnf - pointer to the data confirm information
+ * @param      is_refused - the co-processor refused the request
+ * @param      pCookie - message type and destination short address
+ *
+ * A request the co-processor refused gets the retry a failed sendMsg()
+ * would have, any other confirm is handled by processDataCnf() alone.
+ */
+static void sendMsgCnf(ApiMac_mcpsDataCnf_t *pDataCnf, bool is_refused,
+                       void *pCookie)
+{
+    Smsgs_cmdIds_t type;
+    ApiMac_sAddr_t devAddr;
+
+    type = (Smsgs_cmdIds_t)(((intptr_t)pCookie >> 16) & 0xff);
+    devAddr.addrMode = ApiMac_addrType_short;
+    devAddr.addr.shortAddr = (uint16_t)((intptr_t)pCookie & 0xffff);
+
+    processDataCnf(pDataCnf, &devAddr);
+
+    if(!is_refused)
+    {
+        return;
+    }
+
+    if(type == Smsgs_cmdIds_configReq)
+    {
+        processConfigRetry();
+    }
+    else if(type == Smsgs_cmdIds_trackingReq)
+    {
+        processDataRetry(&devAddr);
+    }
+}
+
 /*!
  * @brief      Send MAC broadcast data request.
  *             This function can be used to send broadcast messages
@@ -1879,7 +2035,7 @@ static void sendBroadcastMsg(Smsgs_cmdIds_t type, uint16_t len,
 #endif /* FEATURE_MAC_SECURITY */
 
     /* Send the message */
-    ApiMac_mcpsDataReq(&dataReq);
+    ApiMac_mcpsDataReqSubmit(&dataReq, NULL, NULL);
 }
 
 /*!
@@ -1888,6 +2044,12 @@ static void sendBroadcastMsg(Smsgs_cmdIds_t type, uint16_t len,
  */
 static void generateConfigRequests(void)
 {
+    ApiMac_mcpsDataReq_t dataReqs[CONFIG_BATCH_MAX];
+    uint8_t buffers[CONFIG_BATCH_MAX][SMSGS_CONFIG_REQUEST_MSG_LENGTH];
+    Cllc_associated_devices_t *pDevs[CONFIG_BATCH_MAX];
+    void *cookies[CONFIG_BATCH_MAX];
+    ApiMac_status_t stats[CONFIG_BATCH_MAX];
+    int n;
     int x;
 
     if(CERTIFICATION_TEST_MODE)
@@ -1897,6 +2059,14 @@ static void generateConfigRequests(void)
         return;
     }
 
+    /* Wait for the rest of the last batch, unless the responses timed out */
+    if(Csf_isConfigTimerActive() &&
+       (findDeviceStatusBit(ASSOC_CONFIG_MASK,
+                            (ASSOC_CONFIG_SENT | ASSOC_CONFIG_RSP)) != NULL))
+    {
+        return;
+    }
+
     /* Clear any timed out transactions */
     for(x = 0; x < CONFIG_MAX_DEVICES; x++)
     {
@@ -1913,51 +2083,90 @@ static void generateConfigRequests(void)
         }
     }
 
-    /* Make sure we are only sending one config request at a time */
-    if(findDeviceStatusBit(ASSOC_CONFIG_MASK, ASSOC_CONFIG_SENT) == NULL)
+    /* Make sure we are only sending one batch of config requests at a time */
+    if((findDeviceStatusBit(ASSOC_CONFIG_MASK, ASSOC_CONFIG_SENT) != NULL) ||
+       (cllcState < Cllc_states_started))
+    {
+        return;
+    }
+
+    /* Run through all of the devices */
+    n = 0;
+    for(x = 0; (x < CONFIG_MAX_DEVICES) && (n < CONFIG_BATCH_MAX); x++)
     {
-        /* Run through all of the devices */
-        for(x = 0; x < CONFIG_MAX_DEVICES; x++)
+        /* Make sure the entry is valid. */
+        if((Cllc_associatedDevList[x].shortAddr != CSF_INVALID_SHORT_ADDR)
+           && (Cllc_associatedDevList[x].status & CLLC_ASSOC_STATUS_ALIVE))
         {
-            /* Make sure the entry is valid. */
-            if((Cllc_associatedDevList[x].shortAddr != CSF_INVALID_SHORT_ADDR)
-               && (Cllc_associatedDevList[x].status & CLLC_ASSOC_STATUS_ALIVE))
-            {
-                uint16_t status = Cllc_associatedDevList[x].status;
+            uint16_t status = Cllc_associatedDevList[x].status;
 
-                /*
-                 Has the device been sent or already received a config request?
-                 */
-                if(((status & (ASSOC_CONFIG_SENT | ASSOC_CONFIG_RSP)) == 0))
-                {
-                    ApiMac_sAddr_t dstAddr;
-                    Collector_status_t stat;
+            /*
+             Has the device been sent or already received a config request?
+             */
+            if(((status & (ASSOC_CONFIG_SENT | ASSOC_CONFIG_RSP)) == 0))
+            {
+                ApiMac_sAddr_t dstAddr;
+                Llc_deviceListItem_t item;
 
-                    /* Set up the destination address */
-                    dstAddr.addrMode = ApiMac_addrType_short;
-                    dstAddr.addr.shortAddr =
-                        Cllc_associatedDevList[x].shortAddr;
+                /* Set up the destination address */
+                dstAddr.addrMode = ApiMac_addrType_short;
+                dstAddr.addr.shortAddr =
+                    Cllc_associatedDevList[x].shortAddr;
 
-                    /* Send the Config Request */
-                    stat = Collector_sendConfigRequest(
-                                    &dstAddr, (CONFIG_FRAME_CONTROL),
-                                    (CONFIG_REPORTING_INTERVAL),
-                                    (CONFIG_POLLING_INTERVAL));
-                    if(stat == Collector_status_success)
-                    {
-                        /*
-                         Mark as the message has been sent and expecting a response
-                         */
-                        Cllc_associatedDevList[x].status |= ASSOC_CONFIG_SENT;
-                        Cllc_associatedDevList[x].status &= ~ASSOC_CONFIG_RSP;
-                    }
+                /* Is the device a known device? */
+                if(!Csf_getDevice(&dstAddr, &item))
+                {
+                    continue;
+                }
 
-                    /* Only do one at a time */
-                    break;
+                /* Build the Config Request */
+                buildConfigRequest(buffers[n], (CONFIG_FRAME_CONTROL),
+                                   (CONFIG_REPORTING_INTERVAL),
+                                   (CONFIG_POLLING_INTERVAL));
+                if(!buildMsg(Smsgs_cmdIds_configReq,
+                             item.devInfo.shortAddress,
+                             item.capInfo.rxOnWhenIdle,
+                             (SMSGS_CONFIG_REQUEST_MSG_LENGTH),
+                             buffers[n], &dataReqs[n]))
+                {
+                    processConfigRetry();
+                    continue;
                 }
+                cookies[n] = (void *)(intptr_t)
+                    ((Smsgs_cmdIds_configReq << 16) |
+                     item.devInfo.shortAddress);
+                pDevs[n] = &Cllc_associatedDevList[x];
+                n++;
             }
         }
     }
+
+    if(n == 0)
+    {
+        return;
+    }
+
+    /* Send them together, the confirms go to sendMsgCnf() */
+    ApiMac_mcpsDataReqBatch(dataReqs, n, sendMsgCnf, cookies, stats);
+
+    for(x = 0; x < n; x++)
+    {
+        if(stats[x] == ApiMac_status_success)
+        {
+            /*
+             Mark as the message has been sent and expecting a response
+             */
+            pDevs[x]->status |= ASSOC_CONFIG_SENT;
+            pDevs[x]->status &= ~ASSOC_CONFIG_RSP;
+            Collector_statistics.configRequestAttempts++;
+            /* set timer for retry in case response is not received */
+            Csf_setConfigClock(CONFIG_DELAY);
+        }
+        else
+        {
+            processConfigRetry();
+        }
+    }
 }
 
 
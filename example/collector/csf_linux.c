@@ -343,7 +343,7 @@ void Csf_init(void *sem)
     /* save the application semaphore here */
     /* load the NV function pointers */
     // printf("   >> Initialize the NV Function pointers \n");
-    NVOCMP_loadApiPtrs(&nvFps);
+    NV_LINUX_loadApiPtrs(&nvFps);
 
     /* Suyash - the code is using pNV var. Using that for now. */
     /* config nv pointer will be read from the mac_config_t... */
@@ -2045,6 +2045,14 @@ void Csf_updateFrameCounter(ApiMac_sAddr_t *pDevAddr, uint32_t frameCntr)
                 if(pNV->writeItem(id, sizeof(uint32_t), &frameCntr)
                                 == NVINTF_SUCCESS)
                 {
+                    /*
+                     Frame counters must never be reused after a restart,
+                     the window is only safe once it is on disk.
+                     */
+                    if(pNV->syncNV != NULL)
+                    {
+                        pNV->syncNV();
+                    }
                     lastSavedCoordinatorFrameCounter = frameCntr;
                 }
             }
@@ -2067,6 +2075,10 @@ void Csf_updateFrameCounter(ApiMac_sAddr_t *pDevAddr, uint32_t frameCntr)
                     /* Update the frame counter */
                     devItem.rxFrameCounter = frameCntr;
                     updateDeviceListItem(&devItem);
+                    if(pNV->syncNV != NULL)
+                    {
+                        pNV->syncNV();
+                    }
                 }
             }
         }
@@ -70,6 +70,9 @@ int linux_CONFIG_MAX_BE = CONFIG_MAX_BE_DEFAULT;
 int linux_CONFIG_MAC_MAX_CSMA_BACKOFFS = CONFIG_MAC_MAX_CSMA_BACKOFFS_DEFAULT;
 int linux_CONFIG_MAX_RETRIES = CONFIG_MAX_RETRIES_DEFAULT;
 
+/*! If not NULL, every MT frame is captured here, see MT_MSG_CAPTURE_start() */
+static const char *mt_capture_filename;
+
 /*!
  * Called from the linux config file parser as each channel mask is parsed
  * from the configuration file. This allows the user to override/set
@@ -253,6 +256,27 @@ static int my_APP_settings(struct ini_parser *pINI, bool *handled)
         return 0;
     }
 
+    if(INI_itemMatches(pINI, NULL, "api-mac-data-inflight"))
+    {
+        ApiMacLinux_dataReq_maxInFlight = INI_valueAsInt(pINI);
+        *handled = true;
+        return 0;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "api-mac-data-timeout"))
+    {
+        ApiMacLinux_dataReq_timeout_mSecs = INI_valueAsInt(pINI);
+        *handled = true;
+        return 0;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "api-mac-pib-cache"))
+    {
+        ApiMacLinux_pibCache_enable = INI_valueAsBool(pINI);
+        *handled = true;
+        return 0;
+    }
+
     if(INI_itemMatches(pINI, NULL, "interface"))
     {
         if(0 == strcmp("socket", pINI->item_value))
@@ -521,6 +545,14 @@ static int my_APP_settings(struct ini_parser *pINI, bool *handled)
         return 0;
     }
 
+    if(INI_itemMatches(pINI, NULL, "mt-capture"))
+    {
+        INI_dequote(pINI);
+        mt_capture_filename = INI_itemValue_strdup(pINI);
+        *handled = true;
+        return 0;
+    }
+
     if(INI_itemMatches(pINI,NULL,"msg-dbg-data"))
     {
         struct mt_msg_dbg **ppDbg;
@@ -550,6 +582,7 @@ static int cfg_callback(struct ini_parser *pINI, bool *handled)
         my_UART_INI_settings,
         my_SOCKET_INI_settings,
         my_MT_MSG_INI_settings,
+        NV_LINUX_INI_settings,
         my_APP_settings,
         /* Terminate list */
         NULL
@@ -605,6 +638,19 @@ int main(int argc, char **argv)
         }
     }
 
+    /* all msg-dbg-data files are loaded, add what they don't describe */
+    ApiMacLinux_dbgAddSchemas();
+    /* and index them */
+    MT_MSG_dbg_buildIndex(ALL_MT_MSG_DBG);
+
+    if(mt_capture_filename)
+    {
+        if(MT_MSG_CAPTURE_start(mt_capture_filename) != 0)
+        {
+            FATAL_printf("Cannot capture to: %s\n", mt_capture_filename);
+        }
+    }
+
     /* Begin application */
     APP_main();
 
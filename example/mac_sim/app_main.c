@@ -0,0 +1,2042 @@
+/******************************************************************************
+ @file app_main.c
+
+ @brief TIMAC 2.0 API Primary application file for the simulated MAC
+        co-processor
+
+ Group: WCS LPC
+ $Target Device: DEVICES $
+
+ ******************************************************************************
+ $License: BSD3 2016 $
+ ******************************************************************************
+ $Release Name: PACKAGE NAME $
+ $Release Date: PACKAGE RELEASE DATE $
+ *****************************************************************************/
+
+/******************************************************************************
+ Overview
+ ========
+
+ This application pretends to be a CC13xx running the MAC co-processor
+ firmware, so that the collector (or npi_server2, or anything else that
+ uses api_mac.c) can be capacity tested on a plain linux box.
+
+ Each co-processor answers the MT commands api_mac.c sends: reset,
+ version, extended address, PIB get/set, scan, start, data request
+ and association response. Behind each co-processor a configurable
+ number of virtual sensors join the network and send sensor data
+ at a configurable rate, with a configurable frame loss.
+
+ The sensors speak the messages in example/collector/smsgs.h.
+
+ Transports:
+    pty    - one co-processor on a pseudo terminal,
+             point the collector [uart-cfg] devname at the slave.
+    socket - each accepted connection is an independent co-processor,
+             point the collector at it like an npi_server2.
+ *****************************************************************************/
+
+#define _GNU_SOURCE 1  /* ptsname() */
+#include "compiler.h"
+#include "mac_sim.h"
+#include "api_mac.h"
+#include "threads.h"
+#include "timer.h"
+#include "stream.h"
+#include "stream_socket.h"
+#include "stream_uart.h"
+#include "rand_data.h"
+#include "fatal.h"
+#include "log.h"
+#include "mutex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+/******************************************************************************
+ Constants and definitions
+ *****************************************************************************/
+
+/*! How often the traffic thread looks for work */
+#define SIM_TICK_mSecs             10
+
+/*! A joining sensor that hears nothing tries again after this */
+#define SIM_ASSOC_TIMEOUT_mSecs    5000
+
+/*! Sensor report interval until the collector configures one */
+#define SIM_DEFAULT_REPORT_mSecs   (90 * 1000)
+
+/*! A new sensor sends its first report within this time */
+#define SIM_FIRST_REPORT_mSecs     1000
+
+/*! A rejected sensor waits this many join intervals */
+#define SIM_ASSOC_REJECT_BACKOFF   10
+
+/*! Largest PIB value we keep (net name, excluded channel maps) */
+#define SIM_PIB_MAX                32
+
+/*! Frequency hopping attribute ids are 0x2000 and up */
+#define SIM_PIB_FH_FIRST           0x2000
+#define SIM_PIB_FH_COUNT           0x20
+
+/*! Security header on the wire: key source, level, key id mode, index */
+#define SIM_SEC_LEN                (APIMAC_KEY_SOURCE_MAX_LEN + 3)
+
+/*! Length of an address on the wire: mode + 8 bytes */
+#define SIM_ADDR_LEN               9
+
+/*! Energy detect results, the collector looks at every 15.4g channel */
+#define SIM_ED_RESULTS             APIMAC_154G_MAX_NUM_CHANNEL
+
+/*! The largest sensor message we generate */
+#define SIM_MSDU_MAX               40
+
+/*! Version reported in the reset indication and the version response */
+#define SIM_VERSION_TRANSPORT      2
+#define SIM_VERSION_PRODUCT        1
+#define SIM_VERSION_MAJOR          2
+#define SIM_VERSION_MINOR          0
+#define SIM_VERSION_MAINT          0
+
+/*! MAC SREQ command ids, see api_mac.c */
+#define SIM_MAC_cmd0               0x22
+#define SIM_MAC_RESET_REQ          0x01
+#define SIM_MAC_START_REQ          0x03
+#define SIM_MAC_DATA_REQ           0x05
+#define SIM_MAC_DISASSOCIATE_REQ   0x07
+#define SIM_MAC_GET_REQ            0x08
+#define SIM_MAC_SET_REQ            0x09
+#define SIM_MAC_SCAN_REQ           0x0c
+#define SIM_MAC_SECURITY_GET_REQ   0x30
+#define SIM_MAC_SECURITY_SET_REQ   0x31
+#define SIM_MAC_GET_DEF_SRC_KEY    0x37
+#define SIM_MAC_FH_GET_REQ         0x42
+#define SIM_MAC_FH_SET_REQ         0x43
+#define SIM_MAC_ASSOCIATE_RSP      0x50
+
+/*! Sensor message ids, see example/collector/smsgs.h */
+#define SIM_SMSGS_configReq        1
+#define SIM_SMSGS_configRsp        2
+#define SIM_SMSGS_trackingReq      3
+#define SIM_SMSGS_trackingRsp      4
+#define SIM_SMSGS_sensorData       5
+#define SIM_SMSGS_toggleLedReq     6
+#define SIM_SMSGS_toggleLedRsp     7
+#define SIM_SMSGS_deviceTypeReq    16
+#define SIM_SMSGS_deviceTypeRsp    17
+
+/*! Sensor data fields we can report, see smsgs.h */
+#define SIM_SMSGS_temp             0x0001
+#define SIM_SMSGS_light            0x0002
+#define SIM_SMSGS_humidity         0x0004
+#define SIM_SMSGS_configSettings   0x0010
+#define SIM_SMSGS_supported        (SIM_SMSGS_temp | SIM_SMSGS_light | \
+                                    SIM_SMSGS_humidity | \
+                                    SIM_SMSGS_configSettings)
+
+/*! Smsgs_statusValues_t */
+#define SIM_SMSGS_success          0
+#define SIM_SMSGS_partialSuccess   2
+
+/*! Capability information bits, see ApiMac_buildMsgCapInfo() */
+#define SIM_CAP_mainsPower         0x04
+#define SIM_CAP_rxOnWhenIdle       0x08
+#define SIM_CAP_security           0x40
+#define SIM_CAP_allocAddr          0x80
+
+/*!
+ * @struct sim_pib_size
+ * @brief Size on the wire of a range of PIB attributes
+ */
+struct sim_pib_size {
+    /*! first attribute id in the range */
+    uint16_t first;
+    /*! last attribute id in the range */
+    uint16_t last;
+    /*! value size in bytes */
+    uint8_t  size;
+};
+
+/*! sensor life cycle */
+enum sim_sensor_state {
+    /*! not part of the network */
+    SIM_SENSOR_idle,
+    /*! associate indication sent, waiting for the response */
+    SIM_SENSOR_joining,
+    /*! has a short address */
+    SIM_SENSOR_joined
+};
+
+/*!
+ * @struct sim_sensor
+ * @brief One virtual sensor
+ */
+struct sim_sensor {
+    /*! where in the life cycle */
+    enum sim_sensor_state state;
+
+    /*! assigned by the collector */
+    uint16_t short_addr;
+
+    /*! data sequence number */
+    uint8_t dsn;
+
+    /*! LED state, for toggle requests */
+    uint8_t led;
+
+    /*! security frame counter */
+    uint32_t frame_cntr;
+
+    /*! fields to report, from the config request */
+    uint16_t frame_control;
+
+    /*! from the config request, 0 until configured */
+    uint32_t report_mSecs;
+
+    /*! from the config request */
+    uint32_t poll_mSecs;
+
+    /*! TIMER_getNow() when the next report or join retry is due */
+    uint32_t due;
+};
+
+/*!
+ * @struct sim_stats
+ * @brief Counters logged every stats-interval-msecs
+ */
+struct sim_stats {
+    uint32_t sreqs;
+    uint32_t data_reqs;
+    uint32_t data_no_acks;
+    uint32_t assoc_inds;
+    uint32_t reports;
+    uint32_t reports_lost;
+    uint32_t responses;
+};
+
+/*!
+ * @struct sim_device
+ * @brief One simulated co-processor
+ */
+struct sim_device {
+    /*! connection number */
+    int id;
+
+    /*! for log messages */
+    char *dbg_name;
+
+    /*! set when this device should go away */
+    volatile bool is_dead;
+
+    /*! the MT interface to the host */
+    struct mt_msg_interface iface;
+
+    /*! protects everything below */
+    intptr_t lock;
+
+    /*! handles requests from the host */
+    intptr_t req_thread;
+
+    /*! generates sensor traffic */
+    intptr_t traffic_thread;
+
+    /*! loss and jitter */
+    struct rand_data_one rand;
+
+    /*! standard and security PIB values, by attribute id */
+    uint8_t pib[256][SIM_PIB_MAX];
+
+    /*! frequency hopping PIB values */
+    uint8_t pib_fh[SIM_PIB_FH_COUNT][SIM_PIB_MAX];
+
+    /*! true after a start request */
+    bool started;
+
+    /*! replay mode: true once the host has said something */
+    volatile bool host_seen;
+
+    /*! security header for sensor frames */
+    uint8_t sec[SIM_SEC_LEN];
+
+    /*! our extended address, sensors follow */
+    uint64_t ext_addr;
+
+    /*! the sensors */
+    int n_sensors;
+    struct sim_sensor *pSensors;
+
+    /*! short address to sensor index + 1 */
+    uint16_t *pShortMap;
+
+    /*! next sensor to try to join */
+    int join_cursor;
+
+    /*! when the next join may happen */
+    uint32_t join_due;
+
+    /*! when stats are next logged */
+    uint32_t stats_due;
+
+    struct sim_stats stats;
+};
+
+/*! PIB attribute sizes, anything not here is unsupported */
+static const struct sim_pib_size sim_pib_sizes[] = {
+    /* standard attributes */
+    { 0x40, 0x44,  1 },
+    { 0x45, 0x45, 16 },   /* beaconPayload */
+    { 0x46, 0x47,  1 },
+    { 0x48, 0x48,  4 },
+    { 0x49, 0x49,  1 },
+    { 0x4a, 0x4a,  8 },   /* coordExtendedAddress */
+    { 0x4b, 0x4b,  2 },
+    { 0x4c, 0x4f,  1 },
+    { 0x50, 0x50,  2 },   /* panId */
+    { 0x51, 0x52,  1 },
+    { 0x53, 0x53,  2 },   /* shortAddress */
+    { 0x54, 0x54,  1 },
+    { 0x55, 0x55,  2 },
+    { 0x56, 0x57,  1 },
+    { 0x58, 0x58,  2 },
+    { 0x59, 0x5f,  1 },
+    { 0x60, 0x60,  2 },
+    { 0x61, 0x62,  1 },
+    /* security attributes */
+    { 0x81, 0x82,  2 },
+    { 0x83, 0x83,  1 },
+    { 0x85, 0x86,  1 },
+    { 0x87, 0x87,  8 },
+    { 0x88, 0x88,  1 },
+    { 0x89, 0x8a,  8 },
+    { 0x8b, 0x8b,  2 },
+    /* phy and TI specific attributes */
+    { 0xe0, 0xe1,  1 },
+    { 0xe2, 0xe2,  8 },   /* extendedAddress */
+    { 0xe3, 0xe9,  1 },
+    { 0xea, 0xf3,  4 },
+    { 0xf4, 0xf8,  1 },
+    /* frequency hopping attributes */
+    { 0x2000, 0x2000, 8 },
+    { 0x2001, 0x2001, 2 },   /* api_mac.c reads BCInterval as 2 bytes */
+    { 0x2002, 0x2003, APIMAC_FH_MAX_BIT_MAP_SIZE },
+    { 0x2004, 0x200a, 1 },
+    { 0x200b, 0x200e, 2 },
+    { 0x200f, 0x2012, 1 },
+    { 0x2013, 0x2013, APIMAC_FH_NET_NAME_SIZE_MAX },
+    { 0x2014, 0x2014, 2 },
+    { 0x2015, 0x2018, APIMAC_FH_GTK_HASH_SIZE },
+    { 0x2019, 0x2019, 2 },
+    { 0x201a, 0x201a, 1 },
+    { 0x201b, 0x201d, 2 },
+    /* terminate */
+    { 0, 0, 0 }
+};
+
+/*! key source the collector uses, see CLLC_DEFAULT_KEY_SOURCE */
+static const uint8_t sim_default_key_source[APIMAC_KEY_SOURCE_MAX_LEN] = {
+    0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33
+};
+
+/******************************************************************************
+ Global variables
+ *****************************************************************************/
+
+struct mac_sim_cfg sim_cfg;
+struct uart_cfg my_uart_cfg;
+struct socket_cfg my_socket_cfg;
+struct mt_msg_interface uart_interface_template;
+struct mt_msg_interface socket_interface_template;
+
+/******************************************************************************
+ Functions
+ *****************************************************************************/
+
+void APP_defaults(void)
+{
+    sim_cfg.use_socket = false;
+    sim_cfg.pty_link = NULL;
+    sim_cfg.n_sensors = 10;
+    sim_cfg.report_interval_mSecs = 0;
+    sim_cfg.join_interval_mSecs = 100;
+    sim_cfg.loss_percent = 0;
+    sim_cfg.sleepy = false;
+    sim_cfg.security_level = ApiMac_secLevel_encMic32;
+    sim_cfg.ext_addr_base = 0x00124b0000a00000ULL;
+    sim_cfg.stats_interval_mSecs = 10 * 1000;
+    sim_cfg.replay_file = NULL;
+    sim_cfg.replay_iface = NULL;
+    sim_cfg.replay_speed = 1;
+    sim_cfg.replay_loops = 1;
+
+    /* the co-processor side of a pseudo terminal */
+    my_uart_cfg.devname = "/dev/ptmx";
+    my_uart_cfg.baudrate = 115200;
+    my_uart_cfg.open_flags = STREAM_UART_FLAG_pty;
+
+    my_socket_cfg.ascp = 's';
+    my_socket_cfg.host = NULL;
+    my_socket_cfg.server_backlog = 5;
+    my_socket_cfg.device_binding = NULL;
+    my_socket_cfg.service = strdup("12345");
+    if(my_socket_cfg.service == NULL)
+    {
+        BUG_HERE("No memory\n");
+    }
+
+    /* framed like the real co-processor uart */
+    uart_interface_template.dbg_name = "sim-uart";
+    uart_interface_template.frame_sync = true;
+    uart_interface_template.include_chksum = true;
+    uart_interface_template.s_cfg = NULL;
+    uart_interface_template.u_cfg = &my_uart_cfg;
+    uart_interface_template.rx_thread = 0;
+    uart_interface_template.tx_frag_size = 240;
+    uart_interface_template.retry_max = 3;
+    uart_interface_template.frag_timeout_mSecs = 2000;
+    uart_interface_template.srsp_timeout_mSecs = 2000;
+    uart_interface_template.stack_id = 0;
+    uart_interface_template.len_2bytes = false;
+    uart_interface_template.rx_handler_cookie = 0;
+    uart_interface_template.is_dead = false;
+    uart_interface_template.flush_timeout_mSecs = 50;
+    uart_interface_template.intermsg_timeout_mSecs = 3000;
+
+    /* framed like the npi_server2 socket */
+    socket_interface_template.dbg_name = "sim-socket";
+    socket_interface_template.frame_sync = false;
+    socket_interface_template.include_chksum = false;
+    socket_interface_template.s_cfg = NULL;
+    socket_interface_template.u_cfg = NULL;
+    socket_interface_template.rx_thread = 0;
+    socket_interface_template.tx_frag_size = 3000;
+    socket_interface_template.retry_max = 3;
+    socket_interface_template.frag_timeout_mSecs = 2000;
+    socket_interface_template.srsp_timeout_mSecs = 2000;
+    socket_interface_template.stack_id = 0;
+    socket_interface_template.len_2bytes = true;
+    socket_interface_template.rx_handler_cookie = 0;
+    socket_interface_template.is_dead = false;
+    socket_interface_template.flush_timeout_mSecs = 10;
+    socket_interface_template.intermsg_timeout_mSecs = 3000;
+}
+
+/*!
+ * @brief Has a time arrived?
+ * @param now - TIMER_getNow()
+ * @param when - the time in question
+ * @returns true if now is at or after when
+ */
+static bool sim_isDue(uint32_t now, uint32_t when)
+{
+    return ((int32_t)(now - when) >= 0);
+}
+
+/*!
+ * @brief A random number 0..65535
+ * @param pDev - the device
+ */
+static unsigned sim_rand16(struct sim_device *pDev)
+{
+    unsigned v;
+
+    v = RAND_DATA_nextByte(&(pDev->rand));
+    v = (v << 8) | RAND_DATA_nextByte(&(pDev->rand));
+    return (v);
+}
+
+/*!
+ * @brief Decide if a frame is lost
+ * @param pDev - the device
+ * @returns true if the frame should be dropped
+ */
+static bool sim_isLost(struct sim_device *pDev)
+{
+    if(sim_cfg.loss_percent == 0)
+    {
+        return (false);
+    }
+    return ((int)(sim_rand16(pDev) % 100) < sim_cfg.loss_percent);
+}
+
+/*!
+ * @brief Spread a time interval by up to +/- 1/8th
+ * @param pDev - the device
+ * @param mSecs - the interval
+ * @returns the jittered interval
+ */
+static uint32_t sim_jitter(struct sim_device *pDev, uint32_t mSecs)
+{
+    uint32_t j;
+
+    j = mSecs / 8;
+    if(j == 0)
+    {
+        return (mSecs);
+    }
+    return (mSecs - j + (sim_rand16(pDev) % (2 * j)));
+}
+
+/*!
+ * @brief Find the wire size of a PIB attribute
+ * @param id - the attribute id
+ * @returns size in bytes, 0 if not supported
+ */
+static int sim_pibSize(int id)
+{
+    const struct sim_pib_size *pS;
+
+    for(pS = sim_pib_sizes ; pS->size ; pS++)
+    {
+        if(_inrange(id, pS->first, pS->last + 1))
+        {
+            return (pS->size);
+        }
+    }
+    return (0);
+}
+
+/*!
+ * @brief Find where a PIB attribute is kept
+ * @param pDev - the device
+ * @param id - the attribute id
+ * @returns pointer to SIM_PIB_MAX bytes, NULL if not supported
+ */
+static uint8_t *sim_pib(struct sim_device *pDev, int id)
+{
+    if(_inrange(id, 0, 256))
+    {
+        return (pDev->pib[id]);
+    }
+    if(_inrange(id, SIM_PIB_FH_FIRST, SIM_PIB_FH_FIRST + SIM_PIB_FH_COUNT))
+    {
+        return (pDev->pib_fh[id - SIM_PIB_FH_FIRST]);
+    }
+    return (NULL);
+}
+
+/*!
+ * @brief Read a little endian PIB value
+ * @param pDev - the device
+ * @param id - the attribute id
+ * @param nbytes - value size, at most 8
+ */
+static uint64_t sim_pibGet(struct sim_device *pDev, int id, int nbytes)
+{
+    uint8_t *pV;
+    uint64_t v;
+
+    pV = sim_pib(pDev, id);
+    v = 0;
+    while(nbytes > 0)
+    {
+        nbytes--;
+        v = (v << 8) | pV[nbytes];
+    }
+    return (v);
+}
+
+/*!
+ * @brief Write a little endian PIB value
+ * @param pDev - the device
+ * @param id - the attribute id
+ * @param nbytes - value size, at most 8
+ * @param v - the value
+ */
+static void sim_pibPut(struct sim_device *pDev, int id, int nbytes, uint64_t v)
+{
+    uint8_t *pV;
+    int x;
+
+    pV = sim_pib(pDev, id);
+    for(x = 0 ; x < nbytes ; x++)
+    {
+        pV[x] = (uint8_t)(v >> (8 * x));
+    }
+}
+
+/*!
+ * @brief Return everything to the power on state
+ * @param pDev - the device
+ * @param clear_pib - true to set the PIB to its defaults
+ */
+static void sim_reset(struct sim_device *pDev, bool clear_pib)
+{
+    int x;
+
+    if(clear_pib)
+    {
+        memset((void *)(pDev->pib), 0, sizeof(pDev->pib));
+        memset((void *)(pDev->pib_fh), 0, sizeof(pDev->pib_fh));
+        sim_pibPut(pDev, ApiMac_attribute_extendedAddress, 8, pDev->ext_addr);
+        sim_pibPut(pDev, ApiMac_attribute_panId, 2, 0xffff);
+        sim_pibPut(pDev, ApiMac_attribute_shortAddress, 2, 0xffff);
+    }
+
+    pDev->started = false;
+
+    memcpy((void *)(&pDev->sec[0]),
+           (const void *)(sim_default_key_source),
+           APIMAC_KEY_SOURCE_MAX_LEN);
+    pDev->sec[APIMAC_KEY_SOURCE_MAX_LEN + 0] = (uint8_t)(sim_cfg.security_level);
+    pDev->sec[APIMAC_KEY_SOURCE_MAX_LEN + 1] = ApiMac_keyIdMode_8;
+    pDev->sec[APIMAC_KEY_SOURCE_MAX_LEN + 2] = 3;
+    if(sim_cfg.security_level == 0)
+    {
+        memset((void *)(pDev->sec), 0, sizeof(pDev->sec));
+    }
+
+    memset((void *)(pDev->pSensors), 0,
+           sizeof(pDev->pSensors[0]) * pDev->n_sensors);
+    memset((void *)(pDev->pShortMap), 0, sizeof(uint16_t) * 0x10000);
+    for(x = 0 ; x < pDev->n_sensors ; x++)
+    {
+        pDev->pSensors[x].frame_control = SIM_SMSGS_temp |
+            SIM_SMSGS_light | SIM_SMSGS_humidity;
+    }
+    pDev->join_cursor = 0;
+}
+
+/*!
+ * @brief Allocate a message to the host
+ * @param pDev - the device
+ * @param len - payload length
+ * @param cmd0 - the cmd0 value
+ * @param cmd1 - the cmd1 value
+ * @param dbg_prefix - for log messages
+ * @returns NULL on error
+ */
+static struct mt_msg *sim_newMsg(struct sim_device *pDev,
+                                 int len, int cmd0, int cmd1,
+                                 const char *dbg_prefix)
+{
+    struct mt_msg *pMsg;
+
+    pMsg = MT_MSG_alloc(len, cmd0, cmd1);
+    if(pMsg)
+    {
+        pMsg->pLogPrefix = dbg_prefix;
+        MT_MSG_setDestIface(pMsg, &(pDev->iface));
+    }
+    return (pMsg);
+}
+
+/*!
+ * @brief Transmit a message to the host and release it
+ * @param pMsg - the message, may be NULL
+ */
+static void sim_send(struct mt_msg *pMsg)
+{
+    if(pMsg == NULL)
+    {
+        return;
+    }
+    if(MT_MSG_txrx(pMsg) != 1)
+    {
+        MT_MSG_log(LOG_ERROR, pMsg, "cannot send\n");
+    }
+    MT_MSG_free(pMsg);
+}
+
+/*!
+ * @brief Reply to an SREQ with just a status byte
+ * @param pDev - the device
+ * @param pReq - the request
+ * @param status - the status
+ */
+static void sim_srspStatus(struct sim_device *pDev,
+                           struct mt_msg *pReq,
+                           int status)
+{
+    struct mt_msg *pRsp;
+
+    pRsp = sim_newMsg(pDev, 1, MT_MSG_cmd0_srsp(pReq->cmd0), pReq->cmd1,
+                      "srsp-status");
+    if(pRsp)
+    {
+        MT_MSG_wrU8(pRsp, (uint8_t)(status));
+        sim_send(pRsp);
+    }
+}
+
+/*!
+ * @brief Write a short address in the 9 byte wire format
+ * @param pMsg - the message
+ * @param short_addr - the address
+ */
+static void sim_wrAddrShort(struct mt_msg *pMsg, uint16_t short_addr)
+{
+    MT_MSG_wrU8(pMsg, ApiMac_addrType_short);
+    MT_MSG_wrU16(pMsg, short_addr);
+    MT_MSG_wrBuf(pMsg, NULL, SIM_ADDR_LEN - 3);
+}
+
+/*!
+ * @brief Write an extended address in the 9 byte wire format
+ * @param pMsg - the message
+ * @param ext_addr - the address
+ */
+static void sim_wrAddrExt(struct mt_msg *pMsg, uint64_t ext_addr)
+{
+    MT_MSG_wrU8(pMsg, ApiMac_addrType_extended);
+    MT_MSG_wrU64(pMsg, ext_addr);
+}
+
+/*!
+ * @brief Extended address of a sensor
+ * @param pDev - the device
+ * @param idx - the sensor index
+ */
+static uint64_t sim_sensorExtAddr(struct sim_device *pDev, int idx)
+{
+    return (pDev->ext_addr + 1 + idx);
+}
+
+/*!
+ * @brief Find a sensor from a 9 byte wire format address
+ * @param pDev - the device
+ * @param pMsg - the message, positioned at the address
+ * @returns sensor index, or negative if not ours
+ */
+static int sim_rdAddr(struct sim_device *pDev, struct mt_msg *pMsg)
+{
+    uint64_t v;
+    int mode;
+    int idx;
+
+    mode = MT_MSG_rdU8(pMsg);
+    switch(mode)
+    {
+    default:
+        MT_MSG_rdBuf(pMsg, NULL, SIM_ADDR_LEN - 1);
+        return (-1);
+    case ApiMac_addrType_short:
+        v = MT_MSG_rdU16(pMsg);
+        MT_MSG_rdBuf(pMsg, NULL, SIM_ADDR_LEN - 3);
+        return (((int)(pDev->pShortMap[v])) - 1);
+    case ApiMac_addrType_extended:
+        v = MT_MSG_rdU64(pMsg) - pDev->ext_addr - 1;
+        idx = (int)(v);
+        if((v >= (uint64_t)(pDev->n_sensors)) || (idx < 0))
+        {
+            return (-1);
+        }
+        return (idx);
+    }
+}
+
+/*!
+ * @brief Send a data indication from a sensor
+ * @param pDev - the device
+ * @param pS - the sensor
+ * @param pMsdu - the sensor message
+ * @param len - sensor message length
+ */
+static void sim_dataInd(struct sim_device *pDev,
+                        struct sim_sensor *pS,
+                        const uint8_t *pMsdu,
+                        int len)
+{
+    struct mt_msg *pMsg;
+    uint16_t pan_id;
+
+    pMsg = sim_newMsg(pDev,
+                      (2 * SIM_ADDR_LEN) + 4 + 2 + 2 + 2 + 4 +
+                      SIM_SEC_LEN + 4 + 2 + 2 + len,
+                      MAC_DATA_IND_cmd0, MAC_DATA_IND_cmd1, "data-ind");
+    if(pMsg == NULL)
+    {
+        return;
+    }
+
+    pan_id = (uint16_t)sim_pibGet(pDev, ApiMac_attribute_panId, 2);
+
+    sim_wrAddrShort(pMsg, pS->short_addr);
+    sim_wrAddrShort(pMsg,
+                    (uint16_t)sim_pibGet(pDev,
+                                         ApiMac_attribute_shortAddress, 2));
+    MT_MSG_wrU32(pMsg, TIMER_getNow());
+    MT_MSG_wrU16(pMsg, 0);
+    MT_MSG_wrU16(pMsg, pan_id);
+    MT_MSG_wrU16(pMsg, pan_id);
+    /* link quality, correlation, rssi: a decent link */
+    MT_MSG_wrU8(pMsg, 0xe0);
+    MT_MSG_wrU8(pMsg, 0x6e);
+    MT_MSG_wrU8(pMsg, (uint8_t)(-50 - (int)(sim_rand16(pDev) % 30)));
+    MT_MSG_wrU8(pMsg, pS->dsn++);
+    MT_MSG_wrBuf(pMsg, pDev->sec, SIM_SEC_LEN);
+    MT_MSG_wrU32(pMsg, pS->frame_cntr++);
+    MT_MSG_wrU16(pMsg, (uint16_t)(len));
+    MT_MSG_wrU16(pMsg, 0);
+    MT_MSG_wrBuf(pMsg, pMsdu, len);
+    sim_send(pMsg);
+}
+
+/*!
+ * @brief Send the sensor data message
+ * @param pDev - the device
+ * @param pS - the sensor
+ * @param idx - the sensor index
+ */
+static void sim_sensorData(struct sim_device *pDev,
+                           struct sim_sensor *pS,
+                           int idx)
+{
+    uint8_t msdu[ SIM_MSDU_MAX ];
+    uint64_t ext;
+    uint16_t fc;
+    uint16_t v;
+    int n;
+    int x;
+
+    fc = pS->frame_control & SIM_SMSGS_supported;
+    ext = sim_sensorExtAddr(pDev, idx);
+
+    n = 0;
+    msdu[n++] = SIM_SMSGS_sensorData;
+    for(x = 0 ; x < 8 ; x++)
+    {
+        msdu[n++] = (uint8_t)(ext >> (8 * x));
+    }
+    msdu[n++] = (uint8_t)(fc);
+    msdu[n++] = (uint8_t)(fc >> 8);
+
+    /* fields are in bit order */
+    if(fc & SIM_SMSGS_temp)
+    {
+        /* ambience and object temperature, degrees C */
+        v = (uint16_t)(20 + (sim_rand16(pDev) % 5));
+        msdu[n++] = (uint8_t)(v);
+        msdu[n++] = (uint8_t)(v >> 8);
+        msdu[n++] = (uint8_t)(v);
+        msdu[n++] = (uint8_t)(v >> 8);
+    }
+    if(fc & SIM_SMSGS_light)
+    {
+        v = (uint16_t)(400 + (sim_rand16(pDev) % 100));
+        msdu[n++] = (uint8_t)(v);
+        msdu[n++] = (uint8_t)(v >> 8);
+    }
+    if(fc & SIM_SMSGS_humidity)
+    {
+        /* temperature, then humidity */
+        v = (uint16_t)(20 + (sim_rand16(pDev) % 5));
+        msdu[n++] = (uint8_t)(v);
+        msdu[n++] = (uint8_t)(v >> 8);
+        v = (uint16_t)(40 + (sim_rand16(pDev) % 20));
+        msdu[n++] = (uint8_t)(v);
+        msdu[n++] = (uint8_t)(v >> 8);
+    }
+    if(fc & SIM_SMSGS_configSettings)
+    {
+        for(x = 0 ; x < 4 ; x++)
+        {
+            msdu[n++] = (uint8_t)(pS->report_mSecs >> (8 * x));
+        }
+        for(x = 0 ; x < 4 ; x++)
+        {
+            msdu[n++] = (uint8_t)(pS->poll_mSecs >> (8 * x));
+        }
+    }
+
+    sim_dataInd(pDev, pS, msdu, n);
+}
+
+/*!
+ * @brief A sensor received a message from the collector, reply to it
+ * @param pDev - the device
+ * @param pS - the sensor
+ * @param pMsdu - the message
+ * @param len - message length
+ */
+static void sim_sensorRx(struct sim_device *pDev,
+                         struct sim_sensor *pS,
+                         const uint8_t *pMsdu,
+                         int len)
+{
+    uint8_t rsp[ SIM_MSDU_MAX ];
+    uint16_t fc;
+    int n;
+    int x;
+
+    if(len < 1)
+    {
+        return;
+    }
+
+    n = 0;
+    switch(pMsdu[0])
+    {
+    default:
+        /* nothing to say */
+        return;
+    case SIM_SMSGS_configReq:
+        if(len < 11)
+        {
+            return;
+        }
+        pS->frame_control = (uint16_t)(pMsdu[1] | (pMsdu[2] << 8));
+        pS->report_mSecs = ((uint32_t)(pMsdu[3])) |
+            ((uint32_t)(pMsdu[4]) << 8) |
+            ((uint32_t)(pMsdu[5]) << 16) |
+            ((uint32_t)(pMsdu[6]) << 24);
+        pS->poll_mSecs = ((uint32_t)(pMsdu[7])) |
+            ((uint32_t)(pMsdu[8]) << 8) |
+            ((uint32_t)(pMsdu[9]) << 16) |
+            ((uint32_t)(pMsdu[10]) << 24);
+        if(sim_cfg.report_interval_mSecs)
+        {
+            pS->report_mSecs = (uint32_t)(sim_cfg.report_interval_mSecs);
+        }
+        /* spread the first report over one interval */
+        if(pS->report_mSecs)
+        {
+            pS->due = TIMER_getNow() + (sim_rand16(pDev) % pS->report_mSecs);
+        }
+
+        fc = pS->frame_control & SIM_SMSGS_supported;
+        rsp[n++] = SIM_SMSGS_configRsp;
+        rsp[n++] = (fc == pS->frame_control) ?
+            SIM_SMSGS_success : SIM_SMSGS_partialSuccess;
+        rsp[n++] = 0;
+        rsp[n++] = (uint8_t)(fc);
+        rsp[n++] = (uint8_t)(fc >> 8);
+        for(x = 0 ; x < 4 ; x++)
+        {
+            rsp[n++] = (uint8_t)(pS->report_mSecs >> (8 * x));
+        }
+        for(x = 0 ; x < 4 ; x++)
+        {
+            rsp[n++] = (uint8_t)(pS->poll_mSecs >> (8 * x));
+        }
+        break;
+    case SIM_SMSGS_trackingReq:
+        rsp[n++] = SIM_SMSGS_trackingRsp;
+        break;
+    case SIM_SMSGS_toggleLedReq:
+        pS->led = !(pS->led);
+        rsp[n++] = SIM_SMSGS_toggleLedRsp;
+        rsp[n++] = pS->led;
+        break;
+    case SIM_SMSGS_deviceTypeReq:
+        rsp[n++] = SIM_SMSGS_deviceTypeRsp;
+        /* device family and type: unknown */
+        rsp[n++] = 0xff;
+        rsp[n++] = 0xff;
+        break;
+    }
+
+    if(sim_isLost(pDev))
+    {
+        return;
+    }
+    pDev->stats.responses++;
+    sim_dataInd(pDev, pS, rsp, n);
+}
+
+/*!
+ * @brief Handle a data request
+ * @param pDev - the device
+ * @param pReq - the request
+ */
+static void sim_dataReq(struct sim_device *pDev, struct mt_msg *pReq)
+{
+    uint8_t msdu[ SIM_MSDU_MAX ];
+    struct mt_msg *pCnf;
+    uint8_t handle;
+    uint8_t sec[ SIM_SEC_LEN ];
+    bool is_lost;
+    int idx;
+    int len;
+
+    pDev->stats.data_reqs++;
+
+    idx = sim_rdAddr(pDev, pReq);
+    MT_MSG_rdU16(pReq);                  /* dstPanId */
+    MT_MSG_rdU8(pReq);                   /* srcAddrMode */
+    handle = MT_MSG_rdU8(pReq);
+    MT_MSG_rdU8(pReq);                   /* txOptions */
+    MT_MSG_rdU8(pReq);                   /* channel */
+    MT_MSG_rdU8(pReq);                   /* power */
+    MT_MSG_rdBuf(pReq, sec, SIM_SEC_LEN);
+    MT_MSG_rdU32(pReq);                  /* includeFhIEs */
+    len = MT_MSG_rdU16(pReq);
+    MT_MSG_rdU16(pReq);                  /* payloadIELen */
+    if(len > (int)sizeof(msdu))
+    {
+        /* nothing we understand is this big */
+        len = 0;
+    }
+    MT_MSG_rdBuf(pReq, msdu, len);
+
+    if(pReq->is_error)
+    {
+        sim_srspStatus(pDev, pReq, ApiMac_status_invalidParameter);
+        return;
+    }
+    sim_srspStatus(pDev, pReq, ApiMac_status_success);
+
+    /* use the same key as the collector */
+    if(sec[APIMAC_KEY_SOURCE_MAX_LEN] != 0)
+    {
+        memcpy((void *)(pDev->sec), (void *)(sec), SIM_SEC_LEN);
+    }
+
+    /* nobody there is the same as a lost frame */
+    is_lost = sim_isLost(pDev);
+    if((idx < 0) || (pDev->pSensors[idx].state != SIM_SENSOR_joined))
+    {
+        is_lost = true;
+    }
+    if(is_lost)
+    {
+        pDev->stats.data_no_acks++;
+    }
+
+    pCnf = sim_newMsg(pDev, 16, MAC_DATA_CNF_cmd0, MAC_DATA_CNF_cmd1,
+                      "data-cnf");
+    if(pCnf)
+    {
+        MT_MSG_wrU8(pCnf, is_lost ? ApiMac_status_noAck : ApiMac_status_success);
+        MT_MSG_wrU8(pCnf, handle);
+        MT_MSG_wrU32(pCnf, TIMER_getNow());
+        MT_MSG_wrU16(pCnf, 0);
+        MT_MSG_wrU8(pCnf, is_lost ? 3 : 0);   /* retries */
+        MT_MSG_wrU8(pCnf, 0xe0);              /* link quality */
+        MT_MSG_wrU8(pCnf, 0x6e);              /* correlation */
+        MT_MSG_wrU8(pCnf, (uint8_t)(-50));    /* rssi */
+        MT_MSG_wrU32(pCnf, 0);                /* frame counter */
+        sim_send(pCnf);
+    }
+
+    if(!is_lost)
+    {
+        sim_sensorRx(pDev, &(pDev->pSensors[idx]), msdu, len);
+    }
+}
+
+/*!
+ * @brief Handle an associate response
+ * @param pDev - the device
+ * @param pReq - the response from the collector
+ */
+static void sim_associateRsp(struct sim_device *pDev, struct mt_msg *pReq)
+{
+    struct sim_sensor *pS;
+    struct mt_msg *pInd;
+    uint64_t ext;
+    uint16_t short_addr;
+    uint32_t now;
+    int status;
+    int idx;
+
+    ext = MT_MSG_rdU64(pReq);
+    short_addr = MT_MSG_rdU16(pReq);
+    status = MT_MSG_rdU8(pReq);
+    sim_srspStatus(pDev, pReq, ApiMac_status_success);
+
+    idx = (int)(ext - pDev->ext_addr - 1);
+    if((ext <= pDev->ext_addr) || (idx >= pDev->n_sensors))
+    {
+        return;
+    }
+    pS = &(pDev->pSensors[idx]);
+
+    now = TIMER_getNow();
+    if(status != ApiMac_assocStatus_success)
+    {
+        /* at capacity, or denied: try again much later */
+        pS->state = SIM_SENSOR_idle;
+        pS->due = now + (SIM_ASSOC_REJECT_BACKOFF *
+                         (uint32_t)(sim_cfg.join_interval_mSecs));
+        return;
+    }
+
+    /* a rejoin might get a new address */
+    if(pS->state == SIM_SENSOR_joined)
+    {
+        pDev->pShortMap[pS->short_addr] = 0;
+    }
+    pS->state = SIM_SENSOR_joined;
+    pS->short_addr = short_addr;
+    pDev->pShortMap[short_addr] = (uint16_t)(idx + 1);
+
+    /* like the sensor example, report before being configured */
+    if(pS->report_mSecs == 0)
+    {
+        pS->report_mSecs = SIM_DEFAULT_REPORT_mSecs;
+        if(sim_cfg.report_interval_mSecs)
+        {
+            pS->report_mSecs = (uint32_t)(sim_cfg.report_interval_mSecs);
+        }
+    }
+    pS->due = now + (sim_rand16(pDev) % SIM_FIRST_REPORT_mSecs);
+
+    /* the response reached the sensor */
+    pInd = sim_newMsg(pDev, 1 + (2 * SIM_ADDR_LEN) + 2 + 1 + SIM_SEC_LEN,
+                      MAC_COMM_STATUS_IND_cmd0, MAC_COMM_STATUS_IND_cmd1,
+                      "comm-status-ind");
+    if(pInd)
+    {
+        MT_MSG_wrU8(pInd, ApiMac_status_success);
+        sim_wrAddrExt(pInd, pDev->ext_addr);
+        sim_wrAddrExt(pInd, ext);
+        MT_MSG_wrU16(pInd,
+                     (uint16_t)sim_pibGet(pDev, ApiMac_attribute_panId, 2));
+        MT_MSG_wrU8(pInd, ApiMac_commStatusReason_assocRsp);
+        MT_MSG_wrBuf(pInd, pDev->sec, SIM_SEC_LEN);
+        sim_send(pInd);
+    }
+}
+
+/*!
+ * @brief Handle a disassociate request
+ * @param pDev - the device
+ * @param pReq - the request
+ */
+static void sim_disassociateReq(struct sim_device *pDev, struct mt_msg *pReq)
+{
+    struct sim_sensor *pS;
+    struct mt_msg *pCnf;
+    uint16_t pan_id;
+    int idx;
+
+    idx = sim_rdAddr(pDev, pReq);
+    pan_id = MT_MSG_rdU16(pReq);
+    sim_srspStatus(pDev, pReq, ApiMac_status_success);
+
+    pCnf = sim_newMsg(pDev, 1 + SIM_ADDR_LEN + 2,
+                      MAC_DISASSOCIATE_CNF_cmd0, MAC_DISASSOCIATE_CNF_cmd1,
+                      "disassociate-cnf");
+    if(pCnf == NULL)
+    {
+        return;
+    }
+    if(idx < 0)
+    {
+        MT_MSG_wrU8(pCnf, ApiMac_status_noAck);
+        MT_MSG_wrU8(pCnf, ApiMac_addrType_none);
+        MT_MSG_wrBuf(pCnf, NULL, SIM_ADDR_LEN - 1);
+    }
+    else
+    {
+        pS = &(pDev->pSensors[idx]);
+        if(pS->state == SIM_SENSOR_joined)
+        {
+            pDev->pShortMap[pS->short_addr] = 0;
+        }
+        pS->state = SIM_SENSOR_idle;
+        /* it comes back after a while */
+        pS->due = TIMER_getNow() + SIM_ASSOC_TIMEOUT_mSecs;
+        MT_MSG_wrU8(pCnf, ApiMac_status_success);
+        sim_wrAddrExt(pCnf, sim_sensorExtAddr(pDev, idx));
+    }
+    MT_MSG_wrU16(pCnf, pan_id);
+    sim_send(pCnf);
+}
+
+/*!
+ * @brief Handle a scan request, there are no other networks
+ * @param pDev - the device
+ * @param pReq - the request
+ */
+static void sim_scanReq(struct sim_device *pDev, struct mt_msg *pReq)
+{
+    struct mt_msg *pCnf;
+    int scan_type;
+    int page;
+    int phy_id;
+    int n;
+
+    scan_type = MT_MSG_rdU8(pReq);
+    MT_MSG_rdU8(pReq);                   /* duration */
+    page = MT_MSG_rdU8(pReq);
+    phy_id = MT_MSG_rdU8(pReq);
+    sim_srspStatus(pDev, pReq, ApiMac_status_success);
+
+    n = 0;
+    if(scan_type == ApiMac_scantype_energyDetect)
+    {
+        n = SIM_ED_RESULTS;
+    }
+
+    pCnf = sim_newMsg(pDev, 4 + 17 + 1 + n,
+                      MAC_SCAN_CNF_cmd0, MAC_SCAN_CNF_cmd1, "scan-cnf");
+    if(pCnf == NULL)
+    {
+        return;
+    }
+    switch(scan_type)
+    {
+    case ApiMac_scantype_energyDetect:
+    case ApiMac_scantype_orphan:
+        MT_MSG_wrU8(pCnf, ApiMac_status_success);
+        break;
+    default:
+        MT_MSG_wrU8(pCnf, ApiMac_status_noBeacon);
+        break;
+    }
+    MT_MSG_wrU8(pCnf, (uint8_t)(scan_type));
+    MT_MSG_wrU8(pCnf, (uint8_t)(page));
+    MT_MSG_wrU8(pCnf, (uint8_t)(phy_id));
+    MT_MSG_wrBuf(pCnf, NULL, 17);        /* unscanned channels */
+    MT_MSG_wrU8(pCnf, (uint8_t)(n));
+    /* every channel is quiet */
+    MT_MSG_wrBuf(pCnf, NULL, n);
+    sim_send(pCnf);
+}
+
+/*!
+ * @brief Handle a start request
+ * @param pDev - the device
+ * @param pReq - the request
+ */
+static void sim_startReq(struct sim_device *pDev, struct mt_msg *pReq)
+{
+    struct mt_msg *pCnf;
+    uint16_t pan_id;
+    uint8_t channel;
+
+    MT_MSG_rdU32(pReq);                  /* startTime */
+    pan_id = MT_MSG_rdU16(pReq);
+    channel = MT_MSG_rdU8(pReq);
+    sim_srspStatus(pDev, pReq, ApiMac_status_success);
+
+    sim_pibPut(pDev, ApiMac_attribute_panId, 2, pan_id);
+    sim_pibPut(pDev, ApiMac_attribute_logicalChannel, 1, channel);
+    pDev->started = true;
+    LOG_printf(LOG_ALWAYS, "%s: started pan 0x%04x channel %d\n",
+               pDev->dbg_name, pan_id, channel);
+
+    pCnf = sim_newMsg(pDev, 1, MAC_START_CNF_cmd0, MAC_START_CNF_cmd1,
+                      "start-cnf");
+    if(pCnf)
+    {
+        MT_MSG_wrU8(pCnf, ApiMac_status_success);
+        sim_send(pCnf);
+    }
+}
+
+/*!
+ * @brief Handle PIB get requests
+ * @param pDev - the device
+ * @param pReq - the request
+ */
+static void sim_pibGetReq(struct sim_device *pDev, struct mt_msg *pReq)
+{
+    struct mt_msg *pRsp;
+    int size;
+    int id;
+
+    if(pReq->cmd1 == SIM_MAC_FH_GET_REQ)
+    {
+        id = MT_MSG_rdU16(pReq);
+    }
+    else
+    {
+        id = MT_MSG_rdU8(pReq);
+    }
+
+    size = sim_pibSize(id);
+    if((size == 0) ||
+       ((pReq->cmd1 == SIM_MAC_SECURITY_GET_REQ) != _inrange(id, 0x80, 0x90)))
+    {
+        sim_srspStatus(pDev, pReq, ApiMac_status_unsupportedAttribute);
+        return;
+    }
+
+    pRsp = sim_newMsg(pDev, 1 + size,
+                      MT_MSG_cmd0_srsp(pReq->cmd0), pReq->cmd1, "pib-get");
+    if(pRsp)
+    {
+        MT_MSG_wrU8(pRsp, ApiMac_status_success);
+        MT_MSG_wrBuf(pRsp, sim_pib(pDev, id), size);
+        sim_send(pRsp);
+    }
+}
+
+/*!
+ * @brief Handle PIB set requests
+ * @param pDev - the device
+ * @param pReq - the request
+ * @param start - where the request payload starts
+ */
+static void sim_pibSetReq(struct sim_device *pDev,
+                          struct mt_msg *pReq,
+                          int start)
+{
+    uint8_t *pV;
+    int n;
+    int id;
+
+    if(pReq->cmd1 == SIM_MAC_FH_SET_REQ)
+    {
+        id = MT_MSG_rdU16(pReq);
+    }
+    else
+    {
+        id = MT_MSG_rdU8(pReq);
+    }
+    if((pReq->cmd1 == SIM_MAC_SECURITY_SET_REQ) && _inrange(id, 0x80, 0x90))
+    {
+        /* table indexes, not used */
+        MT_MSG_rdU16(pReq);
+        MT_MSG_rdU16(pReq);
+    }
+
+    /* security structures are accepted, but not kept */
+    pV = NULL;
+    if(sim_pibSize(id))
+    {
+        pV = sim_pib(pDev, id);
+    }
+
+    /* scalars come with filler, keep what fits */
+    n = pReq->expected_len - (pReq->iobuf_idx - start);
+    if(pV && (n > 0))
+    {
+        if(n > SIM_PIB_MAX)
+        {
+            n = SIM_PIB_MAX;
+        }
+        memset((void *)(pV), 0, SIM_PIB_MAX);
+        MT_MSG_rdBuf(pReq, pV, n);
+    }
+    sim_srspStatus(pDev, pReq, ApiMac_status_success);
+}
+
+/*!
+ * @brief Handle a MAC SREQ
+ * @param pDev - the device
+ * @param pReq - the request
+ * @param start - where the request payload starts
+ */
+static void sim_macSreq(struct sim_device *pDev,
+                        struct mt_msg *pReq,
+                        int start)
+{
+    struct mt_msg *pRsp;
+
+    switch(pReq->cmd1)
+    {
+    default:
+        /* enable FH, sec add device, src match ... */
+        sim_srspStatus(pDev, pReq, ApiMac_status_success);
+        break;
+    case SIM_MAC_RESET_REQ:
+        sim_reset(pDev, MT_MSG_rdU8(pReq) != 0);
+        sim_srspStatus(pDev, pReq, ApiMac_status_success);
+        break;
+    case SIM_MAC_START_REQ:
+        sim_startReq(pDev, pReq);
+        break;
+    case SIM_MAC_DATA_REQ:
+        sim_dataReq(pDev, pReq);
+        break;
+    case SIM_MAC_DISASSOCIATE_REQ:
+        sim_disassociateReq(pDev, pReq);
+        break;
+    case SIM_MAC_SCAN_REQ:
+        sim_scanReq(pDev, pReq);
+        break;
+    case SIM_MAC_ASSOCIATE_RSP:
+        sim_associateRsp(pDev, pReq);
+        break;
+    case SIM_MAC_GET_REQ:
+    case SIM_MAC_SECURITY_GET_REQ:
+    case SIM_MAC_FH_GET_REQ:
+        sim_pibGetReq(pDev, pReq);
+        break;
+    case SIM_MAC_SET_REQ:
+    case SIM_MAC_SECURITY_SET_REQ:
+    case SIM_MAC_FH_SET_REQ:
+        sim_pibSetReq(pDev, pReq, start);
+        break;
+    case SIM_MAC_GET_DEF_SRC_KEY:
+        pRsp = sim_newMsg(pDev, 5, MT_MSG_cmd0_srsp(pReq->cmd0), pReq->cmd1,
+                          "def-src-key");
+        if(pRsp)
+        {
+            MT_MSG_wrU8(pRsp, ApiMac_status_success);
+            MT_MSG_wrU32(pRsp, 0);
+            sim_send(pRsp);
+        }
+        break;
+    }
+}
+
+/*!
+ * @brief Handle a SYS or UTIL SREQ
+ * @param pDev - the device
+ * @param pReq - the request
+ * @param start - where the request payload starts
+ */
+static void sim_sysSreq(struct sim_device *pDev,
+                        struct mt_msg *pReq,
+                        int start)
+{
+    struct mt_msg *pRsp;
+    int type;
+
+    if((pReq->cmd0 == SYS_VERSION_REQ_cmd0) &&
+       (pReq->cmd1 == SYS_VERSION_REQ_cmd1))
+    {
+        pRsp = sim_newMsg(pDev, 5, MT_MSG_cmd0_srsp(pReq->cmd0), pReq->cmd1,
+                          "version");
+        if(pRsp)
+        {
+            MT_MSG_wrU8(pRsp, SIM_VERSION_TRANSPORT);
+            MT_MSG_wrU8(pRsp, SIM_VERSION_PRODUCT);
+            MT_MSG_wrU8(pRsp, SIM_VERSION_MAJOR);
+            MT_MSG_wrU8(pRsp, SIM_VERSION_MINOR);
+            MT_MSG_wrU8(pRsp, SIM_VERSION_MAINT);
+            sim_send(pRsp);
+        }
+        return;
+    }
+
+    if((pReq->cmd0 == MT_UTIL_GET_EXT_ADDR_cmd0) &&
+       (pReq->cmd1 == MT_UTIL_GET_EXT_ADDR_cmd1))
+    {
+        type = MT_MSG_rdU8(pReq);
+        pRsp = sim_newMsg(pDev, 9, MT_MSG_cmd0_srsp(pReq->cmd0), pReq->cmd1,
+                          "ext-addr");
+        if(pRsp)
+        {
+            MT_MSG_wrU8(pRsp, (uint8_t)(type));
+            if(type == 2)
+            {
+                /* the CCFG address is not programmed */
+                MT_MSG_wrU64(pRsp, ~((uint64_t)(0)));
+            }
+            else
+            {
+                MT_MSG_wrU64(pRsp, pDev->ext_addr);
+            }
+            sim_send(pRsp);
+        }
+        return;
+    }
+
+    if((pReq->cmd0 == MT_UTIL_LOOPBACK_cmd0) &&
+       (pReq->cmd1 == MT_UTIL_LOOPBACK_cmd1))
+    {
+        pRsp = sim_newMsg(pDev, pReq->expected_len,
+                          MT_MSG_cmd0_srsp(pReq->cmd0), pReq->cmd1,
+                          "loopback");
+        if(pRsp)
+        {
+            MT_MSG_wrBuf(pRsp, &(pReq->iobuf[start]), pReq->expected_len);
+            sim_send(pRsp);
+        }
+        return;
+    }
+
+    MT_MSG_log(LOG_ERROR, pReq, "%s: unknown SREQ\n", pDev->dbg_name);
+    sim_srspStatus(pDev, pReq, ApiMac_status_unsupported);
+}
+
+/*!
+ * @brief Handle an AREQ from the host
+ * @param pDev - the device
+ * @param pReq - the request
+ */
+static void sim_areq(struct sim_device *pDev, struct mt_msg *pReq)
+{
+    struct mt_msg *pInd;
+
+    if((pReq->cmd0 != SYS_RESET_REQ_cmd0) ||
+       (pReq->cmd1 != SYS_RESET_REQ_cmd1))
+    {
+        return;
+    }
+
+    LOG_printf(LOG_ALWAYS, "%s: reset\n", pDev->dbg_name);
+    sim_reset(pDev, true);
+
+    pInd = sim_newMsg(pDev, 6, SYS_RESET_IND_cmd0, SYS_RESET_IND_cmd1,
+                      "reset-ind");
+    if(pInd)
+    {
+        MT_MSG_wrU8(pInd, ApiMac_resetReason_hostReq);
+        MT_MSG_wrU8(pInd, SIM_VERSION_TRANSPORT);
+        MT_MSG_wrU8(pInd, SIM_VERSION_PRODUCT);
+        MT_MSG_wrU8(pInd, SIM_VERSION_MAJOR);
+        MT_MSG_wrU8(pInd, SIM_VERSION_MINOR);
+        MT_MSG_wrU8(pInd, SIM_VERSION_MAINT);
+        sim_send(pInd);
+    }
+}
+
+/*!
+ * @brief Let the next unjoined sensor try to join
+ * @param pDev - the device
+ * @param now - TIMER_getNow()
+ */
+static void sim_join(struct sim_device *pDev, uint32_t now)
+{
+    struct sim_sensor *pS;
+    struct mt_msg *pInd;
+    uint8_t cap;
+    int idx;
+    int x;
+
+    if(!(pDev->pib[ApiMac_attribute_associatePermit][0]) ||
+       !sim_isDue(now, pDev->join_due))
+    {
+        return;
+    }
+
+    pS = NULL;
+    idx = 0;
+    for(x = 0 ; x < pDev->n_sensors ; x++)
+    {
+        idx = (pDev->join_cursor + x) % pDev->n_sensors;
+        pS = &(pDev->pSensors[idx]);
+        if((pS->state != SIM_SENSOR_joined) && sim_isDue(now, pS->due))
+        {
+            break;
+        }
+    }
+    if((x == pDev->n_sensors) || (pS == NULL))
+    {
+        return;
+    }
+    pDev->join_cursor = idx + 1;
+    pDev->join_due = now + (uint32_t)(sim_cfg.join_interval_mSecs);
+
+    pS->state = SIM_SENSOR_joining;
+    pS->due = now + SIM_ASSOC_TIMEOUT_mSecs;
+    if(sim_isLost(pDev))
+    {
+        return;
+    }
+
+    cap = SIM_CAP_allocAddr;
+    if(!sim_cfg.sleepy)
+    {
+        cap |= SIM_CAP_rxOnWhenIdle | SIM_CAP_mainsPower;
+    }
+    if(sim_cfg.security_level)
+    {
+        cap |= SIM_CAP_security;
+    }
+
+    pInd = sim_newMsg(pDev, 8 + 1 + SIM_SEC_LEN,
+                      MAC_ASSOCIATE_IND_cmd0, MAC_ASSOCIATE_IND_cmd1,
+                      "associate-ind");
+    if(pInd)
+    {
+        pDev->stats.assoc_inds++;
+        MT_MSG_wrU64(pInd, sim_sensorExtAddr(pDev, idx));
+        MT_MSG_wrU8(pInd, cap);
+        MT_MSG_wrBuf(pInd, pDev->sec, SIM_SEC_LEN);
+        sim_send(pInd);
+    }
+}
+
+/*!
+ * @brief Send the reports that are due
+ * @param pDev - the device
+ * @param now - TIMER_getNow()
+ */
+static void sim_report(struct sim_device *pDev, uint32_t now)
+{
+    struct sim_sensor *pS;
+    int x;
+
+    for(x = 0 ; x < pDev->n_sensors ; x++)
+    {
+        pS = &(pDev->pSensors[x]);
+        if((pS->state != SIM_SENSOR_joined) || (pS->report_mSecs == 0) ||
+           !sim_isDue(now, pS->due))
+        {
+            continue;
+        }
+        pS->due = now + sim_jitter(pDev, pS->report_mSecs);
+
+        if(sim_isLost(pDev))
+        {
+            pDev->stats.reports_lost++;
+            continue;
+        }
+        pDev->stats.reports++;
+        sim_sensorData(pDev, pS, x);
+    }
+}
+
+/*!
+ * @brief Log the statistics
+ * @param pDev - the device
+ * @param now - TIMER_getNow()
+ */
+static void sim_logStats(struct sim_device *pDev, uint32_t now)
+{
+    int joined;
+    int x;
+
+    if((sim_cfg.stats_interval_mSecs == 0) || !sim_isDue(now, pDev->stats_due))
+    {
+        return;
+    }
+    pDev->stats_due = now + (uint32_t)(sim_cfg.stats_interval_mSecs);
+
+    joined = 0;
+    for(x = 0 ; x < pDev->n_sensors ; x++)
+    {
+        if(pDev->pSensors[x].state == SIM_SENSOR_joined)
+        {
+            joined++;
+        }
+    }
+
+    LOG_printf(LOG_ALWAYS,
+               "%s: joined: %d/%d assoc-ind: %u sreq: %u data-req: %u "
+               "(no-ack: %u) reports: %u (lost: %u) responses: %u\n",
+               pDev->dbg_name, joined, pDev->n_sensors,
+               pDev->stats.assoc_inds,
+               pDev->stats.sreqs,
+               pDev->stats.data_reqs,
+               pDev->stats.data_no_acks,
+               pDev->stats.reports,
+               pDev->stats.reports_lost,
+               pDev->stats.responses);
+}
+
+/*!
+ * @brief Play a capture to the host instead of simulating sensors
+ * @param pDev - the device
+ *
+ * The replay starts when the host sends its first message, so the
+ * host sees the captured traffic the way it saw it the first time.
+ */
+static void sim_replay(struct sim_device *pDev)
+{
+    struct mt_msg_replay_cfg cfg;
+    struct mt_msg_replay_result res;
+    int r;
+
+    while(!(pDev->host_seen))
+    {
+        if(pDev->is_dead)
+        {
+            return;
+        }
+        TIMER_sleep(SIM_TICK_mSecs);
+    }
+
+    memset((void *)(&cfg), 0, sizeof(cfg));
+    cfg.filename = sim_cfg.replay_file;
+    cfg.iface_name = sim_cfg.replay_iface;
+    cfg.type = MT_MSG_CAPTURE_rx;
+    cfg.speed = sim_cfg.replay_speed;
+    cfg.transmit = true;
+    cfg.loops = sim_cfg.replay_loops;
+    cfg.pStop = &(pDev->is_dead);
+
+    LOG_printf(LOG_ALWAYS, "%s: replay %s\n",
+               pDev->dbg_name, sim_cfg.replay_file);
+    r = MT_MSG_replay(&(pDev->iface), &cfg, &res);
+    LOG_printf(LOG_ALWAYS,
+               "%s: replay r=%d frames=%u bytes=%u skipped=%u "
+               "errors=%u mSecs=%u\n",
+               pDev->dbg_name, r,
+               (unsigned)(res.n_frames),
+               (unsigned)(res.n_bytes),
+               (unsigned)(res.n_skipped),
+               (unsigned)(res.n_errors),
+               (unsigned)(res.elapsed_nSecs / 1000000));
+}
+
+/*!
+ * @brief Thread that generates the sensor traffic
+ * @param cookie - the device
+ * @returns nothing
+ */
+static intptr_t sim_trafficThread(intptr_t cookie)
+{
+    struct sim_device *pDev;
+    uint32_t now;
+
+    pDev = (struct sim_device *)(cookie);
+    if(sim_cfg.replay_file)
+    {
+        sim_replay(pDev);
+        return (0);
+    }
+    while(!(pDev->is_dead))
+    {
+        TIMER_sleep(SIM_TICK_mSecs);
+
+        now = TIMER_getNow();
+        MUTEX_lock(pDev->lock, -1);
+        if(pDev->started && pDev->n_sensors)
+        {
+            sim_join(pDev, now);
+            sim_report(pDev, now);
+        }
+        sim_logStats(pDev, now);
+        MUTEX_unLock(pDev->lock);
+    }
+    return (0);
+}
+
+/*!
+ * @brief Handle one message from the host
+ * @param pDev - the device
+ * @param pMsg - the message
+ */
+static void sim_handle(struct sim_device *pDev, struct mt_msg *pMsg)
+{
+    int start;
+
+    start = pMsg->iobuf_idx;
+
+    switch(pMsg->m_type)
+    {
+    default:
+        MT_MSG_log(LOG_ERROR, pMsg, "%s: unexpected message type\n",
+                   pDev->dbg_name);
+        break;
+    case MT_MSG_TYPE_areq:
+        sim_areq(pDev, pMsg);
+        break;
+    case MT_MSG_TYPE_sreq:
+        pDev->stats.sreqs++;
+        if(pMsg->cmd0 == SIM_MAC_cmd0)
+        {
+            sim_macSreq(pDev, pMsg, start);
+        }
+        else
+        {
+            sim_sysSreq(pDev, pMsg, start);
+        }
+        break;
+    }
+}
+
+/*!
+ * @brief Stop the traffic thread, it uses the interface
+ * @param pDev - the device
+ */
+static void sim_stopTraffic(struct sim_device *pDev)
+{
+    pDev->is_dead = true;
+    if(pDev->traffic_thread)
+    {
+        while(THREAD_isAlive(pDev->traffic_thread))
+        {
+            TIMER_sleep(SIM_TICK_mSecs);
+        }
+        THREAD_destroy(pDev->traffic_thread);
+        pDev->traffic_thread = 0;
+    }
+}
+
+/*!
+ * @brief Release a device
+ * @param pDev - the device
+ */
+static void sim_destroy(struct sim_device *pDev)
+{
+    sim_stopTraffic(pDev);
+    if(pDev->lock)
+    {
+        MUTEX_destroy(pDev->lock);
+    }
+    if(pDev->pSensors)
+    {
+        free((void *)(pDev->pSensors));
+    }
+    if(pDev->pShortMap)
+    {
+        free((void *)(pDev->pShortMap));
+    }
+    if(pDev->dbg_name)
+    {
+        free((void *)(pDev->dbg_name));
+    }
+    free((void *)(pDev));
+}
+
+/*!
+ * @brief Thread that answers the host, and owns the device
+ * @param cookie - the device
+ * @returns nothing
+ */
+static intptr_t sim_reqThread(intptr_t cookie)
+{
+    struct sim_device *pDev;
+    struct mt_msg *pMsg;
+    bool is_socket;
+
+    pDev = (struct sim_device *)(cookie);
+    is_socket = (pDev->iface.u_cfg == NULL);
+
+    while(!(pDev->is_dead))
+    {
+        if(pDev->iface.is_dead || STREAM_isError(pDev->iface.hndl))
+        {
+            LOG_printf(LOG_ALWAYS, "%s: host is gone\n", pDev->dbg_name);
+            break;
+        }
+
+        pMsg = MT_MSG_LIST_remove(&(pDev->iface),
+                                  &(pDev->iface.rx_list), 1000);
+        if(pMsg == NULL)
+        {
+            continue;
+        }
+        MT_MSG_stamp(pMsg, MT_MSG_STAMP_rx_dequeue);
+
+        if(sim_cfg.replay_file)
+        {
+            /* the capture already holds the answers */
+            pDev->host_seen = true;
+        }
+        else
+        {
+            MUTEX_lock(pDev->lock, -1);
+            sim_handle(pDev, pMsg);
+            MUTEX_unLock(pDev->lock);
+        }
+
+        MT_MSG_stamp(pMsg, MT_MSG_STAMP_rx_handled);
+        MT_MSG_free(pMsg);
+    }
+    sim_stopTraffic(pDev);
+
+    MT_MSG_interfaceDestroy(&(pDev->iface));
+    if(is_socket)
+    {
+        SOCKET_ACCEPT_destroy(pDev->iface.hndl);
+    }
+    sim_destroy(pDev);
+    return (0);
+}
+
+/*!
+ * @brief Create a simulated co-processor on an interface
+ * @param id - connection number
+ * @param pTemplate - interface settings, hndl is set for sockets
+ * @returns NULL on error
+ */
+static struct sim_device *sim_create(int id,
+                                     const struct mt_msg_interface *pTemplate)
+{
+    struct sim_device *pDev;
+    char buf[30];
+
+    pDev = calloc(1, sizeof(*pDev));
+    if(pDev == NULL)
+    {
+        return (NULL);
+    }
+    pDev->id = id;
+    (void)snprintf(buf, sizeof(buf), "mac-sim-%d", id);
+    pDev->dbg_name = strdup(buf);
+    pDev->lock = MUTEX_create(buf);
+    pDev->n_sensors = sim_cfg.n_sensors;
+    pDev->pSensors = calloc(pDev->n_sensors + 1, sizeof(pDev->pSensors[0]));
+    pDev->pShortMap = calloc(0x10000, sizeof(uint16_t));
+    if((pDev->dbg_name == NULL) || (pDev->lock == 0) ||
+       (pDev->pSensors == NULL) || (pDev->pShortMap == NULL))
+    {
+        goto fail;
+    }
+
+    /* each co-processor has its own block of addresses */
+    pDev->ext_addr = sim_cfg.ext_addr_base + (((uint64_t)(id)) << 32);
+    RAND_DATA_initOne(&(pDev->rand), (uint32_t)(TIMER_getAbsNow()) + id);
+    sim_reset(pDev, true);
+
+    pDev->iface = *pTemplate;
+    pDev->iface.dbg_name = pDev->dbg_name;
+    if(MT_MSG_interfaceCreate(&(pDev->iface)) != 0)
+    {
+        LOG_printf(LOG_ERROR, "%s: cannot create interface\n", buf);
+        goto fail;
+    }
+
+    pDev->traffic_thread = THREAD_create(buf, sim_trafficThread,
+                                         (intptr_t)(pDev),
+                                         THREAD_FLAGS_DEFAULT);
+    if(pDev->traffic_thread == 0)
+    {
+        MT_MSG_interfaceDestroy(&(pDev->iface));
+        goto fail;
+    }
+    return (pDev);
+
+fail:
+    sim_destroy(pDev);
+    return (NULL);
+}
+
+/*!
+ * @brief Start answering the host
+ * @param pDev - the device from sim_create()
+ * @returns 0 on success
+ */
+static int sim_start(struct sim_device *pDev)
+{
+    char buf[30];
+
+    (void)snprintf(buf, sizeof(buf), "%s-req", pDev->dbg_name);
+    pDev->req_thread = THREAD_create(buf, sim_reqThread,
+                                     (intptr_t)(pDev),
+                                     THREAD_FLAGS_DEFAULT);
+    if(pDev->req_thread == 0)
+    {
+        return (-1);
+    }
+    return (0);
+}
+
+/*!
+ * @brief Run one co-processor on a pseudo terminal
+ */
+static void sim_pty(void)
+{
+    struct sim_device *pDev;
+    const char *slave;
+    int slave_fd;
+
+    pDev = sim_create(0, &uart_interface_template);
+    if(pDev == NULL)
+    {
+        FATAL_printf("Cannot create pty\n");
+    }
+
+    slave = ptsname(STREAM_getFd(pDev->iface.hndl));
+    if(slave == NULL)
+    {
+        FATAL_printf("Cannot find the pty slave\n");
+    }
+
+    /* hold the slave open, so the master survives host restarts */
+    slave_fd = open(slave, O_RDWR | O_NOCTTY);
+    if(slave_fd < 0)
+    {
+        FATAL_printf("Cannot open: %s\n", slave);
+    }
+
+    if(sim_cfg.pty_link)
+    {
+        (void)unlink(sim_cfg.pty_link);
+        if(symlink(slave, sim_cfg.pty_link) != 0)
+        {
+            FATAL_printf("Cannot link: %s -> %s\n", sim_cfg.pty_link, slave);
+        }
+    }
+
+    LOG_printf(LOG_ALWAYS, "Simulated MAC co-processor on: %s (%d sensors)\n",
+               sim_cfg.pty_link ? sim_cfg.pty_link : slave,
+               sim_cfg.n_sensors);
+    fprintf(stdout, "Simulated MAC co-processor on: %s (%d sensors)\n",
+            sim_cfg.pty_link ? sim_cfg.pty_link : slave,
+            sim_cfg.n_sensors);
+    fflush(stdout);
+
+    /* this releases the device when the host goes away */
+    (void)sim_reqThread((intptr_t)(pDev));
+    close(slave_fd);
+    if(sim_cfg.pty_link)
+    {
+        (void)unlink(sim_cfg.pty_link);
+    }
+}
+
+/*!
+ * @brief Each connection is a co-processor
+ */
+static void sim_server(void)
+{
+    struct mt_msg_interface iface;
+    struct sim_device *pDev;
+    intptr_t server_handle;
+    int connection_id;
+    int r;
+
+    server_handle = SOCKET_SERVER_create(&my_socket_cfg);
+    if(server_handle == 0)
+    {
+        FATAL_printf("Cannot create server socket\n");
+    }
+    r = SOCKET_SERVER_listen(server_handle);
+    if(r != 0)
+    {
+        FATAL_printf("Cannot set server socket to listen mode\n");
+    }
+
+    LOG_printf(LOG_ALWAYS,
+               "Simulated MAC co-processor listening on port: %s "
+               "(%d sensors)\n",
+               my_socket_cfg.service, sim_cfg.n_sensors);
+    fprintf(stdout,
+            "Simulated MAC co-processor listening on port: %s (%d sensors)\n",
+            my_socket_cfg.service, sim_cfg.n_sensors);
+    fflush(stdout);
+
+    connection_id = 0;
+    for(;;)
+    {
+        if(STREAM_isError(server_handle))
+        {
+            LOG_printf(LOG_ERROR, "Server (accept) socket is dead\n");
+            break;
+        }
+
+        iface = socket_interface_template;
+        r = SOCKET_SERVER_accept(&(iface.hndl), server_handle, 5000);
+        if(r < 0)
+        {
+            BUG_HERE("Cannot accept!\n");
+        }
+        if(r == 0)
+        {
+            continue;
+        }
+
+        pDev = sim_create(connection_id, &iface);
+        if((pDev == NULL) || (sim_start(pDev) != 0))
+        {
+            LOG_printf(LOG_ERROR, "Cannot create co-processor: %d\n",
+                       connection_id);
+            SOCKET_ACCEPT_destroy(iface.hndl);
+            continue;
+        }
+        LOG_printf(LOG_ALWAYS, "Connection %d: %s\n",
+                   connection_id, pDev->dbg_name);
+        connection_id++;
+    }
+}
+
+void APP_main(void)
+{
+    if(sim_cfg.use_socket)
+    {
+        sim_server();
+    }
+    else
+    {
+        sim_pty();
+    }
+}
+
+/*
+ *  ========================================
+ *  Texas Instruments Micro Controller Style
+ *  ========================================
+ *  Local Variables:
+ *  mode: c
+ *  c-file-style: "bsd"
+ *  tab-width: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  End:
+ *  vim:set  filetype=c tabstop=4 shiftwidth=4 expandtab=true
+ */
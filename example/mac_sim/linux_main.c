@@ -0,0 +1,340 @@
+/******************************************************************************
+ @file linux_main.c
+
+ @brief TIMAC 2.0 API Linux "main" for the simulated MAC co-processor
+
+ Group: WCS LPC
+ $Target Device: DEVICES $
+
+ ******************************************************************************
+ $License: BSD3 2016 $
+ ******************************************************************************
+ $Release Name: PACKAGE NAME $
+ $Release Date: PACKAGE RELEASE DATE $
+ *****************************************************************************/
+
+#include "compiler.h"
+#include "mac_sim.h"
+
+#include "ini_file.h"       /* this reads our ini file */
+#include "log.h"            /* our logging scheme */
+#include "mt_msg.h"
+#include "mt_msg_dbg.h"
+#include "timer.h"
+#include "fatal.h"
+#include "stream_socket.h"  /* we use a socket in our app */
+#include "stream_uart.h"    /* and a uart. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const struct ini_flag_name * const log_flag_names[] = {
+    log_builtin_flag_names,
+    mt_msg_log_flags,
+    /* terminate */
+    NULL
+};
+
+/*!
+ * @brief Handle any config file settings for the uart.
+ *
+ * @param pINI - ini file parse info
+ * @param handled - set to true if the item was handled
+ */
+static int my_UART_INI_settings(struct ini_parser *pINI, bool *handled)
+{
+    int r;
+
+    r = 0;
+    if(INI_itemMatches(pINI, "uart-cfg", NULL))
+    {
+        r = UART_INI_settingsOne(pINI, handled, &my_uart_cfg);
+    }
+    return r;
+}
+
+static int my_SOCKET_INI_settings(struct ini_parser *pINI, bool *handled)
+{
+    int r;
+
+    r = 0;
+    if(INI_itemMatches(pINI, "socket-cfg", NULL))
+    {
+        r = SOCKET_INI_settingsOne(pINI, handled, &my_socket_cfg);
+    }
+    return r;
+}
+
+static int my_MT_MSG_INI_settings(struct ini_parser *pINI, bool *handled)
+{
+    int r;
+
+    r = 0;
+    if(INI_itemMatches(pINI, "socket-interface", NULL))
+    {
+        r = MT_MSG_INI_settings(pINI, handled, &socket_interface_template);
+    }
+
+    if(INI_itemMatches(pINI, "uart-interface", NULL))
+    {
+        r = MT_MSG_INI_settings(pINI, handled, &uart_interface_template);
+    }
+    return r;
+}
+
+static int my_APP_settings(struct ini_parser *pINI, bool *handled)
+{
+    if(!INI_itemMatches(pINI, "application", NULL))
+    {
+        return 0;
+    }
+
+    if(INI_itemMatches(pINI,NULL,"msg-dbg-data"))
+    {
+        struct mt_msg_dbg **ppDbg;
+
+        /* append at end of list */
+        ppDbg = &(ALL_MT_MSG_DBG);
+        while( *ppDbg ){
+            ppDbg = &((*ppDbg)->m_pNext);
+        }
+        INI_dequote(pINI);
+        *ppDbg = MT_MSG_dbg_load(pINI->item_value);
+        *handled = true;
+        return 0;
+    }
+    return 0;
+}
+
+static int my_SIM_settings(struct ini_parser *pINI, bool *handled)
+{
+    if(!INI_itemMatches(pINI, "mac-sim", NULL))
+    {
+        return 0;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "transport"))
+    {
+        INI_dequote(pINI);
+        if(0 == strcmp(pINI->item_value, "socket"))
+        {
+            sim_cfg.use_socket = true;
+        }
+        else if(0 == strcmp(pINI->item_value, "pty"))
+        {
+            sim_cfg.use_socket = false;
+        }
+        else
+        {
+            INI_syntaxError(pINI, "transport must be: pty or socket\n");
+            return -1;
+        }
+        *handled = true;
+        return 0;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "pty-link"))
+    {
+        INI_dequote(pINI);
+        sim_cfg.pty_link = strdup(pINI->item_value);
+        if(sim_cfg.pty_link == NULL)
+        {
+            BUG_HERE("No memory\n");
+        }
+        *handled = true;
+        return 0;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "sensors"))
+    {
+        sim_cfg.n_sensors = INI_valueAsInt(pINI);
+        if(!_inrange(sim_cfg.n_sensors, 0, 0xfff0))
+        {
+            INI_syntaxError(pINI, "sensors must be 0..65519\n");
+            return -1;
+        }
+        *handled = true;
+        return 0;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "report-interval-msecs"))
+    {
+        sim_cfg.report_interval_mSecs = INI_valueAsInt(pINI);
+        *handled = true;
+        return 0;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "join-interval-msecs"))
+    {
+        sim_cfg.join_interval_mSecs = INI_valueAsInt(pINI);
+        *handled = true;
+        return 0;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "loss-percent"))
+    {
+        sim_cfg.loss_percent = INI_valueAsInt(pINI);
+        if(!_inrange(sim_cfg.loss_percent, 0, 101))
+        {
+            INI_syntaxError(pINI, "loss-percent must be 0..100\n");
+            return -1;
+        }
+        *handled = true;
+        return 0;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "sleepy"))
+    {
+        sim_cfg.sleepy = INI_valueAsBool(pINI);
+        *handled = true;
+        return 0;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "security-level"))
+    {
+        sim_cfg.security_level = INI_valueAsInt(pINI);
+        *handled = true;
+        return 0;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "ext-addr-base"))
+    {
+        INI_dequote(pINI);
+        sim_cfg.ext_addr_base = strtoull(pINI->item_value, NULL, 0);
+        *handled = true;
+        return 0;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "stats-interval-msecs"))
+    {
+        sim_cfg.stats_interval_mSecs = INI_valueAsInt(pINI);
+        *handled = true;
+        return 0;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "replay"))
+    {
+        INI_dequote(pINI);
+        sim_cfg.replay_file = INI_itemValue_strdup(pINI);
+        *handled = true;
+        return 0;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "replay-iface"))
+    {
+        INI_dequote(pINI);
+        sim_cfg.replay_iface = INI_itemValue_strdup(pINI);
+        *handled = true;
+        return 0;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "replay-speed"))
+    {
+        sim_cfg.replay_speed = INI_valueAsInt(pINI);
+        if(sim_cfg.replay_speed < 0)
+        {
+            INI_syntaxError(pINI, "replay-speed must be >= 0\n");
+            return -1;
+        }
+        *handled = true;
+        return 0;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "replay-loops"))
+    {
+        sim_cfg.replay_loops = INI_valueAsInt(pINI);
+        *handled = true;
+        return 0;
+    }
+    return 0;
+}
+
+static ini_rd_callback * const ini_cb_table[] = {
+    LOG_INI_settings,
+    my_UART_INI_settings,
+    my_SOCKET_INI_settings,
+    my_MT_MSG_INI_settings,
+    my_SIM_settings,
+    my_APP_settings,
+    /* Terminate list */
+    NULL
+};
+
+static int cfg_callback(struct ini_parser *pINI, bool *handled)
+{
+    int x;
+    int r;
+
+    for(x = 0 ; ini_cb_table[x] ; x++)
+    {
+        r = (*(ini_cb_table[x]))(pINI, handled);
+        if(*handled)
+        {
+            return r;
+        }
+    }
+    /* let the system handle it */
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int r;
+    const char *cfg_filename;
+
+    cfg_filename = "mac_sim.cfg";
+
+    switch(argc)
+    {
+    default:
+        fprintf(stderr, "Usage: %s [CONFIGFILE]\n", argv[0]);
+        fprintf(stderr, "\n");
+        fprintf(stderr, "Default CONFIGFILE = %s\n", cfg_filename);
+        exit(1);
+    case 1:
+        /* use default */
+        break;
+    case 2:
+        cfg_filename = argv[1];
+        break;
+    }
+
+    /* Basic initialization */
+    SOCKET_init();
+    STREAM_init();
+    TIMER_init();
+    LOG_init("/dev/stderr");
+    /* we want these logs to begin with */
+    log_cfg.log_flags = LOG_FATAL | LOG_WARN | LOG_ERROR;
+
+    APP_defaults();
+
+    /* Read our configuration file */
+    r = INI_read(cfg_filename, cfg_callback, 0);
+    if(r != 0)
+    {
+        FATAL_printf("Failed to read cfg file\n");
+    }
+
+    /* all msg-dbg-data files are loaded, index them */
+    MT_MSG_dbg_buildIndex(ALL_MT_MSG_DBG);
+
+    APP_main();
+
+    exit(0);
+}
+
+/*
+ *  ========================================
+ *  Texas Instruments Micro Controller Style
+ *  ========================================
+ *  Local Variables:
+ *  mode: c
+ *  c-file-style: "bsd"
+ *  tab-width: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  End:
+ *  vim:set  filetype=c tabstop=4 shiftwidth=4 expandtab=true
+ */
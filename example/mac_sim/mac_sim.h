@@ -0,0 +1,96 @@
+/******************************************************************************
+ @file mac_sim.h
+
+ @brief TIMAC 2.0 API simulated MAC co-processor primary app header.
+
+ Group: WCS LPC
+ $Target Device: DEVICES $
+
+ ******************************************************************************
+ $License: BSD3 2016 $
+ ******************************************************************************
+ $Release Name: PACKAGE NAME $
+ $Release Date: PACKAGE RELEASE DATE $
+ *****************************************************************************/
+
+#include "stream.h"
+#include "stream_uart.h"
+#include "stream_socket.h"
+#include "log.h"
+
+#include "mt_msg.h"
+
+/*!
+ * @struct mac_sim_cfg
+ * @brief What the simulated network looks like, see [mac-sim] in mac_sim.cfg
+ */
+struct mac_sim_cfg {
+    /*! true: listen on a socket, false: use a pseudo terminal */
+    bool use_socket;
+
+    /*! if not null, a symlink to the pseudo terminal slave is made here */
+    char *pty_link;
+
+    /*! number of virtual sensors behind each co-processor */
+    int n_sensors;
+
+    /*! 0 means use the interval the collector configures */
+    int report_interval_mSecs;
+
+    /*! how often an unjoined sensor sends an associate indication */
+    int join_interval_mSecs;
+
+    /*! percent of frames that are lost, in both directions */
+    int loss_percent;
+
+    /*! true if the sensors are sleepy (not rx-on-when-idle) */
+    bool sleepy;
+
+    /*! security level of sensor frames, 0 is none */
+    int security_level;
+
+    /*! co-processor extended address, sensors are base+1, base+2 ... */
+    uint64_t ext_addr_base;
+
+    /*! how often statistics are logged, 0 is never */
+    int stats_interval_mSecs;
+
+    /*! if not null, replay the rx frames of this capture to the host */
+    char *replay_file;
+
+    /*! if not null, only replay frames captured on this interface */
+    char *replay_iface;
+
+    /*! 0 is as fast as possible, 1 is as captured, N is N times faster */
+    int replay_speed;
+
+    /*! how many times the capture is played */
+    int replay_loops;
+};
+
+extern struct mac_sim_cfg sim_cfg;
+
+extern struct uart_cfg my_uart_cfg;
+extern struct socket_cfg my_socket_cfg;
+
+extern struct mt_msg_interface uart_interface_template;
+extern struct mt_msg_interface socket_interface_template;
+
+void APP_defaults(void);
+
+void APP_main(void);
+
+/*
+ *  ========================================
+ *  Texas Instruments Micro Controller Style
+ *  ========================================
+ *  Local Variables:
+ *  mode: c
+ *  c-file-style: "bsd"
+ *  tab-width: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  End:
+ *  vim:set  filetype=c tabstop=4 shiftwidth=4 expandtab=true
+ */
+
@@ -28,6 +28,9 @@
 
 #include "stream.h"
 
+/* uart to socket thread forwards at most this many areqs per wakeup */
+#define U2S_MAX_MSGS_PER_WAKEUP 16
+
 struct uart_cfg my_uart_cfg;
 struct socket_cfg my_socket_cfg;
 struct mt_msg_interface common_uart_interface;
@@ -38,6 +41,7 @@ static bool     server_thread_ready;
 static intptr_t uart_mutex;
 
 struct mt_msg_interface socket_interface_template;
+struct npi_areq_cfg npi_areq_cfg;
 
 struct npi_connection {
     /* has something gone wrong this is set to true */
@@ -188,6 +192,9 @@ void APP_defaults(void)
     socket_interface_template.flush_timeout_mSecs = 50;
     socket_interface_template.intermsg_timeout_mSecs = 3000;
 
+    npi_areq_cfg.capacity = 1024;
+    npi_areq_cfg.policy = MT_MSG_LIST_POLICY_drop_oldest;
+    npi_areq_cfg.block_mSecs = 1000;
 }
 
 /*!
@@ -217,6 +224,9 @@ static intptr_t u2s_thread(intptr_t cookie)
 {
     struct npi_connection *pCONN;
     struct mt_msg *pMsg;
+    struct mt_msg *msgs[ U2S_MAX_MSGS_PER_WAKEUP ];
+    int n;
+    int x;
 
     pCONN = (struct npi_connection *)(cookie);
     pCONN->uart_ready = true;
@@ -244,34 +254,36 @@ static intptr_t u2s_thread(intptr_t cookie)
             break;
         }
 
-        /* wait for an AREQ to come in */
-        pMsg = MT_MSG_LIST_remove(&(pCONN->socket_interface),
-                                   &(pCONN->areq_list), 5000);
-        if( pCONN->is_dead ){
-            continue;
-        }
-        if(pMsg == NULL)
+        /* wait for an AREQ to come in, take all that are ready */
+        n = MT_MSG_LIST_removeN(&(pCONN->socket_interface),
+                                &(pCONN->areq_list),
+                                msgs, U2S_MAX_MSGS_PER_WAKEUP, 5000);
+        for(x = 0 ; x < n ; x++)
         {
-            /* no areq.. timeout.. */
-            continue;
-        }
+            pMsg = msgs[x];
+            if(pCONN->is_dead)
+            {
+                MT_MSG_free(pMsg);
+                continue;
+            }
 
-        /* we just transmit it to the socket */
-        MT_MSG_setDestIface(pMsg, &(pCONN->socket_interface));
+            /* we just transmit it to the socket */
+            MT_MSG_setDestIface(pMsg, &(pCONN->socket_interface));
 
-        /* but first, we must reformat for the socket */
-        MT_MSG_reformat(pMsg);
+            /* but first, we must reformat for the socket */
+            MT_MSG_reformat(pMsg);
 
-        /* we just send it */
-        MT_MSG_txrx(pMsg);
+            /* we just send it */
+            MT_MSG_txrx(pMsg);
 
-        MT_MSG_log(LOG_DBG_MT_MSG_traffic, pMsg, "*** Sending UART Data to "
-            "socket (%s -> %s). Sequence ID: %d Length: %d\n",
-            pMsg->pSrcIface->dbg_name, pMsg->pDestIface->dbg_name,
-            pMsg->sequence_id, pMsg->expected_len);
+            MT_MSG_log(LOG_DBG_MT_MSG_traffic, pMsg, "*** Sending UART Data to "
+                "socket (%s -> %s). Sequence ID: %d Length: %d\n",
+                pMsg->pSrcIface->dbg_name, pMsg->pDestIface->dbg_name,
+                pMsg->sequence_id, pMsg->expected_len);
 
-        /* we don't need this any more */
-        MT_MSG_free(pMsg);
+            /* we don't need this any more */
+            MT_MSG_free(pMsg);
+        }
     }
     pCONN->u2s_busy = false;
 
@@ -595,26 +607,21 @@ static intptr_t uart_thread(intptr_t _notused)
         {
             continue;
         }
+        MT_MSG_stamp(pMsg, MT_MSG_STAMP_rx_dequeue);
 
         /* and send it to all active connections. */
         lock_connection_list();
         pCONN = all_connections;
         while(pCONN)
         {
-            /* assume we can send *THIS* message */
-            pSend = pMsg;
-            /* if there are more connections.. */
-            if(pCONN->pNext)
+            /* each connection gets a share, the payload is not copied */
+            pSend = MT_MSG_share(pMsg);
+            if(pSend == NULL)
             {
-                /* then we send a clone instead */
-                pSend = MT_MSG_clone(pSend);
-                if(pSend == NULL)
-                {
-                    /* nothing here clone printed an error */
-                }
+                /* nothing here share printed an error */
             }
 
-            /* handle case where clone failed, don't send null pointer */
+            /* handle case where share failed, don't send null pointer */
             if(pSend)
             {
                 /* and give it to the connections thread to process */
@@ -628,6 +635,10 @@ static intptr_t uart_thread(intptr_t _notused)
             pCONN = pCONN->pNext;
         }
         unlock_connection_list();
+
+        /* the shares keep the payload until they are sent */
+        MT_MSG_stamp(pMsg, MT_MSG_STAMP_rx_handled);
+        MT_MSG_free(pMsg);
     }
 
     uart_thread_ready = 0;
@@ -711,6 +722,11 @@ static intptr_t server_thread(intptr_t _notused)
                 BUG_HERE("No memory\n");
             }
             MT_MSG_LIST_create(&(pCONN->areq_list), pCONN->dbg_name, "areq");
+            MT_MSG_LIST_setLimit(&(pCONN->areq_list),
+                                 (unsigned)(npi_areq_cfg.capacity),
+                                 npi_areq_cfg.policy,
+                                 npi_areq_cfg.block_mSecs,
+                                 MT_MSG_coalesceDataInd);
         }
 
         /* wait for a connection.. */
@@ -82,6 +82,9 @@ static int my_MT_MSG_INI_settings(struct ini_parser *pINI, bool *handled)
     return r;
 }
 
+/*! If not NULL, every MT frame is captured here, see MT_MSG_CAPTURE_start() */
+static const char *mt_capture_filename;
+
 static int my_APP_settings(struct ini_parser *pINI, bool *handled)
 {
     if(!INI_itemMatches(pINI, "application", NULL))
@@ -89,6 +92,45 @@ static int my_APP_settings(struct ini_parser *pINI, bool *handled)
         return 0;
     }
 
+    if(INI_itemMatches(pINI, NULL, "mt-capture"))
+    {
+        INI_dequote(pINI);
+        mt_capture_filename = INI_itemValue_strdup(pINI);
+        *handled = true;
+        return 0;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "areq-capacity"))
+    {
+        npi_areq_cfg.capacity = INI_valueAsInt(pINI);
+        *handled = true;
+        return 0;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "areq-block-msecs"))
+    {
+        npi_areq_cfg.block_mSecs = INI_valueAsInt(pINI);
+        *handled = true;
+        return 0;
+    }
+
+    if(INI_itemMatches(pINI, NULL, "areq-policy"))
+    {
+        int policy;
+
+        INI_dequote(pINI);
+        policy = MT_MSG_LIST_policyFromName(pINI->item_value);
+        if(policy < 0)
+        {
+            INI_syntaxError(pINI, "areq-policy must be: drop-oldest, "
+                            "drop-newest, block or coalesce\n");
+            return -1;
+        }
+        npi_areq_cfg.policy = (enum mt_msg_list_policy)(policy);
+        *handled = true;
+        return 0;
+    }
+
     if(INI_itemMatches(pINI,NULL,"msg-dbg-data"))
     {
         struct mt_msg_dbg **ppDbg;
@@ -172,6 +214,17 @@ int main(int argc, char **argv)
         FATAL_printf("Failed to read cfg file\n");
     }
 
+    /* all msg-dbg-data files are loaded, index them */
+    MT_MSG_dbg_buildIndex(ALL_MT_MSG_DBG);
+
+    if(mt_capture_filename)
+    {
+        if(MT_MSG_CAPTURE_start(mt_capture_filename) != 0)
+        {
+            FATAL_printf("Cannot capture to: %s\n", mt_capture_filename);
+        }
+    }
+
     APP_main();
 
     exit(0);
@@ -26,6 +26,25 @@ extern struct socket_cfg my_socket_cfg;
 extern struct mt_msg_interface common_uart_interface;
 extern struct mt_msg_interface socket_interface_template;
 
+/*!
+ * @struct npi_areq_cfg
+ * @brief Limits of the per connection AREQ list, see [application]
+ *
+ * A client that stops reading would otherwise keep every AREQ.
+ */
+struct npi_areq_cfg {
+    /*! most AREQs waiting for a client, 0 is unbounded */
+    int capacity;
+
+    /*! what a full list does */
+    enum mt_msg_list_policy policy;
+
+    /*! block policy: how long the uart thread waits for a client */
+    int block_mSecs;
+};
+
+extern struct npi_areq_cfg npi_areq_cfg;
+
 void APP_defaults(void);
 
 void APP_main(void);
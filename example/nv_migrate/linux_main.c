@@ -0,0 +1,147 @@
+/******************************************************************************
+ @file linux_main.c
+
+ @brief TIMAC 2.0 API Linux "main" for the NV migration tool
+
+ Group: CMCU LPC
+ $Target Device: DEVICES $
+
+ ******************************************************************************
+ $License: BSD3 2019 $
+ ******************************************************************************
+ $Release Name: PACKAGE NAME $
+ $Release Date: PACKAGE RELEASE DATE $
+ *****************************************************************************/
+
+/*
+ * Overview
+ * ========
+ *
+ * Copies the items in the NV simulation file ([nv] filename) into a
+ * new NV log ([nv] log-filename), the same copy the collector does on
+ * startup with [nv] backend = log and migrate = true. Only the [nv]
+ * section of the configuration file is used, so the collector's own
+ * file works, for example:
+ *
+ *    bash$ ./host_nv_migrate collector.cfg
+ *
+ * An existing log is left alone, remove its segment files first.
+ * A log with an interrupted migration is completed.
+ */
+
+#include "ini_file.h"       /* this reads our ini file */
+#include "log.h"            /* our logging scheme */
+#include "stream.h"
+#include "timer.h"
+#include "fatal.h"
+#include "nv_linux.h"
+#include "nvlog.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+const struct ini_flag_name * const log_flag_names[] = {
+    log_builtin_flag_names,
+    /* see nv_linux.c */
+    nv_log_flags,
+    /* terminate */
+    NULL
+};
+
+/*!
+ * @brief Use the [nv] settings, ignore everything else
+ * @param pINI - ini file parse info
+ * @param handled - set to true if the item was handled
+ */
+static int cfg_callback(struct ini_parser *pINI, bool *handled)
+{
+    if(INI_itemMatches(pINI, "nv", NULL))
+    {
+        return (NV_LINUX_INI_settings(pINI, handled));
+    }
+
+    /* the rest is for the application */
+    *handled = true;
+    return (0);
+}
+
+int main(int argc, char **argv)
+{
+    NVINTF_nvFuncts_t nv;
+    struct nvlog_stats stats;
+    const char *cfg_filename;
+    int r;
+
+    cfg_filename = "collector.cfg";
+
+    switch(argc)
+    {
+    default:
+        fprintf(stderr, "Usage: %s [CONFIGFILE]\n", argv[0]);
+        fprintf(stderr, "\n");
+        fprintf(stderr, "Default CONFIGFILE = %s\n", cfg_filename);
+        exit(1);
+    case 1:
+        /* use default */
+        break;
+    case 2:
+        cfg_filename = argv[1];
+        break;
+    }
+
+    /* Basic initialization */
+    STREAM_init();
+    TIMER_init();
+    LOG_init("/dev/stderr");
+    log_cfg.log_flags = LOG_FATAL | LOG_WARN | LOG_ERROR;
+
+    r = INI_read(cfg_filename, cfg_callback, 0);
+    if(r != 0)
+    {
+        FATAL_printf("Failed to read cfg file\n");
+    }
+
+    /* The NV simulation file must be loaded to be migrated */
+    linux_CONFIG_NV_RESTORE = true;
+
+    NVLOG_loadApiPtrs(&nv);
+    if(nv.initNV(NULL) != NVINTF_SUCCESS)
+    {
+        FATAL_printf("Cannot open the NV log: %s\n", NVLOG_cfg.filename);
+    }
+    NVLOG_getStats(&stats);
+    r = NV_LINUX_migrateState(&nv);
+    if((r == NV_LINUX_MIGRATE_done) ||
+       ((r == NV_LINUX_MIGRATE_none) && (stats.n_items != 0)))
+    {
+        fprintf(stderr, "%s: the NV log exists, %u items, not migrating\n",
+                NVLOG_cfg.filename, stats.n_items);
+        exit(1);
+    }
+
+    r = NV_LINUX_migrate(&nv);
+    if(r < 0)
+    {
+        fprintf(stderr, "Migration failed\n");
+        exit(1);
+    }
+    NVLOG_getStats(&stats);
+    printf("Migrated %d items, log: %s, %u segments, %llu bytes\n",
+           r, NVLOG_cfg.filename, stats.n_segments,
+           (unsigned long long)stats.total_bytes);
+    exit(0);
+}
+
+/*
+ *  ========================================
+ *  Texas Instruments Micro Controller Style
+ *  ========================================
+ *  Local Variables:
+ *  mode: c
+ *  c-file-style: "bsd"
+ *  tab-width: 4
+ *  c-basic-offset: 4
+ *  indent-tabs-mode: nil
+ *  End:
+ *  vim:set  filetype=c tabstop=4 shiftwidth=4 expandtab=true
+ */
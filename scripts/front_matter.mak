@@ -240,6 +240,14 @@ ${OBJDIR}:
 CFLAGS_STRICT= -Wshadow -Wpointer-arith -Wcast-qual 
 CFLAGS +=-Wall -Wmissing-prototypes -Wstrict-prototypes -Iinc 
 
+# Release builds, ie:  bash$ make RELEASE=1 remake
+#    Optimize, and inline the MT_MSG field readers/writers
+#    (the per field debug log is not available, see mt_msg.h)
+#    Release and debug objects share OBJDIR, so rebuild when switching.
+ifeq (${RELEASE},1)
+CFLAGS += -O2 -DMT_MSG_FAST_FIELDS=1
+endif
+
 # Compile
 #  NOTE: "-MMD" and "-MF" create compiler dependancy files
 #        Which we load below with an include statement.